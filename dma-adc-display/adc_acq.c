@@ -0,0 +1,322 @@
+#include "adc_acq.h"
+#include "hal.h"
+#include "prof.h"
+
+#ifdef ACQ_REPLAY
+    // Generated, not in the repository: python util/ecg_convert.py <record> --c-header
+    // dma-adc-display/ecg_replay_data.h (see adc_acq.h)
+    #if defined(__has_include)
+        #if !__has_include("ecg_replay_data.h")
+            #error "ACQ_REPLAY needs ecg_replay_data.h, made by util/ecg_convert.py --c-header"
+        #endif
+    #endif
+    #include "ecg_replay_data.h"
+#endif
+
+// log2 of the CIC gain, ACQ_OVERSAMPLE^2, less the extra bits kept
+#if ACQ_OVERSAMPLE == 4
+    #define ACQ_OVS_SHIFT (4 - ACQ_OVS_BITS)
+#elif ACQ_OVERSAMPLE == 8
+    #define ACQ_OVS_SHIFT (6 - ACQ_OVS_BITS)
+#elif ACQ_OVERSAMPLE == 16
+    #define ACQ_OVS_SHIFT (8 - ACQ_OVS_BITS)
+#elif ACQ_OVERSAMPLE != 1
+    #error "ACQ_OVERSAMPLE must be 1, 4, 8 or 16"
+#endif
+
+// The DMA writes straight into the segment ring (one channel, or interleaved channels) rather than
+// into a staging pair the ISR copies from (oversampling, planar channels)
+#define ACQ_DMA_TO_RING (ACQ_OVERSAMPLE == 1 && ACQ_CHANNEL_STRIDE == ACQ_CHANNELS)
+
+// --- Private Variables ---
+static uint16_t acq_buffer[ACQ_BUFFER_SAMPLES * ACQ_CHANNELS];
+static uint16_t acq_len = ACQ_DEFAULT_SEGMENT_LEN;
+static uint16_t acq_count = ACQ_DEFAULT_SEGMENT_COUNT;
+
+static volatile uint16_t acq_fill_slot = 0; // Slot the DMA is writing
+#if ACQ_DMA_TO_RING
+static uint16_t acq_armed_slot = 0; // Slot loaded into DMA0DA for the next reload
+#endif
+static uint32_t acq_samples = 0; // Samples (per channel) completed since acq_init()
+#ifdef ACQ_REPLAY
+static uint16_t acq_replay_pos = 0; // Next sample of acq_replay_samples
+#endif
+#if ACQ_OVERSAMPLE > 1
+static uint16_t acq_raw[2][ACQ_OVS_BLOCK_MAX]; // Conversions, filled by the DMA in turn
+static uint16_t acq_raw_len; // Conversions per raw block, a multiple of ACQ_OVERSAMPLE
+static uint8_t acq_raw_fill = 0; // Raw block the DMA is writing
+static uint16_t acq_out_pos = 0; // Next output sample in the slot being filled
+static uint8_t acq_cic_primed = 0;
+static uint32_t acq_cic_i1, acq_cic_i2; // Integrators, wrap freely
+static uint32_t acq_cic_c1, acq_cic_c2; // Comb delays
+#endif
+#if ACQ_CHANNELS > 1
+static uint16_t acq_set_pos = 0; // Sample set being written in the filling slot
+#endif
+#if ACQ_CHANNELS > 1 && ACQ_DMA_TO_RING
+static uint16_t acq_armed_pos = 0; // Sample set of acq_armed_slot loaded into DMA0DA
+#elif ACQ_CHANNELS > 1
+static uint16_t acq_stage[2][ACQ_CHANNELS]; // Sample sets, filled by the DMA in turn
+static uint8_t acq_stage_fill = 0; // Staging set the DMA is writing
+#endif
+
+SegQueue acq_queue;
+
+// --- Private Function Prototypes ---
+static uint16_t acq_next_slot(uint16_t slot);
+static void acq_segment_done(void);
+#if ACQ_DMA_TO_RING
+static void acq_set_dest(uint16_t slot, uint16_t set);
+#endif
+#if ACQ_OVERSAMPLE > 1
+static uint16_t acq_raw_block_len(uint16_t segment_len);
+static void acq_decimate(const uint16_t* raw, uint16_t* out, uint16_t count);
+#endif
+#ifdef ACQ_REPLAY
+static void acq_replay_fill(uint16_t* dst, uint16_t count);
+#endif
+
+// --- Function Implementations ---
+
+int acq_init(uint16_t segment_len, uint16_t segment_count) {
+    if (segment_len == 0 || segment_len > ACQ_MAX_SEGMENT_LEN || segment_count < ACQ_MIN_SEGMENTS
+        || segment_count > ACQ_MAX_SEGMENTS
+        || (uint32_t)segment_len * segment_count > ACQ_BUFFER_SAMPLES) {
+        return 0;
+    }
+
+    DMA0CTL &= ~DMAEN;
+    acq_len = segment_len;
+    acq_count = segment_count;
+    acq_samples = 0;
+#ifdef ACQ_REPLAY
+    acq_replay_pos = 0;
+#endif
+    segq_init(&acq_queue, segment_count - 1); // A queued slot must not be the one being refilled
+
+    // Trigger 24: ADC12IFGx; in sequence mode only the last conversion of the sequence triggers
+    DMACTL0 = (DMACTL0 & ~DMA0TSEL_31) | DMA0TSEL_24;
+
+#if ACQ_CHANNELS > 1
+    // Repeated block transfer: each trigger moves ADC12MEM0..n as one block, then the channel
+    // reloads DMA0SA, DMA0DA and DMA0SZ, raises DMA0IFG and stays enabled
+    DMA0CTL = DMADT_5 | DMASRCINCR_3 | DMADSTINCR_3 | DMAIE;
+    DMA0SZ = ACQ_CHANNELS;
+    acq_set_pos = 0;
+#else
+    // Repeated single transfer: after DMA0SZ words the channel reloads DMA0SA, DMA0DA and DMA0SZ,
+    // raises DMA0IFG and stays enabled, so no conversion is lost while the ISR is pending
+    DMA0CTL = DMADT_4 | DMASRCINCR_0 | DMADSTINCR_3 | DMAIE;
+#endif
+    __data20_write_long((unsigned long)&DMA0SA, (unsigned long)&ADC12MEM0);
+    acq_fill_slot = 0;
+
+#if ACQ_CHANNELS > 1 && ACQ_DMA_TO_RING
+    // Interleaved: the DMA writes the ring one sample set after the other
+    acq_set_dest(0, 0);
+    DMA0CTL |= DMAEN;
+    acq_armed_slot = 0;
+    acq_armed_pos = 1 % acq_len;
+    if (acq_armed_pos == 0) {
+        acq_armed_slot = acq_next_slot(0);
+    }
+    acq_set_dest(acq_armed_slot, acq_armed_pos);
+#elif ACQ_CHANNELS > 1
+    // Planar: the DMA alternates between the two staging sets, the ISR scatters them
+    acq_stage_fill = 0;
+    __data20_write_long((unsigned long)&DMA0DA, (unsigned long)acq_stage[0]);
+    DMA0CTL |= DMAEN;
+    __data20_write_long((unsigned long)&DMA0DA, (unsigned long)acq_stage[1]);
+#elif ACQ_OVERSAMPLE > 1
+    // The DMA alternates between the two raw blocks; the segment slots are written by the decimator
+    acq_raw_len = acq_raw_block_len(segment_len);
+    acq_raw_fill = 0;
+    acq_out_pos = 0;
+    acq_cic_primed = 0;
+    DMA0SZ = acq_raw_len;
+    __data20_write_long((unsigned long)&DMA0DA, (unsigned long)acq_raw[0]);
+    DMA0CTL |= DMAEN;
+    __data20_write_long((unsigned long)&DMA0DA, (unsigned long)acq_raw[1]);
+#else
+    DMA0SZ = acq_len;
+    acq_set_dest(0, 0);
+    DMA0CTL |= DMAEN; // Slot 0 is latched into the working registers here
+    acq_armed_slot = acq_next_slot(0);
+    acq_set_dest(acq_armed_slot, 0); // Picked up at the end of slot 0
+#endif
+    return 1;
+}
+
+uint16_t acq_segment_len(void) {
+    return acq_len;
+}
+
+uint16_t acq_segment_count(void) {
+    return acq_count;
+}
+
+uint16_t acq_filling_segment(void) {
+    return acq_fill_slot;
+}
+
+int acq_segment_intact(const SegDesc* seg) {
+    // acq_samples is the first sample of the slot being filled; the segment's slot is refilled
+    // from acq_count segments after its own start
+    return acq_samples - seg->start_sample < (uint32_t)acq_len * acq_count;
+}
+
+int acq_dma_isr(void) {
+#if ACQ_CHANNELS > 1 && ACQ_DMA_TO_RING
+    // The DMA has moved on to the armed set; arm the one after it
+    if (++acq_armed_pos >= acq_len) {
+        acq_armed_pos = 0;
+        acq_armed_slot = acq_next_slot(acq_armed_slot);
+    }
+    acq_set_dest(acq_armed_slot, acq_armed_pos);
+    if (++acq_set_pos < acq_len) {
+        return 0;
+    }
+    acq_set_pos = 0;
+#elif ACQ_CHANNELS > 1
+    // The DMA has moved on to the other staging set. The one just filled is armed for the reload
+    // after that, so it has to be scattered within one sample period.
+    const uint16_t* set = acq_stage[acq_stage_fill];
+    uint16_t* dst = &acq_buffer[acq_fill_slot * acq_len * ACQ_CHANNELS + acq_set_pos];
+    uint8_t ch;
+
+    acq_stage_fill ^= 1;
+    __data20_write_long((unsigned long)&DMA0DA, (unsigned long)set);
+    for (ch = 0; ch < ACQ_CHANNELS; ch++) {
+        *dst = set[ch];
+        dst += acq_len;
+    }
+    if (++acq_set_pos < acq_len) {
+        return 0;
+    }
+    acq_set_pos = 0;
+#elif ACQ_OVERSAMPLE > 1
+    // The DMA has moved on to the other raw block. The one just filled is armed for the reload
+    // after that, so it has to be decimated within one block time.
+    const uint16_t* raw = acq_raw[acq_raw_fill];
+    uint16_t count = acq_raw_len / ACQ_OVERSAMPLE;
+
+    acq_raw_fill ^= 1;
+    __data20_write_long((unsigned long)&DMA0DA, (unsigned long)raw);
+    PROF_BEGIN(PROF_CIC);
+    acq_decimate(raw, &acq_buffer[acq_fill_slot * acq_len + acq_out_pos], count);
+    PROF_END(PROF_CIC);
+    acq_out_pos += count;
+    if (acq_out_pos < acq_len) {
+        return 0;
+    }
+    acq_out_pos = 0;
+#endif
+    acq_segment_done();
+    return 1;
+}
+
+static uint16_t acq_next_slot(uint16_t slot) {
+    slot++;
+    return (slot >= acq_count) ? 0 : slot;
+}
+
+#if ACQ_DMA_TO_RING
+static void acq_set_dest(uint16_t slot, uint16_t set) {
+    uint16_t* dst = &acq_buffer[(slot * acq_len + set) * ACQ_CHANNELS];
+    __data20_write_long((unsigned long)&DMA0DA, (unsigned long)dst);
+}
+#endif
+
+// Publishes the slot that was just completed and moves on to the next
+static void acq_segment_done(void) {
+    SegDesc seg;
+
+    seg.data = &acq_buffer[acq_fill_slot * acq_len * ACQ_CHANNELS];
+    seg.num_samples = acq_len;
+    seg.slot = acq_fill_slot;
+    seg.start_sample = acq_samples;
+    seg.flags = 0;
+    acq_samples += acq_len;
+#if ACQ_OVERSAMPLE > 1 || ACQ_CHANNELS > 1
+    acq_fill_slot = acq_next_slot(acq_fill_slot);
+#else
+    // The hardware has already switched to the armed slot; arm the one after it
+    acq_fill_slot = acq_armed_slot;
+    acq_armed_slot = acq_next_slot(acq_armed_slot);
+    acq_set_dest(acq_armed_slot, 0);
+#endif
+
+#ifdef ACQ_REPLAY
+    acq_replay_fill((uint16_t*)seg.data, acq_len);
+#endif
+    segq_push(&acq_queue, &seg);
+}
+
+#if ACQ_OVERSAMPLE > 1
+// Raw block length: whole output samples that divide the segment evenly, so a segment always ends
+// on a block boundary, and as many as fit in ACQ_OVS_BLOCK_MAX to keep the ISR rate down
+static uint16_t acq_raw_block_len(uint16_t segment_len) {
+    uint16_t parts;
+
+    for (parts = 1; parts < segment_len; parts++) {
+        if (segment_len % parts == 0 && segment_len / parts * ACQ_OVERSAMPLE <= ACQ_OVS_BLOCK_MAX) {
+            break;
+        }
+    }
+    return segment_len / parts * ACQ_OVERSAMPLE;
+}
+
+// Second-order CIC: y = sum of 2 * ACQ_OVERSAMPLE - 1 conversions weighted 1, 2 .. R .. 2, 1,
+// divided by the gain R^2 with rounding, times 2^ACQ_OVS_BITS
+static void acq_decimate(const uint16_t* raw, uint16_t* out, uint16_t count) {
+    uint32_t i1 = acq_cic_i1;
+    uint32_t i2 = acq_cic_i2;
+    uint8_t k;
+
+    if (!acq_cic_primed) {
+        // Start as if the first conversion had always been the input, not from a step up from 0:
+        // with i1 = i2 = 0 now, the comb delays are those of a constant input raw[0]
+        acq_cic_primed = 1;
+        i1 = 0;
+        i2 = 0;
+        acq_cic_c1 = 0;
+        acq_cic_c2 = 0 - (uint32_t)raw[0] * (ACQ_OVERSAMPLE * (ACQ_OVERSAMPLE - 1) / 2);
+    }
+    while (count--) {
+        uint32_t d1, d2;
+
+        for (k = 0; k < ACQ_OVERSAMPLE; k++) {
+            i1 += *raw++;
+            i2 += i1;
+        }
+        d1 = i2 - acq_cic_c1;
+        acq_cic_c1 = i2;
+        d2 = d1 - acq_cic_c2;
+        acq_cic_c2 = d1;
+        *out++ = (uint16_t)((d2 + (1UL << (ACQ_OVS_SHIFT - 1))) >> ACQ_OVS_SHIFT);
+    }
+    acq_cic_i1 = i1;
+    acq_cic_i2 = i2;
+}
+#endif
+
+#ifdef ACQ_REPLAY
+// Every channel gets the same recorded lead
+static void acq_replay_fill(uint16_t* dst, uint16_t count) {
+    uint16_t i;
+    uint8_t ch;
+
+    for (i = 0; i < count; i++) {
+        for (ch = 0; ch < ACQ_CHANNELS; ch++) {
+#if ACQ_CHANNEL_STRIDE == 1
+            dst[ch * count + i] = acq_replay_samples[acq_replay_pos] << ACQ_OVS_BITS;
+#else
+            dst[i * ACQ_CHANNELS + ch] = acq_replay_samples[acq_replay_pos] << ACQ_OVS_BITS;
+#endif
+        }
+        if (++acq_replay_pos >= ACQ_REPLAY_LEN) {
+            acq_replay_pos = 0;
+        }
+    }
+}
+#endif
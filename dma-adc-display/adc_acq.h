@@ -0,0 +1,162 @@
+#ifndef ADC_ACQ_H_
+#define ADC_ACQ_H_
+
+#include "seg_queue.h"
+#include <stdint.h>
+
+// --- Configuration ---
+// ADC inputs captured, bit n = An (P6.n): 1, 2 or 4 of A0..A7, so the timer period stays exact.
+// ADC12 runs a repeated sequence over them into ADC12MEM0.., one conversion per timer trigger
+// (the timer runs at ACQ_CHANNELS times the sample rate, see timebase.h), and at the end of each
+// sequence DMA channel 0 moves the whole sample set as one block. Channel k of a segment is the
+// k-th lowest input, sampled k / ACQ_CHANNELS of a sample period after channel 0. Channel 0 is
+// the primary lead, the one the QRS detector runs on.
+#ifndef ACQ_CHANNEL_MASK
+    #define ACQ_CHANNEL_MASK 0x01
+#endif
+// Number of inputs set in an 8-bit mask, usable in #if
+#define ACQ_MASK_COUNT(m)                                                                          \
+    (((m) & 1) + ((m) >> 1 & 1) + ((m) >> 2 & 1) + ((m) >> 3 & 1) + ((m) >> 4 & 1)                 \
+     + ((m) >> 5 & 1) + ((m) >> 6 & 1) + ((m) >> 7 & 1))
+#define ACQ_CHANNELS ACQ_MASK_COUNT(ACQ_CHANNEL_MASK)
+#define ACQ_MAX_CHANNELS 4 // Capture RAM is ACQ_BUFFER_SAMPLES words per channel
+
+#if (ACQ_CHANNELS != 1 && ACQ_CHANNELS != 2 && ACQ_CHANNELS != 4) || ACQ_CHANNEL_MASK > 0xFF
+    #error "ACQ_CHANNEL_MASK must select 1, 2 or 4 of the inputs A0..A7"
+#endif
+
+// Segment layout with more than one channel. By default the sample sets follow each other
+// (interleaved), as the DMA writes them and as ECG_TYPE_SAMPLES frames carry them. With ACQ_PLANAR
+// defined each channel's samples are contiguous instead (ECG_TYPE_SAMPLES_PLANAR): the DMA fills
+// a pair of one-set staging blocks and the ISR scatters them. Consumers read channel k from
+// acq_channel_data() in steps of ACQ_CHANNEL_STRIDE either way.
+//
+// With more than one channel DMA0IFG comes once per sample set, not per segment, since the DMA
+// destination has to move on after every block. That costs about 50 MCLK per set (interleaved)
+// or 50 + 6 per channel (planar): 0.5% of the CPU at 2 kHz.
+#if ACQ_CHANNELS > 1 && defined(ACQ_PLANAR)
+    #define ACQ_CHANNEL_STRIDE 1
+#else
+    #define ACQ_CHANNEL_STRIDE ACQ_CHANNELS
+#endif
+
+// Capture memory per channel shared by all segments; segment_len * segment_count must fit
+#define ACQ_BUFFER_SAMPLES 640
+
+// Limits accepted by acq_init()
+#define ACQ_MIN_SEGMENTS 3 // Slot being filled, slot armed next, and at least one readable slot
+#define ACQ_MAX_SEGMENTS 32 // At most SEGQ_LEN: the queue depth, count - 1, has to stay below it
+#define ACQ_MAX_SEGMENT_LEN 64
+
+// Geometry used at start-up: 16 segments of 20 samples
+#define ACQ_DEFAULT_SEGMENT_LEN 20
+#define ACQ_DEFAULT_SEGMENT_COUNT 16
+
+// ADC conversions per output sample: 1 (off), 4, 8 or 16. Timer_A0 then triggers the ADC at
+// ACQ_OVERSAMPLE times the sample rate (timebase.h), and the DMA fills two alternating raw blocks
+// of at most ACQ_OVS_BLOCK_MAX conversions. The DMA ISR runs each block through a second-order
+// CIC decimator (two integrators at the conversion rate, two combs at the output rate) straight
+// into the segment ring, so segments, their sample rate and consumers are the same as without
+// oversampling, and the CPU reads every conversion exactly once.
+//
+// By default the output stays in 12-bit codes. What oversampling buys then is the ADC's own noise
+// averaged down (the decimator's noise gain is 2 / (3 x ACQ_OVERSAMPLE)), so the codes are quiet
+// to the last bit, and a sinc^2 anti-alias response with nulls at every multiple of the sample
+// rate: mains harmonics and EMG above Nyquist no longer fold into the band. The price is some
+// passband droop (-0.7 dB at 0.16 x the sample rate, e.g. 40 Hz at 250 Hz, -3 dB at 0.32 x) and
+// a delay of about one output sample.
+//
+// ACQ_OVS_BITS keeps that many of the bits the decimator gains instead of rounding them off:
+// samples are then ACQ_SAMPLE_BITS wide, mid-scale at 1 << (ACQ_SAMPLE_BITS - 1). At most as
+// many bits as the noise went down by: 1 at x4 and x8, 2 at x16. Every consumer takes the width
+// from ACQ_SAMPLE_BITS (filter, QRS detector, trace), Rice blocks record it in their escape
+// width, and LINK_CMD_RATE_REPORT (uart_link.h) tells the host.
+//
+// The decimator's time is PROF_CIC (prof.h), one record per raw block; util/ecg_prof_bench.py
+// lists it with its share of the CPU for PROF builds of each ratio. Counting the instructions gives
+// 9 MCLK per conversion in the integrators and about 45 per output sample in the combs, i.e. 1.9%
+// of the 20 MHz MCLK at x16 and 2 kHz.
+#ifndef ACQ_OVERSAMPLE
+    #define ACQ_OVERSAMPLE 1
+#endif
+#if ACQ_OVERSAMPLE > 1 && ACQ_CHANNELS > 1
+    #error "Oversampling works on a single channel only"
+#endif
+#ifndef ACQ_OVS_BITS
+    #define ACQ_OVS_BITS 0
+#endif
+#if ACQ_OVS_BITS < 0 || ACQ_OVS_BITS > (ACQ_OVERSAMPLE >= 16 ? 2 : ACQ_OVERSAMPLE >= 4 ? 1 : 0)
+    #error "ACQ_OVS_BITS must be 0, or up to 1 at x4 and x8 and up to 2 at x16 oversampling"
+#endif
+#define ACQ_SAMPLE_BITS (12 + ACQ_OVS_BITS)
+#define ACQ_OVS_BLOCK_MAX 128
+
+// Build with ACQ_REPLAY defined to replace every captured segment with the next samples
+// of the flash-resident test vector in ecg_replay_data.h (made by util/ecg_convert.py
+// --c-header, not kept in the repository), looping at its end; its 12-bit codes are scaled up
+// to ACQ_SAMPLE_BITS. Timer_A0 and the ADC still pace the capture, so the rest of the firmware
+// runs under the same timing as with the live front end.
+
+// --- Public Variables ---
+// Completed segments, newest last. Each consumer reads it with its own cursor; a consumer
+// that lags by segment_count - 1 entries loses the oldest ones (counted in its cursor).
+extern SegQueue acq_queue;
+
+// --- Public Function Prototypes ---
+
+/**
+ * @brief Sets up DMA channel 0 to copy ADC12MEM0 into a ring of segments.
+ *
+ * The channel runs in repeated single-transfer mode, so it never has to be
+ * re-enabled and keeps sampling however late its interrupt is serviced. At
+ * each segment boundary the hardware reloads the destination address, which
+ * the ISR set one segment ahead of time. ADC12 and its trigger timer are
+ * configured separately. Finished segments are pushed to acq_queue.
+ *
+ * With more than one channel the channel runs in repeated block mode instead,
+ * one block of ADC12MEM0..ADC12MEMn per trigger, and the ISR sets the
+ * destination one sample set ahead.
+ * @param segment_len Samples per channel per segment, 1..ACQ_MAX_SEGMENT_LEN.
+ * @param segment_count Number of segments, ACQ_MIN_SEGMENTS..ACQ_MAX_SEGMENTS.
+ * @return 1 on success, 0 if the geometry does not fit the capture buffer.
+ */
+int acq_init(uint16_t segment_len, uint16_t segment_count);
+
+uint16_t acq_segment_len(void);
+uint16_t acq_segment_count(void);
+
+/**
+ * @brief Returns the first sample of one channel of a segment; the next ones follow every
+ * ACQ_CHANNEL_STRIDE words.
+ * @param channel 0..ACQ_CHANNELS - 1.
+ */
+static inline const uint16_t* acq_channel_data(const SegDesc* seg, uint8_t channel) {
+#if ACQ_CHANNEL_STRIDE == 1
+    return seg->data + (uint16_t)channel * seg->num_samples;
+#else
+    return seg->data + channel;
+#endif
+}
+
+/**
+ * @brief Returns the slot the DMA (or, when oversampling, the decimator) is writing to right now.
+ */
+uint16_t acq_filling_segment(void);
+
+/**
+ * @brief Tells whether capture has not yet come round to a segment's slot again, i.e. its
+ * samples are still the ones the descriptor was published with. A consumer that lags close to
+ * the queue depth can pop a segment whose slot the DMA starts refilling moments later. Call
+ * with interrupts disabled.
+ */
+int acq_segment_intact(const SegDesc* seg);
+
+/**
+ * @brief Handles DMA0IFG: publishes a finished segment, or decimates a raw block when
+ * oversampling, or moves on one sample set with more than one channel. Call from the shared
+ * DMA ISR.
+ * @return 1 if a segment was completed, i.e. acq_filling_segment() has moved on.
+ */
+int acq_dma_isr(void);
+
+#endif /* ADC_ACQ_H_ */
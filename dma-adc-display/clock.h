@@ -0,0 +1,12 @@
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+// Clock tree set up by init_clock() in main.c: MCLK from the DCO, locked by the FLL to XT2;
+// SMCLK straight from XT2. Every file that derives a divider or a delay from a clock takes it
+// from here (sim/sim_internal.h models the same frequencies).
+
+#define XT2_FREQ 4000000UL // XT2 crystal
+#define MCLK_FREQ 20000000UL // DCO, FLLN = MCLK_FREQ / (XT2_FREQ / 16) - 1
+#define SMCLK_FREQ XT2_FREQ // Clocks the ADC, Timer_A0 and both USCIs
+
+#endif /* CLOCK_H_ */
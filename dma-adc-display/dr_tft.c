@@ -1,5 +1,5 @@
 #include "dr_tft.h"
-#include <msp430.h>
+#include "hal.h"
 
 //--------------P5.0---------------------------------
 #define LCD_CS_SET P5OUT |= 0x01
@@ -47,7 +47,7 @@ void initTFT() {
     UCB1CTL0 = UCCKPL + UCMSB + UCMST
         + UCSYNC; //下降沿变数据、上升沿采样；高位先；8位模式；主机；3线；同步
     UCB1CTL1 = UCSSEL__SMCLK + UCSWRST;
-    UCB1BRW = SMCLK_FREQ / SPI_FREQ;
+    UCB1BRW = TFT_SPI_DIV;
     P8REN |= BIT6;
     P8OUT &= ~BIT6;
     P8SEL |= BIT4 + BIT5 + BIT6;
@@ -126,6 +126,21 @@ void initTFT() {
     tft_send_and_wait(0x007, 0x0113);
 }
 
+//DMA通道1：由UCB1TXIFG触发，逐字节搬运到UCB1TXBUF
+#define TFT_DMA_PATTERN_BYTES 64
+#define TFT_DMA_MAX_CHUNK 0xFFFE
+
+#define TFT_DMA_MODE_REPEAT 0 //每一轮都从tft_dma_pattern开头重新发送
+#define TFT_DMA_MODE_LINEAR 1 //源地址逐轮前进(内存到LCD的块传输)
+
+static uint8_t tft_dma_pattern[TFT_DMA_PATTERN_BYTES];
+static const uint8_t* tft_dma_src;
+static uint16_t tft_dma_pass_bytes; //REPEAT模式下每一轮最多发送的字节数(图案长度的整数倍)
+static uint32_t tft_dma_remaining; //尚未交给DMA的字节数
+static uint8_t tft_dma_mode;
+static volatile uint8_t tft_dma_busy = 0;
+static void (*tft_dma_done_cb)(void) = 0;
+
 void tft_AddTxData(uint16_t val) {
     while (!(UCB1IFG & UCTXIFG))
         ; //等待发送缓冲区空
@@ -139,6 +154,8 @@ void tft_AddTxData(uint16_t val) {
 
 //向TFT屏发送一个地址，返回是否发送成功
 int tft_SendIndex(uint16_t val) {
+    while (tft_dma_busy) //等待DMA传输结束后再动CS、RS，否则后台发送的剩余像素会被当作地址
+        HAL_IDLE();
     LCD_CS_CLR;
     LCD_RS_CLR;
     tft_AddTxData(val);
@@ -148,6 +165,8 @@ int tft_SendIndex(uint16_t val) {
 
 //向TFT屏发送一个数据，返回是否发送成功
 int tft_SendData(uint16_t val) {
+    while (tft_dma_busy) //等待DMA传输结束后再动CS、RS，否则后台发送的剩余像素会被当作地址
+        HAL_IDLE();
     LCD_CS_CLR;
     LCD_RS_SET;
     tft_AddTxData(val);
@@ -161,3 +180,158 @@ int tft_SendCmd(uint16_t reg, uint16_t data) {
     tft_SendData(data);
     return 1;
 }
+
+//打开RAM写入流：写入RAM访问寄存器地址后保持CS为低、RS为高
+void tft_StreamBegin(void) {
+    tft_SendIndex(TFTREG_RAM_ACCESS);
+    LCD_CS_CLR;
+    LCD_RS_SET;
+}
+
+//向已打开的流写入一个像素，只等待发送缓冲区空，不等待移位完成
+void tft_StreamPixel(uint16_t color) {
+    while (!(UCB1IFG & UCTXIFG))
+        ;
+    UCB1TXBUF = color >> 8;
+    while (!(UCB1IFG & UCTXIFG))
+        ;
+    UCB1TXBUF = color & 0xFF;
+}
+
+//向已打开的流连续写入count个相同颜色的像素
+void tft_StreamFill(uint16_t color, uint32_t count) {
+    uint8_t hi = color >> 8;
+    uint8_t lo = color & 0xFF;
+    while (count--) {
+        while (!(UCB1IFG & UCTXIFG))
+            ;
+        UCB1TXBUF = hi;
+        while (!(UCB1IFG & UCTXIFG))
+            ;
+        UCB1TXBUF = lo;
+    }
+}
+
+//结束流：等待最后一位实际送出后再拉高CS
+void tft_StreamEnd(void) {
+    while (UCB1STAT & UCBUSY)
+        ;
+    LCD_CS_SET;
+}
+
+//启动一轮DMA传输，长度为min(剩余字节, 本轮上限)
+static void tft_DmaStartPass(void) {
+    uint16_t pass_bytes;
+    if (tft_dma_mode == TFT_DMA_MODE_REPEAT) {
+        pass_bytes = tft_dma_pass_bytes;
+    } else {
+        pass_bytes = TFT_DMA_MAX_CHUNK;
+    }
+    if (tft_dma_remaining < pass_bytes) {
+        pass_bytes = tft_dma_remaining;
+    }
+
+    //UCB1TXIFG是边沿触发，先等发送缓冲区空(SPI下最多一个字节时间)，再在下面手动产生触发边沿，
+    //否则TXBUF中的字节移出时产生的硬件边沿与手动触发叠加会覆盖未发出的字节
+    while (!(UCB1IFG & UCTXIFG))
+        ;
+    DMA1CTL &= ~DMAEN;
+    __data20_write_long((unsigned long)&DMA1SA, (unsigned long)tft_dma_src);
+    __data20_write_long((unsigned long)&DMA1DA, (unsigned long)&UCB1TXBUF);
+    DMA1SZ = pass_bytes;
+    DMA1CTL = DMADT_0 | DMASRCINCR_3 | DMADSTINCR_0 | DMASRCBYTE | DMADSTBYTE | DMAIE | DMAEN;
+
+    tft_dma_remaining -= pass_bytes;
+    if (tft_dma_mode == TFT_DMA_MODE_LINEAR) {
+        tft_dma_src += pass_bytes;
+    }
+
+    UCB1IFG &= ~UCTXIFG;
+    UCB1IFG |= UCTXIFG;
+}
+
+static void tft_DmaStart(uint32_t total_bytes) {
+    if (total_bytes == 0) {
+        tft_StreamEnd();
+        if (tft_dma_done_cb)
+            tft_dma_done_cb();
+        return;
+    }
+    DMACTL0 = (DMACTL0 & ~DMA1TSEL_31) | DMA1TSEL_23; //通道1触发源：UCB1TXIFG
+    tft_dma_remaining = total_bytes;
+    tft_dma_busy = 1;
+    tft_DmaStartPass();
+}
+
+void tft_DmaPattern(const uint16_t* pattern, uint16_t pattern_words, uint32_t repeats) {
+    uint16_t pattern_bytes = pattern_words * 2;
+    uint16_t copies, i, j;
+
+    while (tft_dma_busy)
+        HAL_IDLE();
+    if (pattern_bytes == 0 || pattern_bytes > TFT_DMA_PATTERN_BYTES) {
+        //图案放不进缓冲区时退化为同步发送
+        for (; repeats; repeats--) {
+            for (j = 0; j < pattern_words; j++) {
+                tft_StreamPixel(pattern[j]);
+            }
+        }
+        tft_StreamEnd();
+        if (tft_dma_done_cb)
+            tft_dma_done_cb();
+        return;
+    }
+
+    //把图案按LCD字节序(高位在前)重复铺满缓冲区，每轮发送整数个图案
+    copies = TFT_DMA_PATTERN_BYTES / pattern_bytes;
+    for (i = 0; i < copies; i++) {
+        for (j = 0; j < pattern_words; j++) {
+            tft_dma_pattern[(i * pattern_words + j) * 2] = pattern[j] >> 8;
+            tft_dma_pattern[(i * pattern_words + j) * 2 + 1] = pattern[j] & 0xFF;
+        }
+    }
+    tft_dma_src = tft_dma_pattern;
+    tft_dma_pass_bytes = copies * pattern_bytes;
+    tft_dma_mode = TFT_DMA_MODE_REPEAT;
+    tft_DmaStart((uint32_t)pattern_bytes * repeats);
+}
+
+void tft_DmaFill(uint16_t color, uint32_t count) {
+    tft_DmaPattern(&color, 1, count);
+}
+
+void tft_DmaBlit(const uint8_t* data, uint32_t bytes) {
+    while (tft_dma_busy)
+        HAL_IDLE();
+    tft_dma_src = data;
+    tft_dma_mode = TFT_DMA_MODE_LINEAR;
+    tft_DmaStart(bytes);
+}
+
+uint8_t tft_DmaBusy(void) {
+    return tft_dma_busy;
+}
+
+void tft_DmaWait(void) {
+    while (tft_dma_busy)
+        HAL_IDLE();
+}
+
+void tft_DmaSetCallback(void (*done)(void)) {
+    tft_dma_done_cb = done;
+}
+
+void tft_DmaIsr(void) {
+    if (tft_dma_remaining > 0) {
+        tft_DmaStartPass();
+        return;
+    }
+    //最后一个字节写入TXBUF后才置位DMAIFG，需等它实际移出后再拉高CS
+    //此时移位寄存器里可能还有前一个字节，最坏要等两个字节时间：SMCLK 4MHz、UCB1BRW=1时
+    //SPI为4MHz，即4us(80个MCLK)。这段时间内DMA0照常搬运ADC结果，只是段完成中断
+    //(DMA0IFG)最多晚4us得到处理，远小于一段的时长，因此不把收尾挪出中断
+    tft_StreamEnd();
+    tft_dma_busy = 0;
+    if (tft_dma_done_cb)
+        tft_dma_done_cb();
+}
@@ -1,21 +1,25 @@
 #ifndef __DR_TFT_H_
 #define __DR_TFT_H_
 
+#include "clock.h"
 #include <stdint.h>
 
-#ifndef MCLK_FREQ
-    #define MCLK_FREQ 20000000
-#endif
-
-#ifndef SMCLK_FREQ
-    #define SMCLK_FREQ 20000000
-#endif
-
-#define SPI_FREQ 10000000
+#define SPI_FREQ 10000000UL // Wanted SPI clock; the USCI divides SMCLK by at least 1
+#define TFT_SPI_DIV (SMCLK_FREQ > SPI_FREQ ? SMCLK_FREQ / SPI_FREQ : 1)
 
 #define TFT_XSIZE 240
 #define TFT_YSIZE 320
 
+//扫描显示时擦除条领先光标的列数
+#ifndef ETFT_SWEEP_GAP
+    #define ETFT_SWEEP_GAP 8
+#endif
+
+//扫描波形最多的条带数(导联数)，每条带占640字节RAM
+#ifndef ETFT_TRACE_LANES
+    #define ETFT_TRACE_LANES 4
+#endif
+
 #define TFTREG_RAM_XADDR 0x0201
 #define TFTREG_RAM_YADDR 0x0200
 #define TFTREG_RAM_ACCESS 0x0202
@@ -41,6 +45,47 @@ int tft_SendData(uint16_t val);
 //向TFT屏的寄存器reg发送数据data，返回是否发送成功
 int tft_SendCmd(uint16_t reg, uint16_t data);
 
+/* 像素流接口：一次打开RAM访问窗口，CS保持为低连续写入像素，最后关闭 */
+/* 用法：设置窗口 -> tft_StreamBegin -> tft_StreamPixel/tft_StreamFill ... -> tft_StreamEnd */
+/* 流打开期间不能调用tft_SendIndex/tft_SendData/tft_SendCmd */
+
+//打开RAM写入流(内部写入TFTREG_RAM_ACCESS地址)
+void tft_StreamBegin(void);
+
+//向流写入一个像素
+void tft_StreamPixel(uint16_t color);
+
+//向流写入count个相同颜色的像素
+void tft_StreamFill(uint16_t color, uint32_t count);
+
+//关闭RAM写入流
+void tft_StreamEnd(void);
+
+/* DMA发送接口：在tft_StreamBegin(或etft_BeginWindow)之后调用，立即返回， */
+/* 由DMA通道1(UCB1TXIFG触发)在后台发送，完成后自动关闭流(相当于tft_StreamEnd) */
+/* 传输进行中调用其他TFT接口会先等待传输完成 */
+
+//后台发送count个相同颜色的像素
+void tft_DmaFill(uint16_t color, uint32_t count);
+
+//后台将pattern_words个像素组成的图案重复发送repeats次，图案不超过32个像素时才走DMA
+void tft_DmaPattern(const uint16_t* pattern, uint16_t pattern_words, uint32_t repeats);
+
+//后台将内存中的数据块直接发送给LCD，data须为LCD字节序(每像素高字节在前)
+void tft_DmaBlit(const uint8_t* data, uint32_t bytes);
+
+//DMA传输是否仍在进行
+uint8_t tft_DmaBusy(void);
+
+//等待DMA传输完成
+void tft_DmaWait(void);
+
+//设置传输完成回调(在中断上下文中调用)，传0取消
+void tft_DmaSetCallback(void (*done)(void));
+
+//DMA通道1中断处理，由DMA_ISR在DMA1IFG时调用
+void tft_DmaIsr(void);
+
 /* TFT屏高层接口 */
 /* 所有高层接口内置X、Y对调，即接口处X为横Y为纵 */
 
@@ -53,9 +98,22 @@ static inline uint16_t etft_Color(uint8_t r, uint8_t g, uint8_t b) {
     return temp;
 }
 
+//设置绘图窗口并打开像素流，之后用tft_StreamPixel/tft_StreamFill写入，tft_StreamEnd结束
+void etft_BeginWindow(uint16_t startX, uint16_t startY, uint16_t endX, uint16_t endY);
+
 //将一个区域置为某个颜色
 void etft_AreaSet(uint16_t startX, uint16_t startY, uint16_t endX, uint16_t endY, uint16_t color);
 
+//异步将一个区域置为某个颜色，由DMA在后台完成
+void etft_AreaSetAsync(uint16_t startX,
+                       uint16_t startY,
+                       uint16_t endX,
+                       uint16_t endY,
+                       uint16_t color);
+
+//异步将像素块写入区域，pixels为逐行排列的RGB565数据，每像素高字节在前
+void etft_BlitAsync(const uint8_t* pixels, uint16_t sx, uint16_t sy, uint16_t width, uint16_t height);
+
 //在指定的位置显示一个字符串
 void etft_DisplayString(const char* str, uint16_t sx, uint16_t sy, uint16_t fRGB, uint16_t bRGB);
 
@@ -68,11 +126,25 @@ void etft_DisplayImage(const uint8_t* image,
                        uint16_t width,
                        uint16_t height);
 
-void etft_DisplayADCSegment(const uint16_t* segment_data_ptr,
-                            uint16_t samples_in_segment,
-                            uint16_t segment_idx_for_positioning,
-                            uint16_t num_total_segments_on_screen,
-                            uint16_t fRGB,
-                            uint16_t bRGB);
+//把屏幕上下等分为lanes条扫描波形(1~ETFT_TRACE_LANES)，光标回到左端
+//须在清屏后、第一次etft_TraceSamples之前调用
+void etft_TraceSetLanes(uint8_t lanes);
+
+//设置波形扫描的时间比例：sample_rate_hz个样本对应columns_per_s列，比值可以是任意分数
+void etft_TraceSetScale(uint16_t sample_rate_hz, uint16_t columns_per_s);
+
+//设置样本位宽(12~14，默认12)：0到2^bits-1的码值对应条带的整个高度
+void etft_TraceSetBits(uint8_t bits);
+
+//向第lane条扫描波形追加一段样本(位宽见etft_TraceSetBits)，每列画出列内样本的最小值到最大值，QRS峰值不会被平均掉
+//相邻样本相隔stride个字(交织的多通道数据取其中一个通道)
+//start_sample为samples[0]的样本序号，与上一段不连续时光标按缺失的样本数前移
+void etft_TraceSamples(uint8_t lane,
+                       const uint16_t* samples,
+                       uint16_t count,
+                       uint16_t stride,
+                       uint32_t start_sample,
+                       uint16_t fRGB,
+                       uint16_t bRGB);
 
 #endif
@@ -1,23 +1,53 @@
 #include "dr_tft.h"
 #include "dr_tft_ascii.h"
-#include <msp430.h>
+#include "hal.h"
+#include <string.h>
 
-void etft_AreaSet(uint16_t startX, uint16_t startY, uint16_t endX, uint16_t endY, uint16_t color) {
-    uint16_t i, j;
-    tft_SendCmd(TFTREG_WIN_MINX, startX);
-    tft_SendCmd(TFTREG_WIN_MINY, startY);
-    tft_SendCmd(TFTREG_WIN_MAXX, endX);
-    tft_SendCmd(TFTREG_WIN_MAXY, endY);
+// 窗口寄存器的当前值，与要写入的值相同时省去该次写入(0xFFFF表示未知，初始化后首次总会写入)
+static uint16_t win_minx = 0xFFFF, win_miny = 0xFFFF, win_maxx = 0xFFFF, win_maxy = 0xFFFF;
+
+void etft_BeginWindow(uint16_t startX, uint16_t startY, uint16_t endX, uint16_t endY) {
+    if (startX != win_minx) {
+        tft_SendCmd(TFTREG_WIN_MINX, startX);
+        win_minx = startX;
+    }
+    if (startY != win_miny) {
+        tft_SendCmd(TFTREG_WIN_MINY, startY);
+        win_miny = startY;
+    }
+    if (endX != win_maxx) {
+        tft_SendCmd(TFTREG_WIN_MAXX, endX);
+        win_maxx = endX;
+    }
+    if (endY != win_maxy) {
+        tft_SendCmd(TFTREG_WIN_MAXY, endY);
+        win_maxy = endY;
+    }
 
     tft_SendCmd(TFTREG_RAM_XADDR, startX);
     tft_SendCmd(TFTREG_RAM_YADDR, startY);
 
-    tft_SendIndex(TFTREG_RAM_ACCESS);
-    for (i = 0; i < endY - startY + 1; i++) {
-        for (j = 0; j < endX - startX + 1; j++) {
-            tft_SendData(color);
-        }
-    }
+    tft_StreamBegin();
+}
+
+void etft_AreaSet(uint16_t startX, uint16_t startY, uint16_t endX, uint16_t endY, uint16_t color) {
+    etft_BeginWindow(startX, startY, endX, endY);
+    tft_StreamFill(color, (uint32_t)(endX - startX + 1) * (endY - startY + 1));
+    tft_StreamEnd();
+}
+
+void etft_AreaSetAsync(uint16_t startX,
+                       uint16_t startY,
+                       uint16_t endX,
+                       uint16_t endY,
+                       uint16_t color) {
+    etft_BeginWindow(startX, startY, endX, endY);
+    tft_DmaFill(color, (uint32_t)(endX - startX + 1) * (endY - startY + 1));
+}
+
+void etft_BlitAsync(const uint8_t* pixels, uint16_t sx, uint16_t sy, uint16_t width, uint16_t height) {
+    etft_BeginWindow(sx, sy, sx + width - 1, sy + height - 1);
+    tft_DmaBlit(pixels, (uint32_t)width * height * 2);
 }
 
 void etft_DisplayString(const char* str, uint16_t sx, uint16_t sy, uint16_t fRGB, uint16_t bRGB) {
@@ -29,41 +59,23 @@ void etft_DisplayString(const char* str, uint16_t sx, uint16_t sy, uint16_t fRGB
         if (curchar == '\0') //字符串已发送完
             return;
 
-        cx = 0;
-        cy = 0;
         //屏幕是横的，XY要对调
-        tft_SendCmd(TFTREG_WIN_MINX, sx); //x start point
-        tft_SendCmd(TFTREG_WIN_MINY, sy); //y start point
-        tft_SendCmd(TFTREG_WIN_MAXX, sx + 7); //x end point
-        tft_SendCmd(TFTREG_WIN_MAXY, sy + 15); //y end point
-        tft_SendCmd(TFTREG_RAM_XADDR, sx); //x start point
-        tft_SendCmd(TFTREG_RAM_YADDR, sy); //y start point
-        tft_SendIndex(TFTREG_RAM_ACCESS);
-
-        uint16_t color;
-        while (1) {
-            if (cx >= 8) {
-                cx = 0;
-                cy++;
-                if (cy >= 16) { //一个字符发送完毕
-                    cc++; //下一个字符
-                    sx += 8;
-                    if (sx >= TFT_YSIZE) //越过行末
-                    {
-                        sx = 0;
-                        sy += 16;
-                    }
-                    break;
-                }
+        etft_BeginWindow(sx, sy, sx + 7, sy + 15);
+        for (cy = 0; cy < 16; cy++) {
+            uint8_t bits = tft_ascii[curchar * 16 + cy];
+            for (cx = 0; cx < 8; cx++) {
+                tft_StreamPixel((bits & 0x80) ? fRGB : bRGB);
+                bits <<= 1;
             }
-
-            if ((tft_ascii[curchar * 16 + cy] << cx) & 0x80)
-                color = fRGB;
-            else
-                color = bRGB;
-
-            tft_SendData(color);
-            cx++; //X自增
+        }
+        tft_StreamEnd();
+
+        cc++; //下一个字符
+        sx += 8;
+        if (sx >= TFT_YSIZE) //越过行末
+        {
+            sx = 0;
+            sy += 16;
         }
     }
 }
@@ -81,189 +93,337 @@ void etft_DisplayImage(const uint8_t* image,
         row_length += 1;
     }
     const uint8_t* ptr = image + (height - 1) * row_length;
-    tft_SendCmd(TFTREG_WIN_MINX, sx);
-    tft_SendCmd(TFTREG_WIN_MINY, sy);
-    tft_SendCmd(TFTREG_WIN_MAXX, sx + width - 1);
-    tft_SendCmd(TFTREG_WIN_MAXY, sy + height - 1);
-
-    tft_SendCmd(TFTREG_RAM_XADDR, sx);
-    tft_SendCmd(TFTREG_RAM_YADDR, sy);
-
-    tft_SendIndex(TFTREG_RAM_ACCESS);
+    etft_BeginWindow(sx, sy, sx + width - 1, sy + height - 1);
     for (i = 0; i < height; i++) {
         for (j = 0; j < width; j++) {
-            tft_SendData(etft_Color(ptr[2], ptr[1], ptr[0]));
+            tft_StreamPixel(etft_Color(ptr[2], ptr[1], ptr[0]));
             ptr += 3;
         }
         ptr -= width * 3 + row_length;
     }
+    tft_StreamEnd();
 }
 
 // --- 辅助函数 ---
 
+// 扫描式波形渲染：每列记录屏幕上现有波形的纵向跨度，只改写旧跨度与新跨度覆盖的像素。
+// 擦除条领先光标ETFT_SWEEP_GAP列，提前抹掉上一轮的波形，像监护仪一样留出一段空白。
+// 多导联时屏幕上下等分为若干条带，每条带一条独立的扫描波形，共用时间比例。
+#define TRACE_NO_COLUMN 0xFFFF
+
+typedef struct {
+    uint8_t shown_top[TFT_YSIZE]; // 每列屏幕上波形跨度的起点
+    uint8_t shown_len[TFT_YSIZE]; // 每列屏幕上波形跨度的长度，0表示该列没有波形
+
+    uint16_t col_x; // 当前待完成的列
+    uint16_t col_lo, col_hi; // 该列波形的纵向跨度
+    uint16_t prev_y; // 该列最后一个样本的y
+
+    uint16_t top; // 条带的第一行
+    uint16_t phase;
+    uint16_t x; // 正在累积的列
+    uint8_t env_count; // 该列已有的样本数(0或1，只区分有无)
+    uint16_t env_first, env_lo, env_hi, env_last;
+    uint16_t gap; // 放大时没有样本的列数，下一个样本到来时按插值补上
+    uint8_t started;
+    uint32_t next_sample;
+} TraceLane;
+
+static TraceLane trace_lanes[ETFT_TRACE_LANES];
+static uint8_t trace_lane_count = 1;
+static uint16_t trace_lane_height = TFT_XSIZE;
+static uint16_t trace_code_max = 4095; // 满量程码值，etft_TraceSetBits()设置
+
+// 样本到列的抽取：每个样本相位加trace_cols，满trace_rate进一列，比值可以是任意分数。
+// 一列内只保留样本码值的首、末、最小、最大值，换算成坐标的除法每列只做一次。
+static uint16_t trace_rate = 1, trace_cols = 1; // 样本/秒，列/秒
+
+/**
+ * @brief 把第x列改写为[lo, hi]的波形：只写旧跨度与新跨度的并集，并更新该列记录
+ */
+static void etft_WriteSpanPriv(TraceLane* t,
+                               uint16_t x,
+                               uint16_t lo,
+                               uint16_t hi,
+                               uint16_t fRGB,
+                               uint16_t bRGB) {
+    uint16_t ulo = lo, uhi = hi;
+    if (t->shown_len[x] > 0) {
+        uint16_t old_lo = t->shown_top[x];
+        uint16_t old_hi = old_lo + t->shown_len[x] - 1;
+        if (old_lo == lo && old_hi == hi)
+            return; // 屏幕上已是该跨度
+        if (old_lo < ulo)
+            ulo = old_lo;
+        if (old_hi > uhi)
+            uhi = old_hi;
+    }
+    etft_BeginWindow(x, ulo, x, uhi);
+    tft_StreamFill(bRGB, lo - ulo);
+    tft_StreamFill(fRGB, hi - lo + 1);
+    tft_StreamFill(bRGB, uhi - hi);
+    tft_StreamEnd();
+    t->shown_top[x] = lo;
+    t->shown_len[x] = hi - lo + 1;
+}
+
 /**
- * @brief 在指定逻辑坐标绘制一个像素点
- * @param x 逻辑X坐标 (0 到 TFT_YSIZE-1)
- * @param y 逻辑Y坐标 (0 到 TFT_XSIZE-1)
- * @param color 像素颜色
- * @note TFT_YSIZE 是屏幕逻辑宽度 (320), TFT_XSIZE 是屏幕逻辑高度 (240)
+ * @brief 擦除条：抹掉第x列上一轮留下的波形
  */
-static void etft_DrawPixelPriv(uint16_t x, uint16_t y, uint16_t color) {
-    // 边界检查
-    if (x >= TFT_YSIZE || y >= TFT_XSIZE) {
+static void etft_EraseColumnPriv(TraceLane* t, uint16_t x, uint16_t bRGB) {
+    if (t->shown_len[x] == 0)
+        return;
+    etft_BeginWindow(x, t->shown_top[x], x, t->shown_top[x] + t->shown_len[x] - 1);
+    tft_StreamFill(bRGB, t->shown_len[x]);
+    tft_StreamEnd();
+    t->shown_len[x] = 0;
+}
+
+/**
+ * @brief 把当前列的跨度写到屏幕上
+ */
+static void etft_FlushColumnPriv(TraceLane* t, uint16_t fRGB, uint16_t bRGB) {
+    if (t->col_x == TRACE_NO_COLUMN || t->col_x >= TFT_YSIZE) {
         return;
     }
-    // etft_AreaSet 接收逻辑坐标 (x为横向, y为纵向)
-    etft_AreaSet(x, y, x, y, color);
+    etft_WriteSpanPriv(t, t->col_x, t->col_lo, t->col_hi, fRGB, bRGB);
 }
 
 /**
- * @brief 使用Bresenham算法绘制一条直线
- * @param x1 起点逻辑X坐标
- * @param y1 起点逻辑Y坐标
- * @param x2 终点逻辑X坐标
- * @param y2 终点逻辑Y坐标
- * @param color 直线颜色
+ * @brief 向波形追加第x列：列内样本的纵向范围为[lo, hi]，first、last为列内首、末样本的y
+ * @note 与前一列相邻时，前一列末点到本列首点的连线按Bresenham的像素分配：纵向距离为d时，
+ *       前一列画到d/2(向下取整)处，其余像素属于本列。因此一列的最终跨度要等到下一列到来
+ *       才能确定，当前列暂存到下一列到来时再写出。
  */
-static void etft_DrawLinePriv(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color) {
-    int16_t dx_abs, dy_abs;
-    int16_t sx, sy;
-    int16_t err, e2;
-
-    // 计算坐标差的绝对值及符号
-    if (x2 > x1) {
-        dx_abs = x2 - x1;
-        sx = 1;
-    } else {
-        dx_abs = x1 - x2;
-        sx = -1;
+static void etft_TraceColumnPriv(TraceLane* t,
+                                 uint16_t x,
+                                 uint16_t first,
+                                 uint16_t lo,
+                                 uint16_t hi,
+                                 uint16_t last,
+                                 uint16_t fRGB,
+                                 uint16_t bRGB) {
+    uint16_t new_lo = lo, new_hi = hi;
+
+    if (t->col_x != TRACE_NO_COLUMN && x == t->col_x + 1) {
+        uint16_t half;
+        if (first > t->prev_y) {
+            half = (first - t->prev_y) / 2;
+            if (t->prev_y + half > t->col_hi)
+                t->col_hi = t->prev_y + half;
+            if (t->prev_y + half + 1 < new_lo)
+                new_lo = t->prev_y + half + 1;
+        } else if (first < t->prev_y) {
+            half = (t->prev_y - first) / 2;
+            if (t->prev_y - half < t->col_lo)
+                t->col_lo = t->prev_y - half;
+            if (t->prev_y - half - 1 > new_hi)
+                new_hi = t->prev_y - half - 1;
+        }
     }
+    etft_FlushColumnPriv(t, fRGB, bRGB);
 
-    if (y2 > y1) {
-        dy_abs = y2 - y1;
-        sy = 1;
-    } else {
-        dy_abs = y1 - y2;
-        sy = -1;
+    if (x < TFT_YSIZE && x != t->col_x) {
+        uint16_t erase_x = x + ETFT_SWEEP_GAP;
+        if (erase_x >= TFT_YSIZE)
+            erase_x -= TFT_YSIZE;
+        etft_EraseColumnPriv(t, erase_x, bRGB);
     }
 
-    err = dx_abs - dy_abs;
+    t->col_x = x;
+    t->col_lo = new_lo;
+    t->col_hi = new_hi;
+    t->prev_y = last;
+}
 
-    while (1) {
-        etft_DrawPixelPriv(x1, y1, color); // 绘制当前点
-        if (x1 == x2 && y1 == y2) { // 如果到达终点则退出
-            break;
-        }
-        e2 = 2 * err;
-        if (e2 > -dy_abs) { // e2 大于 -dy_abs
-            err -= dy_abs;
-            x1 += sx;
-        }
-        if (e2 < dx_abs) { // e2 小于 dx_abs
-            err += dx_abs;
-            y1 += sy;
-        }
+/**
+ * @brief 码值换算为条带内的屏幕纵坐标，满量程为trace_code_max，码值越大越靠上
+ */
+static uint16_t etft_CodeToYPriv(const TraceLane* t, uint16_t code) {
+    uint32_t temp_y = (uint32_t)code * (trace_lane_height - 1);
+    return t->top + (trace_lane_height - 1) - (uint16_t)(temp_y / trace_code_max);
+}
+
+/**
+ * @brief 输出正在累积的列(码值的首、末、最小、最大)，光标前进一列
+ */
+static void etft_EmitColumnPriv(TraceLane* t,
+                                uint16_t first,
+                                uint16_t lo,
+                                uint16_t hi,
+                                uint16_t last,
+                                uint16_t fRGB,
+                                uint16_t bRGB) {
+    etft_TraceColumnPriv(t,
+                         t->x,
+                         etft_CodeToYPriv(t, first),
+                         etft_CodeToYPriv(t, hi),
+                         etft_CodeToYPriv(t, lo),
+                         etft_CodeToYPriv(t, last),
+                         fRGB,
+                         bRGB);
+    if (++t->x >= TFT_YSIZE)
+        t->x = 0;
+}
+
+/**
+ * @brief 输入有缺口：光标按缺失的样本数前移，擦除跳过的列，波形在缺口处断开
+ */
+static void etft_TraceSkipPriv(TraceLane* t, uint32_t skipped, uint16_t bRGB) {
+    uint32_t total;
+    uint16_t cols, i;
+
+    skipped %= (uint32_t)trace_rate * TFT_YSIZE; // 这么多样本正好是trace_cols轮完整的扫描
+    total = t->phase + skipped * trace_cols;
+    cols = (uint16_t)((total / trace_rate) % TFT_YSIZE);
+    t->phase = (uint16_t)(total % trace_rate);
+    t->env_count = 0;
+    t->gap = 0;
+
+    for (i = 0; i < cols; i++) {
+        uint16_t erase_x = t->x + ETFT_SWEEP_GAP + i;
+        while (erase_x >= TFT_YSIZE)
+            erase_x -= TFT_YSIZE;
+        etft_EraseColumnPriv(t, erase_x, bRGB);
     }
+    t->x += cols;
+    if (t->x >= TFT_YSIZE)
+        t->x -= TFT_YSIZE;
+    t->col_x = TRACE_NO_COLUMN; // 待完成的列已在上一段末写出
 }
 
 // --- 主要绘图函数 ---
 
 /**
- * @brief Displays a single segment of the ADC voltage waveform using averaging.
- * @param segment_data_ptr Pointer to the start of the current segment's ADC data.
- * @param samples_in_segment Number of ADC samples in this segment (e.g., 40).
- * @param segment_idx_for_positioning The index of the current segment (0 to NUM_SEGMENTS-1) for X positioning.
- * @param num_total_segments_on_screen Total number of segments the screen is divided into (e.g., 16).
- * @param fRGB Foreground color for the waveform.
- * @param bRGB Background color for this segment's area.
+ * @brief Splits the screen into lanes stacked top to bottom, one sweep trace each.
+ * @note Forgets what the traces have drawn, so clear the screen as well. The cursors go back to
+ *       the left edge; the time base set by etft_TraceSetScale() is kept.
+ * @param lanes 1..ETFT_TRACE_LANES; each lane gets TFT_XSIZE / lanes rows.
  */
-void etft_DisplayADCSegment(const uint16_t* segment_data_ptr,
-                            uint16_t samples_in_segment,
-                            uint16_t segment_idx_for_positioning,
-                            uint16_t num_total_segments_on_screen,
-                            uint16_t fRGB,
-                            uint16_t bRGB) {
-    const uint16_t screen_total_width = TFT_YSIZE; // 320 (logical width)
-    const uint16_t screen_height = TFT_XSIZE; // 240 (logical height)
-    const uint16_t adc_max_value = 4095;
-
-    if (samples_in_segment == 0 || segment_data_ptr == 0 || num_total_segments_on_screen == 0) {
-        return;
+void etft_TraceSetLanes(uint8_t lanes) {
+    uint8_t i;
+
+    if (lanes == 0)
+        lanes = 1;
+    if (lanes > ETFT_TRACE_LANES)
+        lanes = ETFT_TRACE_LANES;
+    trace_lane_count = lanes;
+    trace_lane_height = TFT_XSIZE / lanes;
+    for (i = 0; i < lanes; i++) {
+        TraceLane* t = &trace_lanes[i];
+        memset(t->shown_len, 0, sizeof(t->shown_len));
+        t->col_x = TRACE_NO_COLUMN;
+        t->top = i * trace_lane_height;
+        t->x = 0;
+        t->phase = 0;
+        t->env_count = 0;
+        t->gap = 0;
+        t->started = 0;
     }
+}
 
-    uint16_t segment_pixel_width =
-        screen_total_width / num_total_segments_on_screen; // e.g., 320 / 16 = 20 pixels
-    if (segment_pixel_width == 0)
-        segment_pixel_width = 1; // Prevent division by zero
-
-    uint16_t x_start_on_screen_for_segment = segment_idx_for_positioning * segment_pixel_width;
-
-    etft_AreaSet(x_start_on_screen_for_segment,
-                0,
-                x_start_on_screen_for_segment + segment_pixel_width,
-                TFT_XSIZE - 1,
-                bRGB); // Clear this segment
-    static uint16_t prev_x_coord_on_screen = 0; // These will be screen absolute coordinates
-    static uint16_t prev_y_coord_on_screen = 0;
-
-    // Downsampling: 'samples_in_segment' (e.g., 40) to 'segment_pixel_width' (e.g., 20) columns.
-    // Each pixel column will represent an average of (samples_in_segment / segment_pixel_width) samples.
-    uint16_t samples_to_average_per_pixel = 1;
-    if (segment_pixel_width > 0 && samples_in_segment > segment_pixel_width) {
-        samples_to_average_per_pixel =
-            samples_in_segment / segment_pixel_width; // e.g., 40 / 20 = 2
+/**
+ * @brief Sets the time base of the sweep: sample_rate_hz samples span columns_per_s columns.
+ * @note Any ratio works, including fractional ones and more columns than samples (the trace is
+ *       then interpolated between samples). Restarts the column accumulation of every lane; the
+ *       cursors stay. columns_per_s * sample_rate_hz * 320 must fit in 32 bits.
+ */
+void etft_TraceSetScale(uint16_t sample_rate_hz, uint16_t columns_per_s) {
+    uint8_t i;
+
+    trace_rate = sample_rate_hz ? sample_rate_hz : 1;
+    trace_cols = columns_per_s ? columns_per_s : 1;
+    for (i = 0; i < ETFT_TRACE_LANES; i++) {
+        trace_lanes[i].phase = 0;
+        trace_lanes[i].env_count = 0;
+        trace_lanes[i].gap = 0;
+        trace_lanes[i].started = 0;
     }
+}
 
-    uint16_t i, k;
-    for (i = 0; i < segment_pixel_width; i++)
-    { // 'i' is the pixel column index (0 to 19 for a 20px segment)
-        uint32_t sum_of_samples = 0;
-        uint16_t num_actual_samples_averaged = 0;
-        uint16_t start_sample_idx_in_segment = i * samples_to_average_per_pixel;
-
-        for (k = 0; k < samples_to_average_per_pixel; k++) {
-            uint16_t current_sample_idx = start_sample_idx_in_segment + k;
-            if (current_sample_idx < samples_in_segment) {
-                sum_of_samples += segment_data_ptr[current_sample_idx];
-                num_actual_samples_averaged++;
-            } else {
-                break; // No more samples in the segment data for this pixel column
+/**
+ * @brief Sets the sample width: codes 0..2^bits - 1 span the height of a lane.
+ * @param bits 12..14; others are ignored.
+ */
+void etft_TraceSetBits(uint8_t bits) {
+    if (bits >= 12 && bits <= 14)
+        trace_code_max = (uint16_t)((1u << bits) - 1);
+}
+
+/**
+ * @brief Appends samples to the sweep trace of one lane, drawing each pixel column as soon as it
+ *        is complete.
+ * @note Peak-preserving: a column covers the min..max of its samples, joined to its neighbours, so
+ *       a QRS spike keeps its full height at any zoom. The code-to-pixel division runs once per
+ *       column, so the LCD cost depends on columns_per_s only, not on the sample rate.
+ *       Only pixels that change are written; an erase bar ETFT_SWEEP_GAP columns ahead of the
+ *       cursor removes the previous sweep.
+ * @param lane 0..lanes - 1 (etft_TraceSetLanes()); others are ignored.
+ * @param samples ADC codes of the width set by etft_TraceSetBits(), 12 bits by default.
+ * @param count Number of samples.
+ * @param stride Words from one sample to the next: 1, or the channel count for one channel of
+ *        interleaved samples.
+ * @param start_sample Index of samples[0]. If it does not follow on from the previous call, the
+ *        cursor jumps ahead by the missing samples and the trace is broken there.
+ * @param fRGB Foreground color for the waveform.
+ * @param bRGB Background color.
+ */
+void etft_TraceSamples(uint8_t lane,
+                       const uint16_t* samples,
+                       uint16_t count,
+                       uint16_t stride,
+                       uint32_t start_sample,
+                       uint16_t fRGB,
+                       uint16_t bRGB) {
+    TraceLane* t = &trace_lanes[lane];
+    uint16_t i;
+
+    if (count == 0 || samples == 0 || lane >= trace_lane_count) {
+        return;
+    }
+    if (t->started && start_sample != t->next_sample) {
+        etft_TraceSkipPriv(t, start_sample - t->next_sample, bRGB);
+    }
+    t->started = 1;
+    t->next_sample = start_sample + count;
+
+    for (i = 0; i < count; i++, samples += stride) {
+        uint16_t code = *samples;
+        if (code > trace_code_max)
+            code = trace_code_max; // Clamp
+
+        // 放大时上一个样本之后空着的列：在两个样本之间线性插值
+        if (t->gap > 0) {
+            uint16_t prev = t->env_last, j;
+            for (j = 1; j <= t->gap; j++) {
+                uint16_t v = prev + (int16_t)((int32_t)((int16_t)code - (int16_t)prev) * j / (t->gap + 1));
+                etft_EmitColumnPriv(t, v, v, v, v, fRGB, bRGB);
             }
+            t->gap = 0;
         }
 
-        uint16_t averaged_adc_value;
-        if (num_actual_samples_averaged > 0) {
-            averaged_adc_value = sum_of_samples / num_actual_samples_averaged;
-        } else {
-            // Fallback: if no samples could be averaged (e.g., if segment_pixel_width > samples_in_segment)
-            // take the first available sample for this pixel column if possible.
-            if (start_sample_idx_in_segment < samples_in_segment) {
-                averaged_adc_value = segment_data_ptr[start_sample_idx_in_segment];
+        if (t->env_count == 0) {
+            t->env_first = t->env_lo = t->env_hi = code;
+            t->env_count = 1;
+        } else if (code < t->env_lo) {
+            t->env_lo = code;
+        } else if (code > t->env_hi) {
+            t->env_hi = code;
+        }
+        t->env_last = code;
+
+        t->phase += trace_cols;
+        while (t->phase >= trace_rate) {
+            t->phase -= trace_rate;
+            if (t->env_count) {
+                etft_EmitColumnPriv(t, t->env_first, t->env_lo, t->env_hi, t->env_last, fRGB, bRGB);
+                t->env_count = 0;
             } else {
-                averaged_adc_value = 0; // Or some default/last known good value
+                t->gap++;
             }
         }
-
-        if (averaged_adc_value > adc_max_value)
-            averaged_adc_value = adc_max_value; // Clamp
-
-        uint16_t current_x_coord_on_screen = x_start_on_screen_for_segment + i;
-
-        uint32_t temp_y = (uint32_t)averaged_adc_value * (screen_height - 1);
-        uint16_t current_y_coord_on_screen = (screen_height - 1) - (temp_y / adc_max_value);
-        if (current_y_coord_on_screen >= screen_height)
-            current_y_coord_on_screen = screen_height - 1;
-
-        if (i > 0 || segment_idx_for_positioning > 0) { // If not the first point in this segment's drawing loop
-            etft_DrawLinePriv(prev_x_coord_on_screen,
-                              prev_y_coord_on_screen,
-                              current_x_coord_on_screen,
-                              current_y_coord_on_screen,
-                              fRGB);
-        } else {
-            etft_DrawPixelPriv(current_x_coord_on_screen, current_y_coord_on_screen, fRGB);
-        }
-        prev_x_coord_on_screen = current_x_coord_on_screen;
-        prev_y_coord_on_screen = current_y_coord_on_screen;
     }
+
+    // 列末的跨度要等下一列的首点才能确定，先按已知跨度写出，避免画面滞后
+    etft_FlushColumnPriv(t, fRGB, bRGB);
 }
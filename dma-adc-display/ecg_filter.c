@@ -0,0 +1,198 @@
+#include "ecg_filter.h"
+
+#ifdef ECG_FILTER_MPY32
+    #include "hal.h"
+#endif
+
+// --- Private Definitions ---
+
+typedef struct {
+    uint16_t rate_hz;
+    int16_t hp_a; // Q15
+    EcgBiquadCoef lowpass;
+    EcgBiquadCoef notch[2]; // 50 Hz, 60 Hz
+} EcgFilterSet;
+
+// Generated by util/ecg_filter_design.py
+static const EcgFilterSet ecg_filter_sets[] = {
+    {
+        250, 32359, { 2381, 4762, 2381, -10994, 4134 },
+        { { 15980, -9876, 15980, -9871, 15571 }, { 15978, -2007, 15978, -2006, 15571 } },
+    },
+    {
+        500, 32563, { 756, 1511, 756, -21419, 8058 },
+        { { 16185, -26188, 16185, -26177, 15975 }, { 16183, -23594, 16183, -23587, 15975 } },
+    },
+    {
+        1000, 32665, { 219, 437, 219, -26992, 11483 },
+        { { 16288, -30981, 16288, -30968, 16179 }, { 16286, -30284, 16286, -30275, 16179 } },
+    },
+    {
+        2000, 32717, { 59, 119, 59, -29863, 13716 },
+        { { 16339, -32276, 16339, -32263, 16281 }, { 16337, -32095, 16337, -32086, 16281 } },
+    },
+};
+
+#define ECG_FILTER_SET_COUNT (sizeof(ecg_filter_sets) / sizeof(ecg_filter_sets[0]))
+
+// --- Private Functions ---
+
+static int16_t ecg_sat16(int32_t v) {
+    if (v > 32767)
+        return 32767;
+    if (v < -32768)
+        return -32768;
+    return (int16_t)v;
+}
+
+static void ecg_biquad_load(EcgBiquad* q, const EcgBiquadCoef* coef) {
+    q->c[0] = coef->b0;
+    q->c[1] = coef->b1;
+    q->c[2] = coef->b2;
+    q->c[3] = -coef->a1;
+    q->c[4] = -coef->a2;
+}
+
+static void ecg_biquad_clear(EcgBiquad* q) {
+    q->x1 = q->x2 = q->y1 = q->y2 = 0;
+    q->frac = 0;
+}
+
+#ifdef ECG_FILTER_MPY32
+// Interrupts must be off while these run: an ISR using the multiplier would clobber RES0..RES3
+
+// (a * y) >> 15 for a Q15 coefficient and a 32-bit value: MPYS32 32x16 -> 48-bit RES2:RES1:RES0
+static int32_t ecg_mul_q15(int16_t a, int32_t y) {
+    MPYS32L = (uint16_t)y;
+    MPYS32H = (uint16_t)((uint32_t)y >> 16);
+    OP2 = a;
+    return (int32_t)(((uint32_t)RES2 << 17) | ((uint32_t)RES1 << 1) | (RES0 >> 15));
+}
+
+// c[0] v[0] + ... + c[4] v[4], modulo 2^32: MPYS then four MACS into RESHI:RESLO
+static int32_t ecg_mac5(const int16_t* c, int16_t x0, const EcgBiquad* q) {
+    MPYS = c[0];
+    OP2 = x0;
+    MACS = c[1];
+    OP2 = q->x1;
+    MACS = c[2];
+    OP2 = q->x2;
+    MACS = c[3];
+    OP2 = q->y1;
+    MACS = c[4];
+    OP2 = q->y2;
+    return (int32_t)(((uint32_t)RESHI << 16) | RESLO);
+}
+#else
+static int32_t ecg_mul_q15(int16_t a, int32_t y) {
+    return (int32_t)(((int64_t)a * y) >> 15);
+}
+
+// Accumulated in uint32_t: an intermediate sum may wrap like the MPY32 result does,
+// the final one fits
+static int32_t ecg_mac5(const int16_t* c, int16_t x0, const EcgBiquad* q) {
+    uint32_t acc = (uint32_t)((int32_t)c[0] * x0);
+    acc += (uint32_t)((int32_t)c[1] * q->x1);
+    acc += (uint32_t)((int32_t)c[2] * q->x2);
+    acc += (uint32_t)((int32_t)c[3] * q->y1);
+    acc += (uint32_t)((int32_t)c[4] * q->y2);
+    return (int32_t)acc;
+}
+#endif
+
+static int16_t ecg_biquad_step(EcgBiquad* q, int16_t x) {
+    int32_t acc = ecg_mac5(q->c, x, q) + q->frac;
+    int16_t y = ecg_sat16(acc >> 14);
+    q->frac = (uint16_t)acc & 0x3FFF;
+    q->x2 = q->x1;
+    q->x1 = x;
+    q->y2 = q->y1;
+    q->y1 = y;
+    return y;
+}
+
+// --- Public Functions ---
+
+int ecg_filter_init(EcgFilter* f, uint16_t sample_rate_hz, uint8_t mains_hz, uint8_t sample_bits) {
+    uint16_t i;
+
+    f->sample_rate_hz = 0;
+    if (mains_hz != 0 && mains_hz != 50 && mains_hz != 60) {
+        return 0;
+    }
+    if (sample_bits < ECG_FILTER_MIN_BITS || sample_bits > ECG_FILTER_MAX_BITS) {
+        return 0;
+    }
+    for (i = 0; i < ECG_FILTER_SET_COUNT; i++) {
+        const EcgFilterSet* set = &ecg_filter_sets[i];
+        if (set->rate_hz != sample_rate_hz) {
+            continue;
+        }
+        f->hp_a = set->hp_a;
+        ecg_biquad_load(&f->lowpass, &set->lowpass);
+        if (mains_hz) {
+            ecg_biquad_load(&f->notch, &set->notch[mains_hz == 60]);
+        }
+        f->mains_hz = mains_hz;
+        f->scale_shift = ECG_FILTER_MAX_BITS - sample_bits;
+        f->sample_rate_hz = sample_rate_hz;
+        ecg_filter_reset(f);
+        return 1;
+    }
+    return 0;
+}
+
+void ecg_filter_reset(EcgFilter* f) {
+    f->primed = 0;
+    f->hp_x1 = 0;
+    f->hp_y = 0;
+    ecg_biquad_clear(&f->notch);
+    ecg_biquad_clear(&f->lowpass);
+}
+
+void ecg_filter_run(EcgFilter* f, uint16_t* samples, uint16_t count, uint16_t stride) {
+    uint8_t shift = f->scale_shift;
+    int32_t midscale = 1L << (ECG_FILTER_MAX_BITS - 1 - shift);
+    int32_t full_scale = 2 * midscale - 1;
+
+    if (f->sample_rate_hz == 0) {
+        return;
+    }
+    if (!f->primed && count > 0) {
+        // Start the high-pass from the first sample instead of a step up from 0
+        f->hp_x1 = (int16_t)(samples[0] << shift);
+        f->primed = 1;
+    }
+
+    while (count--) {
+        int16_t x = (int16_t)(*samples << shift);
+        int16_t y;
+        int32_t out;
+#ifdef ECG_FILTER_MPY32
+        uint16_t int_state = __get_interrupt_state();
+        __disable_interrupt();
+#endif
+
+        // High-pass: y = x - x1 + a y1, y kept with 15 fraction bits
+        f->hp_y = (int32_t)(x - f->hp_x1) * 32768L + ecg_mul_q15(f->hp_a, f->hp_y);
+        f->hp_x1 = x;
+        y = ecg_sat16((f->hp_y + (1L << 14)) >> 15);
+
+        if (f->mains_hz) {
+            y = ecg_biquad_step(&f->notch, y);
+        }
+        y = ecg_biquad_step(&f->lowpass, y);
+
+#ifdef ECG_FILTER_MPY32
+        __set_interrupt_state(int_state);
+#endif
+
+        out = midscale + (((int32_t)y + (1 << shift >> 1)) >> shift);
+        if (out < 0)
+            out = 0;
+        if (out > full_scale)
+            out = full_scale;
+        *samples = (uint16_t)out;
+        samples += stride;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef ECG_FILTER_H_
+#define ECG_FILTER_H_
+
+#include <stdint.h>
+
+// Streaming fixed-point filter chain for the ECG samples, run in place on each
+// captured segment: a first-order high-pass for baseline wander (0.5 Hz), a
+// 50/60 Hz notch (2 Hz wide) and a second-order Butterworth low-pass (40 Hz).
+//
+// Samples go in and come out as ADC codes of 12 bits, or up to 14 with the extra
+// resolution of oversampling (ACQ_OVS_BITS in adc_acq.h). Inside, the signal is
+// scaled up to a 14-bit range (ECG_FILTER_SCALE_SHIFT for 12-bit codes) in a Q15
+// word; after the high-pass it is centred on 0, and the output is re-centred on
+// mid-scale, so a trace with baseline wander stays on the screen. Coefficients are Q15
+// (high-pass pole) and Q14 (biquads), precomputed per sample rate by
+// util/ecg_filter_design.py; the biquads' DC gain
+// is exactly 1 after quantisation. Each biquad carries the fraction bits it drops
+// from one output into the next (first-order error feedback): with poles this close
+// to the unit circle, plain rounding would leave an error of up to 50 codes at
+// 2 kHz; with the feedback the output stays within 2 codes of the same chain in
+// double precision (tests/ecg_filter_test.c).
+//
+// With ECG_FILTER_MPY32 defined (default on the MSP430 and in the simulator) the
+// multiplies go through the MPY32 peripheral: one 32x16 multiply for the high-pass
+// and five chained MACS per biquad, with interrupts held off for the few cycles
+// the multiplier is in use. Without it, plain C performs the same integer
+// arithmetic, so both builds give bit-identical output (also checked by
+// tests/ecg_filter_test.c).
+//
+// Budget: 300 MCLK (15 us) per sample and channel, which keeps the filter under
+// 3% of the CPU per channel at 2 kHz. PROF_FILTER (prof.h) times ecg_filter_run()
+// over all channels of a segment, so its records must stay under segment_len x
+// channels x 15 us; util/ecg_prof_bench.py lists them. The instruction sequence
+// comes to about 290 MCLK per sample with MPY32 (36 multiplier register accesses).
+
+#if !defined(ECG_FILTER_MPY32) && (defined(__MSP430__) || defined(HOST_SIM))
+    #define ECG_FILTER_MPY32
+#endif
+
+#define ECG_FILTER_SCALE_SHIFT 2 // 12-bit codes * 4 leave headroom for overshoot in Q15
+#define ECG_FILTER_MIN_BITS 12
+#define ECG_FILTER_MAX_BITS (ECG_FILTER_MIN_BITS + ECG_FILTER_SCALE_SHIFT)
+
+// Biquad coefficients, Q14: y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2
+typedef struct {
+    int16_t b0, b1, b2, a1, a2;
+} EcgBiquadCoef;
+
+typedef struct {
+    int16_t c[5]; // b0, b1, b2, -a1, -a2: one multiply-accumulate per term
+    int16_t x1, x2, y1, y2;
+    uint16_t frac; // Fraction bits dropped from y1, added back into the next output
+} EcgBiquad;
+
+typedef struct {
+    uint16_t sample_rate_hz; // 0 until ecg_filter_init() succeeds: samples pass through
+    uint8_t mains_hz; // 0 = notch off
+    uint8_t primed; // First sample seen, hp_x1 valid
+    uint8_t scale_shift; // Code to Q15 word: ECG_FILTER_MAX_BITS - sample bits
+    int16_t hp_a; // High-pass pole, Q15
+    int16_t hp_x1;
+    int32_t hp_y; // High-pass output with 15 fraction bits
+    EcgBiquad notch;
+    EcgBiquad lowpass;
+} EcgFilter;
+
+/**
+ * @brief Loads the coefficients for a sample rate and clears the state.
+ * @param sample_rate_hz 250, 500, 1000 or 2000.
+ * @param mains_hz 50 or 60 for the notch, 0 to leave it out.
+ * @param sample_bits Width of the codes, ECG_FILTER_MIN_BITS..ECG_FILTER_MAX_BITS.
+ * @return 1 on success, 0 if the rate or mains frequency has no coefficient set
+ *         or the width is out of range (the filter then passes samples through unchanged).
+ */
+int ecg_filter_init(EcgFilter* f, uint16_t sample_rate_hz, uint8_t mains_hz, uint8_t sample_bits);
+
+/**
+ * @brief Clears the filter state, e.g. after a gap in the input; keeps the coefficients.
+ */
+void ecg_filter_reset(EcgFilter* f);
+
+/**
+ * @brief Filters a block of samples in place, continuing from the previous block.
+ * @param stride Words from one sample to the next: 1, or the channel count for one channel of
+ *        interleaved samples.
+ */
+void ecg_filter_run(EcgFilter* f, uint16_t* samples, uint16_t count, uint16_t stride);
+
+#endif /* ECG_FILTER_H_ */
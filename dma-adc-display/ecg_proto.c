@@ -0,0 +1,149 @@
+#include "ecg_proto.h"
+
+// --- Private Definitions ---
+
+// CRC-16/CCITT-FALSE, processed one nibble at a time to keep the table at 32 bytes
+static const uint16_t crc16_nibble_table[16] = { 0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5,
+                                                 0x60C6, 0x70E7, 0x8108, 0x9129, 0xA14A, 0xB16B,
+                                                 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF };
+
+static uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+// Drops the first n bytes of the decoder buffer and re-runs the sync search on the rest.
+static void ecg_decoder_shift(EcgDecoder* dec, uint16_t n) {
+    uint16_t i;
+    for (i = n; i < dec->fill; i++) {
+        dec->buf[i - n] = dec->buf[i];
+    }
+    dec->fill -= n;
+    dec->frame_len = 0;
+}
+
+// --- Function Implementations ---
+
+uint16_t ecg_crc16_update(uint16_t crc, const uint8_t* data, uint16_t len) {
+    uint16_t i;
+    for (i = 0; i < len; i++) {
+        crc = (crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+uint8_t ecg_crc8(const uint8_t* data, uint16_t len) {
+    uint8_t crc = 0;
+    uint16_t i;
+    uint8_t bit;
+    for (i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t ecg_encode_header(uint8_t* out, const EcgFrameHeader* header) {
+    out[0] = ECG_SYNC0;
+    out[1] = ECG_SYNC1;
+    out[2] = (ECG_PROTO_VERSION << 4) | (header->type & 0x0F);
+    put_u16(&out[3], header->payload_len);
+    put_u16(&out[5], header->seq);
+    put_u16(&out[7], header->sample_index & 0xFFFF);
+    put_u16(&out[9], header->sample_index >> 16);
+    out[11] = header->channel_mask;
+    out[12] = ecg_crc8(&out[2], 10);
+    return ecg_crc16_update(ECG_CRC16_INIT, &out[2], ECG_HEADER_LEN - 2);
+}
+
+void ecg_write_trailer(uint8_t* out, uint16_t crc) {
+    put_u16(out, crc);
+}
+
+uint16_t ecg_encode_frame(uint8_t* out, const EcgFrameHeader* header, const uint8_t* payload) {
+    uint16_t i;
+    uint16_t crc = ecg_encode_header(out, header);
+    for (i = 0; i < header->payload_len; i++) {
+        out[ECG_HEADER_LEN + i] = payload[i];
+    }
+    crc = ecg_crc16_update(crc, payload, header->payload_len);
+    ecg_write_trailer(&out[ECG_HEADER_LEN + header->payload_len], crc);
+    return header->payload_len + ECG_FRAME_OVERHEAD;
+}
+
+void ecg_decoder_init(EcgDecoder* dec) {
+    dec->fill = 0;
+    dec->frame_len = 0;
+    dec->frames_ok = 0;
+    dec->header_errors = 0;
+    dec->crc_errors = 0;
+    dec->bytes_skipped = 0;
+}
+
+int ecg_decoder_push(EcgDecoder* dec,
+                     uint8_t byte,
+                     EcgFrameHeader* header,
+                     const uint8_t** payload) {
+    dec->buf[dec->fill++] = byte;
+
+    // Rescanning after a false sync only ever looks at the bytes of one header,
+    // so this loop runs at most ECG_HEADER_LEN times per pushed byte.
+    while (dec->fill > 0) {
+        if (dec->buf[0] != ECG_SYNC0) {
+            dec->bytes_skipped++;
+            ecg_decoder_shift(dec, 1);
+            continue;
+        }
+        if (dec->fill >= 2 && dec->buf[1] != ECG_SYNC1) {
+            dec->bytes_skipped++;
+            ecg_decoder_shift(dec, 1);
+            continue;
+        }
+        if (dec->frame_len == 0) {
+            if (dec->fill < ECG_HEADER_LEN) {
+                return 0;
+            }
+            uint16_t payload_len = get_u16(&dec->buf[3]);
+            if ((dec->buf[2] >> 4) != ECG_PROTO_VERSION || payload_len > ECG_MAX_PAYLOAD
+                || ecg_crc8(&dec->buf[2], 10) != dec->buf[12])
+            {
+                dec->header_errors++;
+                ecg_decoder_shift(dec, 1);
+                continue;
+            }
+            dec->frame_len = ECG_HEADER_LEN + payload_len + ECG_TRAILER_LEN;
+        }
+        if (dec->fill < dec->frame_len) {
+            return 0;
+        }
+
+        // Whole frame collected
+        uint16_t payload_len = dec->frame_len - ECG_FRAME_OVERHEAD;
+        uint16_t crc = ecg_crc16_update(ECG_CRC16_INIT, &dec->buf[2], dec->frame_len - 4);
+        dec->fill = 0;
+        dec->frame_len = 0;
+        if (crc != get_u16(&dec->buf[ECG_HEADER_LEN + payload_len])) {
+            // The header was sound, so the frame boundary is trusted: drop the
+            // whole frame instead of rescanning its payload for sync bytes.
+            dec->crc_errors++;
+            return 0;
+        }
+        header->type = dec->buf[2] & 0x0F;
+        header->version = dec->buf[2] >> 4;
+        header->payload_len = payload_len;
+        header->seq = get_u16(&dec->buf[5]);
+        header->sample_index = (uint32_t)get_u16(&dec->buf[7]) | ((uint32_t)get_u16(&dec->buf[9]) << 16);
+        header->channel_mask = dec->buf[11];
+        *payload = &dec->buf[ECG_HEADER_LEN];
+        dec->frames_ok++;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+#ifndef ECG_PROTO_H_
+#define ECG_PROTO_H_
+
+#include <stdint.h>
+
+// ECG frame protocol v2, shared by the firmware and host-side receivers.
+// Plain C with no device headers, so the same file builds for MSP430 and on a PC.
+//
+// Frame layout (all multi-byte fields little-endian):
+//   0      0xAA                 sync
+//   1      0x55                 sync
+//   2      version << 4 | type
+//   3-4    payload length in bytes
+//   5-6    sequence number, +1 per frame, wraps at 65536
+//   7-10   sample index of the first sample in the payload
+//   11     channel mask (bit n = ADC input An present)
+//   12     CRC-8 of bytes 2..11, lets a receiver reject a false sync at once
+//   13..   payload
+//   last 2 CRC-16/CCITT-FALSE of bytes 2..end of payload
+//
+// Sample frames carry the same number of samples of every channel in the mask,
+// channels in ascending input order: interleaved (all channels of sample 0, then
+// of sample 1, ...) in ECG_TYPE_SAMPLES frames, one channel after the other in
+// ECG_TYPE_SAMPLES_PLANAR frames. ECG_TYPE_SAMPLES_RICE codes each channel as a
+// block of its own (ecg_rice.h); with more than one channel, each block is
+// preceded by its length in bytes (2 bytes). The header's sample index counts
+// samples per channel.
+//
+// A receiver that loses sync scans for 0xAA 0x55 and checks the header CRC
+// before buffering any payload, so a corrupted stream costs at most one
+// header of work per false sync instead of a full maximum-length frame.
+
+#define ECG_SYNC0 0xAA
+#define ECG_SYNC1 0x55
+#define ECG_PROTO_VERSION 2
+
+#define ECG_HEADER_LEN 13
+#define ECG_TRAILER_LEN 2
+#define ECG_FRAME_OVERHEAD (ECG_HEADER_LEN + ECG_TRAILER_LEN)
+
+// Largest payload a decoder accepts; longer lengths are treated as a false sync
+#ifndef ECG_MAX_PAYLOAD
+    #define ECG_MAX_PAYLOAD 1024
+#endif
+
+#define ECG_CRC16_INIT 0xFFFF
+
+// Frame types (low nibble of byte 2). Samples are 12-bit codes, or up to 14 bits wide with
+// ACQ_OVS_BITS (adc_acq.h); LINK_CMD_RATE_REPORT (uart_link.h) tells the host which.
+typedef enum {
+    ECG_TYPE_SAMPLES = 0, // Raw samples, one uint16_t per channel per sample, interleaved
+    ECG_TYPE_SAMPLES_RICE = 1, // Same samples, delta + Rice coded per channel (see ecg_rice.h)
+    ECG_TYPE_BEAT = 2, // One detected heartbeat (see ecg_qrs.h), layout below
+    ECG_TYPE_SAMPLES_PLANAR = 3, // Raw samples, one channel after the other
+    ECG_TYPE_STATS = 4, // Firmware profile, PROF builds only (see prof.h), layout below
+    ECG_TYPE_LATENCY = 5, // Pipeline timestamps of one segment, LATENCY builds only (see latency.h)
+} EcgFrameType;
+
+// ECG_TYPE_BEAT payload; the header's sample index is that of the R peak, the
+// channel mask that of the lead the detector ran on
+//   0-1  RR interval from the previous beat in ms, 0 if unknown
+//   2    heart rate from that interval, BPM, 0 if unknown
+//   3    heart rate averaged over the last 8 intervals, BPM, 0 if unknown
+//   4    flags: bit 0 = found by search-back below the detection threshold
+#define ECG_BEAT_PAYLOAD_LEN 5
+
+// ECG_TYPE_STATS payload, sent with every LINK_CMD_POWER_REPORT; the header's sample index
+// and channel mask are 0
+//   0    largest capture backlog seen since capture started, segments
+//   1    capture queue depth, segments: a backlog reaching it loses segments
+//   2-3  segments recaptured while the UART still sent them (the frames' payloads were copied
+//        out first, nothing is lost), since start-up
+//   4-5  profiling timer ticks per ms
+//   6    number of regions N
+//   7..  N records of ECG_STATS_RECORD_LEN bytes, in prof.h's ProfRegion order, covering
+//        the time since the previous stats frame:
+//        0-1 count, 2-3 min, 4-5 max, 6-9 sum (ticks), 10..25 histogram, 8 counts of 2 bytes
+//        for durations of <4, <16, <64 ... ticks and the rest
+#define ECG_STATS_HEADER_LEN 4
+#define ECG_STATS_RECORD_LEN 26
+
+// ECG_TYPE_LATENCY payload, sent once a segment has been through every stage; the header's
+// sample index and channel mask are those of the segment
+//   0-1  samples per channel in the segment
+//   2-3  sequence number of the segment's sample frame
+//   4..  ECG_LATENCY_STAGES times of 2 bytes, in latency.h's LatencyStage order, in ticks of
+//        1/32768 s after the DMA completed the segment; 0xFFFF if it never got there:
+//        processed, framed (queued to the UART), sent (last byte to the USCI), shown (on the TFT)
+#define ECG_LATENCY_STAGES 4
+#define ECG_LATENCY_PAYLOAD_LEN (4 + 2 * ECG_LATENCY_STAGES)
+
+// Fields of a decoded (or to be encoded) frame header
+typedef struct {
+    uint8_t type;
+    uint8_t version;
+    uint16_t payload_len;
+    uint16_t seq;
+    uint32_t sample_index;
+    uint8_t channel_mask;
+} EcgFrameHeader;
+
+// Streaming decoder state. Feed bytes in any chunking with ecg_decoder_push().
+typedef struct {
+    uint8_t buf[ECG_HEADER_LEN + ECG_MAX_PAYLOAD + ECG_TRAILER_LEN];
+    uint16_t fill; // Bytes currently in buf
+    uint16_t frame_len; // Total length of the frame being collected, 0 while in the header
+    // Statistics
+    uint32_t frames_ok;
+    uint32_t header_errors; // False syncs rejected by the header CRC or length check
+    uint32_t crc_errors; // Frames with a good header but a bad CRC-16
+    uint32_t bytes_skipped; // Bytes discarded while hunting for sync
+} EcgDecoder;
+
+/**
+ * @brief Updates a CRC-16/CCITT-FALSE (poly 0x1021, MSB first) over a buffer.
+ * Start with ECG_CRC16_INIT; no final XOR.
+ */
+uint16_t ecg_crc16_update(uint16_t crc, const uint8_t* data, uint16_t len);
+
+/**
+ * @brief CRC-8 (poly 0x07, init 0) used for the header check byte.
+ */
+uint8_t ecg_crc8(const uint8_t* data, uint16_t len);
+
+/**
+ * @brief Writes the ECG_HEADER_LEN header bytes for a frame.
+ * @return The CRC-16 running value over the header, to be continued over the payload
+ *         with ecg_crc16_update() and stored with ecg_write_trailer().
+ */
+uint16_t ecg_encode_header(uint8_t* out, const EcgFrameHeader* header);
+
+/**
+ * @brief Stores the final CRC-16 into the ECG_TRAILER_LEN trailer bytes.
+ */
+void ecg_write_trailer(uint8_t* out, uint16_t crc);
+
+/**
+ * @brief Encodes a complete frame into a contiguous buffer.
+ * @return Frame length in bytes (payload_len + ECG_FRAME_OVERHEAD).
+ */
+uint16_t ecg_encode_frame(uint8_t* out, const EcgFrameHeader* header, const uint8_t* payload);
+
+void ecg_decoder_init(EcgDecoder* dec);
+
+/**
+ * @brief Feeds one received byte into the decoder.
+ * @param header Filled in when a frame completes.
+ * @param payload Set to the payload inside the decoder buffer, valid until the next push.
+ * @return 1 when a valid frame has just completed, 0 otherwise.
+ */
+int ecg_decoder_push(EcgDecoder* dec,
+                     uint8_t byte,
+                     EcgFrameHeader* header,
+                     const uint8_t** payload);
+
+#endif /* ECG_PROTO_H_ */
@@ -0,0 +1,308 @@
+#include "ecg_qrs.h"
+#include <string.h>
+
+// --- Private Definitions ---
+
+// Times in detector samples (4 ms)
+#define QRS_SETTLE 64 // Filters and integration window filling after a restart
+#define QRS_LEARN 500 // 2 s
+#define QRS_RELEARN 1000 // 4 s without a beat
+#define QRS_REFRACTORY 50 // 200 ms
+#define QRS_TWAVE 90 // 360 ms
+#define QRS_PEAK_HOLD 24 // An integrated peak is final 96 ms after its maximum at the latest
+#define QRS_RR_MIN 60 // Plausible RR intervals for the average: 240 ms ..
+#define QRS_RR_MAX 750 // .. 3 s
+#define QRS_RR_CLAMP 16000 // Keeps rr_ms in 16 bits
+#define QRS_BP_DELAY 23 // Band-pass group delay: 7 for the low-pass, 16 for the high-pass
+
+#define QRS_RING_MASK (ECG_QRS_RING - 1)
+#define QRS_MIDSCALE 2048
+
+// --- Private Functions ---
+
+static int16_t ecg_qrs_bp(const EcgQrs* q, uint32_t k) {
+    return q->bp[(uint16_t)k & QRS_RING_MASK];
+}
+
+static int16_t ecg_qrs_derivative(const EcgQrs* q, uint32_t k) {
+    return (int16_t)((2 * ecg_qrs_bp(q, k) + ecg_qrs_bp(q, k - 1) - ecg_qrs_bp(q, k - 3)
+                      - 2 * ecg_qrs_bp(q, k - 4))
+                     >> 3);
+}
+
+// Clears the filters and the beat tracking; learned levels and the RR history stay
+static void ecg_qrs_restart(EcgQrs* q, uint32_t start_sample) {
+    q->started = 1;
+    q->index0 = start_sample;
+    q->n = 0;
+    q->decim_count = 0;
+    q->decim_sum = 0;
+    memset(q->bp, 0, sizeof(q->bp));
+    memset(q->sq, 0, sizeof(q->sq));
+    q->mwi_pos = 0;
+    q->mwi_sum = 0;
+    q->mwi_prev = 0;
+    q->peak_val = 0;
+    q->have_qrs = 0;
+    q->last_qrs_n = QRS_SETTLE;
+    q->sb_peak = 0;
+    q->learn_start = QRS_SETTLE;
+    q->learn_max = 0;
+    q->learn_sum = 0;
+}
+
+// Fills the band-pass delay lines as if x had always been the input, so the start is not a step
+static void ecg_qrs_prime(EcgQrs* q, int16_t x) {
+    uint16_t i;
+    for (i = 0; i < 8; i++) {
+        q->lp_x[i] = x;
+        q->lp_s1d[i] = 8 * x;
+    }
+    q->lp_s1 = 8 * x;
+    q->lp_s2 = 64L * x;
+    for (i = 0; i < 32; i++) {
+        q->lp[i] = x;
+    }
+    q->hp_sum = 32L * x;
+}
+
+static void ecg_qrs_emit(EcgQrs* q, uint32_t r_n, uint8_t flags) {
+    EcgQrsBeat* b;
+    uint16_t rr = 0;
+
+    if (q->have_qrs && r_n > q->last_r_n) {
+        rr = (r_n - q->last_r_n > QRS_RR_CLAMP) ? QRS_RR_CLAMP : (uint16_t)(r_n - q->last_r_n);
+    }
+    if (rr >= QRS_RR_MIN && rr <= QRS_RR_MAX) {
+        if (q->rr_count == ECG_QRS_RR_AVG) {
+            q->rr_sum -= q->rr[q->rr_pos];
+        } else {
+            q->rr_count++;
+        }
+        q->rr[q->rr_pos] = rr;
+        q->rr_sum += rr;
+        q->rr_pos = (q->rr_pos + 1) % ECG_QRS_RR_AVG;
+        q->sb_limit = q->rr_sum / q->rr_count * 5 / 3;
+    }
+
+    if (q->beat_count == ECG_QRS_BEATS) {
+        q->beat_head = (q->beat_head + 1) % ECG_QRS_BEATS;
+        q->beat_drops++;
+    } else {
+        q->beat_count++;
+    }
+    b = &q->beats[(q->beat_head + q->beat_count - 1) % ECG_QRS_BEATS];
+    b->sample_index = q->index0 + (r_n << q->decim_shift) + ((1U << q->decim_shift) >> 1);
+    b->rr_ms = rr * (1000 / ECG_QRS_RATE_HZ);
+    b->bpm = 0;
+    if (rr) {
+        uint16_t bpm = (60U * ECG_QRS_RATE_HZ + rr / 2) / rr;
+        b->bpm = bpm > 255 ? 255 : (uint8_t)bpm;
+    }
+    b->bpm_avg = 0;
+    if (q->rr_count) {
+        uint32_t bpm = (60UL * ECG_QRS_RATE_HZ * q->rr_count + q->rr_sum / 2) / q->rr_sum;
+        b->bpm_avg = bpm > 255 ? 255 : (uint8_t)bpm;
+    }
+    b->flags = flags;
+}
+
+static void ecg_qrs_accept(EcgQrs* q, uint32_t peak_n, uint32_t r_n, uint16_t slope, uint8_t flags) {
+    ecg_qrs_emit(q, r_n, flags);
+    q->have_qrs = 1;
+    q->last_qrs_n = peak_n;
+    q->last_r_n = r_n;
+    q->last_slope = slope;
+    q->sb_peak = 0;
+}
+
+// Classifies a peak of the integrated signal that ended at detector sample peak_n
+static void ecg_qrs_classify(EcgQrs* q, uint32_t peak, uint32_t peak_n) {
+    uint32_t k, r_k = 0;
+    uint16_t r_mag = 0, slope = 0;
+    uint32_t t1;
+
+    if (q->have_qrs && peak_n - q->last_qrs_n < QRS_REFRACTORY) {
+        return;
+    }
+
+    // The window integrated at peak_n covers derivatives centred on peak_n - 39 .. peak_n - 2
+    for (k = peak_n - ECG_QRS_MWI_LEN - 1; k <= peak_n - 2; k++) {
+        int16_t v = ecg_qrs_bp(q, k);
+        int16_t d = ecg_qrs_derivative(q, k + 2);
+        uint16_t mag = (uint16_t)(v < 0 ? -v : v);
+        uint16_t dmag = (uint16_t)(d < 0 ? -d : d);
+        if (mag > r_mag) {
+            r_mag = mag;
+            r_k = k;
+        }
+        if (dmag > slope) {
+            slope = dmag;
+        }
+    }
+    r_k -= QRS_BP_DELAY;
+
+    t1 = q->npki + (q->spki > q->npki ? (q->spki - q->npki) >> 2 : 0);
+    if (peak > t1) {
+        if (q->have_qrs && peak_n - q->last_qrs_n < QRS_TWAVE && slope < q->last_slope / 2) {
+            q->npki = (peak >> 3) + q->npki - (q->npki >> 3); // T wave
+            return;
+        }
+        q->spki = (peak >> 3) + q->spki - (q->spki >> 3);
+        ecg_qrs_accept(q, peak_n, r_k, slope, 0);
+    } else {
+        q->npki = (peak >> 3) + q->npki - (q->npki >> 3);
+        if (peak > t1 / 2 && peak > q->sb_peak) {
+            q->sb_peak = peak;
+            q->sb_n = peak_n;
+            q->sb_r_n = r_k;
+            q->sb_slope = slope;
+        }
+    }
+}
+
+static void ecg_qrs_step(EcgQrs* q, int16_t x) {
+    uint16_t i = (uint16_t)q->n;
+    int16_t lp, d;
+    uint32_t sq, mwi;
+
+    if (q->n == 0) {
+        ecg_qrs_prime(q, x);
+    }
+
+    // Low-pass: two 8-sample running sums, gain 64
+    q->lp_s1 += x - q->lp_x[i & 7];
+    q->lp_x[i & 7] = x;
+    q->lp_s2 += q->lp_s1 - q->lp_s1d[i & 7];
+    q->lp_s1d[i & 7] = q->lp_s1;
+    lp = (int16_t)(q->lp_s2 >> 6);
+
+    // High-pass: the sample in the middle of a 32-sample window minus the window's mean
+    q->hp_sum += lp - q->lp[i & 31];
+    q->lp[i & 31] = lp;
+    q->bp[i & QRS_RING_MASK] = q->lp[(i - 16) & 31] - (int16_t)(q->hp_sum >> 5);
+
+    // Derivative, squaring, moving-window integration
+    d = ecg_qrs_derivative(q, q->n);
+    sq = (uint32_t)((int32_t)d * d);
+    q->mwi_sum += sq - q->sq[q->mwi_pos];
+    q->sq[q->mwi_pos] = sq;
+    if (++q->mwi_pos == ECG_QRS_MWI_LEN) {
+        q->mwi_pos = 0;
+    }
+    mwi = q->mwi_sum;
+
+    if (q->n >= QRS_SETTLE) {
+        if (!q->learned) {
+            if (mwi > q->learn_max) {
+                q->learn_max = mwi;
+            }
+            q->learn_sum += mwi >> 6;
+            if (q->n - q->learn_start == QRS_LEARN - 1) {
+                q->spki = q->learn_max / 3;
+                q->npki = (q->learn_sum / QRS_LEARN) << 5; // Half the mean
+                q->learned = 1;
+                q->last_qrs_n = q->n;
+            }
+        } else {
+            if (q->peak_val) {
+                if (mwi > q->peak_val) {
+                    q->peak_val = mwi;
+                    q->peak_n = q->n;
+                } else if (mwi <= q->peak_val / 2 || q->n - q->peak_n >= QRS_PEAK_HOLD) {
+                    ecg_qrs_classify(q, q->peak_val, q->peak_n);
+                    q->peak_val = 0;
+                }
+            } else if (mwi > q->mwi_prev) {
+                q->peak_val = mwi;
+                q->peak_n = q->n;
+            }
+
+            if (q->have_qrs && q->rr_count && q->sb_peak && q->n - q->last_qrs_n > q->sb_limit) {
+                q->spki = (q->sb_peak >> 2) + q->spki - (q->spki >> 2);
+                ecg_qrs_accept(q, q->sb_n, q->sb_r_n, q->sb_slope, ECG_QRS_FLAG_SEARCHBACK);
+            }
+
+            if (q->n - q->last_qrs_n > QRS_RELEARN) {
+                // Lost the signal (lead off, amplitude change): learn the levels again
+                q->learned = 0;
+                q->learn_start = q->n + 1;
+                q->learn_max = 0;
+                q->learn_sum = 0;
+                q->have_qrs = 0;
+                q->peak_val = 0;
+                q->sb_peak = 0;
+            }
+        }
+    }
+    q->mwi_prev = mwi;
+    q->n++;
+}
+
+// --- Public Functions ---
+
+int ecg_qrs_init(EcgQrs* q, uint16_t sample_rate_hz, uint8_t sample_bits) {
+    uint8_t shift = 0;
+
+    q->sample_rate_hz = 0;
+    if (sample_bits < ECG_QRS_MIN_BITS || sample_bits > ECG_QRS_MAX_BITS) {
+        return 0;
+    }
+    while (((uint16_t)ECG_QRS_RATE_HZ << shift) < sample_rate_hz && shift < 3) {
+        shift++;
+    }
+    if (((uint16_t)ECG_QRS_RATE_HZ << shift) != sample_rate_hz) {
+        return 0;
+    }
+    ecg_qrs_reset(q);
+    q->decim_shift = shift;
+    q->input_shift = sample_bits - ECG_QRS_MIN_BITS;
+    q->sample_rate_hz = sample_rate_hz;
+    return 1;
+}
+
+void ecg_qrs_reset(EcgQrs* q) {
+    uint16_t rate = q->sample_rate_hz;
+    uint8_t shift = q->decim_shift;
+    uint8_t input_shift = q->input_shift;
+
+    memset(q, 0, sizeof(*q));
+    q->sample_rate_hz = rate;
+    q->decim_shift = shift;
+    q->input_shift = input_shift;
+}
+
+void ecg_qrs_run(EcgQrs* q,
+                 const uint16_t* samples,
+                 uint16_t count,
+                 uint16_t stride,
+                 uint32_t start_sample) {
+    if (q->sample_rate_hz == 0 || count == 0) {
+        return;
+    }
+    if (!q->started || start_sample != q->next_sample) {
+        ecg_qrs_restart(q, start_sample);
+    }
+    q->next_sample = start_sample + count;
+
+    while (count--) {
+        q->decim_sum += *samples >> q->input_shift;
+        samples += stride;
+        if (++q->decim_count < (1U << q->decim_shift)) {
+            continue;
+        }
+        ecg_qrs_step(q, (int16_t)(q->decim_sum >> q->decim_shift) - QRS_MIDSCALE);
+        q->decim_sum = 0;
+        q->decim_count = 0;
+    }
+}
+
+int ecg_qrs_pop(EcgQrs* q, EcgQrsBeat* beat) {
+    if (q->beat_count == 0) {
+        return 0;
+    }
+    *beat = q->beats[q->beat_head];
+    q->beat_head = (q->beat_head + 1) % ECG_QRS_BEATS;
+    q->beat_count--;
+    return 1;
+}
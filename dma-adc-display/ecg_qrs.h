@@ -0,0 +1,131 @@
+#ifndef ECG_QRS_H_
+#define ECG_QRS_H_
+
+#include <stdint.h>
+
+// Streaming QRS detector after Pan and Tompkins, integer arithmetic only.
+// Samples are fed one segment at a time; detected beats are queued with the
+// sample index of their R peak and the heart rate.
+//
+// The input (codes centred on mid-scale, raw or from ecg_filter.h) is cut to
+// 12 bits and averaged down to ECG_QRS_RATE_HZ, so the detector's constants and
+// memory depend on neither the sample width nor the capture rate. Per detector
+// sample:
+//   band-pass 5-15 Hz   two 8-sample running sums (low-pass) minus a 32-sample
+//                       running mean (high-pass), no multiplies
+//   derivative          (2x[n] + x[n-1] - x[n-3] - 2x[n-4]) / 8
+//   squaring, then a 152 ms moving-window integration
+// Peaks of the integrated signal are classified against adaptive signal and
+// noise levels (threshold at a quarter of the way from noise to signal). The
+// first 2 s after a reset only learn those levels. A beat arriving less than
+// 200 ms after the last one is ignored; one within 360 ms is taken for a T wave
+// unless its slope reaches half that of the last QRS. If no beat is found for
+// 166% of the average RR interval, the largest peak above half the threshold
+// is taken after all (search-back). After 4 s without a beat the levels are
+// learned again.
+//
+// The R peak is the largest band-passed deflection under the integration
+// window, so its index is accurate to one detector sample (4 ms); a filter
+// ahead of the detector adds its own delay (about 5 ms for ecg_filter.h). A
+// beat is reported about 250 ms after its R peak.
+//
+// State is about 600 bytes.
+
+#define ECG_QRS_RATE_HZ 250
+#define ECG_QRS_BEATS 4 // Beats buffered between ecg_qrs_run() and ecg_qrs_pop()
+#define ECG_QRS_RR_AVG 8 // RR intervals averaged for bpm_avg
+#define ECG_QRS_MWI_LEN 38 // Integration window, detector samples
+#define ECG_QRS_RING 128 // Band-passed history kept to locate the R peak, power of two
+#define ECG_QRS_MIN_BITS 12 // Sample widths accepted by ecg_qrs_init()
+#define ECG_QRS_MAX_BITS 14
+
+// Beat flags
+#define ECG_QRS_FLAG_SEARCHBACK 0x01 // Found below the threshold by search-back
+
+typedef struct {
+    uint32_t sample_index; // R peak, in input samples since capture started
+    uint16_t rr_ms; // Interval from the previous beat, 0 for the first one after a reset or gap
+    uint8_t bpm; // 60000 / rr_ms, 0 if rr_ms is 0
+    uint8_t bpm_avg; // From the last ECG_QRS_RR_AVG plausible intervals, 0 until there is one
+    uint8_t flags;
+} EcgQrsBeat;
+
+typedef struct {
+    uint16_t sample_rate_hz; // 0 until ecg_qrs_init() succeeds: input is ignored
+    uint8_t decim_shift; // Input samples per detector sample = 1 << decim_shift
+    uint8_t input_shift; // Sample bits beyond 12, dropped on input
+    uint8_t decim_count;
+    uint16_t decim_sum;
+    uint8_t started;
+    uint32_t next_sample; // Input index expected next, to detect gaps
+    uint32_t index0; // Input index of detector sample 0
+    uint32_t n; // Detector samples since the last restart
+
+    // Band-pass and integration
+    int16_t lp_x[8], lp_s1d[8];
+    int16_t lp_s1;
+    int32_t lp_s2;
+    int16_t lp[32];
+    int32_t hp_sum;
+    int16_t bp[ECG_QRS_RING];
+    uint32_t sq[ECG_QRS_MWI_LEN];
+    uint8_t mwi_pos;
+    uint32_t mwi_sum;
+    uint32_t mwi_prev;
+
+    // Peak classification
+    uint8_t learned;
+    uint32_t learn_start;
+    uint32_t learn_max;
+    uint32_t learn_sum;
+    uint32_t spki, npki; // Signal and noise peak levels
+    uint32_t peak_val, peak_n; // Integrated peak being tracked, 0 if none
+    uint8_t have_qrs;
+    uint32_t last_qrs_n; // Integrated peak of the last beat
+    uint32_t last_r_n; // R peak of the last beat
+    uint16_t last_slope;
+    uint32_t sb_peak, sb_n, sb_r_n; // Largest noise peak above half the threshold since the last beat
+    uint16_t sb_slope;
+    uint16_t rr[ECG_QRS_RR_AVG]; // Detector samples
+    uint8_t rr_count, rr_pos;
+    uint16_t rr_sum;
+    uint16_t sb_limit; // 166% of the average RR interval
+
+    EcgQrsBeat beats[ECG_QRS_BEATS];
+    uint8_t beat_head, beat_count;
+    uint16_t beat_drops; // Beats overwritten before ecg_qrs_pop() took them
+} EcgQrs;
+
+/**
+ * @brief Sets up the detector for a capture rate and resets it.
+ * @param sample_rate_hz 250, 500, 1000 or 2000.
+ * @param sample_bits Width of the codes, ECG_QRS_MIN_BITS..ECG_QRS_MAX_BITS.
+ * @return 1 on success, 0 if the rate or width is not supported (input is then ignored).
+ */
+int ecg_qrs_init(EcgQrs* q, uint16_t sample_rate_hz, uint8_t sample_bits);
+
+/**
+ * @brief Forgets all state, including the learned levels and the RR history.
+ */
+void ecg_qrs_reset(EcgQrs* q);
+
+/**
+ * @brief Processes a block of samples of the width given to ecg_qrs_init().
+ * @param stride Words from one sample to the next: 1, or the channel count for
+ *        one channel of interleaved samples.
+ * @param start_sample Input index of samples[0]. A block that does not continue
+ *        the previous one restarts the filters; the learned levels are kept.
+ */
+void ecg_qrs_run(EcgQrs* q,
+                 const uint16_t* samples,
+                 uint16_t count,
+                 uint16_t stride,
+                 uint32_t start_sample);
+
+/**
+ * @brief Takes the oldest detected beat.
+ * @return 1 if *beat was filled, 0 if none is waiting.
+ */
+int ecg_qrs_pop(EcgQrs* q, EcgQrsBeat* beat);
+
+#endif /* ECG_QRS_H_ */
@@ -0,0 +1,211 @@
+#include "ecg_rice.h"
+
+// --- Private Definitions ---
+
+typedef struct {
+    uint8_t* out;
+    uint16_t cap;
+    uint16_t pos; // Next byte to write
+    uint16_t acc; // Pending bits, right-aligned
+    uint8_t nbits; // Number of pending bits (< 8 between calls)
+    uint8_t overflow;
+} BitWriter;
+
+typedef struct {
+    const uint8_t* in;
+    uint16_t len;
+    uint16_t pos;
+    uint16_t acc;
+    uint8_t nbits;
+} BitReader;
+
+static void bw_put(BitWriter* bw, uint16_t value, uint8_t nbits) {
+    // Feed at most 8 bits at a time so the 16-bit accumulator never overflows
+    while (nbits > 0) {
+        uint8_t take = nbits > 8 ? 8 : nbits;
+        nbits -= take;
+        bw->acc = (bw->acc << take) | ((value >> nbits) & ((1u << take) - 1));
+        bw->nbits += take;
+        if (bw->nbits >= 8) {
+            bw->nbits -= 8;
+            if (bw->pos < bw->cap) {
+                bw->out[bw->pos++] = bw->acc >> bw->nbits;
+            } else {
+                bw->overflow = 1;
+            }
+        }
+    }
+}
+
+static void bw_put_ones(BitWriter* bw, uint8_t count) {
+    while (count >= 8) {
+        bw_put(bw, 0xFF, 8);
+        count -= 8;
+    }
+    if (count > 0) {
+        bw_put(bw, (1u << count) - 1, count);
+    }
+}
+
+static int br_get(BitReader* br, uint8_t nbits, uint16_t* value) {
+    uint16_t v = 0;
+    while (nbits > 0) {
+        if (br->nbits == 0) {
+            if (br->pos >= br->len) {
+                return 0;
+            }
+            br->acc = br->in[br->pos++];
+            br->nbits = 8;
+        }
+        uint8_t take = nbits < br->nbits ? nbits : br->nbits;
+        br->nbits -= take;
+        v = (v << take) | ((br->acc >> br->nbits) & ((1u << take) - 1));
+        nbits -= take;
+    }
+    *value = v;
+    return 1;
+}
+
+static uint16_t zigzag(int16_t r) {
+    return (r >= 0) ? ((uint16_t)r << 1) : (((uint16_t)(-r) << 1) - 1);
+}
+
+static int16_t unzigzag(uint16_t v) {
+    return (v & 1) ? -(int16_t)((v + 1) >> 1) : (int16_t)(v >> 1);
+}
+
+// Residual of the sample at p, whose predecessors lie stride and 2 * stride words back
+static int16_t residual(const uint16_t* p, uint16_t stride, uint8_t order2) {
+    if (order2) {
+        return (int16_t)(*p - 2 * *(p - stride) + *(p - 2 * stride));
+    }
+    return (int16_t)(*p - *(p - stride));
+}
+
+// --- Function Implementations ---
+
+uint16_t ecg_rice_encode(const uint16_t* samples,
+                         uint16_t count,
+                         uint16_t stride,
+                         uint8_t* out,
+                         uint16_t out_cap) {
+    uint32_t sum1 = 0, sum2 = 0, sum;
+    uint16_t max1 = 0, max2 = 0, max;
+    uint8_t order2, k = 0, w = 0;
+    uint16_t i;
+    const uint16_t* p;
+    BitWriter bw;
+
+    if (count == 0 || out_cap < ECG_RICE_HEADER_LEN) {
+        return 0;
+    }
+
+    // Pick the predictor with the smaller residual energy, then k ~ log2(mean residual) and
+    // the escape width from the largest residual
+    for (i = 1, p = samples + stride; i < count; i++, p += stride) {
+        uint16_t v1 = zigzag(residual(p, stride, 0));
+        uint16_t v2 = zigzag(residual(p, stride, i >= 2));
+        sum1 += v1;
+        sum2 += v2;
+        if (v1 > max1)
+            max1 = v1;
+        if (v2 > max2)
+            max2 = v2;
+    }
+    order2 = sum2 < sum1;
+    sum = order2 ? sum2 : sum1;
+    max = order2 ? max2 : max1;
+    while (k < 13 && ((uint32_t)count << (k + 1)) <= sum) {
+        k++;
+    }
+    while (w < ECG_RICE_MAX_W && (max >> (ECG_RICE_RAW_BITS + w)) != 0) {
+        w++;
+    }
+
+    out[0] = count & 0xFF;
+    out[1] = count >> 8;
+    out[2] = k | (order2 ? ECG_RICE_ORDER2 : 0) | (w << ECG_RICE_W_SHIFT);
+    out[3] = samples[0] & 0xFF;
+    out[4] = samples[0] >> 8;
+
+    bw.out = out;
+    bw.cap = out_cap;
+    bw.pos = ECG_RICE_HEADER_LEN;
+    bw.acc = 0;
+    bw.nbits = 0;
+    bw.overflow = 0;
+
+    for (i = 1, p = samples + stride; i < count && !bw.overflow; i++, p += stride) {
+        uint16_t v = zigzag(residual(p, stride, order2 && i >= 2));
+        uint16_t q = v >> k;
+        if (q >= ECG_RICE_ESCAPE_Q) {
+            bw_put_ones(&bw, ECG_RICE_ESCAPE_Q);
+            bw_put(&bw, v, ECG_RICE_RAW_BITS + w);
+        } else {
+            bw_put_ones(&bw, q);
+            bw_put(&bw, 0, 1);
+            bw_put(&bw, v, k);
+        }
+    }
+    if (bw.nbits > 0) {
+        bw_put(&bw, 0, 8 - bw.nbits); // Pad the last byte with zeros
+    }
+    return bw.overflow ? 0 : bw.pos;
+}
+
+int ecg_rice_decode(const uint8_t* in, uint16_t len, uint16_t* samples, uint16_t max_samples) {
+    uint16_t count, i;
+    uint8_t k, order2, w;
+    BitReader br;
+
+    if (len < ECG_RICE_HEADER_LEN) {
+        return -1;
+    }
+    count = (uint16_t)in[0] | ((uint16_t)in[1] << 8);
+    k = in[2] & ECG_RICE_K_MASK;
+    order2 = (in[2] & ECG_RICE_ORDER2) != 0;
+    w = (in[2] & ECG_RICE_W_MASK) >> ECG_RICE_W_SHIFT;
+    if (count == 0 || count > max_samples || k > 13 || w > ECG_RICE_MAX_W) {
+        return -1;
+    }
+    samples[0] = (uint16_t)in[3] | ((uint16_t)in[4] << 8);
+
+    br.in = in;
+    br.len = len;
+    br.pos = ECG_RICE_HEADER_LEN;
+    br.nbits = 0;
+
+    for (i = 1; i < count; i++) {
+        uint16_t q = 0, bit, v;
+        int16_t prediction;
+        for (;;) {
+            if (!br_get(&br, 1, &bit)) {
+                return -1;
+            }
+            if (!bit) {
+                break;
+            }
+            if (++q == ECG_RICE_ESCAPE_Q) {
+                break;
+            }
+        }
+        if (q == ECG_RICE_ESCAPE_Q) {
+            if (!br_get(&br, ECG_RICE_RAW_BITS + w, &v)) {
+                return -1;
+            }
+        } else {
+            uint16_t low = 0;
+            if (k > 0 && !br_get(&br, k, &low)) {
+                return -1;
+            }
+            v = (q << k) | low;
+        }
+        if (order2 && i >= 2) {
+            prediction = 2 * (int16_t)samples[i - 1] - (int16_t)samples[i - 2];
+        } else {
+            prediction = samples[i - 1];
+        }
+        samples[i] = (uint16_t)(prediction + unzigzag(v));
+    }
+    return count;
+}
@@ -0,0 +1,57 @@
+#ifndef ECG_RICE_H_
+#define ECG_RICE_H_
+
+#include <stdint.h>
+
+// Lossless compression for 12- to 14-bit ECG samples: a first- or second-order
+// predictor followed by a Rice code with one k per frame. Plain C, shared by
+// the firmware encoder and host-side decoders.
+//
+// Block layout, the whole payload of a single-channel ECG_TYPE_SAMPLES_RICE frame
+// (see ecg_proto.h for several channels):
+//   0-1  sample count, little-endian
+//   2    params: bits 0-3 = k, bit 4 = second-order predictor, bits 5-6 = w
+//   3-4  first sample, little-endian
+//   5..  residuals for samples 1..count-1, MSB-first bit stream, zero-padded
+//
+// Each residual is zigzag-mapped (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...) and
+// coded as q = v >> k ones, a zero, then the low k bits of v. If q reaches
+// ECG_RICE_ESCAPE_Q, the ones are followed by ECG_RICE_RAW_BITS + w raw bits of v
+// instead, which bounds the cost of a QRS edge. The encoder sets w to the fewest
+// bits the block's largest residual needs beyond ECG_RICE_RAW_BITS: 0 for 12-bit
+// samples, up to 2 for 14-bit ones (ACQ_OVS_BITS in adc_acq.h).
+
+#define ECG_RICE_HEADER_LEN 5
+#define ECG_RICE_ORDER2 0x10
+#define ECG_RICE_K_MASK 0x0F
+#define ECG_RICE_ESCAPE_Q 16
+#define ECG_RICE_RAW_BITS 14 // Largest zigzag residual: second order over 12-bit samples < 2^14
+#define ECG_RICE_W_SHIFT 5
+#define ECG_RICE_W_MASK 0x60
+#define ECG_RICE_MAX_W 2 // Second order over 14-bit samples < 2^16
+
+/**
+ * @brief Compresses a block of samples.
+ * @param samples Samples of up to 14 bits.
+ * @param count Number of samples, at least 1.
+ * @param stride Words from one sample to the next: 1, or the channel count for
+ *        one channel of interleaved samples.
+ * @param out Output buffer.
+ * @param out_cap Size of out in bytes.
+ * @return Bytes written, or 0 if the result would not fit in out_cap. Pass
+ *         out_cap = count * 2 to get 0 whenever compression would not pay off.
+ */
+uint16_t ecg_rice_encode(const uint16_t* samples,
+                         uint16_t count,
+                         uint16_t stride,
+                         uint8_t* out,
+                         uint16_t out_cap);
+
+/**
+ * @brief Decompresses a payload produced by ecg_rice_encode().
+ * @return Number of samples written, or -1 if the payload is malformed or
+ *         holds more than max_samples samples.
+ */
+int ecg_rice_decode(const uint8_t* in, uint16_t len, uint16_t* samples, uint16_t max_samples);
+
+#endif /* ECG_RICE_H_ */
@@ -0,0 +1,23 @@
+#ifndef HAL_H_
+#define HAL_H_
+
+// Hardware access for the firmware sources. On target this is just the device
+// header. With HOST_SIM defined the same register names and intrinsics map onto
+// the peripheral simulator in sim/, so the unmodified drivers run on a PC.
+
+#ifdef HOST_SIM
+    #include "msp430_sim.h"
+    #define main firmware_main // The simulator provides the process entry point
+#else
+    #include <msp430f6638.h>
+#endif
+
+// Called by the main loop when it has nothing to do, and in busy-waits on flags that only an
+// ISR changes. On target it compiles to nothing; the simulator skips ahead to the next event.
+#ifdef HOST_SIM
+    #define HAL_IDLE() sim_idle()
+#else
+    #define HAL_IDLE()
+#endif
+
+#endif /* HAL_H_ */
@@ -0,0 +1,135 @@
+#include "latency.h"
+#include "adc_acq.h"
+#include "hal.h"
+#include "power.h"
+
+#ifdef LATENCY
+
+// --- Private Definitions ---
+typedef struct {
+    LatencyRecord rec; // start_sample and num_samples are kept for untraced segments too
+    uint16_t captured; // Timer_A1 when the DMA completed the segment
+    uint8_t pending; // Traced and not sent yet
+} LatencySlot;
+
+// --- Private Variables ---
+static LatencySlot latency_slots[ACQ_MAX_SEGMENTS]; // By capture slot
+static uint8_t latency_used = 0; // Stages in use, bit n = stage n
+static uint8_t latency_seen = 0; // Stages that have handled a segment since latency_init()
+static uint32_t latency_last[LATENCY_STAGES]; // start_sample of the newest segment each stage handled
+static uint16_t latency_skip = 0; // Segments until the next traced one
+
+// --- Private Function Prototypes ---
+static void latency_mark(LatencySlot* l, uint8_t stage);
+static int latency_done(const LatencySlot* l);
+
+// --- Function Implementations ---
+
+void latency_init(uint8_t stages) {
+    uint16_t i;
+
+    __disable_interrupt();
+    for (i = 0; i < ACQ_MAX_SEGMENTS; i++) {
+        latency_slots[i].pending = 0;
+    }
+    latency_used = stages;
+    latency_seen = 0;
+    latency_skip = 0;
+    __enable_interrupt();
+}
+
+void latency_capture(const SegQueue* q) {
+    const SegDesc* seg = &q->desc[(uint16_t)(q->head - 1) & (SEGQ_LEN - 1)]; // Just pushed
+    LatencySlot* l = &latency_slots[seg->slot];
+    uint8_t s;
+
+    l->rec.start_sample = seg->start_sample;
+    l->rec.num_samples = seg->num_samples;
+    l->pending = 0;
+    if (latency_skip) {
+        latency_skip--;
+        return;
+    }
+    latency_skip = LATENCY_EVERY - 1;
+    l->captured = power_now();
+    for (s = 0; s < LATENCY_STAGES; s++) {
+        l->rec.stage[s] = LATENCY_NONE;
+    }
+    l->pending = 1;
+}
+
+void latency_stamp(const SegDesc* seg, uint8_t stage) {
+    LatencySlot* l = &latency_slots[seg->slot];
+
+    __disable_interrupt();
+    if (l->rec.start_sample == seg->start_sample) { // Not recaptured meanwhile
+        latency_mark(l, stage);
+    }
+    __enable_interrupt();
+}
+
+void latency_framed(const SegDesc* seg, uint16_t seq) {
+    LatencySlot* l = &latency_slots[seg->slot];
+
+    __disable_interrupt();
+    if (l->rec.start_sample == seg->start_sample) {
+        l->rec.seq = seq;
+        latency_mark(l, LATENCY_FRAMED);
+    }
+    __enable_interrupt();
+}
+
+void latency_sent(uint16_t slot) {
+    LatencySlot* l = &latency_slots[slot];
+
+    if (!l->pending || l->rec.stage[LATENCY_FRAMED] != LATENCY_NONE) { // Else recaptured in flight
+        latency_mark(l, LATENCY_SENT);
+    }
+}
+
+int latency_pop(LatencyRecord* out) {
+    uint16_t i;
+
+    for (i = 0; i < ACQ_MAX_SEGMENTS; i++) {
+        LatencySlot* l = &latency_slots[i];
+        int done;
+
+        __disable_interrupt();
+        done = l->pending && latency_done(l);
+        if (done) {
+            *out = l->rec;
+            l->pending = 0;
+        }
+        __enable_interrupt();
+        if (done) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Notes that a stage has handled the segment in a slot, and stamps it if traced
+static void latency_mark(LatencySlot* l, uint8_t stage) {
+    latency_seen |= 1 << stage;
+    latency_last[stage] = l->rec.start_sample;
+    if (l->pending && l->rec.stage[stage] == LATENCY_NONE) {
+        uint16_t ticks = power_now() - l->captured;
+        l->rec.stage[stage] = ticks == LATENCY_NONE ? LATENCY_NONE - 1 : ticks;
+    }
+}
+
+// A record is done when each stage in use has stamped it or handled a later segment
+static int latency_done(const LatencySlot* l) {
+    uint8_t s;
+
+    for (s = 0; s < LATENCY_STAGES; s++) {
+        if (!(latency_used >> s & 1) || l->rec.stage[s] != LATENCY_NONE) {
+            continue;
+        }
+        if (!(latency_seen >> s & 1) || (int32_t)(latency_last[s] - l->rec.start_sample) <= 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+#endif
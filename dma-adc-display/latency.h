@@ -0,0 +1,101 @@
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include "ecg_proto.h"
+#include "seg_queue.h"
+#include <stdint.h>
+
+// End-to-end latency of the segments, sent to the host as ECG_TYPE_LATENCY frames (ecg_proto.h).
+//
+// Build with LATENCY defined (e.g. -DLATENCY) to compile it in. Without it every macro below
+// expands to nothing, latency.c is empty and no latency frames are sent.
+//
+// Each traced segment is stamped with the Timer_A1 count (power.h, ACLK, 30.5 us) when the
+// DMA completes it, and again at each stage it reaches: processed, framed, sent and shown.
+// The stages are kept as times after that capture, so they must come within the 2 s the
+// counter takes to wrap; TIMEBASE_BUFFER_MS keeps every segment well inside that. A sample
+// waits up to one more segment before the capture, while the segment fills.
+//
+// A segment's record is sent once every stage in use has either stamped it or moved on to a
+// later segment (the UART or display dropped it). The stages run in capture order, so the
+// record frees up as soon as the slowest consumer is done with it.
+//
+// Cost: one timer read and a few stores per stage and segment, and a 27-byte frame per traced
+// segment on the link, about 850 bytes/s when every segment is traced. That is not in the
+// timebase link budget.
+
+// --- Configuration ---
+#define LATENCY_TICK_HZ 32768UL // Timer_A1 from ACLK
+
+// Trace every LATENCY_EVERY-th segment
+#ifndef LATENCY_EVERY
+    #define LATENCY_EVERY 1
+#endif
+
+#define LATENCY_NONE 0xFFFF // Stage never reached
+
+// Stages, in the order of the latency frame
+typedef enum {
+    LATENCY_PROCESSED, // process_segment() returned
+    LATENCY_FRAMED, // send_ecg_frame() queued the sample frame
+    LATENCY_SENT, // The UART DMA moved the frame's last byte to the USCI
+    LATENCY_SHOWN, // show_segment() returned, the trace is on the TFT
+    LATENCY_STAGES // ECG_LATENCY_STAGES
+} LatencyStage;
+
+typedef struct {
+    uint32_t start_sample;
+    uint16_t num_samples;
+    uint16_t seq; // Of the sample frame, if framed
+    uint16_t stage[LATENCY_STAGES]; // Ticks after the capture, or LATENCY_NONE
+} LatencyRecord;
+
+#ifdef LATENCY
+    #define LATENCY_INIT(stages) latency_init(stages)
+    #define LATENCY_CAPTURE(q) latency_capture(q)
+    #define LATENCY_STAMP(seg, stage) latency_stamp(seg, stage)
+    #define LATENCY_FRAMED(seg, seq) latency_framed(seg, seq)
+    #define LATENCY_SENT(slot) latency_sent(slot)
+#else
+    #define LATENCY_INIT(stages)
+    #define LATENCY_CAPTURE(q)
+    #define LATENCY_STAMP(seg, stage)
+    #define LATENCY_FRAMED(seg, seq)
+    #define LATENCY_SENT(slot)
+#endif
+
+// --- Public Function Prototypes ---
+
+/**
+ * @brief Drops all records. Call when capture (re)starts.
+ * @param stages Bit n set if stage n is in use in this build; the others never hold a record up.
+ */
+void latency_init(uint8_t stages);
+
+/**
+ * @brief Starts a record for the segment just pushed to q, if it is traced. DMA ISR only.
+ */
+void latency_capture(const SegQueue* q);
+
+/**
+ * @brief Stamps a stage of a segment (main loop).
+ */
+void latency_stamp(const SegDesc* seg, uint8_t stage);
+
+/**
+ * @brief Stamps LATENCY_FRAMED and notes the sample frame's sequence number.
+ */
+void latency_framed(const SegDesc* seg, uint16_t seq);
+
+/**
+ * @brief Stamps LATENCY_SENT for the segment in a capture slot. From the frame's on_done callback.
+ */
+void latency_sent(uint16_t slot);
+
+/**
+ * @brief Takes a finished record.
+ * @return 1 if *out was filled, 0 if no record is finished yet.
+ */
+int latency_pop(LatencyRecord* out);
+
+#endif /* LATENCY_H_ */
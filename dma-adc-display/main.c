@@ -1,34 +1,157 @@
-// Define target MCLK and XT2 crystal frequencies if using the provided init_clock()
-// These are example values, adjust them to your hardware.
-#define MCLK_FREQ 20000000UL // Example: Target MCLK at 20MHz
-#define SMCLK_FREQ 4000000UL
-#define XT2_FREQ 4000000UL // Example: XT2 crystal at 4MHz
-
+#include "adc_acq.h"
+#include "clock.h"
 #include "dr_tft.h"
+#include "ecg_filter.h"
+#include "ecg_proto.h"
+#include "ecg_qrs.h"
+#include "ecg_rice.h"
+#include "hal.h"
+#include "power.h"
+#include "latency.h"
+#include "prof.h"
+#include "timebase.h"
 #include "uart_lib.h"
-#include <msp430f6638.h>
+#include "uart_link.h"
 #include <stdint.h>
 #include <stdio.h>
-
-// Buffer to store ADC samples
-#define SAMPLES_PER_SEGMENT 20
-#define NUM_SEGMENTS 16
-#define TOTAL_SAMPLES_ON_SCREEN (SAMPLES_PER_SEGMENT * NUM_SEGMENTS) // 640
-unsigned int adc_capture_buffer[TOTAL_SAMPLES_ON_SCREEN];
-
-// Flags/variables to coordinate ISR and main loop
-volatile unsigned char segment_data_ready_for_display[NUM_SEGMENTS] = {
-    0
-}; // ISR sets to 1 when segment_idx data is ready
-volatile unsigned int dma_completed_segment_idx =
-    0; // ISR sets this to the index of the segment it just finished filling
-volatile unsigned char new_dma_data_available = 0; // ISR sets this to 1 on any segment completion
-
-// DMA state - ISR primarily manages this for writing
-volatile unsigned int current_segment_dma_is_filling = 0;
-
-// Display state - main loop manages this
-unsigned int segment_to_display_next = 0;
+#include <string.h>
+
+// Sample rate at start-up, one of the timebase.h modes; the host can switch it later with
+// LINK_CMD_SET_RATE. Timer, S/H time, segment size, TFT sweep and link budget follow from the mode.
+#define ECG_SAMPLE_RATE_HZ 500
+
+#if ECG_SAMPLE_RATE_HZ != 250 && ECG_SAMPLE_RATE_HZ != 500 && ECG_SAMPLE_RATE_HZ != 1000      \
+    && ECG_SAMPLE_RATE_HZ != 2000
+    #error "ECG_SAMPLE_RATE_HZ must be 250, 500, 1000 or 2000 (timebase.h)"
+#endif
+
+// Highest UART rate tried during start-up negotiation with the host
+#define UART_MAX_BAUD BAUD_460800
+
+// Send segments as delta + Rice coded frames (ecg_rice.h); comment out, or build with -DECG_RAW, to
+// always send raw samples
+#ifndef ECG_RAW
+    #define ECG_COMPRESS
+#endif
+
+// Run the filter chain (ecg_filter.h) on every segment before display and telemetry; comment out to
+// pass the raw ADC codes through
+#define ECG_FILTER
+
+// Mains frequency for the notch filter: 50 or 60, 0 leaves the notch out
+#define ECG_MAINS_HZ 50
+
+// Detect heartbeats (ecg_qrs.h): heart rate on the TFT and a beat frame to the host per beat
+#define ECG_QRS
+
+// Inputs drawn on the TFT, one lane each from the top down; a subset of ACQ_CHANNEL_MASK (adc_acq.h),
+// which selects the inputs that are captured, filtered and sent to the host
+#define ECG_DISPLAY_MASK ACQ_CHANNEL_MASK
+
+#if (ECG_DISPLAY_MASK & ~ACQ_CHANNEL_MASK) || ECG_DISPLAY_MASK == 0
+    #error "ECG_DISPLAY_MASK must select captured inputs"
+#endif
+#define ECG_DISPLAY_LANES ACQ_MASK_COUNT(ECG_DISPLAY_MASK)
+#if ECG_DISPLAY_LANES > ETFT_TRACE_LANES
+    #error "More display inputs than ETFT_TRACE_LANES"
+#endif
+
+// The primary lead (channel 0), lowest input of the mask
+#define ECG_PRIMARY_MASK (ACQ_CHANNEL_MASK & (~ACQ_CHANNEL_MASK + 1))
+
+#if defined(ECG_FILTER) || defined(ECG_QRS)
+    #define ECG_PROCESS
+#endif
+
+// UART frames in flight. A raw payload chunk points straight into the capture ring, so the segment
+// is owned by the UART DMA until the frame's on_done callback runs, unless capture comes round to
+// the segment first: then the payload is copied to payload_buf[] and the DMA carries on from there
+// (ecg_frame_release_segment()). A compressed payload is built in payload_buf[], which is only as
+// large as a raw segment: blocks that don't shrink go raw.
+#define ECG_TX_FRAMES UART_TX_QUEUE_LEN // The UART queue can't hold more frames anyway
+
+typedef struct {
+    UartTxFrame frame; // Must be first: on_done receives a pointer to it
+    uint8_t header[ECG_HEADER_LEN];
+    uint8_t trailer[ECG_TRAILER_LEN];
+    uint8_t payload_buf[ACQ_MAX_SEGMENT_LEN * ACQ_CHANNELS * 2];
+    uint8_t segment_idx;
+    volatile uint8_t in_ring; // The payload chunk still points into the capture ring
+    volatile uint8_t busy;
+} EcgTxFrame;
+
+EcgTxFrame ecg_tx_frames[ECG_TX_FRAMES];
+uint16_t ecg_tx_seq = 0; // Incremented for every frame, including dropped ones, so the host sees gaps
+volatile unsigned char segment_tx_in_flight[ACQ_MAX_SEGMENTS] = { 0 };
+volatile unsigned int segment_overrun_count = 0; // DMA capture re-entered a segment still in flight
+
+const Timebase* timebase = 0; // Mode in effect
+UartBaudRate link_rate = BAUD_9600; // Negotiated at start-up
+
+// Read cursors into the segment queue: telemetry and display consume at their own pace
+#define SEGQ_CONSUMER_UART 0
+#define SEGQ_CONSUMER_TFT 1
+
+#ifdef ECG_PROCESS
+// 处理级是acq_queue唯一的读者，滤波和QRS检测后把段转入ecg_out_queue，UART与显示从那里读取
+    #define SEGQ_CONSUMER_PROCESS 0
+    #define ECG_OUT_QUEUE ecg_out_queue
+SegQueue ecg_out_queue;
+#else
+    #define ECG_OUT_QUEUE acq_queue
+#endif
+
+#ifdef ECG_FILTER
+EcgFilter ecg_filter[ACQ_CHANNELS];
+#endif
+
+#ifdef ECG_QRS
+// Beat frames are built in place and sent as one chunk; beats come a few per second at most
+    #define ECG_BEAT_FRAMES 2
+    #define ECG_BEAT_FRAME_LEN (ECG_BEAT_PAYLOAD_LEN + ECG_FRAME_OVERHEAD)
+    #define HR_TIMEOUT_S 3 // Heart rate shown as --- when no beat came for this long
+    #define HR_TEXT_X (320 - 6 * 8) // "HR nnn" in the top right corner
+    #define HR_TEXT_Y 0
+
+typedef struct {
+    UartTxFrame frame; // Must be first: on_done receives a pointer to it
+    uint8_t bytes[ECG_BEAT_FRAME_LEN];
+    volatile uint8_t busy;
+} EcgBeatFrame;
+
+EcgQrs ecg_qrs;
+EcgBeatFrame ecg_beat_frames[ECG_BEAT_FRAMES];
+uint32_t hr_last_beat_sample = 0;
+uint8_t hr_bpm = 0; // Of the last beat, 0 if unknown
+int16_t hr_shown = -1; // BPM on screen, 0 for ---, -1 before the first update
+#endif
+
+#ifdef PROF
+// One stats frame per report window, encoded in place
+    #define ECG_STATS_PAYLOAD_LEN (ECG_STATS_HEADER_LEN + PROF_ENCODED_LEN)
+
+typedef struct {
+    UartTxFrame frame; // Must be first: on_done receives a pointer to it
+    uint8_t bytes[ECG_STATS_PAYLOAD_LEN + ECG_FRAME_OVERHEAD];
+    volatile uint8_t busy;
+} EcgStatsFrame;
+
+EcgStatsFrame ecg_stats_frame;
+#endif
+
+#ifdef LATENCY
+// Latency frames are built in place like beat frames; one per traced segment
+    #define ECG_LATENCY_FRAMES 2
+    #define ECG_LATENCY_FRAME_LEN (ECG_LATENCY_PAYLOAD_LEN + ECG_FRAME_OVERHEAD)
+
+typedef struct {
+    UartTxFrame frame; // Must be first: on_done receives a pointer to it
+    uint8_t bytes[ECG_LATENCY_FRAME_LEN];
+    volatile uint8_t busy;
+} EcgLatencyFrame;
+
+EcgLatencyFrame ecg_latency_frames[ECG_LATENCY_FRAMES];
+#endif
 
 // Background color (can be defined or passed)
 const uint16_t bRGB_BLACK = 0x0000;
@@ -37,10 +160,27 @@ const uint16_t fRGB_GREEN = ((0x3F << 5)); // Pre-calculate if etft_Color is not
 // Function Prototypes
 void init_clock(void);
 void init_gpio(void);
-void init_timer_for_adc(void);
-void init_adc(void);
-void init_dma_for_adc(void);
-void send_ecg_frame(const uint16_t* data, uint16_t num_samples);
+void init_timer_for_adc(const Timebase* tb);
+void init_adc(const Timebase* tb);
+void start_capture(const Timebase* tb);
+void stop_capture(void);
+TimebaseStatus set_sample_rate(uint16_t sample_rate_hz);
+void send_rate_report(uint16_t sample_rate_hz, TimebaseStatus status);
+int send_ecg_frame(const SegDesc* seg);
+void show_segment(const SegDesc* seg);
+#ifdef ECG_PROCESS
+void process_segment(const SegDesc* seg);
+#endif
+#ifdef ECG_QRS
+int send_beat_frame(const EcgQrsBeat* beat);
+void show_heart_rate(uint32_t now_sample);
+#endif
+#ifdef PROF
+int send_stats_frame(void);
+#endif
+#ifdef LATENCY
+int send_latency_frame(void);
+#endif
 
 void main(void) {
     WDTCTL = WDTPW + WDTHOLD; // Stop watchdog timer
@@ -50,55 +190,88 @@ void main(void) {
     init_clock(); // Initialize clock system
     init_gpio(); // Initialize GPIO (e.g., for ADC input pin function)
     uart_init(BAUD_9600);
-    init_timer_for_adc(); // Initialize Timer_A0 to trigger ADC at 200Hz
-    init_adc(); // Initialize ADC12_A module
-    init_dma_for_adc(); // Initialize DMA Channel 0
+
+    // 采集开始前与上位机协商波特率(需要UART接收中断)，并检查采样率是否超出链路带宽
     _EINT();
-    etft_AreaSet(0, 0, 319, 239, 0);
+    link_rate = link_negotiate(BAUD_9600, UART_MAX_BAUD);
+
+    // 启动时的采样率即使超出链路带宽也照常采集(可能根本没有上位机)，只在屏幕上提示
+    const Timebase* tb = timebase_find(ECG_SAMPLE_RATE_HZ);
+    int timebase_ok = timebase_check(tb) == TIMEBASE_OK;
+    int link_fits = link_check_budget(link_rate, tb->link_bytes_s);
+    send_rate_report(tb->sample_rate_hz, TIMEBASE_OK);
+    start_capture(tb); // DMA0 ring armed before the ADC runs
+    etft_AreaSetAsync(0, 0, 319, 239, 0); // 清屏由DMA在后台完成，主循环可立即开始处理数据
+    etft_TraceSetLanes(ECG_DISPLAY_LANES);
+    if (!timebase_ok) {
+        etft_DisplayString("SAMPLE RATE SETTINGS INVALID", 0, 0, etft_Color(255, 0, 0), bRGB_BLACK);
+    } else if (!link_fits) {
+        etft_DisplayString("UART LINK TOO SLOW", 0, 0, etft_Color(255, 0, 0), bRGB_BLACK);
+    }
 
+    power_init(); // 从这里开始统计CPU占空比
+    PROF_INIT();
     __bis_SR_register(GIE); // Enable Global Interrupts
 
     while (1) {
-        if (new_dma_data_available) {
-            new_dma_data_available = 0; // Reset general flag
-
-            // Check if the specific segment we are waiting to display is ready
-            if (segment_data_ready_for_display[segment_to_display_next]) {
-                segment_data_ready_for_display[segment_to_display_next] =
-                    0; // Mark as display processing started
-
-                const uint16_t* p_segment_data =
-                    &adc_capture_buffer[segment_to_display_next * SAMPLES_PER_SEGMENT];
-
-                send_ecg_frame(p_segment_data,
-                               SAMPLES_PER_SEGMENT); // Send the segment data over UART
-                etft_DisplayADCSegment(p_segment_data,
-                                       SAMPLES_PER_SEGMENT,
-                                       segment_to_display_next, // for screen positioning
-                                       NUM_SEGMENTS, // for screen positioning logic
-                                       fRGB_GREEN,
-                                       bRGB_BLACK);
-
-                // Advance to the next segment to be displayed
-                segment_to_display_next = (segment_to_display_next + 1);
-
-                if (segment_to_display_next >= NUM_SEGMENTS) {
-                    segment_to_display_next = 0; // Reset for the next display cycle
-                    // DMA ISR has already set 'current_segment_dma_is_filling' to 0 and
-                    // DMA0DA to '&adc_capture_buffer[0]'.
-                    // Reset any stale "ready" flags for display processing just in case.
-                    unsigned int k;
-                    for (k = 0; k < NUM_SEGMENTS; ++k) {
-                        segment_data_ready_for_display[k] = 0;
-                    }
-                    new_dma_data_available = 0; // Clear this flag as well
-                }
+        SegDesc seg;
+        int idle = 1;
+        uint8_t cmd;
+        uint32_t arg;
+
+        power_events = 0; // 之后中断送来的事件会阻止本轮末尾的睡眠
+
+        // 上位机命令：切换采样率
+        if (link_poll_ctrl(&cmd, &arg)) {
+            if (cmd == LINK_CMD_SET_RATE) {
+                set_sample_rate(arg > 0xFFFF ? 0 : (uint16_t)arg);
+            }
+            continue;
+        }
+#ifdef ECG_PROCESS
+        // 处理在两个读者之前完成，二者看到同一份滤波后的数据
+        if (segq_pop(&acq_queue, SEGQ_CONSUMER_PROCESS, &seg)) {
+            PROF_BEGIN(PROF_PROCESS);
+            process_segment(&seg);
+            PROF_END(PROF_PROCESS);
+            LATENCY_STAMP(&seg, LATENCY_PROCESSED);
+            segq_push(&ecg_out_queue, &seg);
+            idle = 0;
+        }
+#endif
+        // 遥测优先：每段只需组帧入队，很快返回；显示慢时只丢显示的段(计入游标的drops)，不影响UART
+        if (segq_pop(&ECG_OUT_QUEUE, SEGQ_CONSUMER_UART, &seg)) {
+            PROF_BEGIN(PROF_SEND_FRAME);
+            send_ecg_frame(&seg);
+            PROF_END(PROF_SEND_FRAME);
+            idle = 0;
+        }
+        if (segq_pop(&ECG_OUT_QUEUE, SEGQ_CONSUMER_TFT, &seg)) {
+            PROF_BEGIN(PROF_DISPLAY);
+            show_segment(&seg);
+            PROF_END(PROF_DISPLAY);
+            LATENCY_STAMP(&seg, LATENCY_SHOWN);
+            idle = 0;
+        }
+#ifdef LATENCY
+        if (send_latency_frame()) {
+            idle = 0;
+        }
+#endif
+        if (power_poll_report(&arg)) {
+            link_send_ctrl(LINK_CMD_POWER_REPORT, arg);
+#ifdef PROF
+            send_stats_frame();
+#endif
+        }
+        if (idle) {
+            // 队列已空：关中断后确认没有新事件再睡眠，由中断的POWER_WAKE()唤醒
+            _DINT();
+            if (power_events == 0) {
+                power_sleep();
+            } else {
+                _EINT();
             }
-            // If the specific segment_to_display_next is not yet ready, we'll catch it in the next iteration
-            // after new_dma_data_available is set again.
-        } else {
-            // Optional: Enter Low Power Mode if no flag is set, to save power.
-            // __bis_SR_register(LPM0_bits | GIE); // Example: wakes on interrupt (like DMA_ISR)
         }
         // P4OUT ^= BIT5; // Toggle LED to show main loop activity (DONT USE THIS ANYMORE! Conflict with UART)
     }
@@ -127,7 +300,7 @@ void init_clock() {
     } while (SFRIFG1 & OFIFG); // Test oscillator fault flag
 
     // Configure DCO
-    // Assuming MCLK_FREQ and XT2_FREQ are defined globally (e.g., 8MHz MCLK, 4MHz XT2)
+    // MCLK_FREQ and XT2_FREQ come from clock.h
     UCSCTL4 = SELA__XT1CLK | SELS__XT2CLK
         | SELM__XT2CLK; // Temporarily set MCLK to XT2 to avoid issues during DCO config
     UCSCTL1 = DCORSEL_5; // Select DCO range for MCLK_FREQ (e.g., 6MHz to 23.7MHz for DCORSEL_5)
@@ -149,11 +322,10 @@ void init_clock() {
 }
 
 void init_gpio(void) {
-    // Configure ADC input pin
-    // For ADC12_A Channel 0 (A0), this is typically P6.0 on MSP430F6638
-    // Set P6SEL.0 = 1 for A15 function.
-    P6SEL |= BIT0; // Select P6.0 for A15 input
-    P6DIR &= ~BIT0; // Set P6.0 as input
+    // Configure ADC input pins
+    // ADC12_A inputs A0..A7 are P6.0..P6.7 on MSP430F6638, so the channel mask is the pin mask
+    P6SEL |= ACQ_CHANNEL_MASK; // Select the analog function of the captured inputs
+    P6DIR &= ~ACQ_CHANNEL_MASK; // Set them as inputs
 
     // Example LED (optional, for debugging)
     // P4DIR |= BIT5;
@@ -161,19 +333,15 @@ void init_gpio(void) {
     // P4OUT &= ~BIT5;
 }
 
-void init_timer_for_adc(void) {
-    // Configure Timer_A0 to trigger ADC at 200Hz (every 5ms)
-    // Assuming SMCLK is the source for Timer_A0.
-    // SMCLK frequency depends on init_clock(). If SMCLK = XT2 = 4MHz:
-    // Timer_period = SMCLK_freq / 200Hz = 4,000,000 / 200 = 20,000 cycles.
-    // If SMCLK = DCOCLK = 8MHz:
-    // Timer_period = 8,000,000 / 200 = 40,000 cycles. This fits in TA0CCR0.
+void init_timer_for_adc(const Timebase* tb) {
+    // Configure Timer_A0 to trigger the ADC once per conversion of the timebase mode.
+    // Timer_A0 runs from SMCLK = XT2 = 4MHz (init_clock()), so the period is
+    // SMCLK_FREQ / (sample rate * ACQ_OVERSAMPLE * ACQ_CHANNELS): for one channel without
+    // oversampling 16000 cycles at 250Hz down to 2000 cycles at 2kHz, all within TA0CCR0
+    // (timebase_check() verifies this).
 
     TA0CTL = TASSEL__SMCLK | MC__UP | TACLR; // SMCLK, Up mode, Clear TAR
-    TA0CCR0 = (SMCLK_FREQ / 500)
-        - 1; // Period for 200Hz. Using MCLK_FREQ as placeholder, ideally use SMCLK_FREQ.
-    // If SMCLK is different from MCLK, adjust this.
-    // For example, if SMCLK is XT2_FREQ: TA0CCR0 = (XT2_FREQ / 200) - 1;
+    TA0CCR0 = tb->timer_period - 1;
 
     // Configure TA0CCR1 for triggering ADC's Sample-and-Hold input (SHI)
     // We'll use TA0.1 output signal.
@@ -184,145 +352,528 @@ void init_timer_for_adc(void) {
     // The ADC samples on the rising edge of SHI.
 }
 
-void init_adc(void) {
+void init_adc(const Timebase* tb) {
     // Configure ADC12_A module
     // Turn off ADC12ENC to allow configuration [cite: 28]
     ADC12CTL0 &= ~ADC12ENC;
 
     // ADC12CTL0 configuration
-    // ADC12SHT0x: Sample-and-hold time for MEM0-7.
-    // Example: ADC12SHT0_8 = 256 ADC12CLK cycles. Adjust if needed. [cite: 218]
+    // ADC12SHT0x: Sample-and-hold time for MEM0-7, from the timebase mode.
+    // E.g. ADC12SHT0_8 = 256 ADC12CLK cycles = 64us at 4MHz; shorter at the higher rates. [cite: 218]
     // ADC12ON: ADC12 on. [cite: 218]
     // ADC12MSC: Multiple sample and conversion - SET TO 0 for timer-driven sampling of each point. Default is 0.
-    ADC12CTL0 = ADC12SHT0_8 | ADC12ON;
+    ADC12CTL0 = tb->adc_sht | ADC12ON;
 
     // ADC12CTL1 configuration
     // ADC12SHP: Sample-and-hold pulse-mode select. SAMPCON is sourced from sampling timer. [cite: 226]
     // ADC12SHSx: Sample-and-hold source select. Select Timer_A0 TA0.1 output. (Value is 1 for TA0.1) [cite: 226]
-    // ADC12CONSEQx: Conversion sequence mode. 03b for Repeat-single-channel. [cite: 125, 226]
+    // ADC12CONSEQx: Conversion sequence mode. 10b for Repeat-single-channel; 11b for
+    // Repeat-sequence-of-channels with several inputs, one conversion per SHI edge since MSC is 0,
+    // so the timer runs at ACQ_CHANNELS times the sample rate. [cite: 125, 226]
     // ADC12SSELx: ADC12 clock source select. Example: SMCLK 4MHz. [cite: 226]
+#if ACQ_CHANNELS > 1
+    ADC12CTL1 = ADC12SHP | ADC12SHS_1 | ADC12CONSEQ_3 | ADC12SSEL_3; // SMCLK
+#else
     ADC12CTL1 = ADC12SHP | ADC12SHS_1 | ADC12CONSEQ_2 | ADC12SSEL_3; // SMCLK
+#endif
     // ADC12SHS_1 corresponds to TA0.1
 
     // ADC12CTL2 configuration (optional, defaults are often fine for basic use)
     // ADC12RES: Resolution. Default is 10b (ADC12RES_1). For 12-bit: ADC12RES_2. [cite: 231]
     ADC12CTL2 = ADC12RES_2; // 12-bit resolution
 
-    // ADC12MCTL0: Conversion memory control for ADC12MEM0
-    // ADC12INCHx: Input channel select. Using A0 (connected to P6.0) as ECG signal input. [cite: 242]
+    // ADC12MCTLk: Conversion memory control for ADC12MEMk, one per captured input in ascending
+    // order starting at MEM0 (ADC12CSTARTADD = 0)
+    // ADC12INCHx: Input channel select, An on P6.n; A0 alone is the single ECG lead. [cite: 242]
     // ADC12SREFx: Voltage reference select. Default (000b) is VR+ = AVCC, VR- = AVSS. [cite: 241]
-    ADC12MCTL0 = ADC12INCH_0;
+    // ADC12EOS: End of sequence on the last input; ignored in repeat-single-channel mode.
+    {
+        uint8_t input;
+        uint8_t k = 0;
+        for (input = 0; input < 8; input++) {
+            if (ACQ_CHANNEL_MASK >> input & 1) {
+                (&ADC12MCTL0)[k++] = ADC12INCH_0 + input;
+            }
+        }
+        (&ADC12MCTL0)[k - 1] |= ADC12EOS;
+    }
 
-    // Disable ADC12IFG0 interrupt because DMA will use this flag as a trigger [cite: 362]
-    ADC12IE &= ~ADC12IFG0; // Clear interrupt enable for ADC12MEM0
+    // Disable ADC12 interrupts because DMA uses the flag of the last conversion as its trigger [cite: 362]
+    ADC12IE = 0;
+    ADC12IFG = 0; // Drop results of a sequence cut short by stop_capture()
 
     // Enable ADC conversions. The timer will now start triggering conversions. [cite: 222]
     ADC12CTL0 |= ADC12ENC;
 }
 
-void init_dma_for_adc(void) {
-    // Configure DMA Channel 0
-    DMACTL0 &= ~DMA0TSEL_31; // Clear existing trigger selection for Channel 0
-
-    // Select ADC12IFG0 as trigger source for DMA Channel 0 [cite: 439]
-    // The specific trigger source number for ADC12 depends on the MSP430 device.
-    // For F5xx/F6xx, it's typically 24 (0x18). Check device-specific datasheet or header.
-    // Assuming DMA0TSEL__ADC12IFG (or similar) is defined in the header, or use the number.
-    // For msp430f6638.h, there might be DMA0TSEL_24 for ADC12IFGx
-    DMACTL0 |= DMA0TSEL_24; // Trigger select 24 for ADC12 for Channel 0
-
-    // Configure DMA Channel 0 Control Register (DMA0CTL) [cite: 462]
-    DMA0CTL = 0; // Clear existing settings
-    DMA0CTL |= DMAIE; // Enable DMA interrupt (triggers when DMA0SZ reaches 0) [cite: 466]
-    DMA0CTL |= DMASRCINCR_0; // Source address: No change (ADC12MEM0 is fixed) [cite: 463]
-    DMA0CTL |= DMADSTINCR_3; // Destination address: Increment after each transfer [cite: 463]
-    DMA0CTL |= DMADT_0; // Transfer mode: Single transfer per trigger [cite: 295, 463]
-    // DMA controller will perform DMA0SZ transfers.
-
-    // Set DMA Source Address (DMA0SA) [cite: 469, 471]
-    // Needs to be the address of ADC12MEM0
-    __data20_write_long((unsigned long)&DMA0SA, (unsigned long)&ADC12MEM0);
-
-    // Set DMA Destination Address (DMA0DA) [cite: 474, 475]
-    // Needs to be the start address of our RAM buffer
-    __data20_write_long((unsigned long)&DMA0DA, (unsigned long)&adc_capture_buffer[0]);
-
-    // Set DMA Transfer Size (DMA0SZ) [cite: 478, 479]
-    // Number of transfers before DMA interrupt
-    DMA0SZ = SAMPLES_PER_SEGMENT;
-
-    // Enable DMA Channel 0 [cite: 464]
-    DMA0CTL |= DMAEN;
+// 函数：按时基模式启动采集：DMA环形缓冲、各处理级和显示刻度先就位，最后启动定时器和ADC
+// 样本索引从0重新开始
+void start_capture(const Timebase* tb) {
+    _DINT();
+    timebase = tb;
+    acq_init(tb->segment_len, tb->segment_count); // DMA0 ring, armed before the ADC runs
+#ifdef ECG_PROCESS
+    LATENCY_INIT(1 << LATENCY_PROCESSED | 1 << LATENCY_FRAMED | 1 << LATENCY_SENT
+                 | 1 << LATENCY_SHOWN);
+#else
+    LATENCY_INIT(1 << LATENCY_FRAMED | 1 << LATENCY_SENT | 1 << LATENCY_SHOWN);
+#endif
+#ifdef ECG_PROCESS
+    segq_init(&ecg_out_queue, acq_segment_count() - 1);
+#endif
+#ifdef ECG_FILTER
+    {
+        uint8_t ch;
+        for (ch = 0; ch < ACQ_CHANNELS; ch++) {
+            ecg_filter_init(&ecg_filter[ch], tb->sample_rate_hz, ECG_MAINS_HZ, ACQ_SAMPLE_BITS);
+        }
+    }
+#endif
+#ifdef ECG_QRS
+    ecg_qrs_init(&ecg_qrs, tb->sample_rate_hz, ACQ_SAMPLE_BITS);
+    hr_bpm = 0;
+    hr_last_beat_sample = 0;
+#endif
+    etft_TraceSetScale(tb->sample_rate_hz, tb->sweep_columns_s);
+    etft_TraceSetBits(ACQ_SAMPLE_BITS);
+    init_timer_for_adc(tb); // Initialize Timer_A0 to trigger ADC at the mode's sample rate
+    init_adc(tb); // Initialize ADC12_A module
+    // DMA0触发 = TA0.1上升沿 + 采样保持 + 转换，ADC12CLK与TA0同为SMCLK
+    PROF_SET_TRIGGER(tb->timer_period, TA0CCR1, tb->adc_sht_cycles + TIMEBASE_CONVERSION_CYCLES);
+    _EINT();
+}
+
+// 函数：停止采集，并等待UART发完仍指向采集缓冲区的帧，之后缓冲区可以重新分段
+void stop_capture(void) {
+    TA0CTL = MC__STOP | TACLR;
+    ADC12CTL1 &= ~ADC12CONSEQ_3; // Single-conversion mode with ENC = 0 stops a sequence at once
+    ADC12CTL0 &= ~ADC12ENC;
+    uart_wait_tx_idle();
+}
+
+// 函数：切换到上位机要求的采样率。模式不存在、ADC时序不成立或链路带宽不够时保持原采样率
+// 结果以LINK_CMD_RATE_REPORT回报，成功时回报在新采样率的第一帧之前发出
+TimebaseStatus set_sample_rate(uint16_t sample_rate_hz) {
+    const Timebase* tb = timebase_find(sample_rate_hz);
+    TimebaseStatus status = tb ? timebase_check(tb) : TIMEBASE_ERR_RATE;
+
+    if (status == TIMEBASE_OK && !link_check_budget(link_rate, tb->link_bytes_s)) {
+        status = TIMEBASE_ERR_LINK;
+    }
+    if (status != TIMEBASE_OK) {
+        send_rate_report(timebase->sample_rate_hz, status);
+        return status;
+    }
+    stop_capture();
+    send_rate_report(tb->sample_rate_hz, TIMEBASE_OK);
+    start_capture(tb);
+    return TIMEBASE_OK;
+}
+
+// 函数：向上位机回报采样率、状态和样本位宽(LINK_CMD_RATE_REPORT)
+void send_rate_report(uint16_t sample_rate_hz, TimebaseStatus status) {
+    link_send_ctrl(LINK_CMD_RATE_REPORT,
+                   sample_rate_hz | ((uint32_t)status << LINK_RATE_STATUS_SHIFT)
+                       | ((uint32_t)ACQ_OVS_BITS << LINK_RATE_BITS_SHIFT));
+}
+
+// UART DMA发送完成回调(中断上下文)：把段的所有权交还给采集
+static void ecg_frame_done(UartTxFrame* frame) {
+    EcgTxFrame* ecg_frame = (EcgTxFrame*)frame;
+    LATENCY_SENT(ecg_frame->segment_idx);
+    if (ecg_frame->in_ring) {
+        segment_tx_in_flight[ecg_frame->segment_idx] = 0;
+        ecg_frame->in_ring = 0;
+    }
+    ecg_frame->busy = 0;
+}
+
+// 采集即将重新写入一个仍在发送的段(DMA_ISR中调用)：把引用该段的帧的负载复制到帧自己的缓冲区，
+// UART DMA从同一位置接着发送，线路上的字节不变，段交还给采集。
+// DMA0至少再过一个采样周期才写入该段的第一组样本，复制从段首开始，始终领先于采集的写入。
+static void ecg_frame_release_segment(uint16_t segment_idx) {
+    unsigned int i;
+
+    for (i = 0; i < ECG_TX_FRAMES; i++) {
+        EcgTxFrame* ecg_frame = &ecg_tx_frames[i];
+        if (ecg_frame->busy && ecg_frame->in_ring && ecg_frame->segment_idx == segment_idx) {
+            memcpy(ecg_frame->payload_buf, ecg_frame->frame.chunks[1].data,
+                   ecg_frame->frame.chunks[1].len);
+            uart_move_chunk(&ecg_frame->frame, 1, ecg_frame->payload_buf);
+            ecg_frame->in_ring = 0;
+        }
+    }
+    segment_tx_in_flight[segment_idx] = 0;
+}
+
+// 函数：打包并发送一帧ECG数据(协议v2，见ecg_proto.h)，段中所有通道在同一帧内
+// 帧头、负载、CRC作为三段分散列表交给UART DMA，负载直接指向采集缓冲区，不做拷贝。
+// 定义ECG_COMPRESS时先尝试Rice压缩，压缩后不比原始数据短则仍发送原始帧。
+// 返回是否成功排入发送队列；原始帧的段在发送完成(或负载被复制出去)前标记为占用。
+int send_ecg_frame(const SegDesc* seg) {
+    EcgTxFrame* ecg_frame = 0;
+    const uint8_t* payload = (const uint8_t*)seg->data; // 小端架构，内存顺序即发送顺序
+    EcgFrameHeader header;
+    uint16_t crc;
+    uint16_t payload_len = seg->num_samples * ACQ_CHANNELS * 2;
+    uint16_t segment_idx = seg->slot;
+    unsigned int i;
+
+#if ACQ_CHANNELS > 1 && ACQ_CHANNEL_STRIDE == 1
+    header.type = ECG_TYPE_SAMPLES_PLANAR;
+#else
+    header.type = ECG_TYPE_SAMPLES;
+#endif
+    header.seq = ecg_tx_seq++;
+    header.sample_index = seg->start_sample;
+    header.channel_mask = ACQ_CHANNEL_MASK;
+
+    if (segment_tx_in_flight[segment_idx]) {
+        return 0; // 上一轮的同一段还没发完
+    }
+    for (i = 0; i < ECG_TX_FRAMES; i++) {
+        if (!ecg_tx_frames[i].busy) {
+            ecg_frame = &ecg_tx_frames[i];
+            break;
+        }
+    }
+    if (!ecg_frame) {
+        return 0; // 所有帧都在发送队列中，丢弃本帧
+    }
+
+#ifdef ECG_COMPRESS
+    {
+        // 每个通道单独编码一块；多通道时每块前加2字节长度。总长不短于原始数据即放弃
+        const uint16_t prefix = ACQ_CHANNELS > 1 ? 2 : 0;
+        uint16_t packed_len = 0;
+        uint8_t ch;
+
+        for (ch = 0; ch < ACQ_CHANNELS; ch++) {
+            uint8_t* block = ecg_frame->payload_buf + packed_len;
+            uint16_t block_len = 0;
+
+            if (packed_len + prefix < payload_len) {
+                block_len = ecg_rice_encode(acq_channel_data(seg, ch), seg->num_samples,
+                                            ACQ_CHANNEL_STRIDE, block + prefix,
+                                            payload_len - packed_len - prefix);
+            }
+            if (block_len == 0) {
+                packed_len = 0;
+                break;
+            }
+            if (prefix) {
+                block[0] = (uint8_t)block_len;
+                block[1] = (uint8_t)(block_len >> 8);
+            }
+            packed_len += prefix + block_len;
+        }
+        if (packed_len != 0 && packed_len < payload_len) {
+            header.type = ECG_TYPE_SAMPLES_RICE;
+            payload = ecg_frame->payload_buf;
+            payload_len = packed_len;
+        }
+    }
+#endif
+    header.payload_len = payload_len;
+
+    // 1. 填充帧头，计算CRC
+    crc = ecg_encode_header(ecg_frame->header, &header);
+    crc = ecg_crc16_update(crc, payload, payload_len);
+    ecg_write_trailer(ecg_frame->trailer, crc);
+
+    // 2. 组装分散列表
+    ecg_frame->frame.chunks[0].data = ecg_frame->header;
+    ecg_frame->frame.chunks[0].len = ECG_HEADER_LEN;
+    ecg_frame->frame.chunks[1].data = payload;
+    ecg_frame->frame.chunks[1].len = payload_len;
+    ecg_frame->frame.chunks[2].data = ecg_frame->trailer;
+    ecg_frame->frame.chunks[2].len = ECG_TRAILER_LEN;
+    ecg_frame->frame.num_chunks = 3;
+    ecg_frame->frame.on_done = ecg_frame_done;
+
+    // 3. 交给UART DMA发送
+    // 队列积压接近深度时，采集可能在读取(压缩、CRC)期间已重新进入该段，此时负载与CRC都不可信，丢弃本帧。
+    // 检查与占用标记在同一关中断区内：之后再重新进入该段时由ecg_frame_release_segment()把负载复制出去
+    _DINT();
+    if (!acq_segment_intact(seg)) {
+        _EINT();
+        return 0;
+    }
+    ecg_frame->segment_idx = segment_idx;
+    ecg_frame->in_ring = payload != ecg_frame->payload_buf;
+    ecg_frame->busy = 1;
+    segment_tx_in_flight[segment_idx] = ecg_frame->in_ring;
+    _EINT();
+    if (!uart_submit_frame(&ecg_frame->frame)) {
+        segment_tx_in_flight[segment_idx] = 0; // 队列已满，丢弃本帧
+        ecg_frame->in_ring = 0;
+        ecg_frame->busy = 0;
+        return 0;
+    }
+    LATENCY_FRAMED(seg, header.seq);
+    return 1;
+}
+
+// 函数：把一段中要显示的各通道画到各自的波形带上，从上到下按输入编号排列
+void show_segment(const SegDesc* seg) {
+    uint8_t input;
+    uint8_t ch = 0;
+    uint8_t lane = 0;
+
+    for (input = 0; input < 8; input++) {
+        if (!(ACQ_CHANNEL_MASK >> input & 1)) {
+            continue;
+        }
+        if (ECG_DISPLAY_MASK >> input & 1) {
+            etft_TraceSamples(lane++, acq_channel_data(seg, ch), seg->num_samples, ACQ_CHANNEL_STRIDE,
+                              seg->start_sample, fRGB_GREEN, bRGB_BLACK);
+        }
+        ch++;
+    }
+}
+
+#ifdef ECG_PROCESS
+// 处理级：就地滤波(本级是段数据唯一的写入者)，再检测QRS
+void process_segment(const SegDesc* seg) {
+#ifdef ECG_FILTER
+    {
+        uint8_t ch;
+        PROF_BEGIN(PROF_FILTER);
+        for (ch = 0; ch < ACQ_CHANNELS; ch++) {
+            if (seg->flags & SEGQ_FLAG_AFTER_GAP) {
+                ecg_filter_reset(&ecg_filter[ch]); // 丢段后重新起步，不把缺口当作阶跃
+            }
+            ecg_filter_run(&ecg_filter[ch], (uint16_t*)acq_channel_data(seg, ch), seg->num_samples,
+                           ACQ_CHANNEL_STRIDE);
+        }
+        PROF_END(PROF_FILTER);
+    }
+#endif
+#ifdef ECG_QRS
+    {
+        EcgQrsBeat beat;
+        // 只在主导联(通道0)上检测；缺口由检测器根据样本索引自行发现
+        ecg_qrs_run(&ecg_qrs, acq_channel_data(seg, 0), seg->num_samples, ACQ_CHANNEL_STRIDE,
+                    seg->start_sample);
+        while (ecg_qrs_pop(&ecg_qrs, &beat)) {
+            send_beat_frame(&beat);
+            hr_last_beat_sample = beat.sample_index;
+            hr_bpm = beat.bpm_avg ? beat.bpm_avg : beat.bpm; // 平均值要等到有一个合理的RR间期
+        }
+        show_heart_rate(seg->start_sample + seg->num_samples);
+    }
+#endif
+}
+#endif
+
+#ifdef ECG_QRS
+static void ecg_beat_frame_done(UartTxFrame* frame) {
+    ((EcgBeatFrame*)frame)->busy = 0;
+}
+
+// 函数：发送一帧心跳事件(ECG_TYPE_BEAT)，帧很短，直接编码到帧自带的缓冲区
+// 返回是否成功排入发送队列
+int send_beat_frame(const EcgQrsBeat* beat) {
+    EcgBeatFrame* beat_frame = 0;
+    EcgFrameHeader header;
+    uint8_t payload[ECG_BEAT_PAYLOAD_LEN];
+    unsigned int i;
+
+    header.type = ECG_TYPE_BEAT;
+    header.seq = ecg_tx_seq++;
+    header.sample_index = beat->sample_index;
+    header.channel_mask = ECG_PRIMARY_MASK;
+    header.payload_len = ECG_BEAT_PAYLOAD_LEN;
+
+    for (i = 0; i < ECG_BEAT_FRAMES; i++) {
+        if (!ecg_beat_frames[i].busy) {
+            beat_frame = &ecg_beat_frames[i];
+            break;
+        }
+    }
+    if (!beat_frame) {
+        return 0;
+    }
+
+    payload[0] = beat->rr_ms & 0xFF;
+    payload[1] = beat->rr_ms >> 8;
+    payload[2] = beat->bpm;
+    payload[3] = beat->bpm_avg;
+    payload[4] = beat->flags;
+    ecg_encode_frame(beat_frame->bytes, &header, payload);
+
+    beat_frame->frame.chunks[0].data = beat_frame->bytes;
+    beat_frame->frame.chunks[0].len = ECG_BEAT_FRAME_LEN;
+    beat_frame->frame.num_chunks = 1;
+    beat_frame->frame.on_done = ecg_beat_frame_done;
+    beat_frame->busy = 1;
+    if (!uart_submit_frame(&beat_frame->frame)) {
+        beat_frame->busy = 0;
+        return 0;
+    }
+    return 1;
 }
 
-// 函数：打包并发送一帧ECG数据
-void send_ecg_frame(const uint16_t* data, uint16_t num_samples) {
-    uint8_t frame_buffer[2 + 1 + SAMPLES_PER_SEGMENT * 2 + 1];
-    uint8_t checksum = 0;
-    uint16_t i;
-    uint16_t payload_len = num_samples * 2;
+// 函数：在屏幕右上角显示心率，数值变化时才重画；超过HR_TIMEOUT_S没有心跳时显示---
+void show_heart_rate(uint32_t now_sample) {
+    char text[7] = "HR ---";
+    int16_t value = hr_bpm;
+
+    if (now_sample - hr_last_beat_sample > (uint32_t)HR_TIMEOUT_S * timebase->sample_rate_hz) {
+        value = 0;
+    }
+    if (value == hr_shown) {
+        return;
+    }
+    hr_shown = value;
+    if (value > 0) {
+        text[3] = value >= 100 ? '0' + value / 100 : ' ';
+        text[4] = value >= 10 ? '0' + value / 10 % 10 : ' ';
+        text[5] = '0' + value % 10;
+    }
+    etft_DisplayString(text, HR_TEXT_X, HR_TEXT_Y, etft_Color(255, 255, 255), bRGB_BLACK);
+}
+#endif
 
-    // 1. 填充帧头和长度
-    frame_buffer[0] = 0xAA; // 帧头1
-    frame_buffer[1] = 0x55; // 帧头2
-    frame_buffer[2] = payload_len; // 长度
+#ifdef PROF
+static void ecg_stats_frame_done(UartTxFrame* frame) {
+    ((EcgStatsFrame*)frame)->busy = 0;
+}
 
-    // 2. 拷贝数据负载 (因为是小端架构，直接内存拷贝即可)
-    memcpy(&frame_buffer[3], data, payload_len);
+// 函数：发送一帧性能统计(ECG_TYPE_STATS)：采集余量和各热点区段的耗时分布，发送后统计清零
+// 返回是否成功排入发送队列；上一帧还没发完时本窗口的统计留到下一帧
+int send_stats_frame(void) {
+    EcgFrameHeader header;
+    uint8_t* payload = &ecg_stats_frame.bytes[ECG_HEADER_LEN];
+    uint16_t high_water = acq_queue.cursor[0].high_water;
 
-    // 3. 计算校验和
-    for (i = 0; i < payload_len; i++) {
-        checksum += frame_buffer[3 + i];
+    if (ecg_stats_frame.busy) {
+        return 0;
     }
+    header.type = ECG_TYPE_STATS;
+    header.seq = ecg_tx_seq++;
+    header.sample_index = 0;
+    header.channel_mask = 0;
+    header.payload_len = ECG_STATS_PAYLOAD_LEN;
+
+    payload[0] = high_water > 0xFF ? 0xFF : (uint8_t)high_water;
+    payload[1] = (uint8_t)acq_queue.depth;
+    payload[2] = segment_overrun_count & 0xFF;
+    payload[3] = segment_overrun_count >> 8;
+    prof_encode(&payload[ECG_STATS_HEADER_LEN]);
+    ecg_encode_frame(ecg_stats_frame.bytes, &header, payload); // 负载已在原位，复制是空操作
+
+    ecg_stats_frame.frame.chunks[0].data = ecg_stats_frame.bytes;
+    ecg_stats_frame.frame.chunks[0].len = sizeof(ecg_stats_frame.bytes);
+    ecg_stats_frame.frame.num_chunks = 1;
+    ecg_stats_frame.frame.on_done = ecg_stats_frame_done;
+    ecg_stats_frame.busy = 1;
+    if (!uart_submit_frame(&ecg_stats_frame.frame)) {
+        ecg_stats_frame.busy = 0;
+        return 0;
+    }
+    return 1;
+}
+#endif
 
-    // 4. 填充校验和
-    frame_buffer[3 + payload_len] = checksum;
+#ifdef LATENCY
+static void ecg_latency_frame_done(UartTxFrame* frame) {
+    ((EcgLatencyFrame*)frame)->busy = 0;
+}
+
+// 函数：为一个走完各级的段发送一帧延迟记录(ECG_TYPE_LATENCY)
+// 延迟帧只用样本帧剩下的发送队列：UART读者已追上，且至少给下一个样本帧留一个位置，
+// 否则记录留到下一轮。返回是否发出了一帧
+int send_latency_frame(void) {
+    EcgLatencyFrame* latency_frame = 0;
+    EcgFrameHeader header;
+    LatencyRecord rec;
+    uint8_t payload[ECG_LATENCY_PAYLOAD_LEN];
+    unsigned int i;
+
+    if (segq_pending(&ECG_OUT_QUEUE, SEGQ_CONSUMER_UART) != 0
+        || uart_frames_pending() >= UART_TX_QUEUE_LEN - 1) {
+        return 0;
+    }
+    for (i = 0; i < ECG_LATENCY_FRAMES; i++) {
+        if (!ecg_latency_frames[i].busy) {
+            latency_frame = &ecg_latency_frames[i];
+            break;
+        }
+    }
+    if (!latency_frame || !latency_pop(&rec)) {
+        return 0;
+    }
 
-    // 5. 通过UART库发送整个数据帧
-    uart_write_buffer(frame_buffer, sizeof(frame_buffer));
+    header.type = ECG_TYPE_LATENCY;
+    header.seq = ecg_tx_seq++;
+    header.sample_index = rec.start_sample;
+    header.channel_mask = ACQ_CHANNEL_MASK;
+    header.payload_len = ECG_LATENCY_PAYLOAD_LEN;
+
+    payload[0] = rec.num_samples & 0xFF;
+    payload[1] = rec.num_samples >> 8;
+    payload[2] = rec.seq & 0xFF;
+    payload[3] = rec.seq >> 8;
+    for (i = 0; i < LATENCY_STAGES; i++) {
+        payload[4 + 2 * i] = rec.stage[i] & 0xFF;
+        payload[5 + 2 * i] = rec.stage[i] >> 8;
+    }
+    ecg_encode_frame(latency_frame->bytes, &header, payload);
+
+    latency_frame->frame.chunks[0].data = latency_frame->bytes;
+    latency_frame->frame.chunks[0].len = ECG_LATENCY_FRAME_LEN;
+    latency_frame->frame.num_chunks = 1;
+    latency_frame->frame.on_done = ecg_latency_frame_done;
+    latency_frame->busy = 1;
+    if (!uart_submit_frame(&latency_frame->frame)) {
+        latency_frame->busy = 0;
+        return 0;
+    }
+    return 1;
 }
+#endif
 
 #pragma vector = DMA_VECTOR
 __interrupt void DMA_ISR(void) {
     // DMAIFG for the highest priority enabled DMA channel is automatically cleared
     // by accessing DMAIV if it's not 0. Or manually clear the specific flag.
     // For simplicity, we can check and clear DMA0IFG if needed, but DMAIV is better.
+    power_isr_enter();
+    PROF_ISR_ENTRY();
+    PROF_BEGIN(PROF_DMA_ISR);
     switch (__even_in_range(DMAIV, 16)) // DMAIV provides the interrupt vector
     {
         case 0:
             break; // No interrupt
-        case 2: // DMA0IFG
-            // The segment 'current_segment_dma_is_filling' has just been filled.
-            dma_completed_segment_idx = current_segment_dma_is_filling;
-            segment_data_ready_for_display[dma_completed_segment_idx] = 1;
-            new_dma_data_available = 1;
-
-            // Advance to the next segment for DMA capture
-            current_segment_dma_is_filling += 1;
-            if (current_segment_dma_is_filling >= NUM_SEGMENTS) {
-                current_segment_dma_is_filling = 0;
-                // This indicates a full screen's worth of data acquisition has just been set up to start/continue with segment 0.
-                // The main loop will handle pausing AFTER displaying the last segment of the previous cycle.
+        case 2: // DMA0IFG: 采集完成一段(或一个过采样原始块、一组多通道样本)
+            PROF_ADC_TRIGGER();
+            // Acquisition cannot stall: if the UART still owns the segment now being filled, the
+            // frame's payload is copied out before the first new sample lands, and counted
+            if (acq_dma_isr()) {
+                LATENCY_CAPTURE(&acq_queue);
+                if (segment_tx_in_flight[acq_filling_segment()]) {
+                    ecg_frame_release_segment(acq_filling_segment());
+                    segment_overrun_count++;
+                }
+                POWER_WAKE(POWER_EVT_SEGMENT);
+            }
+            break;
+        case 4: // DMA1IFG: TFT SPI发送
+            tft_DmaIsr();
+            if (!tft_DmaBusy()) {
+                POWER_WAKE(POWER_EVT_TFT);
+            }
+            break;
+        case 6: // DMA2IFG: UART帧发送
+            if (uart_dma_isr()) {
+                POWER_WAKE(POWER_EVT_UART_TX);
             }
-
-            // Reconfigure DMA destination for the NEW 'current_segment_dma_is_filling'
-            unsigned long next_segment_start_addr =
-                (unsigned long)&adc_capture_buffer[current_segment_dma_is_filling
-                                                   * SAMPLES_PER_SEGMENT];
-            __data20_write_long((unsigned long)&DMA0DA, next_segment_start_addr);
-
-            // DMA0SZ is automatically reloaded from its temporary register when it decrements to zero and DMAIFG is set[cite: 41, 53].
-            // So, no need to reset DMA0SZ here for DMADT_0.
-
-            // Re-enable DMA Channel 0 (DMAEN was cleared by hardware with DMADT_0 after DMA0SZ transfers) [cite: 34]
-            DMA0CTL |= DMAEN;
             break;
-        case 4:
-            break; // DMA1IFG
-        case 6:
-            break; // DMA2IFG
         // ... up to 16 for DMA7IFG if available
         default:
             break;
     }
+    PROF_END(PROF_DMA_ISR);
+    power_isr_exit();
 }
@@ -0,0 +1,86 @@
+#include "power.h"
+
+#define POWER_REPORT_TICKS (POWER_REPORT_S * POWER_TICK_HZ)
+
+// --- Public Variables ---
+volatile uint8_t power_events = 0;
+volatile uint8_t power_asleep = 0;
+volatile uint16_t power_wakeups = 0;
+
+// --- Private Variables ---
+// Time since power_mark is added to one of the totals at every switch between active and
+// asleep. The switches come at least once per segment, far more often than TA1R wraps (2 s).
+static uint16_t power_mark = 0; // TA1R at the last switch
+static uint32_t power_active_ticks = 0;
+static uint32_t power_sleep_ticks = 0;
+
+// --- Function Implementations ---
+
+void power_init(void) {
+    TA1CTL = TASSEL__ACLK | MC__CONTINUOUS | TACLR; // No interrupts, the count only wraps
+    power_mark = power_now();
+    power_active_ticks = 0;
+    power_sleep_ticks = 0;
+    power_wakeups = 0;
+}
+
+void power_sleep(void) {
+    uint16_t now = power_now();
+
+    power_active_ticks += (uint16_t)(now - power_mark);
+    power_mark = now;
+    power_asleep = 1;
+    __bis_SR_register(POWER_LPM_BITS | GIE); // Sleep and enable interrupts in one instruction
+    __no_operation();
+}
+
+void power_isr_enter(void) {
+    if (power_asleep) {
+        uint16_t now = power_now();
+        power_sleep_ticks += (uint16_t)(now - power_mark);
+        power_mark = now;
+    }
+}
+
+void power_isr_exit(void) {
+    if (power_asleep) {
+        uint16_t now = power_now();
+        power_active_ticks += (uint16_t)(now - power_mark);
+        power_mark = now;
+    }
+}
+
+int power_poll_report(uint32_t* arg) {
+    uint16_t now;
+    uint32_t total;
+
+    __disable_interrupt();
+    now = power_now();
+    power_active_ticks += (uint16_t)(now - power_mark);
+    power_mark = now;
+    total = power_active_ticks + power_sleep_ticks;
+    if (total < POWER_REPORT_TICKS) {
+        __enable_interrupt();
+        return 0;
+    }
+    // At most 10000 * 2 * POWER_REPORT_TICKS, well within 32 bits
+    *arg = power_active_ticks * 10000UL / total
+        | (uint32_t)((power_wakeups * POWER_TICK_HZ + total / 2) / total) << 16;
+    power_active_ticks = 0;
+    power_sleep_ticks = 0;
+    power_wakeups = 0;
+    __enable_interrupt();
+    return 1;
+}
+
+// TA1 counts ACLK, which is asynchronous to MCLK: read until two reads agree
+uint16_t power_now(void) {
+    uint16_t a, b;
+
+    b = TA1R;
+    do {
+        a = b;
+        b = TA1R;
+    } while (a != b);
+    return a;
+}
@@ -0,0 +1,95 @@
+#ifndef POWER_H_
+#define POWER_H_
+
+#include "hal.h"
+#include <stdint.h>
+
+// Event-driven sleep for the main loop, and the measured duty cycle.
+//
+// The main loop sleeps in POWER_LPM_BITS whenever its queues are empty. ISRs that
+// hand it work post an event with POWER_WAKE(), which also clears the LPM bits on
+// exit. The main loop checks power_events with interrupts disabled and enters the
+// sleep with the same instruction that enables them, so an event posted after the
+// queue checks either stops the sleep or wakes it right away; none is lost.
+//
+// Timer_A1 counts ACLK (XT1, 32768 Hz) freely and splits the time into active
+// (main loop or an ISR running) and asleep. Every ISR that can run during the sleep
+// calls power_isr_enter() first and power_isr_exit() last. One tick is 30.5 us,
+// longer than most ISRs, but ACLK is asynchronous to the events, so the rounding
+// averages out over a report window.
+
+// --- Configuration ---
+// LPM0 stops only MCLK. LPM3 also turns off the DCO and its FLL: SMCLK (XT2) keeps
+// running on the conditional requests of Timer_A0, ADC12 and the USCIs, and the
+// DMA requests MCLK for each transfer. Every wake-up and DMA transfer then waits
+// for the DCO to start, which at 460800 baud is tens of thousands of times per
+// second, so LPM3 only pays off with a slow link.
+#ifndef POWER_LPM_BITS
+    #define POWER_LPM_BITS LPM0_bits
+#endif
+
+#define POWER_TICK_HZ 32768UL // Timer_A1 from ACLK
+#define POWER_REPORT_S 5 // Duty-cycle window, one LINK_CMD_POWER_REPORT (uart_link.h) each
+
+// Events posted to the main loop
+#define POWER_EVT_SEGMENT 0x01 // A capture segment completed
+#define POWER_EVT_LINK_RX 0x02 // A byte arrived from the host
+#define POWER_EVT_UART_TX 0x04 // A UART DMA frame was sent and handed back
+#define POWER_EVT_TFT 0x08 // A TFT DMA transfer finished
+
+// --- Public Variables ---
+extern volatile uint8_t power_events; // POWER_EVT_* posted since the main loop last cleared them
+extern volatile uint8_t power_asleep; // The main loop is in LPM
+extern volatile uint16_t power_wakeups;
+
+// Posts events from an ISR and, if the main loop is asleep, wakes it when the ISR returns.
+// Must be expanded in the ISR function itself, where __bic_SR_register_on_exit() applies.
+#define POWER_WAKE(evt)                                                                            \
+    do {                                                                                           \
+        power_events |= (evt);                                                                     \
+        if (power_asleep) {                                                                        \
+            power_asleep = 0;                                                                      \
+            power_wakeups++;                                                                       \
+            __bic_SR_register_on_exit(POWER_LPM_BITS);                                             \
+        }                                                                                          \
+    } while (0)
+
+// --- Public Function Prototypes ---
+
+/**
+ * @brief Starts Timer_A1 and a new report window. Call after init_clock().
+ */
+void power_init(void);
+
+/**
+ * @brief Returns the Timer_A1 count, also the time base of latency.h.
+ */
+uint16_t power_now(void);
+
+/**
+ * @brief Sleeps until an ISR wakes the main loop with POWER_WAKE().
+ *
+ * Call with interrupts disabled, after finding power_events empty; returns with
+ * interrupts enabled.
+ */
+void power_sleep(void);
+
+/**
+ * @brief Closes the time asleep. First thing in every ISR that can run while the main loop sleeps.
+ */
+void power_isr_enter(void);
+
+/**
+ * @brief Starts a new time asleep unless the ISR woke the main loop. Last thing in the same ISRs.
+ */
+void power_isr_exit(void);
+
+/**
+ * @brief Closes the report window once it has lasted POWER_REPORT_S.
+ * @param arg Set to the LINK_CMD_POWER_REPORT argument: active time in 0.01% of the
+ *            window | (wake-ups per second << 16).
+ * @return 1 if a window was closed, 0 otherwise.
+ */
+int power_poll_report(uint32_t* arg);
+
+#endif /* POWER_H_ */
@@ -0,0 +1,127 @@
+#include "prof.h"
+#include <string.h>
+
+#ifdef PROF
+
+// --- Private Variables ---
+static ProfStats prof_stats[PROF_REGIONS];
+static uint16_t prof_period = 1; // Timer_A0 counts per conversion
+static uint16_t prof_trigger_at = 0;
+static uint16_t prof_trigger_delay = 0;
+static uint16_t prof_entry_phase = 0; // TA0R at the last DMA_ISR entry
+
+// --- Private Function Prototypes ---
+static void prof_clear(ProfStats* stats);
+static uint16_t prof_read_ta0(void);
+static void prof_put16(uint8_t* out, uint16_t value);
+
+// --- Function Implementations ---
+
+void prof_init(void) {
+    TB0CTL = TBSSEL__SMCLK | MC__CONTINUOUS | TBCLR; // No interrupts, the count only wraps
+    prof_clear(prof_stats);
+}
+
+// Timer_B0 counts SMCLK, which is asynchronous to MCLK: read until two reads agree
+uint16_t prof_now(void) {
+    uint16_t a, b;
+
+    b = TB0R;
+    do {
+        a = b;
+        b = TB0R;
+    } while (a != b);
+    return a;
+}
+
+void prof_record(uint8_t region, uint16_t ticks) {
+    ProfStats* s = &prof_stats[region];
+    uint16_t t = ticks;
+    uint8_t bucket = 0;
+
+    if (s->count == 0xFFFF) {
+        return;
+    }
+    if (s->count == 0 || ticks < s->min) {
+        s->min = ticks;
+    }
+    if (ticks > s->max) {
+        s->max = ticks;
+    }
+    s->count++;
+    s->sum += ticks;
+    while (t >= 4 && bucket < PROF_BUCKETS - 1) {
+        t >>= 2;
+        bucket++;
+    }
+    s->hist[bucket]++;
+}
+
+void prof_set_trigger(uint16_t period, uint16_t trigger_at, uint16_t delay) {
+    prof_period = period ? period : 1;
+    prof_trigger_at = trigger_at;
+    prof_trigger_delay = delay;
+}
+
+void prof_isr_entry(void) {
+    prof_entry_phase = prof_read_ta0();
+}
+
+void prof_adc_trigger(void) {
+    uint16_t since_edge = prof_entry_phase >= prof_trigger_at
+        ? prof_entry_phase - prof_trigger_at
+        : prof_entry_phase + prof_period - prof_trigger_at;
+
+    prof_record(PROF_ISR_LATENCY,
+                since_edge > prof_trigger_delay ? since_edge - prof_trigger_delay : 0);
+}
+
+uint16_t prof_encode(uint8_t* out) {
+    ProfStats snapshot[PROF_REGIONS];
+    uint8_t* p = out;
+    uint8_t r, b;
+
+    __disable_interrupt();
+    memcpy(snapshot, prof_stats, sizeof(snapshot));
+    prof_clear(prof_stats);
+    __enable_interrupt();
+
+    prof_put16(p, PROF_TICKS_PER_MS);
+    p[2] = PROF_REGIONS;
+    p += 3;
+    for (r = 0; r < PROF_REGIONS; r++) {
+        const ProfStats* s = &snapshot[r];
+        prof_put16(p, s->count);
+        prof_put16(p + 2, s->min);
+        prof_put16(p + 4, s->max);
+        prof_put16(p + 6, (uint16_t)s->sum);
+        prof_put16(p + 8, (uint16_t)(s->sum >> 16));
+        for (b = 0; b < PROF_BUCKETS; b++) {
+            prof_put16(p + 10 + 2 * b, s->hist[b]);
+        }
+        p += ECG_STATS_RECORD_LEN;
+    }
+    return PROF_ENCODED_LEN;
+}
+
+static void prof_clear(ProfStats* stats) {
+    memset(stats, 0, sizeof(ProfStats) * PROF_REGIONS);
+}
+
+// Same as prof_now() for Timer_A0
+static uint16_t prof_read_ta0(void) {
+    uint16_t a, b;
+
+    b = TA0R;
+    do {
+        a = b;
+        b = TA0R;
+    } while (a != b);
+    return a;
+}
+
+static void prof_put16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+#endif
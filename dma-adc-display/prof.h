@@ -0,0 +1,117 @@
+#ifndef PROF_H_
+#define PROF_H_
+
+#include "ecg_proto.h"
+#include "hal.h"
+#include <stdint.h>
+
+// Cycle profiling of the hot paths, sent to the host as ECG_TYPE_STATS frames (ecg_proto.h).
+//
+// Build with PROF defined (e.g. -DPROF) to compile it in. Without it every macro below
+// expands to nothing, prof.c is empty, Timer_B0 stays off and no stats frames are sent.
+//
+// Timer_B0 counts SMCLK (4 MHz, 0.25 us, 5 MCLK) freely. A region is timed between
+// PROF_BEGIN() and PROF_END() in the same block. Durations are taken modulo the 16-bit
+// counter, so a region must stay under 16 ms. Each region keeps a count, min, max, sum
+// and a histogram in buckets that grow by 4x:
+//   <1 us, 1-4 us, 4-16 us, 16-64 us, 64-256 us, 0.25-1 ms, 1-4 ms, 4-16 ms.
+// The table is sent and cleared with each report, so every frame covers one window.
+//
+// PROF_ISR_LATENCY is the time from the DMA0 trigger to DMA_ISR entry. The trigger is
+// the end of the conversion that completes a segment (or a raw block or sample set),
+// which comes a fixed S/H and conversion time after the TA0.1 edge. Timer_A0 counts
+// the same SMCLK, so its phase at ISR entry gives the latency, modulo one conversion
+// period.
+//
+// Cost: about 40 MCLK for each timer read and 60 to record a region, paid only in
+// PROF builds.
+
+// --- Configuration ---
+#define PROF_TICKS_PER_MS 4000 // Timer_B0 from SMCLK
+#define PROF_BUCKETS 8
+
+// Regions, in the order of the stats frame
+typedef enum {
+    PROF_DMA_ISR, // DMA_ISR, whole
+    PROF_UART_ISR, // USCI_A1_ISR, whole
+    PROF_SEND_FRAME, // send_ecg_frame(): framing, Rice coding, CRC
+    PROF_PROCESS, // process_segment(): filters and QRS detector
+    PROF_DISPLAY, // show_segment(): TFT trace of all lanes
+    PROF_ISR_LATENCY, // DMA0 trigger to DMA_ISR entry
+    PROF_CIC, // acq_decimate(): one oversampled raw block through the CIC, inside DMA_ISR
+    PROF_FILTER, // ecg_filter_run() on every channel of a segment, inside PROF_PROCESS
+    PROF_REGIONS
+} ProfRegion;
+
+typedef struct {
+    uint16_t count; // Stops counting at 0xFFFF; the other fields stop with it
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+    uint16_t hist[PROF_BUCKETS];
+} ProfStats;
+
+// Stats frame payload bytes written by prof_encode(), after the ECG_STATS_HEADER_LEN written by
+// the caller
+#define PROF_ENCODED_LEN (3 + PROF_REGIONS * ECG_STATS_RECORD_LEN)
+
+#ifdef PROF
+    #define PROF_INIT() prof_init()
+    #define PROF_BEGIN(region) uint16_t prof_t0_##region = prof_now()
+    #define PROF_END(region) prof_record(region, (uint16_t)(prof_now() - prof_t0_##region))
+    #define PROF_ISR_ENTRY() prof_isr_entry()
+    #define PROF_ADC_TRIGGER() prof_adc_trigger()
+    #define PROF_SET_TRIGGER(period, at, delay) prof_set_trigger(period, at, delay)
+#else
+    #define PROF_INIT()
+    #define PROF_BEGIN(region)
+    #define PROF_END(region)
+    #define PROF_ISR_ENTRY()
+    #define PROF_ADC_TRIGGER()
+    #define PROF_SET_TRIGGER(period, at, delay)
+#endif
+
+// --- Public Function Prototypes ---
+
+/**
+ * @brief Starts Timer_B0 and clears the table.
+ */
+void prof_init(void);
+
+/**
+ * @brief Returns the Timer_B0 count.
+ */
+uint16_t prof_now(void);
+
+/**
+ * @brief Adds one duration to a region. Each region must be recorded from one context only
+ * (an ISR or the main loop).
+ */
+void prof_record(uint8_t region, uint16_t ticks);
+
+/**
+ * @brief Sets where the ADC trigger sits in the Timer_A0 period, for PROF_ISR_LATENCY.
+ * @param period Timer_A0 counts per conversion.
+ * @param trigger_at TA0CCR1, where the TA0.1 edge starts the S/H.
+ * @param delay Counts from the edge to the end of the conversion: S/H time plus conversion.
+ */
+void prof_set_trigger(uint16_t period, uint16_t trigger_at, uint16_t delay);
+
+/**
+ * @brief Notes the Timer_A0 phase. First thing in DMA_ISR.
+ */
+void prof_isr_entry(void);
+
+/**
+ * @brief Records PROF_ISR_LATENCY from the phase noted at entry. Call when DMA0IFG was the cause.
+ */
+void prof_adc_trigger(void);
+
+/**
+ * @brief Writes the table as the tail of a stats frame payload (ecg_proto.h) and clears it.
+ * @param out PROF_ENCODED_LEN bytes.
+ * @return PROF_ENCODED_LEN.
+ */
+uint16_t prof_encode(uint8_t* out);
+
+#endif /* PROF_H_ */
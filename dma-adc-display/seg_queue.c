@@ -0,0 +1,78 @@
+#include "seg_queue.h"
+
+// --- Function Implementations ---
+
+void segq_init(SegQueue* q, uint16_t depth) {
+    uint8_t i;
+
+    if (depth == 0 || depth >= SEGQ_LEN) {
+        depth = SEGQ_LEN - 1;
+    }
+    q->head = 0;
+    q->depth = depth;
+    for (i = 0; i < SEGQ_MAX_CONSUMERS; i++) {
+        q->cursor[i].tail = 0;
+        q->cursor[i].high_water = 0;
+        q->cursor[i].drops = 0;
+    }
+}
+
+void segq_push(SegQueue* q, const SegDesc* d) {
+    uint16_t head = q->head;
+    volatile SegDesc* dst = &q->desc[head & (SEGQ_LEN - 1)];
+
+    dst->data = d->data;
+    dst->num_samples = d->num_samples;
+    dst->slot = d->slot;
+    dst->start_sample = d->start_sample;
+    dst->flags = d->flags;
+    SEGQ_BARRIER(); // Entry complete before it is published
+    q->head = head + 1;
+}
+
+int segq_pop(SegQueue* q, uint8_t consumer, SegDesc* out) {
+    SegCursor* c = &q->cursor[consumer];
+    uint16_t tail = c->tail;
+    uint8_t flags = 0;
+
+    for (;;) {
+        uint16_t head = q->head;
+        uint16_t pending = head - tail;
+        const volatile SegDesc* src;
+
+        if (pending == 0) {
+            c->tail = tail;
+            return 0;
+        }
+        if (pending > q->depth) {
+            // Lapped by the producer: skip what was overwritten
+            c->drops += pending - q->depth;
+            tail = head - q->depth;
+            pending = q->depth;
+            flags = SEGQ_FLAG_AFTER_GAP;
+        }
+        if (pending > c->high_water) {
+            c->high_water = pending;
+        }
+
+        SEGQ_BARRIER(); // Read the entry only after seeing it published
+        src = &q->desc[tail & (SEGQ_LEN - 1)];
+        out->data = src->data;
+        out->num_samples = src->num_samples;
+        out->slot = src->slot;
+        out->start_sample = src->start_sample;
+        out->flags = src->flags | flags;
+        SEGQ_BARRIER();
+
+        // The producer may have lapped us while copying; the copy is then torn
+        if ((uint16_t)(q->head - tail) <= q->depth) {
+            c->tail = tail + 1;
+            return 1;
+        }
+    }
+}
+
+uint16_t segq_pending(const SegQueue* q, uint8_t consumer) {
+    uint16_t pending = q->head - q->cursor[consumer].tail;
+    return (pending > q->depth) ? q->depth : pending;
+}
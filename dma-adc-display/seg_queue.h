@@ -0,0 +1,77 @@
+#ifndef SEG_QUEUE_H_
+#define SEG_QUEUE_H_
+
+#include <stdint.h>
+
+// Single-producer queue of segment descriptors with one read cursor per consumer.
+// The producer (DMA ISR) never waits: once a consumer falls more than `depth`
+// entries behind, its oldest entries are overwritten and counted as drops for
+// that consumer only, so a slow LCD can't hold back telemetry.
+//
+// Plain C with no device headers so it can be exercised on a PC. On the MSP430
+// the producer runs in an ISR and the consumers in the main loop; volatile
+// accesses are enough there. A multi-core host must define SEGQ_BARRIER() as a
+// full memory barrier (e.g. __sync_synchronize()).
+
+// Ring size, power of two
+#define SEGQ_LEN 32
+
+#define SEGQ_MAX_CONSUMERS 2
+
+#ifndef SEGQ_BARRIER
+    #define SEGQ_BARRIER()
+#endif
+
+// Descriptor flags
+#define SEGQ_FLAG_AFTER_GAP 0x01 // Entries were dropped for this consumer just before this one
+
+typedef struct {
+    const uint16_t* data;
+    uint16_t num_samples;
+    uint16_t slot; // Capture ring slot holding the data
+    uint32_t start_sample; // Index of the first sample since capture started
+    uint8_t flags;
+} SegDesc;
+
+typedef struct {
+    volatile uint16_t tail; // Next entry to read (free-running)
+    uint16_t high_water; // Largest backlog seen by this consumer
+    uint16_t drops; // Entries overwritten before this consumer read them
+} SegCursor;
+
+typedef struct {
+    SegDesc desc[SEGQ_LEN];
+    volatile uint16_t head; // Entries pushed so far (free-running)
+    uint16_t depth; // Entries a consumer may lag before losing them
+    SegCursor cursor[SEGQ_MAX_CONSUMERS];
+} SegQueue;
+
+/**
+ * @brief Empties the queue and resets the statistics.
+ * @param depth How far a consumer may lag, 1..SEGQ_LEN - 1, so the entry a
+ *        consumer is copying is never the one the producer is writing. Pass
+ *        the number of capture slots minus one so a queued descriptor never
+ *        points at a slot the DMA is refilling.
+ */
+void segq_init(SegQueue* q, uint16_t depth);
+
+/**
+ * @brief Appends a descriptor; wait-free, producer side only.
+ */
+void segq_push(SegQueue* q, const SegDesc* d);
+
+/**
+ * @brief Takes the oldest entry for one consumer; lock-free, that consumer only.
+ * @note If the producer laps the entry while it is being copied, the copy is retried from the
+ *       oldest entry still intact. Each retry takes a push that landed during the previous copy,
+ *       so with one push per segment and a copy of a few stores, a call retries at most once.
+ * @return 1 if *out was filled, 0 if the consumer is up to date.
+ */
+int segq_pop(SegQueue* q, uint8_t consumer, SegDesc* out);
+
+/**
+ * @brief Returns the number of entries waiting for a consumer (capped at depth).
+ */
+uint16_t segq_pending(const SegQueue* q, uint8_t consumer);
+
+#endif /* SEG_QUEUE_H_ */
@@ -0,0 +1,91 @@
+#include "timebase.h"
+#include "adc_acq.h"
+#include "ecg_proto.h"
+#include "hal.h"
+
+// --- Private Definitions ---
+
+#define TB_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define TB_SEGMENT_LEN(rate)                                                                       \
+    TB_MIN((uint32_t)(rate) * TIMEBASE_SEGMENT_MS / 1000, ACQ_MAX_SEGMENT_LEN)
+#define TB_SEGMENT_COUNT(rate)                                                                     \
+    TB_MIN(TB_MIN((uint32_t)(rate) * TIMEBASE_BUFFER_MS / 1000, ACQ_BUFFER_SAMPLES)                \
+               / TB_SEGMENT_LEN(rate),                                                             \
+           ACQ_MAX_SEGMENTS)
+#define TB_LINK_BYTES(rate)                                                                        \
+    ((uint32_t)(rate) * 2 * ACQ_CHANNELS                                                           \
+     + ((uint32_t)(rate) + TB_SEGMENT_LEN(rate) - 1) / TB_SEGMENT_LEN(rate) * ECG_FRAME_OVERHEAD)
+#define TB_PERIOD(rate) (SMCLK_FREQ / ((uint32_t)(rate) * ACQ_OVERSAMPLE * ACQ_CHANNELS))
+
+// S/H per timebase.h: the longest setting within 1/16 of the trigger period, at least 16 cycles
+#define TB_SHT_LIMIT(rate) (TB_PERIOD(rate) / 16)
+#define TB_SHT_CYCLES(rate)                                                                        \
+    (TB_SHT_LIMIT(rate) >= 256   ? 256                                                             \
+     : TB_SHT_LIMIT(rate) >= 192 ? 192                                                             \
+     : TB_SHT_LIMIT(rate) >= 128 ? 128                                                             \
+     : TB_SHT_LIMIT(rate) >= 96  ? 96                                                              \
+     : TB_SHT_LIMIT(rate) >= 64  ? 64                                                              \
+     : TB_SHT_LIMIT(rate) >= 32  ? 32                                                              \
+                                 : 16)
+#define TB_SHT(rate)                                                                               \
+    (TB_SHT_CYCLES(rate) == 256   ? ADC12SHT0_8                                                    \
+     : TB_SHT_CYCLES(rate) == 192 ? ADC12SHT0_7                                                    \
+     : TB_SHT_CYCLES(rate) == 128 ? ADC12SHT0_6                                                    \
+     : TB_SHT_CYCLES(rate) == 96  ? ADC12SHT0_5                                                    \
+     : TB_SHT_CYCLES(rate) == 64  ? ADC12SHT0_4                                                    \
+     : TB_SHT_CYCLES(rate) == 32  ? ADC12SHT0_3                                                    \
+                                  : ADC12SHT0_2)
+#define TB_COLUMNS(mm_s) (((uint32_t)(mm_s) * 1000 + TFT_PIXEL_PITCH_UM / 2) / TFT_PIXEL_PITCH_UM)
+
+// One row per mode: sample rate and sweep in mm/s. Everything else is derived.
+#define TIMEBASE_MODE(rate, sweep_mm_s)                                                            \
+    {                                                                                              \
+        rate, TB_PERIOD(rate), TB_SHT(rate), TB_SHT_CYCLES(rate), TB_SEGMENT_LEN(rate),            \
+            TB_SEGMENT_COUNT(rate), sweep_mm_s, TB_COLUMNS(sweep_mm_s), TB_LINK_BYTES(rate)        \
+    }
+
+// 250 and 500 Hz for monitoring at the usual 25 mm/s; 1000 and 2000 Hz resolve pacemaker spikes
+// and fine QRS detail, shown at 50 mm/s
+static const Timebase timebase_modes[] = {
+    TIMEBASE_MODE(250, 25),
+    TIMEBASE_MODE(500, 25),
+    TIMEBASE_MODE(1000, 50),
+    TIMEBASE_MODE(2000, 50),
+};
+
+#define TIMEBASE_MODE_COUNT (sizeof(timebase_modes) / sizeof(timebase_modes[0]))
+
+// --- Public Functions ---
+
+const Timebase* timebase_find(uint16_t sample_rate_hz) {
+    uint16_t i;
+
+    for (i = 0; i < TIMEBASE_MODE_COUNT; i++) {
+        if (timebase_modes[i].sample_rate_hz == sample_rate_hz) {
+            return &timebase_modes[i];
+        }
+    }
+    return 0;
+}
+
+TimebaseStatus timebase_check(const Timebase* tb) {
+    // The timer period is in SMCLK and the S/H time in ADC12CLK, both SMCLK here
+    uint32_t busy = (uint32_t)tb->adc_sht_cycles + TIMEBASE_CONVERSION_CYCLES;
+    uint32_t sh_ns = (uint32_t)tb->adc_sht_cycles * 1000000UL / (TIMEBASE_ADC_CLK_HZ / 1000);
+
+    // The period must be exact and fit TA0CCR0; a conversion must be done well before the next
+    // trigger, half a period here
+    if (sh_ns < TIMEBASE_MIN_SH_NS || busy * 2 > tb->timer_period
+        || (uint32_t)tb->timer_period * tb->sample_rate_hz * ACQ_OVERSAMPLE * ACQ_CHANNELS
+               != SMCLK_FREQ)
+    {
+        return TIMEBASE_ERR_ADC;
+    }
+    if (tb->segment_len == 0 || tb->segment_count < ACQ_MIN_SEGMENTS
+        || (uint32_t)tb->segment_len * tb->segment_count > ACQ_BUFFER_SAMPLES)
+    {
+        return TIMEBASE_ERR_CAPTURE;
+    }
+    return TIMEBASE_OK;
+}
@@ -0,0 +1,104 @@
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include "clock.h"
+#include <stdint.h>
+
+// Sample rate modes and every setting that follows from the rate, in one table
+// so the timer, ADC, capture geometry, display and link budget can't disagree.
+// Per mode:
+//   timer period   Timer_A0 counts (SMCLK) per conversion, i.e. per sample divided
+//                  by ACQ_OVERSAMPLE and ACQ_CHANNELS (adc_acq.h); TA0.1 triggers
+//                  the ADC12 S/H
+//   S/H time       the longest ADC12SHT0 setting within 1/16 of the timer period,
+//                  capped at 256 ADC12CLK (64 us): plenty for the front end and
+//                  nothing gained beyond it. Never below 16 cycles (4 us), the
+//                  shortest that meets TIMEBASE_MIN_SH_NS
+//   segment        TIMEBASE_SEGMENT_MS of samples per DMA segment and UART frame
+//                  (at most ACQ_MAX_SEGMENT_LEN), and enough segments for
+//                  TIMEBASE_BUFFER_MS of backlog within ACQ_BUFFER_SAMPLES
+//   sweep          TFT paper speed in mm/s, converted to pixel columns per second
+//                  with TFT_PIXEL_PITCH_UM
+//   link           bytes per second of raw sample frames of all channels including
+//                  framing; Rice frames are never longer, so this is what the UART
+//                  must carry
+//
+// Limits by channel count (ACQ_CHANNEL_MASK): the slowest UART rate that carries
+// each mode within LINK_BUDGET_PERCENT, and the capture RAM.
+//   channels   250 Hz   500 Hz   1000 Hz   2000 Hz   capture RAM
+//   1          19200    19200    38400     57600     1280 bytes
+//   2          19200    38400    57600     115200    2560 bytes
+//   4          38400    57600    115200    230400    5120 bytes
+// The ADC is not the limit: 4 channels at 2 kHz is one conversion per 125 us,
+// of which S/H and conversion take 7 us. Modes the link can't carry are refused
+// with TIMEBASE_ERR_LINK when the host asks for them.
+//
+// The default mode is chosen at compile time; the host can switch modes at run
+// time with LINK_CMD_SET_RATE (uart_link.h). timebase_check() rejects a mode
+// whose ADC timing or capture geometry does not work with the clocks and
+// buffers built in; whether its link rate fits is up to link_check_budget().
+
+// ADC12CLK is SMCLK undivided (ADC12SSEL_3)
+#define TIMEBASE_ADC_CLK_HZ SMCLK_FREQ
+
+// Horizontal pixel pitch of the TFT: a 3.2" 320x240 panel is 65 mm wide
+#ifndef TFT_PIXEL_PITCH_UM
+    #define TFT_PIXEL_PITCH_UM 203
+#endif
+
+// Shortest S/H time the front end settles in: (Rs 10k + Ri 1.8k) * Ci 25 pF * ln(2^13)
+// plus 800 ns, from the ADC12_A sample timing formula in the family user's guide
+#define TIMEBASE_MIN_SH_NS 3500
+
+// ADC12CLK cycles of a 12-bit conversion after the S/H time
+#define TIMEBASE_CONVERSION_CYCLES 13
+
+// Longer segments for Rice frames (main.c, ECG_COMPRESS unless ECG_RAW): the frame header, CRC and
+// Rice block header are paid once per segment, and at 20 samples they ate most of the gain.
+// util/ecg_rice_bench.py on the built-in heartbeat at 500 Hz, bytes on the wire raw / Rice:
+//   40 ms 2.07x, 80 ms 2.83x, 100 ms 3.09x, 128 ms 3.35x
+#ifndef TIMEBASE_SEGMENT_MS
+    #ifdef ECG_RAW
+        #define TIMEBASE_SEGMENT_MS 40 // 20 samples at 500 Hz; latency.h measures what it costs
+    #else
+        #define TIMEBASE_SEGMENT_MS 80 // 40 samples at 500 Hz
+    #endif
+#endif
+#ifndef TIMEBASE_BUFFER_MS
+    #define TIMEBASE_BUFFER_MS 640 // Capture backlog the consumers may fall behind by
+#endif
+
+// Why a mode was rejected
+typedef enum {
+    TIMEBASE_OK = 0,
+    TIMEBASE_ERR_RATE, // No such mode, or the filter or QRS detector has no settings for it
+    TIMEBASE_ERR_ADC, // S/H too short for the front end, or S/H + conversion overruns the period
+    TIMEBASE_ERR_CAPTURE, // Segment geometry doesn't fit the capture buffer
+    TIMEBASE_ERR_LINK, // The negotiated UART rate can't carry the stream
+} TimebaseStatus;
+
+typedef struct {
+    uint16_t sample_rate_hz;
+    uint16_t timer_period; // SMCLK cycles per conversion; TA0CCR0 = timer_period - 1
+    uint16_t adc_sht; // ADC12SHT0_x bits for ADC12CTL0
+    uint16_t adc_sht_cycles; // ADC12CLK cycles of that S/H time
+    uint16_t segment_len; // Samples per DMA segment and per sample frame
+    uint16_t segment_count;
+    uint16_t sweep_mm_s; // TFT paper speed
+    uint16_t sweep_columns_s; // The same in pixel columns per second
+    uint16_t link_bytes_s; // Raw sample frames, header and CRC included
+} Timebase;
+
+/**
+ * @brief Looks up the mode for a sample rate.
+ * @return The mode, or 0 if there is none for this rate.
+ */
+const Timebase* timebase_find(uint16_t sample_rate_hz);
+
+/**
+ * @brief Checks a mode against the clocks and the capture buffer.
+ * @return TIMEBASE_OK, TIMEBASE_ERR_ADC or TIMEBASE_ERR_CAPTURE.
+ */
+TimebaseStatus timebase_check(const Timebase* tb);
+
+#endif /* TIMEBASE_H_ */
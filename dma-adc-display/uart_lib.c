@@ -1,5 +1,7 @@
 #include "uart_lib.h"
-#include <msp430.h>
+#include "hal.h"
+#include "power.h"
+#include "prof.h"
 
 // Buffer size check - ensures it's a power of 2 for efficient modulo
 #if (UART_BUFFER_SIZE & (UART_BUFFER_SIZE - 1)) != 0
@@ -19,31 +21,72 @@ typedef struct {
 static RingBuffer rx_buffer;
 static RingBuffer tx_buffer;
 
-// --- Function Implementations ---
+// DMA frame queue. Frames are popped by uart_dma_isr() in submission order.
+static UartTxFrame* volatile tx_frames[UART_TX_QUEUE_LEN];
+static volatile uint16_t tx_frames_head; // Next free slot
+static volatile uint16_t tx_frames_tail; // Frame currently being sent
+static volatile uint16_t tx_frames_count;
+static volatile uint8_t tx_chunk_idx; // Chunk of the tail frame currently being sent
+static volatile uint8_t tx_dma_active; // DMA owns UCA1TXBUF
 
-void uart_init(UartBaudRate baud_rate) {
-    // Initialize buffer pointers
-    rx_buffer.head = 0;
-    rx_buffer.tail = 0;
-    tx_buffer.head = 0;
-    tx_buffer.tail = 0;
+// --- Private Functions ---
 
-    // Configure P8.2 (RXD) and P8.3 (TXD) for USCI_A1 functionality
-    P3DIR |= BIT4 | BIT5;
-    P4DIR |= BIT4 | BIT5;
-    P4OUT |= BIT4;
-    P4OUT &= ~BIT5;
-    P3OUT |= BIT5;
-    P3OUT &= ~BIT4;
-    P8SEL |= BIT2 | BIT3;
+// Loads the current chunk of the tail frame into DMA channel 2 and starts it.
+// Empty chunks are skipped; returns 0 if the frame has no chunk left.
+static int uart_dma_start_chunk(void) {
+    UartTxFrame* frame = tx_frames[tx_frames_tail];
 
-    // Place the USCI in reset mode for configuration [cite: 14]
-    UCA1CTL1 |= UCSWRST;
+    while (tx_chunk_idx < frame->num_chunks && frame->chunks[tx_chunk_idx].len == 0) {
+        tx_chunk_idx++;
+    }
+    if (tx_chunk_idx >= frame->num_chunks) {
+        return 0;
+    }
 
-    // Configure the clock source. SMCLK is generally preferred over ACLK
-    // for higher baud rates and flexibility. [cite: 263]
-    UCA1CTL1 |= UCSSEL_2; // Select SMCLK
+    // UCA1TXIFG is an edge trigger for the DMA. If TXBUF is already empty no edge will come,
+    // so one is generated below. Otherwise the byte still in TXBUF raises the edge when it moves
+    // to the shift register, a full character time after the previous chunk ended.
+    uint8_t tx_empty = UCA1IFG & UCTXIFG;
+
+    DMA2CTL &= ~DMAEN;
+    __data20_write_long((unsigned long)&DMA2SA, (unsigned long)frame->chunks[tx_chunk_idx].data);
+    __data20_write_long((unsigned long)&DMA2DA, (unsigned long)&UCA1TXBUF);
+    DMA2SZ = frame->chunks[tx_chunk_idx].len;
+    DMA2CTL = DMADT_0 | DMASRCINCR_3 | DMADSTINCR_0 | DMASRCBYTE | DMADSTBYTE | DMAIE | DMAEN;
+
+    if (tx_empty) {
+        UCA1IFG &= ~UCTXIFG;
+        UCA1IFG |= UCTXIFG;
+    }
+    return 1;
+}
+
+// Starts the next queued frame if the transmitter is free. Must run with interrupts disabled.
+static void uart_dma_kick(void) {
+    while (!tx_dma_active && tx_frames_count > 0) {
+        if (UCA1IE & UCTXIE) {
+            return; // The ring buffer owns the transmitter; its ISR kicks us when it drains
+        }
+        tx_chunk_idx = 0;
+        if (uart_dma_start_chunk()) {
+            tx_dma_active = 1;
+        } else {
+            // Frame without payload: complete it immediately
+            UartTxFrame* frame = tx_frames[tx_frames_tail];
+            tx_frames_tail = (tx_frames_tail + 1) % UART_TX_QUEUE_LEN;
+            tx_frames_count--;
+            if (frame->on_done) {
+                frame->on_done(frame);
+            }
+        }
+    }
+}
+
+static const uint32_t baud_values[BAUD_COUNT] = { 9600,   19200,  38400, 57600,
+                                                   115200, 230400, 460800 };
 
+// Writes UCA1BRW/UCA1MCTL for the rate. The USCI must be in reset.
+static void uart_set_divider(UartBaudRate baud_rate) {
     // Configure baud rate settings based on a 4MHz SMCLK
     // Values are from the device datasheet, Table 36-4 [cite: 211]
     switch (baud_rate) {
@@ -72,7 +115,54 @@ void uart_init(UartBaudRate baud_rate) {
             UCA1BR1 = 0;
             UCA1MCTL = UCBRS_6 | UCBRF_0;
             break;
+        default: {
+            // Low-frequency mode: N = clk / baud, UCBRx = INT(N), UCBRSx = round((N - INT(N)) * 8)
+            uint32_t baud = baud_values[baud_rate];
+            uint16_t br = UART_CLK_FREQ / baud;
+            uint16_t brs = ((UART_CLK_FREQ % baud) * 8 + baud / 2) / baud;
+            if (brs > 7) {
+                brs = 7;
+            }
+            UCA1BRW = br;
+            UCA1MCTL = (brs << 1) | UCBRF_0;
+            break;
+        }
     }
+}
+
+// --- Function Implementations ---
+
+void uart_init(UartBaudRate baud_rate) {
+    // Initialize buffer pointers
+    rx_buffer.head = 0;
+    rx_buffer.tail = 0;
+    tx_buffer.head = 0;
+    tx_buffer.tail = 0;
+    tx_frames_head = 0;
+    tx_frames_tail = 0;
+    tx_frames_count = 0;
+    tx_dma_active = 0;
+
+    // DMA channel 2 is triggered by UCA1TXIFG for frame transmission
+    DMACTL1 = (DMACTL1 & ~DMA2TSEL_31) | DMA2TSEL_21;
+
+    // Configure P8.2 (RXD) and P8.3 (TXD) for USCI_A1 functionality
+    P3DIR |= BIT4 | BIT5;
+    P4DIR |= BIT4 | BIT5;
+    P4OUT |= BIT4;
+    P4OUT &= ~BIT5;
+    P3OUT |= BIT5;
+    P3OUT &= ~BIT4;
+    P8SEL |= BIT2 | BIT3;
+
+    // Place the USCI in reset mode for configuration [cite: 14]
+    UCA1CTL1 |= UCSWRST;
+
+    // Configure the clock source. SMCLK is generally preferred over ACLK
+    // for higher baud rates and flexibility. [cite: 263]
+    UCA1CTL1 |= UCSSEL_2; // Select SMCLK
+
+    uart_set_divider(baud_rate);
 
     // Release the USCI for operation [cite: 13]
     UCA1CTL1 &= ~UCSWRST;
@@ -82,6 +172,28 @@ void uart_init(UartBaudRate baud_rate) {
     UCA1IE |= UCRXIE;
 }
 
+void uart_set_baud_rate(UartBaudRate baud_rate) {
+    UCA1CTL1 |= UCSWRST;
+    uart_set_divider(baud_rate);
+    UCA1CTL1 &= ~UCSWRST;
+    // UCSWRST clears UCA1IE; restore RX and hand pending TX data back to the ISR
+    UCA1IE |= UCRXIE;
+    if (tx_buffer.head != tx_buffer.tail && !tx_dma_active) {
+        UCA1IE |= UCTXIE;
+    }
+}
+
+uint32_t uart_baud_value(UartBaudRate baud_rate) {
+    return baud_values[baud_rate];
+}
+
+void uart_wait_tx_idle(void) {
+    while (tx_buffer.head != tx_buffer.tail || tx_frames_count > 0)
+        HAL_IDLE();
+    while (UCA1STAT & UCBUSY)
+        ;
+}
+
 int uart_write_byte(uint8_t byte) {
     // Calculate next head index
     uint16_t next_head = (tx_buffer.head + 1) & (UART_BUFFER_SIZE - 1);
@@ -95,8 +207,11 @@ int uart_write_byte(uint8_t byte) {
     tx_buffer.buffer[tx_buffer.head] = byte;
     tx_buffer.head = next_head;
 
-    // Enable TX interrupt to start/continue transmission
-    UCA1IE |= UCTXIE;
+    // Enable TX interrupt to start/continue transmission, unless DMA frames own
+    // the transmitter; uart_dma_isr() hands it back to the ring buffer when done.
+    if (!tx_dma_active) {
+        UCA1IE |= UCTXIE;
+    }
 
     return 1; // Success
 }
@@ -119,6 +234,72 @@ uint16_t uart_write_uint16_array(const uint16_t* buffer, uint16_t num_samples) {
     return uart_write_buffer((const uint8_t*)buffer, num_samples * 2);
 }
 
+int uart_submit_frame(UartTxFrame* frame) {
+    __disable_interrupt();
+    if (tx_frames_count >= UART_TX_QUEUE_LEN) {
+        __enable_interrupt();
+        return 0; // Failure, queue is full
+    }
+    tx_frames[tx_frames_head] = frame;
+    tx_frames_head = (tx_frames_head + 1) % UART_TX_QUEUE_LEN;
+    tx_frames_count++;
+    uart_dma_kick();
+    __enable_interrupt();
+    return 1;
+}
+
+void uart_move_chunk(UartTxFrame* frame, uint8_t chunk, const uint8_t* data) {
+    uint16_t left;
+
+    frame->chunks[chunk].data = data;
+    if (!tx_dma_active || tx_frames[tx_frames_tail] != frame || tx_chunk_idx != chunk) {
+        return; // Not started yet, or already past this chunk: the new pointer is enough
+    }
+    DMA2CTL &= ~DMAEN;
+    if (DMA2CTL & DMAIFG) {
+        return; // The chunk ended meanwhile; uart_dma_isr() moves on to the next one
+    }
+    left = DMA2SZ; // Counts down per byte
+    __data20_write_long((unsigned long)&DMA2SA,
+                        (unsigned long)(data + frame->chunks[chunk].len - left));
+    DMA2SZ = left;
+    DMA2CTL |= DMAEN;
+    // A TXIFG edge while the channel was off is lost: TXIFG still set now means nobody took it
+    if (UCA1IFG & UCTXIFG) {
+        UCA1IFG &= ~UCTXIFG;
+        UCA1IFG |= UCTXIFG;
+    }
+}
+
+uint16_t uart_frames_pending(void) {
+    return tx_frames_count;
+}
+
+int uart_dma_isr(void) {
+    UartTxFrame* frame = tx_frames[tx_frames_tail];
+
+    tx_chunk_idx++;
+    if (uart_dma_start_chunk()) {
+        return 0; // Next chunk of the same frame is on its way
+    }
+
+    // Frame complete: hand it back to its owner
+    tx_frames_tail = (tx_frames_tail + 1) % UART_TX_QUEUE_LEN;
+    tx_frames_count--;
+    tx_dma_active = 0;
+    if (frame->on_done) {
+        frame->on_done(frame);
+    }
+
+    if (tx_buffer.head != tx_buffer.tail) {
+        // Bytes were written to the ring meanwhile; let the TX ISR send them first
+        UCA1IE |= UCTXIE;
+    } else {
+        uart_dma_kick();
+    }
+    return 1;
+}
+
 int uart_read_byte(uint8_t* byte) {
     // Check if there is data in the buffer
     if (rx_buffer.head == rx_buffer.tail) {
@@ -151,6 +332,8 @@ void uart_flush_rx(void) {
 
 #pragma vector = USCI_A1_VECTOR
 __interrupt void USCI_A1_ISR(void) {
+    power_isr_enter();
+    PROF_BEGIN(PROF_UART_ISR);
     // Using the recommended switch statement for vector generator [cite: 239, 244]
     switch (__even_in_range(UCA1IV, 4)) {
         case 0: // Vector 0: No interrupt
@@ -170,6 +353,7 @@ __interrupt void USCI_A1_ISR(void) {
                 // Buffer is full, discard the received byte to prevent overflow
                 (void)UCA1RXBUF;
             }
+            POWER_WAKE(POWER_EVT_LINK_RX);
             break;
         }
 
@@ -186,10 +370,14 @@ __interrupt void USCI_A1_ISR(void) {
                 // This is crucial to prevent the ISR from firing continuously
                 UCA1IE &= ~UCTXIE;
                 UCA1IFG |= UCTXIFG;
+                // Hand the transmitter over to any queued DMA frames
+                uart_dma_kick();
             }
             break;
         }
         default:
             break;
     }
+    PROF_END(PROF_UART_ISR);
+    power_isr_exit();
 }
@@ -1,16 +1,50 @@
 #ifndef UART_LIB_H_
 #define UART_LIB_H_
 
+#include "clock.h"
 #include <stdint.h>
 
 // --- Configuration ---
 // Define the size of the circular buffers (must be a power of 2 for efficiency)
 #define UART_BUFFER_SIZE 256
 
+// Maximum number of scatter chunks in one DMA frame (header, payload, trailer)
+#define UART_TX_MAX_CHUNKS 3
+
+// Number of frames that can be queued for DMA transmission at once
+#define UART_TX_QUEUE_LEN 4
+
+// Clock feeding USCI_A1 (SMCLK = XT2), used to compute dividers for rates not in the fixed table
+#define UART_CLK_FREQ SMCLK_FREQ
+
 // --- Public Types ---
-// Enum for common baud rates assuming a 1MHz SMCLK.
+// Enum for common baud rates assuming a 4MHz SMCLK.
 // These values are derived from the USCI documentation (Table 36-4)[cite: 211].
-typedef enum { BAUD_9600, BAUD_19200, BAUD_38400, BAUD_57600, BAUD_115200 } UartBaudRate;
+// Rates above 115200 have their dividers computed from UART_CLK_FREQ.
+typedef enum {
+    BAUD_9600,
+    BAUD_19200,
+    BAUD_38400,
+    BAUD_57600,
+    BAUD_115200,
+    BAUD_230400,
+    BAUD_460800,
+    BAUD_COUNT
+} UartBaudRate;
+
+// One contiguous piece of a frame. The memory must stay valid until the frame completes.
+typedef struct {
+    const uint8_t* data;
+    uint16_t len;
+} UartTxChunk;
+
+// A frame described as a scatter list, sent by DMA channel 2 without copying.
+// The caller owns the frame and every buffer it points to again once on_done has run.
+typedef struct UartTxFrame {
+    UartTxChunk chunks[UART_TX_MAX_CHUNKS];
+    uint8_t num_chunks;
+    void (*on_done)(struct UartTxFrame* frame); // Called from the DMA ISR, may be 0
+} UartTxFrame;
 
 // --- Public Function Prototypes ---
 
@@ -24,6 +58,25 @@ typedef enum { BAUD_9600, BAUD_19200, BAUD_38400, BAUD_57600, BAUD_115200 } Uart
  */
 void uart_init(UartBaudRate baud_rate);
 
+/**
+ * @brief Changes the baud rate without touching the buffers.
+ *
+ * Anything still being transmitted is cut off; call uart_wait_tx_idle() first.
+ * @param baud_rate The new baud rate.
+ */
+void uart_set_baud_rate(UartBaudRate baud_rate);
+
+/**
+ * @brief Returns the rate in bits per second for a UartBaudRate value.
+ */
+uint32_t uart_baud_value(UartBaudRate baud_rate);
+
+/**
+ * @brief Blocks until the ring buffer and the DMA frame queue are empty and the
+ * last stop bit has left the shift register.
+ */
+void uart_wait_tx_idle(void);
+
 /**
  * @brief Writes a single byte to the UART transmit buffer.
  *
@@ -60,6 +113,43 @@ uint16_t uart_write_buffer(const uint8_t* buffer, uint16_t len);
  */
 uint16_t uart_write_uint16_array(const uint16_t* buffer, uint16_t num_samples);
 
+/**
+ * @brief Queues a scatter-list frame for DMA transmission.
+ *
+ * The chunks are sent back to back by DMA channel 2, triggered by UCA1TXIFG,
+ * with no per-byte interrupt and no copy into the TX ring buffer. Bytes already
+ * in the ring buffer are sent first; bytes written to the ring while DMA frames
+ * are pending go out after them.
+ *
+ * @param frame The frame to send. It must not be modified until on_done is called.
+ * @return 1 if the frame was queued, 0 if the DMA queue is full.
+ */
+int uart_submit_frame(UartTxFrame* frame);
+
+/**
+ * @brief Points a chunk of a queued frame at a copy of its data, so the original memory can be
+ *        reused before the frame completes.
+ *
+ * If the chunk is being sent, DMA channel 2 carries on from the same offset in the copy; the
+ * bytes on the wire are unchanged. Call with interrupts disabled, e.g. from DMA_ISR.
+ *
+ * @param frame A frame passed to uart_submit_frame() whose on_done has not run yet.
+ * @param chunk Index of the chunk to move.
+ * @param data The copy, same length as the chunk.
+ */
+void uart_move_chunk(UartTxFrame* frame, uint8_t chunk, const uint8_t* data);
+
+/**
+ * @brief Returns the number of frames queued or in flight on the DMA path.
+ */
+uint16_t uart_frames_pending(void);
+
+/**
+ * @brief DMA channel 2 completion handler, called from DMA_ISR on DMA2IFG.
+ * @return 1 if a frame was completed and handed back with on_done, 0 after an intermediate chunk.
+ */
+int uart_dma_isr(void);
+
 /**
  * @brief Reads a single byte from the UART receive buffer.
  *
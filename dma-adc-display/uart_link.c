@@ -0,0 +1,142 @@
+#include "uart_link.h"
+#include "clock.h"
+#include "hal.h"
+
+// --- Private Variables ---
+static uint8_t link_rx_frame[LINK_CTRL_FRAME_LEN]; // Control frame being received
+static uint8_t link_rx_fill = 0;
+
+// --- Private Functions ---
+
+// Adds one received byte to the control frame being collected.
+// Returns 1 and the command and argument when a frame with a good checksum completes.
+static int link_rx_byte(uint8_t byte, uint8_t* cmd, uint32_t* arg) {
+    uint8_t checksum;
+
+    // Hunt for the two header bytes, then collect the rest of the frame
+    if ((link_rx_fill == 0 && byte != 0xAA) || (link_rx_fill == 1 && byte != LINK_CTRL_HEADER2)) {
+        link_rx_fill = (byte == 0xAA) ? 1 : 0;
+        return 0;
+    }
+    link_rx_frame[link_rx_fill++] = byte;
+    if (link_rx_fill < LINK_CTRL_FRAME_LEN) {
+        return 0;
+    }
+    link_rx_fill = 0;
+
+    checksum = link_rx_frame[2] + link_rx_frame[3] + link_rx_frame[4] + link_rx_frame[5]
+        + link_rx_frame[6];
+    if (checksum != link_rx_frame[7]) {
+        return 0;
+    }
+    *cmd = link_rx_frame[2];
+    *arg = (uint32_t)link_rx_frame[3] | ((uint32_t)link_rx_frame[4] << 8)
+        | ((uint32_t)link_rx_frame[5] << 16) | ((uint32_t)link_rx_frame[6] << 24);
+    return 1;
+}
+
+// Waits up to timeout_ms for a control frame with the given command.
+// Other bytes are discarded. Returns 1 and stores the argument on success.
+static int link_wait_ctrl(uint8_t cmd, uint32_t* arg, uint16_t timeout_ms) {
+    uint8_t byte;
+    uint8_t rx_cmd;
+    uint32_t rx_arg;
+
+    link_rx_fill = 0;
+    while (timeout_ms > 0) {
+        if (!uart_read_byte(&byte)) {
+            __delay_cycles(MCLK_FREQ / 1000);
+            timeout_ms--;
+            continue;
+        }
+        if (link_rx_byte(byte, &rx_cmd, &rx_arg) && rx_cmd == cmd) {
+            *arg = rx_arg;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// --- Function Implementations ---
+
+UartBaudRate link_negotiate(UartBaudRate start_rate, UartBaudRate max_rate) {
+    UartBaudRate current = start_rate;
+    uint32_t arg;
+
+    if (max_rate >= BAUD_COUNT) {
+        max_rate = (UartBaudRate)(BAUD_COUNT - 1);
+    }
+
+    while (current < max_rate) {
+        UartBaudRate next = (UartBaudRate)(current + 1);
+        uint32_t next_baud = uart_baud_value(next);
+
+        // 1. Offer the next rate at the current one
+        uart_flush_rx();
+        link_send_ctrl(LINK_CMD_BAUD_OFFER, next_baud);
+        if (!link_wait_ctrl(LINK_CMD_BAUD_ACK, &arg, LINK_REPLY_TIMEOUT_MS) || arg != next_baud) {
+            break; // No receiver, or it does not support this rate
+        }
+
+        // 2. Both sides switch; give the host a moment to reopen its port
+        uart_wait_tx_idle();
+        uart_set_baud_rate(next);
+        __delay_cycles(MCLK_FREQ / 1000 * 20);
+        uart_flush_rx();
+
+        // 3. Verify the new rate in both directions
+        link_send_ctrl(LINK_CMD_PROBE, LINK_PROBE_PATTERN);
+        if (!link_wait_ctrl(LINK_CMD_PROBE_ECHO, &arg, LINK_REPLY_TIMEOUT_MS)
+            || arg != LINK_PROBE_PATTERN)
+        {
+            // The host falls back on its own when no CONFIRM arrives
+            uart_wait_tx_idle();
+            uart_set_baud_rate(current);
+            break;
+        }
+        link_send_ctrl(LINK_CMD_CONFIRM, next_baud);
+        uart_wait_tx_idle();
+        current = next;
+    }
+
+    uart_flush_rx();
+    return current;
+}
+
+int link_check_budget(UartBaudRate baud_rate, uint32_t required) {
+    // 10 bits per byte on the wire (start + 8 data + stop)
+    uint32_t capacity = uart_baud_value(baud_rate) / 10;
+    int fits = required * 100 <= capacity * LINK_BUDGET_PERCENT;
+
+    link_send_ctrl(LINK_CMD_LINK_REPORT,
+                   (required > 0xFFFF ? 0xFFFF : required)
+                       | ((uint32_t)(capacity > 0xFFFF ? 0xFFFF : capacity) << 16));
+    return fits;
+}
+
+void link_send_ctrl(uint8_t cmd, uint32_t arg) {
+    uint8_t frame[LINK_CTRL_FRAME_LEN];
+    uint8_t checksum = cmd;
+    uint8_t i;
+
+    frame[0] = 0xAA;
+    frame[1] = LINK_CTRL_HEADER2;
+    frame[2] = cmd;
+    for (i = 0; i < 4; i++) {
+        frame[3 + i] = (arg >> (8 * i)) & 0xFF;
+        checksum += frame[3 + i];
+    }
+    frame[7] = checksum;
+    uart_write_buffer(frame, sizeof(frame));
+}
+
+int link_poll_ctrl(uint8_t* cmd, uint32_t* arg) {
+    uint8_t byte;
+
+    while (uart_read_byte(&byte)) {
+        if (link_rx_byte(byte, cmd, arg)) {
+            return 1;
+        }
+    }
+    return 0;
+}
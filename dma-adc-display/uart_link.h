@@ -0,0 +1,84 @@
+#ifndef UART_LINK_H_
+#define UART_LINK_H_
+
+#include "uart_lib.h"
+#include <stdint.h>
+
+// --- Control frames ---
+// Control frames share the 0xAA sync byte with ECG frames but use 0x5A as the
+// second header byte, so an old receiver simply skips them:
+//   0xAA 0x5A <cmd> <arg, 4 bytes little-endian> <8-bit sum of cmd and arg>
+#define LINK_CTRL_HEADER2 0x5A
+#define LINK_CTRL_FRAME_LEN 8
+
+#define LINK_CMD_BAUD_OFFER 0x01 // device -> host, arg = proposed baud (bps), sent at the old rate
+#define LINK_CMD_BAUD_ACK 0x02 // host -> device, arg = accepted baud, host switches after sending
+#define LINK_CMD_PROBE 0x03 // device -> host at the new rate, arg = LINK_PROBE_PATTERN
+#define LINK_CMD_PROBE_ECHO 0x04 // host -> device, echoes the probe argument
+#define LINK_CMD_CONFIRM 0x05 // device -> host, the new rate is committed
+#define LINK_CMD_LINK_REPORT 0x06 // device -> host, arg = required B/s | (capacity B/s << 16)
+#define LINK_CMD_SET_RATE 0x07 // host -> device at any time, arg = sample rate in Hz
+#define LINK_CMD_RATE_REPORT 0x08 // device -> host, arg = sample rate in effect | (status << 16)
+                                  // | (sample bits beyond 12 << 24)
+#define LINK_CMD_POWER_REPORT 0x09 // device -> host every POWER_REPORT_S (power.h),
+                                   // arg = CPU active in 0.01% | (wake-ups per second << 16)
+
+#define LINK_PROBE_PATTERN 0x33CC55AAUL
+
+// How long the device waits for each host reply
+#define LINK_REPLY_TIMEOUT_MS 200
+
+// Status in LINK_CMD_RATE_REPORT: 0 the rate is in effect (also sent unasked at start-up and
+// before the first frame of a new rate); otherwise a TimebaseStatus (timebase.h) saying why the
+// requested rate was refused, and the old rate stays in effect. The top byte gives the width of
+// the samples in the frames that follow, as bits beyond 12 (ACQ_OVS_BITS, adc_acq.h); firmware
+// from before it was added sends 0 there, which means 12 bits as well.
+#define LINK_RATE_OK 0
+#define LINK_RATE_STATUS_SHIFT 16
+#define LINK_RATE_BITS_SHIFT 24
+
+// Share of the raw link capacity the stream may use before it is reported as not fitting
+#define LINK_BUDGET_PERCENT 90
+
+// --- Public Function Prototypes ---
+
+/**
+ * @brief Steps the UART up through the UartBaudRate table, one rate at a time.
+ *
+ * For each step the device offers the next rate at the current rate and waits
+ * for the host to acknowledge. Both sides then switch, and the device sends a
+ * probe frame that the host has to echo. If the echo is missing or wrong, the
+ * device drops back to the last rate that worked and stops. If the host does
+ * not answer the offer at all (e.g. no receiver running), the current rate is kept.
+ * Must be called with interrupts enabled and before acquisition starts.
+ *
+ * @param start_rate The rate uart_init() was called with.
+ * @param max_rate The highest rate to try.
+ * @return The negotiated rate.
+ */
+UartBaudRate link_negotiate(UartBaudRate start_rate, UartBaudRate max_rate);
+
+/**
+ * @brief Checks whether an ECG stream fits the link and reports the result to the host.
+ *
+ * @param baud_rate The negotiated rate.
+ * @param required_bytes_s Bytes per second the stream needs, framing included.
+ * @return 1 if the stream fits within LINK_BUDGET_PERCENT of the link, 0 otherwise.
+ */
+int link_check_budget(UartBaudRate baud_rate, uint32_t required_bytes_s);
+
+/**
+ * @brief Sends a control frame through the TX ring buffer, behind any queued DMA frames.
+ */
+void link_send_ctrl(uint8_t cmd, uint32_t arg);
+
+/**
+ * @brief Takes the next complete control frame from the host without waiting.
+ *
+ * Reads whatever the RX buffer holds; a partial frame is kept for the next call.
+ * Bytes that are not part of a valid control frame are discarded.
+ * @return 1 and the command and argument if a frame was complete, 0 otherwise.
+ */
+int link_poll_ctrl(uint8_t* cmd, uint32_t* arg);
+
+#endif /* UART_LINK_H_ */
@@ -0,0 +1,539 @@
+#include "ecg_hub.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static_assert(sizeof(HubRecordHeader) == 8, "HubRecordHeader layout");
+static_assert(sizeof(HubDeviceInfo) == 56, "HubDeviceInfo layout");
+static_assert(sizeof(HubSamples) == 24, "HubSamples layout");
+static_assert(sizeof(HubFrame) == 16, "HubFrame layout");
+static_assert(sizeof(HubCtrl) == 8, "HubCtrl layout");
+
+namespace ecg_hub {
+
+// --- Private Definitions ---
+namespace {
+
+// As SUPPORTED_BAUD_RATES in util/ecg_receiver.py
+const uint32_t BAUD_RATES[] = { 9600, 19200, 38400, 57600, 115200, 230400, 460800 };
+const size_t NUM_BAUD_RATES = sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]);
+
+const int WAIT_MS = 100; // Longest sleep of the workers and of run(), so stop() takes effect
+
+void log_device(const Device* d, const char* fmt, ...) {
+    char line[256];
+    int n = snprintf(line, sizeof(line), "%s: ", d->path.c_str());
+    va_list args;
+
+    va_start(args, fmt);
+    if (n > 0 && (size_t)n < sizeof(line)) {
+        vsnprintf(line + n, sizeof(line) - n, fmt, args);
+    }
+    va_end(args);
+    puts(line); // One call, so lines from different workers don't mix
+}
+
+void append_bytes(std::vector<uint8_t>* out, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    out->insert(out->end(), p, p + len);
+}
+
+// Appends a record header and its fixed-size body; the caller appends extra_len more bytes
+template <typename T>
+void append_record(std::vector<uint8_t>* out,
+                   uint8_t type,
+                   uint8_t device,
+                   const T& body,
+                   size_t extra_len) {
+    HubRecordHeader header = { type, device, 0, (uint32_t)(sizeof(T) + extra_len) };
+    append_bytes(out, &header, sizeof(header));
+    append_bytes(out, &body, sizeof(body));
+}
+
+bool is_supported_baud(uint32_t baud) {
+    for (uint32_t b : BAUD_RATES) {
+        if (b == baud) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool is_sample_frame(uint8_t type) {
+    return type == ECG_TYPE_SAMPLES || type == ECG_TYPE_SAMPLES_RICE
+           || type == ECG_TYPE_SAMPLES_PLANAR;
+}
+
+} // namespace
+
+// --- Function Implementations ---
+
+Device::Device(uint8_t index, const std::string& path) :
+    index(index), path(path), rx(HUB_RING_CAPACITY, HUB_EVENT_CAPACITY) {
+    info.sample_rate = HUB_DEFAULT_SAMPLE_RATE;
+    info.sample_bits = 12;
+}
+
+Hub::~Hub() {
+    stop();
+    for (std::thread& t : workers_) {
+        t.join();
+    }
+    for (Client* c : clients_) {
+        close(c->fd);
+        delete c;
+    }
+    for (Device* d : devices_) {
+        delete d;
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(socket_path_.c_str());
+    }
+    if (main_epoll_ >= 0) {
+        close(main_epoll_);
+    }
+    if (device_epoll_ >= 0) {
+        close(device_epoll_);
+    }
+}
+
+void Hub::add_device(const std::string& path) {
+    devices_.push_back(new Device((uint8_t)devices_.size(), path));
+}
+
+bool Hub::start(const char* socket_path, uint32_t baud, unsigned workers) {
+    struct sockaddr_un addr = {};
+    struct epoll_event ev = {};
+
+    start_baud_ = baud;
+    device_epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    main_epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    if (device_epoll_ < 0 || main_epoll_ < 0) {
+        return false;
+    }
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        return false;
+    }
+    unlink(socket_path); // Left by an earlier run
+    if (bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || listen(listen_fd_, 16) != 0)
+    {
+        int err = errno;
+        close(listen_fd_);
+        listen_fd_ = -1;
+        errno = err;
+        return false;
+    }
+    socket_path_ = socket_path;
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr; // The listening socket; viewers have their Client
+    epoll_ctl(main_epoll_, EPOLL_CTL_ADD, listen_fd_, &ev);
+
+    double now = ecg_rx::wall_time();
+    for (Device* d : devices_) {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        open_device(d, now);
+    }
+    for (unsigned i = 0; i < workers; i++) {
+        workers_.emplace_back(&Hub::worker, this);
+    }
+    return true;
+}
+
+void Hub::run() {
+    double last_status = 0;
+
+    while (!stopping_) {
+        struct epoll_event evs[16];
+        int n = epoll_wait(main_epoll_, evs, 16, WAIT_MS);
+
+        for (int i = 0; i < n; i++) {
+            Client* c = (Client*)evs[i].data.ptr;
+            bool gone = (evs[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+
+            if (!c) {
+                accept_client();
+                continue;
+            }
+            if (evs[i].events & EPOLLIN) {
+                // Viewers have nothing to say; reading tells when one has gone
+                uint8_t buf[256];
+                ssize_t r = recv(c->fd, buf, sizeof(buf), MSG_DONTWAIT);
+                gone |= r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR);
+            }
+            if (gone) {
+                drop_client(c);
+            } else if (evs[i].events & EPOLLOUT) {
+                std::lock_guard<std::mutex> lock(clients_mutex_);
+                flush_client(c);
+            }
+        }
+
+        double now = ecg_rx::wall_time();
+        bool status = now - last_status >= HUB_STATUS_INTERVAL_S;
+        for (Device* d : devices_) {
+            std::lock_guard<std::mutex> lock(d->mutex);
+            housekeeping(d, now);
+            if (status) {
+                append_device_info(d);
+            }
+            publish(d->out);
+            d->out.clear();
+        }
+        if (status) {
+            last_status = now;
+        }
+    }
+}
+
+size_t Hub::num_clients() {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    return clients_.size();
+}
+
+// --- Boards ---
+
+void Hub::worker() {
+    while (!stopping_) {
+        struct epoll_event ev;
+        if (epoll_wait(device_epoll_, &ev, 1, WAIT_MS) == 1) {
+            service((Device*)ev.data.ptr);
+        }
+    }
+}
+
+// Reads and decodes what a board has sent, publishes the records and rearms its descriptor
+void Hub::service(Device* d) {
+    std::lock_guard<std::mutex> lock(d->mutex);
+    EcgRxEvent ev;
+
+    if (d->info.state == HUB_DEVICE_CLOSED) { // Closed by housekeeping() meanwhile
+        return;
+    }
+    if (d->rx.pump(0) < 0) {
+        log_device(d, "read failed (%s), closed", strerror(errno));
+        close_device(d);
+    } else {
+        double now = ecg_rx::wall_time();
+        bool valid = false;
+        while (d->rx.poll_event(&ev)) {
+            valid = true;
+            if (ev.kind == ECG_RX_EVENT_CTRL) {
+                handle_ctrl(d, ev, now);
+            } else {
+                handle_frame(d, ev);
+            }
+        }
+        if (valid) {
+            d->last_valid = now;
+        }
+        if (valid && d->info.state == HUB_DEVICE_HUNTING) {
+            log_device(d, "receiving at %u baud", d->rx.port().baud());
+            d->info.state = HUB_DEVICE_STREAMING;
+            append_device_info(d);
+        }
+        struct epoll_event rearm = {};
+        rearm.events = EPOLLIN | EPOLLONESHOT;
+        rearm.data.ptr = d;
+        epoll_ctl(device_epoll_, EPOLL_CTL_MOD, d->rx.port().fd(), &rearm);
+    }
+    publish(d->out);
+    d->out.clear();
+}
+
+// The host side of the link negotiation in uart_link.h, driven by events instead of waits
+void Hub::handle_ctrl(Device* d, const EcgRxEvent& ev, double now) {
+    HubCtrl ctrl = {};
+
+    switch (ev.type) {
+        case ECG_RX_CMD_BAUD_OFFER:
+            if (d->info.state == HUB_DEVICE_NEGOTIATING) {
+                break;
+            }
+            if (!is_supported_baud(ev.arg)) {
+                log_device(d, "offered baud rate %u not supported, ignored", ev.arg);
+                break;
+            }
+            d->old_baud = d->rx.port().baud();
+            send_ctrl(d, ECG_RX_CMD_BAUD_ACK, ev.arg);
+            d->rx.port().set_baud(ev.arg); // After the ACK has gone out
+            d->rx.reset(); // The rest was sent at the old rate
+            d->new_baud = ev.arg;
+            d->deadline = now + HUB_LINK_TIMEOUT_S;
+            d->info.state = HUB_DEVICE_NEGOTIATING;
+            break;
+        case ECG_RX_CMD_PROBE:
+            if (d->info.state == HUB_DEVICE_NEGOTIATING) {
+                send_ctrl(d, ECG_RX_CMD_PROBE_ECHO, ev.arg);
+                d->deadline = now + HUB_LINK_TIMEOUT_S;
+            }
+            break;
+        case ECG_RX_CMD_CONFIRM:
+            if (d->info.state == HUB_DEVICE_NEGOTIATING && ev.arg == d->new_baud) {
+                log_device(d, "baud rate %u -> %u", d->old_baud, d->new_baud);
+                d->info.state = HUB_DEVICE_STREAMING;
+                append_device_info(d);
+            }
+            break;
+        case ECG_RX_CMD_RATE_REPORT:
+            if ((ev.arg >> 16 & 0xFF) == 0) { // The sample index starts again at 0
+                d->info.sample_rate = ev.arg & 0xFFFF;
+                d->info.sample_bits = (uint8_t)(12 + (ev.arg >> 24));
+                log_device(d, "sample rate %u Hz, %u-bit samples", d->info.sample_rate,
+                           d->info.sample_bits);
+                d->have_min = false;
+                d->info.epoch = 0;
+                append_device_info(d);
+            }
+            break;
+        default:
+            break;
+    }
+    ctrl.cmd = ev.type;
+    ctrl.arg = ev.arg;
+    append_record(&d->out, HUB_RECORD_CTRL, d->index, ctrl, 0);
+}
+
+void Hub::handle_frame(Device* d, const EcgRxEvent& ev) {
+    d->info.frames++;
+    if (d->expected_seq >= 0) {
+        d->info.lost_frames += (uint16_t)(ev.seq - d->expected_seq);
+    }
+    d->expected_seq = (uint16_t)(ev.seq + 1);
+
+    if (!is_sample_frame(ev.type)) {
+        HubFrame frame = { ev.type, ev.channel_mask, ev.seq, ev.sample_index, ev.arrival };
+        append_record(&d->out, HUB_RECORD_FRAME, d->index, frame, ev.payload_len);
+        append_bytes(&d->out, ev.payload, ev.payload_len);
+        return;
+    }
+    if (ev.num_samples == 0) { // Malformed; the receiver counts it
+        return;
+    }
+
+    // Host time of sample 0 if this frame had taken no time to arrive; the least-delayed frame
+    // of the recent windows gives the estimate
+    double rate = d->info.sample_rate;
+    double offset = ev.arrival - (ev.sample_index + ev.num_samples) / rate;
+    if (!d->have_min) {
+        d->have_min = true;
+        d->window_start = ev.arrival;
+        d->window_min = d->prev_min = offset;
+    } else if (ev.arrival - d->window_start > HUB_ALIGN_WINDOW_S) {
+        d->prev_min = d->window_min;
+        d->window_min = offset;
+        d->window_start = ev.arrival;
+    } else if (offset < d->window_min) {
+        d->window_min = offset;
+    }
+    d->info.epoch = d->window_min < d->prev_min ? d->window_min : d->prev_min;
+    d->info.channel_mask = ev.channel_mask;
+
+    HubSamples samples = { ev.seq,
+                           ev.channel_mask,
+                           ev.num_channels,
+                           ev.sample_index,
+                           ev.num_samples,
+                           d->info.sample_rate,
+                           d->info.epoch + ev.sample_index / rate };
+    size_t plane_bytes = (size_t)ev.num_samples * sizeof(uint16_t);
+    size_t start = d->out.size();
+    append_record(&d->out, HUB_RECORD_SAMPLES, d->index, samples, plane_bytes * ev.num_channels);
+    for (uint8_t ch = 0; ch < ev.num_channels; ch++) {
+        uint64_t cursor = ev.ring_pos;
+        size_t at = d->out.size();
+        d->out.resize(at + plane_bytes);
+        if (d->rx.ring().read(ch, &cursor, (uint16_t*)&d->out[at], ev.num_samples)
+            != ev.num_samples) { // Overwritten already, cannot happen with HUB_RING_CAPACITY
+            d->out.resize(start);
+            return;
+        }
+    }
+}
+
+void Hub::housekeeping(Device* d, double now) {
+    switch (d->info.state) {
+        case HUB_DEVICE_CLOSED:
+            if (now - d->last_open_try >= HUB_REOPEN_INTERVAL_S) {
+                open_device(d, now);
+            }
+            break;
+        case HUB_DEVICE_NEGOTIATING:
+            if (now > d->deadline) {
+                log_device(d, "baud rate %u failed, back to %u", d->new_baud, d->old_baud);
+                d->rx.port().set_baud(d->old_baud);
+                d->rx.reset();
+                d->info.state = HUB_DEVICE_STREAMING;
+                d->last_valid = now;
+                append_device_info(d);
+            }
+            break;
+        default:
+            if (now - d->last_valid > HUB_HUNT_TIMEOUT_S) {
+                // E.g. the board negotiated a higher rate before the hub started
+                size_t i = 0;
+                while (i < NUM_BAUD_RATES && BAUD_RATES[i] != d->rx.port().baud()) {
+                    i++;
+                }
+                d->rx.port().set_baud(BAUD_RATES[(i + 1) % NUM_BAUD_RATES]);
+                d->rx.reset();
+                d->info.state = HUB_DEVICE_HUNTING;
+                d->last_valid = now;
+                append_device_info(d);
+            }
+            break;
+    }
+}
+
+bool Hub::open_device(Device* d, double now) {
+    bool first = d->last_open_try == 0;
+    struct epoll_event ev = {};
+
+    d->last_open_try = now;
+    if (!d->rx.port().open(d->path.c_str(), start_baud_)) {
+        if (first) {
+            log_device(d, "cannot open (%s), retrying", strerror(errno));
+        }
+        return false;
+    }
+    d->rx.reset();
+    d->info.state = HUB_DEVICE_HUNTING;
+    d->last_valid = now;
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = d;
+    epoll_ctl(device_epoll_, EPOLL_CTL_ADD, d->rx.port().fd(), &ev);
+    if (!first) {
+        log_device(d, "reopened");
+    }
+    append_device_info(d);
+    return true;
+}
+
+void Hub::close_device(Device* d) {
+    epoll_ctl(device_epoll_, EPOLL_CTL_DEL, d->rx.port().fd(), nullptr);
+    d->rx.port().close();
+    d->info.state = HUB_DEVICE_CLOSED;
+    append_device_info(d);
+}
+
+void Hub::send_ctrl(Device* d, uint8_t cmd, uint32_t arg) {
+    uint8_t frame[ECG_RX_CTRL_FRAME_LEN];
+
+    ecg_rx::encode_ctrl(frame, cmd, arg);
+    d->rx.port().write(frame, sizeof(frame));
+}
+
+void Hub::append_device_info(Device* d) {
+    const EcgRxStats& stats = d->rx.stats();
+
+    d->info.baud = d->rx.port().baud();
+    d->info.header_errors = stats.header_errors;
+    d->info.crc_errors = stats.crc_errors;
+    append_record(&d->out, HUB_RECORD_DEVICE, d->index, d->info, d->path.size());
+    append_bytes(&d->out, d->path.data(), d->path.size());
+}
+
+// --- Viewers ---
+
+// Queues a batch of records for every viewer and writes what the sockets take now. A viewer
+// whose queue is full misses the whole batch.
+void Hub::publish(const std::vector<uint8_t>& batch) {
+    if (batch.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (Client* c : clients_) {
+        if (c->out.size() - c->sent + batch.size() > HUB_CLIENT_BUFFER) {
+            c->dropped += batch.size();
+            continue;
+        }
+        c->out.insert(c->out.end(), batch.begin(), batch.end());
+        flush_client(c);
+    }
+}
+
+void Hub::accept_client() {
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    struct epoll_event ev = {};
+
+    if (fd < 0) {
+        return;
+    }
+    Client* c = new Client();
+    c->fd = fd;
+    // Every board first, so the viewer knows them before their samples
+    for (Device* d : devices_) {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        size_t start = d->out.size();
+        append_device_info(d);
+        c->out.insert(c->out.end(), d->out.begin() + start, d->out.end());
+        d->out.resize(start);
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    epoll_ctl(main_epoll_, EPOLL_CTL_ADD, fd, &ev);
+
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    clients_.push_back(c);
+    flush_client(c);
+    printf("viewer connected, %zu attached\n", clients_.size());
+}
+
+void Hub::flush_client(Client* c) {
+    while (c->sent < c->out.size()) {
+        ssize_t n =
+            send(c->fd, &c->out[c->sent], c->out.size() - c->sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n <= 0) {
+            break; // Full, or gone: run() drops it when epoll says so
+        }
+        c->sent += (size_t)n;
+    }
+    if (c->sent == c->out.size()) {
+        c->out.clear();
+        c->sent = 0;
+    } else if (c->sent >= HUB_CLIENT_BUFFER / 4) {
+        c->out.erase(c->out.begin(), c->out.begin() + c->sent);
+        c->sent = 0;
+    }
+
+    bool want_write = !c->out.empty();
+    if (want_write != c->want_write) {
+        struct epoll_event ev = {};
+        ev.events = want_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        ev.data.ptr = c;
+        epoll_ctl(main_epoll_, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_write = want_write;
+    }
+}
+
+void Hub::drop_client(Client* c) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    for (size_t i = 0; i < clients_.size(); i++) {
+        if (clients_[i] == c) {
+            clients_.erase(clients_.begin() + i);
+            break;
+        }
+    }
+    epoll_ctl(main_epoll_, EPOLL_CTL_DEL, c->fd, nullptr);
+    close(c->fd);
+    printf("viewer left (%llu bytes dropped), %zu attached\n",
+           (unsigned long long)c->dropped,
+           clients_.size());
+    delete c;
+}
+
+} // namespace ecg_hub
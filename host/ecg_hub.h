@@ -0,0 +1,203 @@
+#ifndef ECG_HUB_H_
+#define ECG_HUB_H_
+
+// Aggregation server: one process reads every board, and any number of viewers attach to it
+// over a Unix socket instead of each opening a port.
+//
+// Build the daemon and the pty benchmark from the repository root:
+//   g++ -O2 -std=c++11 -pthread -Ihost -Idma-adc-display -o ecg_hub host/ecg_hub_main.cpp
+//       host/ecg_hub.cpp host/ecg_rx.cpp dma-adc-display/ecg_proto.c dma-adc-display/ecg_rice.c
+//   g++ -O2 -std=c++11 -pthread -Ihost -Idma-adc-display -o ecg_hub_bench
+//       host/ecg_hub_bench.cpp host/ecg_hub.cpp host/ecg_rx.cpp host/ecg_test_stream.cpp
+//       dma-adc-display/ecg_proto.c dma-adc-display/ecg_rice.c -lutil
+// and run it as
+//   ./ecg_hub [-s socket] [-b baud] [-j threads] /dev/ttyACM0 /dev/ttyACM1 ...
+// util/ecg_hub_view.py plots all boards from the socket.
+//
+// Reading: each board is an ecg_rx::Receiver. Their descriptors sit in one epoll set with
+// EPOLLONESHOT, and a pool of worker threads waits on it, so a board is only ever serviced by
+// one worker at a time and the boards are spread over the workers. A worker reads everything
+// the board has, decodes it and publishes the resulting records to every viewer in one batch.
+// The link negotiation of uart_link.h (baud offer, probe, confirm) runs per board as a state
+// machine, and a board that sends nothing valid is hunted through the baud rates, as
+// util/ecg_receiver.py does. A board that disappears is reopened once a second.
+//
+// Alignment: the boards' sample counters start whenever each board started. For each board
+// the hub estimates the host time of sample 0 (its epoch) from arrival time minus sample time,
+// taking the minimum over the last two windows of HUB_ALIGN_WINDOW_S so that the estimate is
+// the least-delayed frame and still follows clock drift. Every sample record carries the host
+// time of its first sample, so viewers line the boards up on one time axis.
+//
+// Viewers: the socket speaks a stream of records, all little endian, each a HubRecordHeader
+// followed by its body. A viewer first gets a HUB_RECORD_DEVICE for every board, then records
+// as they come. A viewer that does not keep up loses whole records (its buffer is capped at
+// HUB_CLIENT_BUFFER), never the hub's time; sample_index shows where the gap is.
+
+#include "ecg_rx.h"
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define HUB_DEFAULT_SOCKET "/tmp/ecg_hub.sock"
+#define HUB_DEFAULT_BAUD 9600 // Boards start at this rate and negotiate up
+#define HUB_RING_CAPACITY (1u << 17) // Samples per channel per board, more than one pump() yields
+#define HUB_EVENT_CAPACITY 2048 // Events per board, see Receiver::pump()
+#define HUB_CLIENT_BUFFER (4u << 20) // Bytes queued per viewer before records are dropped
+#define HUB_ALIGN_WINDOW_S 10.0
+#define HUB_STATUS_INTERVAL_S 1.0 // HUB_RECORD_DEVICE for every board this often
+#define HUB_LINK_TIMEOUT_S 0.5 // Waiting for each step of the baud negotiation
+#define HUB_HUNT_TIMEOUT_S 2.0 // No valid frame for this long: try the next baud rate
+#define HUB_REOPEN_INTERVAL_S 1.0
+#define HUB_DEFAULT_SAMPLE_RATE 500 // Until the board reports its rate
+
+// --- Viewer protocol ---
+
+enum HubRecordType {
+    HUB_RECORD_DEVICE = 0, // HubDeviceInfo, then the device path (not terminated)
+    HUB_RECORD_SAMPLES = 1, // HubSamples, then num_channels planes of num_samples uint16
+    HUB_RECORD_FRAME = 2, // HubFrame, then the payload of an ECG frame that is not samples
+    HUB_RECORD_CTRL = 3, // HubCtrl: a link control frame from the board (reports)
+};
+
+typedef struct {
+    uint8_t type; // HubRecordType
+    uint8_t device; // Index in the order given on the command line
+    uint16_t reserved;
+    uint32_t len; // Bytes of body that follow
+} HubRecordHeader;
+
+enum HubDeviceState {
+    HUB_DEVICE_CLOSED = 0, // Not open (unplugged); retried every HUB_REOPEN_INTERVAL_S
+    HUB_DEVICE_HUNTING = 1, // Open, no valid frame yet at this baud rate
+    HUB_DEVICE_NEGOTIATING = 2,
+    HUB_DEVICE_STREAMING = 3,
+};
+
+typedef struct {
+    uint8_t state; // HubDeviceState
+    uint8_t channel_mask; // Of the last sample frame
+    uint8_t sample_bits; // Width of the samples, 12..14 (LINK_CMD_RATE_REPORT, uart_link.h)
+    uint8_t reserved;
+    uint32_t sample_rate; // Hz
+    uint32_t baud;
+    uint32_t reserved2;
+    double epoch; // Host time (as Python's time.time()) of sample 0; 0 if not known yet
+    uint64_t frames; // Counters since the hub started
+    uint64_t lost_frames; // Sequence gaps
+    uint64_t header_errors;
+    uint64_t crc_errors;
+} HubDeviceInfo;
+
+typedef struct {
+    uint16_t seq;
+    uint8_t channel_mask;
+    uint8_t num_channels;
+    uint32_t sample_index; // Board's counter of the first sample
+    uint32_t num_samples; // Per channel
+    uint32_t sample_rate;
+    double t0; // Host time of the first sample (epoch + sample_index / sample_rate)
+} HubSamples;
+
+typedef struct {
+    uint8_t type; // EcgFrameType
+    uint8_t channel_mask;
+    uint16_t seq;
+    uint32_t sample_index;
+    double arrival;
+} HubFrame;
+
+typedef struct {
+    uint8_t cmd; // LINK_CMD_* of uart_link.h
+    uint8_t reserved[3];
+    uint32_t arg;
+} HubCtrl;
+
+namespace ecg_hub {
+
+// One board; every member is guarded by mutex
+struct Device {
+    Device(uint8_t index, const std::string& path);
+
+    std::mutex mutex;
+    uint8_t index;
+    std::string path;
+    ecg_rx::Receiver rx;
+    HubDeviceInfo info = {};
+    std::vector<uint8_t> out; // Records of the current batch
+
+    // Baud negotiation
+    uint32_t old_baud = 0;
+    uint32_t new_baud = 0;
+    double deadline = 0;
+
+    double last_valid = 0; // Time of the last valid frame
+    double last_open_try = 0;
+    int32_t expected_seq = -1;
+
+    // Alignment: minimum of arrival - sample time over this window and the previous one
+    double window_start = 0;
+    double window_min = 0;
+    double prev_min = 0;
+    bool have_min = false;
+};
+
+class Hub {
+public:
+    Hub() = default;
+    ~Hub();
+    Hub(const Hub&) = delete;
+    Hub& operator=(const Hub&) = delete;
+
+    void add_device(const std::string& path);
+    // Opens the devices and the socket and starts the workers. Returns false with errno set
+    // if the socket cannot be set up; devices that cannot be opened are retried later.
+    bool start(const char* socket_path, uint32_t baud, unsigned workers);
+    // Serves viewers and runs the timeouts until stop() is called (from any thread or a
+    // signal handler)
+    void run();
+    void stop() {
+        stopping_ = true;
+    }
+    size_t num_clients();
+
+private:
+    struct Client {
+        int fd;
+        std::vector<uint8_t> out;
+        size_t sent = 0; // Bytes of out already written
+        bool want_write = false;
+        uint64_t dropped = 0;
+    };
+
+    void worker();
+    void service(Device* d);
+    void handle_ctrl(Device* d, const EcgRxEvent& ev, double now);
+    void handle_frame(Device* d, const EcgRxEvent& ev);
+    void housekeeping(Device* d, double now);
+    bool open_device(Device* d, double now);
+    void close_device(Device* d);
+    void send_ctrl(Device* d, uint8_t cmd, uint32_t arg);
+    void append_device_info(Device* d);
+    void publish(const std::vector<uint8_t>& batch);
+    void accept_client();
+    void flush_client(Client* c); // With clients_mutex_ held
+    void drop_client(Client* c);
+
+    std::vector<Device*> devices_;
+    std::vector<std::thread> workers_;
+    int device_epoll_ = -1; // Boards, serviced by the workers
+    int main_epoll_ = -1; // Listening socket and viewers
+    int listen_fd_ = -1;
+    std::string socket_path_;
+    uint32_t start_baud_ = HUB_DEFAULT_BAUD;
+    std::atomic<bool> stopping_{ false };
+    std::mutex clients_mutex_;
+    std::vector<Client*> clients_;
+};
+
+} // namespace ecg_hub
+
+#endif /* ECG_HUB_H_ */
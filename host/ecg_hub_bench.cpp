@@ -0,0 +1,303 @@
+// Scaling and alignment of the aggregation server (ecg_hub.h), with ptys standing in for the
+// boards. Build: see ecg_hub.h.
+//
+//   ./ecg_hub_bench [-d max_devices] [-n frames] [-c channel_mask] [-j threads]
+//
+// Throughput: for 1, 2, 4 ... max_devices boards, a writer thread per board pushes a test stream
+// (ecg_test_stream.h) into its pty as fast as it is taken, and a viewer on the hub's socket
+// counts what comes out. Every sample of every board has to arrive, in order.
+// Alignment: max_devices boards stream in real time at ALIGN_RATE Hz, board k starting
+// k * ALIGN_STAGGER_S after board 0. The hub's epochs have to come out that far apart.
+// The exit status is 1 if a check fails.
+
+#include "ecg_hub.h"
+#include "ecg_test_stream.h"
+#include <chrono>
+#include <fcntl.h>
+#include <math.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const double ALIGN_RATE = HUB_DEFAULT_SAMPLE_RATE; // The hub assumes it until a rate report
+const double ALIGN_STAGGER_S = 0.040;
+const double ALIGN_TOLERANCE_S = 0.005;
+const uint32_t ALIGN_FRAMES = 150; // About 3 s
+const double TIMEOUT_S = 60;
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Board {
+    int master = -1;
+    int slave = -1; // Kept open so the master never sees a hang-up
+    std::string path;
+};
+
+struct ViewerResult {
+    std::vector<uint64_t> samples; // Per device, channel 0
+    std::vector<uint64_t> frames; // All records but DEVICE
+    std::vector<double> epoch; // From the last sample record
+    uint64_t bytes = 0;
+    bool in_order = true;
+};
+
+bool open_board(Board* b) {
+    char name[64];
+
+    if (openpty(&b->master, &b->slave, name, nullptr, nullptr) != 0) {
+        perror("openpty");
+        return false;
+    }
+    b->path = name;
+    return true;
+}
+
+void close_board(Board* b) {
+    close(b->master);
+    close(b->slave);
+}
+
+int connect_viewer(const char* path) {
+    struct sockaddr_un addr = {};
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+// Reads records until every board has sent `expected` samples or the time is up
+void run_viewer(int fd, size_t num_devices, uint64_t expected, ViewerResult* res) {
+    std::vector<uint8_t> buf;
+    std::vector<uint32_t> next_index(num_devices, 0);
+    size_t done = 0;
+    auto start = Clock::now();
+
+    res->samples.assign(num_devices, 0);
+    res->frames.assign(num_devices, 0);
+    res->epoch.assign(num_devices, 0);
+    while (done < num_devices && seconds_since(start) < TIMEOUT_S) {
+        uint8_t chunk[65536];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            break;
+        }
+        res->bytes += (uint64_t)n;
+        buf.insert(buf.end(), chunk, chunk + n);
+
+        size_t pos = 0;
+        while (buf.size() - pos >= sizeof(HubRecordHeader)) {
+            HubRecordHeader h;
+            memcpy(&h, &buf[pos], sizeof(h));
+            if (buf.size() - pos < sizeof(h) + h.len) {
+                break;
+            }
+            const uint8_t* body = &buf[pos + sizeof(h)];
+            pos += sizeof(h) + h.len;
+            if (h.device >= num_devices || h.type == HUB_RECORD_DEVICE) {
+                continue;
+            }
+            res->frames[h.device]++;
+            if (h.type != HUB_RECORD_SAMPLES) {
+                continue;
+            }
+            HubSamples s;
+            memcpy(&s, body, sizeof(s));
+            if (s.sample_index != next_index[h.device]) {
+                res->in_order = false;
+            }
+            next_index[h.device] = s.sample_index + s.num_samples;
+            res->samples[h.device] += s.num_samples;
+            res->epoch[h.device] = s.t0 - s.sample_index / (double)s.sample_rate;
+            if (res->samples[h.device] == expected) {
+                done++;
+            }
+        }
+        buf.erase(buf.begin(), buf.begin() + pos);
+    }
+}
+
+// Starts a hub on the boards, waits for the viewer to attach, runs the writers, returns the
+// seconds from the first write to the viewer's last record
+double run_hub(std::vector<Board>& boards,
+               const ecg_rx::TestStream& stream,
+               unsigned workers,
+               bool paced,
+               ViewerResult* res) {
+    std::string socket_path = "/tmp/ecg_hub_bench." + std::to_string(getpid()) + ".sock";
+    ecg_hub::Hub hub;
+
+    for (const Board& b : boards) {
+        hub.add_device(b.path);
+    }
+    if (!hub.start(socket_path.c_str(), HUB_DEFAULT_BAUD, workers)) {
+        perror(socket_path.c_str());
+        return -1;
+    }
+    std::thread server(&ecg_hub::Hub::run, &hub);
+    int fd = connect_viewer(socket_path.c_str());
+    while (fd >= 0 && hub.num_clients() == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto start = Clock::now();
+    std::vector<std::thread> writers;
+    for (size_t k = 0; k < boards.size(); k++) {
+        writers.emplace_back([&, k] {
+            auto board_start = start + std::chrono::duration_cast<Clock::duration>(
+                                           std::chrono::duration<double>(k * ALIGN_STAGGER_S));
+            size_t pos = 0;
+            for (size_t f = 0; f < stream.frame_end.size(); f++) {
+                size_t end = stream.frame_end[f];
+                if (!paced && end - pos < 4096 && f + 1 < stream.frame_end.size()) {
+                    continue; // Unpaced: write in chunks of 4 KB or more
+                }
+                if (paced) {
+                    std::this_thread::sleep_until(
+                        board_start + std::chrono::duration_cast<Clock::duration>(
+                                          std::chrono::duration<double>(stream.sample_end[f]
+                                                                        / ALIGN_RATE)));
+                }
+                while (pos < end) {
+                    ssize_t n = write(boards[k].master, &stream.bytes[pos], end - pos);
+                    if (n <= 0) {
+                        return;
+                    }
+                    pos += (size_t)n;
+                }
+            }
+        });
+    }
+    if (fd >= 0) {
+        run_viewer(fd, boards.size(), stream.samples, res);
+        close(fd);
+    }
+    double t = seconds_since(start);
+    for (std::thread& w : writers) {
+        w.join();
+    }
+    hub.stop();
+    server.join();
+    return t;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t max_devices = 8;
+    uint32_t frames = 20000;
+    uint8_t mask = 0x01;
+    unsigned workers = std::thread::hardware_concurrency();
+    bool ok = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:c:j:")) != -1) {
+        switch (opt) {
+            case 'd':
+                max_devices = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'n':
+                frames = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'c':
+                mask = (uint8_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'j':
+                workers = (unsigned)strtoul(optarg, nullptr, 0);
+                break;
+            default:
+                fprintf(stderr,
+                        "usage: %s [-d max_devices] [-n frames] [-c channel_mask] [-j threads]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    if (workers == 0) {
+        workers = 1;
+    }
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    ecg_rx::TestStream stream;
+    ecg_rx::build_test_stream(frames, mask, 0, &stream);
+    printf("%u frames (%zu bytes) per board, channel mask 0x%02X, %u workers\n",
+           frames,
+           stream.bytes.size(),
+           mask,
+           workers);
+
+    for (uint32_t n = 1; n <= max_devices; n *= 2) {
+        std::vector<Board> boards(n);
+        ViewerResult res;
+        bool all = true;
+
+        for (Board& b : boards) {
+            all &= open_board(&b);
+        }
+        double t = all ? run_hub(boards, stream, workers < n ? workers : n, false, &res) : -1;
+        for (uint32_t k = 0; all && k < n; k++) {
+            all &= res.samples[k] == stream.samples;
+        }
+        all &= res.in_order;
+        printf("%2u boards: %10.0f frames/s %8.1f MB/s in, %8.1f MB/s to the viewer%s\n",
+               n,
+               n * (double)(stream.frames + stream.ctrl) / t,
+               n * stream.bytes.size() / t / 1e6,
+               res.bytes / t / 1e6,
+               all ? "" : "  MISSING OR OUT OF ORDER");
+        ok &= all;
+        for (Board& b : boards) {
+            close_board(&b);
+        }
+    }
+
+    // Alignment
+    {
+        ecg_rx::TestStream paced;
+        std::vector<Board> boards(max_devices);
+        ViewerResult res;
+        bool all = true;
+        double worst = 0;
+
+        ecg_rx::build_test_stream(ALIGN_FRAMES, mask, 0, &paced);
+        for (Board& b : boards) {
+            all &= open_board(&b);
+        }
+        if (all && run_hub(boards, paced, workers, true, &res) < 0) {
+            all = false;
+        }
+        for (uint32_t k = 1; all && k < max_devices; k++) {
+            double err = (res.epoch[k] - res.epoch[0]) - k * ALIGN_STAGGER_S;
+            worst = fabs(err) > worst ? fabs(err) : worst;
+        }
+        all &= worst <= ALIGN_TOLERANCE_S;
+        printf("alignment: %u boards started %.0f ms apart, worst epoch error %.2f ms%s\n",
+               max_devices,
+               ALIGN_STAGGER_S * 1000,
+               worst * 1000,
+               all ? "" : "  FAILED");
+        ok &= all;
+        for (Board& b : boards) {
+            close_board(&b);
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+// The aggregation daemon (ecg_hub.h). Build: see ecg_hub.h.
+//
+//   ./ecg_hub [-s socket] [-b baud] [-j threads] device...
+//
+//   -s  Unix socket viewers attach to (default HUB_DEFAULT_SOCKET)
+//   -b  baud rate the boards start at (default HUB_DEFAULT_BAUD)
+//   -j  worker threads (default: one per CPU, at most one per device)
+//
+// Runs until SIGINT or SIGTERM.
+
+#include "ecg_hub.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+ecg_hub::Hub* hub_instance = nullptr;
+
+void on_signal(int) {
+    hub_instance->stop();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* socket_path = HUB_DEFAULT_SOCKET;
+    uint32_t baud = HUB_DEFAULT_BAUD;
+    unsigned workers = std::thread::hardware_concurrency();
+    struct sigaction sa = {};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:b:j:")) != -1) {
+        switch (opt) {
+            case 's':
+                socket_path = optarg;
+                break;
+            case 'b':
+                baud = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'j':
+                workers = (unsigned)strtoul(optarg, nullptr, 0);
+                break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if (optind >= argc || argc - optind > 256) {
+        fprintf(stderr, "usage: %s [-s socket] [-b baud] [-j threads] device...\n", argv[0]);
+        return 2;
+    }
+    if (workers == 0) {
+        workers = 1;
+    }
+    if (workers > (unsigned)(argc - optind)) {
+        workers = (unsigned)(argc - optind);
+    }
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    ecg_hub::Hub hub;
+    for (int i = optind; i < argc; i++) {
+        hub.add_device(argv[i]);
+    }
+    hub_instance = &hub;
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!hub.start(socket_path, baud, workers)) {
+        perror(socket_path);
+        return 1;
+    }
+    printf("%d devices, %u workers, viewers on %s\n", argc - optind, workers, socket_path);
+    hub.run();
+    return 0;
+}
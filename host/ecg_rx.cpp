@@ -0,0 +1,636 @@
+#include "ecg_rx.h"
+#include "ecg_rice.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace ecg_rx {
+
+// --- Private Definitions ---
+namespace {
+
+struct CrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+
+    CrcTables() {
+        for (unsigned i = 0; i < 256; i++) {
+            uint8_t c8 = (uint8_t)i;
+            uint16_t c16 = (uint16_t)(i << 8);
+            for (int bit = 0; bit < 8; bit++) {
+                c8 = (uint8_t)(c8 & 0x80 ? (c8 << 1) ^ 0x07 : c8 << 1);
+                c16 = (uint16_t)(c16 & 0x8000 ? (c16 << 1) ^ 0x1021 : c16 << 1);
+            }
+            crc8[i] = c8;
+            crc16[i] = c16;
+        }
+    }
+};
+
+const CrcTables CRC_TABLES;
+
+struct BaudEntry {
+    uint32_t baud;
+    speed_t speed;
+};
+
+const BaudEntry BAUD_TABLE[] = {
+    { 9600, B9600 },     { 19200, B19200 },   { 38400, B38400 },   { 57600, B57600 },
+    { 115200, B115200 }, { 230400, B230400 },
+#ifdef B460800
+    { 460800, B460800 },
+#endif
+#ifdef B921600
+    { 921600, B921600 },
+#endif
+};
+
+uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+uint8_t count_channels(uint8_t mask) {
+    uint8_t n = 0;
+    for (; mask; mask &= (uint8_t)(mask - 1)) {
+        n++;
+    }
+    return n;
+}
+
+} // namespace
+
+// --- Function Implementations ---
+
+double wall_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+uint8_t crc8(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc = CRC_TABLES.crc8[crc ^ data[i]];
+    }
+    return crc;
+}
+
+uint16_t crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = ECG_CRC16_INIT;
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)(crc << 8) ^ CRC_TABLES.crc16[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+void encode_ctrl(uint8_t* out, uint8_t cmd, uint32_t arg) {
+    out[0] = ECG_SYNC0;
+    out[1] = ECG_RX_CTRL_HEADER2;
+    out[2] = cmd;
+    out[7] = cmd;
+    for (int i = 0; i < 4; i++) {
+        out[3 + i] = (uint8_t)(arg >> (8 * i));
+        out[7] = (uint8_t)(out[7] + out[3 + i]);
+    }
+}
+
+// --- SerialPort ---
+
+SerialPort::~SerialPort() {
+    close();
+}
+
+bool SerialPort::open(const char* path, uint32_t baud) {
+    struct termios tio;
+
+    close();
+    fd_ = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd_ < 0) {
+        return false;
+    }
+    owned_ = true;
+    if (tcgetattr(fd_, &tio) != 0) {
+        close();
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(tcflag_t)(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 0; // read() returns what is there; poll() does the waiting
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd_, TCSANOW, &tio) != 0 || !set_baud(baud)) {
+        int err = errno;
+        close();
+        errno = err;
+        return false;
+    }
+    tcflush(fd_, TCIFLUSH);
+    return true;
+}
+
+void SerialPort::attach(int fd) {
+    close();
+    fd_ = fd;
+    owned_ = false;
+}
+
+void SerialPort::close() {
+    if (fd_ >= 0 && owned_) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    owned_ = false;
+    baud_ = 0;
+}
+
+bool SerialPort::set_baud(uint32_t baud) {
+    struct termios tio;
+
+    for (const BaudEntry& entry : BAUD_TABLE) {
+        if (entry.baud != baud) {
+            continue;
+        }
+        if (tcgetattr(fd_, &tio) != 0) {
+            return false;
+        }
+        cfsetispeed(&tio, entry.speed);
+        cfsetospeed(&tio, entry.speed);
+        if (tcsetattr(fd_, TCSADRAIN, &tio) != 0) {
+            return false;
+        }
+        baud_ = baud;
+        return true;
+    }
+    errno = EINVAL;
+    return false;
+}
+
+long SerialPort::read(uint8_t* buf, size_t cap, int timeout_ms) {
+    struct pollfd pfd = { fd_, POLLIN, 0 };
+    int ready = poll(&pfd, 1, timeout_ms);
+
+    if (ready <= 0) {
+        return ready == 0 || errno == EINTR ? 0 : -1;
+    }
+    ssize_t n = ::read(fd_, buf, cap);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EINTR ? 0 : -1;
+    }
+    if (n == 0 && (pfd.revents & (POLLHUP | POLLERR))) { // Device gone
+        errno = EIO;
+        return -1;
+    }
+    return (long)n;
+}
+
+long SerialPort::write(const uint8_t* data, size_t len) {
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = ::write(fd_, data + done, len - done);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                struct pollfd pfd = { fd_, POLLOUT, 0 };
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return (long)done;
+}
+
+// --- SampleRing ---
+
+SampleRing::SampleRing(uint32_t capacity) :
+    capacity_(capacity), data_((size_t)ECG_RX_MAX_CHANNELS * capacity), head_(0) {}
+
+void SampleRing::push(const uint16_t* const* planes,
+                      uint8_t num_channels,
+                      uint32_t count,
+                      uint32_t stride) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint32_t mask = capacity_ - 1;
+
+    for (uint8_t ch = 0; ch < num_channels; ch++) {
+        uint16_t* plane = &data_[(size_t)ch * capacity_];
+        const uint16_t* src = planes[ch];
+        for (uint32_t i = 0; i < count; i++) {
+            plane[(uint32_t)(head + i) & mask] = src[(size_t)i * stride];
+        }
+    }
+    head_.store(head + count, std::memory_order_release);
+}
+
+uint32_t SampleRing::read(uint8_t ch, uint64_t* cursor, uint16_t* out, uint32_t max_samples) const {
+    const uint16_t* plane = channel(ch);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t pos = *cursor;
+    uint32_t mask = capacity_ - 1;
+
+    if (pos > head) {
+        pos = head;
+    }
+    if (head - pos > capacity_) {
+        pos = head - capacity_;
+    }
+    uint32_t n = (uint32_t)(head - pos < max_samples ? head - pos : max_samples);
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = plane[(uint32_t)(pos + i) & mask];
+    }
+
+    // The producer may have wrapped onto the start of the copy meanwhile: drop what it overwrote
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t oldest = head_.load(std::memory_order_relaxed);
+    oldest = oldest > capacity_ ? oldest - capacity_ : 0;
+    if (pos < oldest) {
+        uint64_t lost = oldest - pos;
+        if (lost >= n) {
+            *cursor = oldest;
+            return 0;
+        }
+        memmove(out, out + lost, (n - lost) * sizeof(uint16_t));
+        n -= (uint32_t)lost;
+        pos = oldest;
+    }
+    *cursor = pos + n;
+    return n;
+}
+
+// --- EventQueue ---
+
+EventQueue::EventQueue(uint32_t capacity) : events_(capacity), head_(0), tail_(0) {}
+
+EcgRxEvent* EventQueue::claim() {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+
+    if (head - tail_.load(std::memory_order_acquire) >= events_.size()) {
+        return nullptr;
+    }
+    return &events_[head & (events_.size() - 1)];
+}
+
+void EventQueue::commit() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool EventQueue::pop(EcgRxEvent* out) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+
+    if (tail == head_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    const EcgRxEvent& ev = events_[tail & (events_.size() - 1)];
+    memcpy(out, &ev, offsetof(EcgRxEvent, payload) + ev.payload_len);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// --- FrameScanner ---
+
+FrameScanner::FrameScanner() {
+    buf_.reserve(64 * 1024);
+}
+
+void FrameScanner::append(const uint8_t* data, size_t len) {
+    buf_.insert(buf_.end(), data, data + len);
+}
+
+void FrameScanner::scan(std::vector<FrameSpan>* spans, EcgRxStats* stats) {
+    const uint8_t* buf = buf_.data();
+    size_t end = buf_.size();
+    size_t pos = 0;
+
+    while (pos < end) {
+        const uint8_t* sync = (const uint8_t*)memchr(buf + pos, ECG_SYNC0, end - pos);
+        if (!sync) {
+            stats->bytes_skipped += end - pos;
+            pos = end;
+            break;
+        }
+        stats->bytes_skipped += (size_t)(sync - (buf + pos));
+        pos = (size_t)(sync - buf);
+        if (end - pos < 2) {
+            break;
+        }
+
+        if (buf[pos + 1] == ECG_RX_CTRL_HEADER2) {
+            if (end - pos < ECG_RX_CTRL_FRAME_LEN) {
+                break;
+            }
+            uint8_t sum = 0;
+            for (int i = 2; i < 7; i++) {
+                sum = (uint8_t)(sum + buf[pos + i]);
+            }
+            if (sum != buf[pos + 7]) {
+                stats->ctrl_errors++;
+                pos++;
+                continue;
+            }
+            spans->push_back({ (uint32_t)pos, ECG_RX_CTRL_FRAME_LEN, 1 });
+            pos += ECG_RX_CTRL_FRAME_LEN;
+            continue;
+        }
+        if (buf[pos + 1] != ECG_SYNC1) {
+            stats->bytes_skipped++;
+            pos++;
+            continue;
+        }
+        if (end - pos < ECG_HEADER_LEN) {
+            break;
+        }
+        uint16_t payload_len = get_u16(&buf[pos + 3]);
+        if ((buf[pos + 2] >> 4) != ECG_PROTO_VERSION || payload_len > ECG_MAX_PAYLOAD
+            || crc8(&buf[pos + 2], 10) != buf[pos + 12])
+        {
+            stats->header_errors++;
+            pos++;
+            continue;
+        }
+        uint32_t frame_len = ECG_FRAME_OVERHEAD + payload_len;
+        if (end - pos < frame_len) {
+            break;
+        }
+        spans->push_back({ (uint32_t)pos, frame_len, 0 });
+        pos += frame_len; // The caller checks the CRC-16; a bad one still ends the frame here
+    }
+    pos_ = pos;
+}
+
+void FrameScanner::consume() {
+    buf_.erase(buf_.begin(), buf_.begin() + (long)pos_);
+    pos_ = 0;
+}
+
+void FrameScanner::clear() {
+    buf_.clear();
+    pos_ = 0;
+}
+
+// --- Receiver ---
+
+Receiver::Receiver(uint32_t ring_capacity, uint32_t event_capacity) :
+    ring_(ring_capacity),
+    events_(event_capacity),
+    read_buf_(64 * 1024),
+    scratch_((size_t)ECG_RX_MAX_CHANNELS * ECG_RX_MAX_SAMPLES) {}
+
+int Receiver::pump(int timeout_ms) {
+    long n = port_.read(read_buf_.data(), read_buf_.size(), timeout_ms);
+    int produced = 0;
+
+    if (n < 0) {
+        return -1;
+    }
+    // A full buffer means more is waiting: keep reading without blocking, while the events of
+    // another full buffer still fit
+    while (n > 0) {
+        produced += feed(read_buf_.data(), (size_t)n, wall_time());
+        if ((size_t)n < read_buf_.size() || events_.size() > events_.capacity() / 2) {
+            break;
+        }
+        n = port_.read(read_buf_.data(), read_buf_.size(), 0);
+    }
+    return n < 0 ? -1 : produced;
+}
+
+int Receiver::feed(const uint8_t* data, size_t len, double arrival) {
+    int produced = 0;
+
+    stats_.bytes += len;
+    scanner_.append(data, len);
+    spans_.clear();
+    scanner_.scan(&spans_, &stats_);
+    const uint8_t* base = scanner_.data();
+
+    // CRC-16 of the whole batch first, then decoding
+    for (FrameSpan& span : spans_) {
+        const uint8_t* frame = base + span.offset;
+        if (!span.ctrl && crc16(frame + 2, span.len - 4) != get_u16(frame + span.len - 2)) {
+            stats_.crc_errors++;
+            span.len = 0;
+        }
+    }
+
+    for (const FrameSpan& span : spans_) {
+        const uint8_t* frame = base + span.offset;
+        EcgRxEvent spare;
+        EcgRxEvent* ev;
+
+        if (span.len == 0) {
+            continue;
+        }
+        ev = events_.claim();
+        if (!ev) {
+            stats_.events_dropped++;
+            ev = &spare; // Samples still go to the ring
+        }
+        ev->arrival = arrival;
+        ev->ring_pos = ring_.head();
+        ev->num_samples = 0;
+        ev->payload_len = 0;
+        if (span.ctrl) {
+            stats_.ctrl_frames++;
+            ev->kind = ECG_RX_EVENT_CTRL;
+            ev->type = frame[2];
+            ev->arg = get_u32(frame + 3);
+            ev->channel_mask = 0;
+            ev->num_channels = 0;
+            ev->seq = 0;
+            ev->sample_index = 0;
+        } else {
+            uint16_t payload_len = (uint16_t)(span.len - ECG_FRAME_OVERHEAD);
+            stats_.frames_ok++;
+            ev->kind = ECG_RX_EVENT_FRAME;
+            ev->type = frame[2] & 0x0F;
+            ev->arg = 0;
+            ev->seq = get_u16(frame + 5);
+            ev->sample_index = get_u32(frame + 7);
+            ev->channel_mask = frame[11];
+            ev->num_channels = count_channels(frame[11]);
+            if (ev->type == ECG_TYPE_SAMPLES || ev->type == ECG_TYPE_SAMPLES_PLANAR
+                || ev->type == ECG_TYPE_SAMPLES_RICE)
+            {
+                if (!decode_samples(frame, ev)) {
+                    stats_.decode_errors++;
+                }
+            } else {
+                memcpy(ev->payload, frame + ECG_HEADER_LEN, payload_len);
+                ev->payload_len = payload_len;
+            }
+        }
+        if (ev != &spare) {
+            events_.commit();
+            produced++;
+        }
+    }
+    scanner_.consume();
+    return produced;
+}
+
+void Receiver::reset() {
+    scanner_.clear();
+}
+
+// Decodes a sample frame into the ring. Fills ev->num_samples; false if the payload is malformed.
+bool Receiver::decode_samples(const uint8_t* frame, EcgRxEvent* ev) {
+    const uint8_t* payload = frame + ECG_HEADER_LEN;
+    uint16_t len = get_u16(frame + 3);
+    uint8_t num_channels = ev->num_channels;
+    const uint16_t* planes[ECG_RX_MAX_CHANNELS];
+    uint32_t count;
+
+    if (num_channels == 0) {
+        return false;
+    }
+    for (uint8_t ch = 0; ch < num_channels; ch++) {
+        planes[ch] = &scratch_[(size_t)ch * ECG_RX_MAX_SAMPLES];
+    }
+
+    if (ev->type == ECG_TYPE_SAMPLES_RICE) {
+        // One block per channel, each preceded by its length when there are several
+        uint32_t pos = 0;
+        count = 0;
+        for (uint8_t ch = 0; ch < num_channels; ch++) {
+            uint32_t block_len = len;
+            if (num_channels > 1) {
+                if (pos + 2 > len) {
+                    return false;
+                }
+                block_len = get_u16(payload + pos);
+                pos += 2;
+            }
+            if (pos + block_len > len) {
+                return false;
+            }
+            int n = ecg_rice_decode(payload + pos,
+                                    (uint16_t)block_len,
+                                    &scratch_[(size_t)ch * ECG_RX_MAX_SAMPLES],
+                                    ECG_RX_MAX_SAMPLES);
+            if (n < 0 || (ch > 0 && (uint32_t)n != count)) {
+                return false;
+            }
+            count = (uint32_t)n;
+            pos += block_len;
+        }
+    } else {
+        if (len % (2 * num_channels) != 0) {
+            return false;
+        }
+        count = len / 2 / num_channels;
+        for (uint32_t i = 0; i < count; i++) {
+            for (uint8_t ch = 0; ch < num_channels; ch++) {
+                uint32_t word =
+                    ev->type == ECG_TYPE_SAMPLES ? i * num_channels + ch : ch * count + i;
+                scratch_[(size_t)ch * ECG_RX_MAX_SAMPLES + i] = get_u16(payload + 2 * word);
+            }
+        }
+    }
+    ring_.push(planes, num_channels, count, 1);
+    ev->num_samples = count;
+    return true;
+}
+
+} // namespace ecg_rx
+
+// --- C Interface ---
+
+struct EcgRx {
+    static const uint32_t EVENT_CAPACITY = 4096; // Frames in a full 64 KB read, 16+ bytes each
+    explicit EcgRx(uint32_t ring_capacity) : rx(ring_capacity, EVENT_CAPACITY) {}
+    ecg_rx::Receiver rx;
+};
+
+namespace {
+
+EcgRx* ecg_rx_new(uint32_t ring_capacity) {
+    if (ring_capacity == 0 || (ring_capacity & (ring_capacity - 1)) != 0) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    return new EcgRx(ring_capacity);
+}
+
+} // namespace
+
+EcgRx* ecg_rx_open(const char* path, uint32_t baud, uint32_t ring_capacity) {
+    EcgRx* rx = ecg_rx_new(ring_capacity);
+
+    if (rx && !rx->rx.port().open(path, baud)) {
+        int err = errno;
+        delete rx;
+        errno = err;
+        return nullptr;
+    }
+    return rx;
+}
+
+EcgRx* ecg_rx_attach(int fd, uint32_t ring_capacity) {
+    EcgRx* rx = ecg_rx_new(ring_capacity);
+
+    if (rx) {
+        rx->rx.port().attach(fd);
+    }
+    return rx;
+}
+
+void ecg_rx_close(EcgRx* rx) {
+    delete rx;
+}
+
+int ecg_rx_set_baud(EcgRx* rx, uint32_t baud) {
+    return rx->rx.port().set_baud(baud) ? 0 : -1;
+}
+
+int ecg_rx_write(EcgRx* rx, const uint8_t* data, uint32_t len) {
+    return (int)rx->rx.port().write(data, len);
+}
+
+int ecg_rx_pump(EcgRx* rx, int timeout_ms) {
+    return rx->rx.pump(timeout_ms);
+}
+
+int ecg_rx_feed(EcgRx* rx, const uint8_t* data, uint32_t len, double arrival) {
+    return rx->rx.feed(data, len, arrival);
+}
+
+void ecg_rx_reset(EcgRx* rx) {
+    rx->rx.reset();
+}
+
+int ecg_rx_poll_event(EcgRx* rx, EcgRxEvent* out) {
+    return rx->rx.poll_event(out) ? 1 : 0;
+}
+
+void ecg_rx_get_stats(const EcgRx* rx, EcgRxStats* out) {
+    *out = rx->rx.stats();
+}
+
+uint32_t ecg_rx_ring_capacity(const EcgRx* rx) {
+    return rx->rx.ring().capacity();
+}
+
+uint64_t ecg_rx_ring_head(const EcgRx* rx) {
+    return rx->rx.ring().head();
+}
+
+const uint16_t* ecg_rx_ring_channel(const EcgRx* rx, uint8_t channel) {
+    return rx->rx.ring().channel(channel);
+}
+
+uint32_t ecg_rx_ring_read(const EcgRx* rx,
+                          uint8_t channel,
+                          uint64_t* cursor,
+                          uint16_t* out,
+                          uint32_t max_samples) {
+    return rx->rx.ring().read(channel, cursor, out, max_samples);
+}
@@ -0,0 +1,196 @@
+#ifndef ECG_RX_H_
+#define ECG_RX_H_
+
+// Native receiver for the ECG frame protocol (dma-adc-display/ecg_proto.h), for links and
+// device counts the Python parser in util/ecg_receiver.py can't keep up with.
+//
+// Build the shared library for util/ecg_rx.py from the repository root (the firmware's protocol
+// and Rice sources are compiled with it):
+//   g++ -O2 -std=c++11 -shared -fPIC -Ihost -Idma-adc-display -o util/libecg_rx.so
+//       host/ecg_rx.cpp dma-adc-display/ecg_proto.c dma-adc-display/ecg_rice.c
+// and the benchmark:
+//   g++ -O2 -std=c++11 -pthread -Ihost -Idma-adc-display -o ecg_rx_bench host/ecg_rx_bench.cpp
+//       host/ecg_rx.cpp host/ecg_test_stream.cpp dma-adc-display/ecg_proto.c
+//       dma-adc-display/ecg_rice.c -lutil
+//
+// Reading: SerialPort waits with poll() and then takes everything the tty has in one read(),
+// so a busy link costs a system call per few kilobytes instead of one per byte.
+//
+// Scanning: FrameScanner finds sync bytes with memchr() (vectorised in the C library) and
+// checks each candidate header with its CRC-8 as the firmware's decoder does. Complete frames
+// are collected first and their CRC-16s are checked afterwards in one pass over the batch.
+// A frame with a good header and a bad CRC-16 is dropped whole, without rescanning its payload.
+//
+// Decoding: sample frames of every layout (raw interleaved, raw planar, Rice) are decoded to
+// one plane per channel in a SampleRing. Each frame also yields an event carrying the header,
+// so a consumer can track sequence numbers and sample indices without touching the samples.
+// Other frames and control frames come as events with their payload.
+//
+// Errors are reported the POSIX way (-1 or false, with errno); nothing here throws.
+
+#include "ecg_rx_c.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ecg_rx {
+
+// Wall-clock seconds, the same clock as Python's time.time()
+double wall_time();
+
+// CRC-8 (poly 0x07) and CRC-16/CCITT-FALSE, table driven; same results as ecg_proto.h
+uint8_t crc8(const uint8_t* data, size_t len);
+uint16_t crc16(const uint8_t* data, size_t len);
+
+// Builds a link control frame of ECG_RX_CTRL_FRAME_LEN bytes
+void encode_ctrl(uint8_t* out, uint8_t cmd, uint32_t arg);
+
+class SerialPort {
+public:
+    SerialPort() = default;
+    ~SerialPort();
+    SerialPort(const SerialPort&) = delete;
+    SerialPort& operator=(const SerialPort&) = delete;
+
+    // Opens a device in raw 8N1 mode without flow control
+    bool open(const char* path, uint32_t baud);
+    // Uses a descriptor opened elsewhere, as it is configured; it is not closed here
+    void attach(int fd);
+    void close();
+    // Switches once the output already written has gone out
+    bool set_baud(uint32_t baud);
+    // Waits up to timeout_ms for data, then reads what is there. Returns bytes read, 0 on
+    // timeout, -1 on error.
+    long read(uint8_t* buf, size_t cap, int timeout_ms);
+    long write(const uint8_t* data, size_t len);
+    int fd() const {
+        return fd_;
+    }
+    uint32_t baud() const { // 0 if not set here
+        return baud_;
+    }
+
+private:
+    int fd_ = -1;
+    bool owned_ = false;
+    uint32_t baud_ = 0;
+};
+
+// Single producer, any number of readers with their own cursors. The producer never waits:
+// a reader that falls more than the capacity behind loses the oldest samples, as with the
+// firmware's SegQueue.
+class SampleRing {
+public:
+    explicit SampleRing(uint32_t capacity);
+
+    uint32_t capacity() const {
+        return capacity_;
+    }
+    uint64_t head() const {
+        return head_.load(std::memory_order_acquire);
+    }
+    const uint16_t* channel(uint8_t ch) const {
+        return &data_[(size_t)ch * capacity_];
+    }
+
+    // Appends count samples to each of num_channels planes; planes[ch] has stride `stride`
+    void push(const uint16_t* const* planes, uint8_t num_channels, uint32_t count, uint32_t stride);
+    uint32_t read(uint8_t ch, uint64_t* cursor, uint16_t* out, uint32_t max_samples) const;
+
+private:
+    uint32_t capacity_;
+    std::vector<uint16_t> data_; // ECG_RX_MAX_CHANNELS planes of capacity_ samples
+    std::atomic<uint64_t> head_;
+};
+
+// Single-producer single-consumer queue of events; a full queue drops the new event
+class EventQueue {
+public:
+    explicit EventQueue(uint32_t capacity); // A power of two
+
+    uint32_t capacity() const {
+        return (uint32_t)events_.size();
+    }
+    uint32_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    // Returns the slot to fill, or nullptr if the queue is full; publish with commit()
+    EcgRxEvent* claim();
+    void commit();
+    bool pop(EcgRxEvent* out);
+
+private:
+    std::vector<EcgRxEvent> events_;
+    std::atomic<uint32_t> head_; // Free-running
+    std::atomic<uint32_t> tail_;
+};
+
+struct FrameSpan {
+    uint32_t offset;
+    uint32_t len;
+    uint8_t ctrl; // Control frame, checksum already good
+};
+
+// Splits a byte stream into frames. Bytes are appended with append(); scan() moves the frames
+// found into spans and leaves an incomplete tail in the buffer for the next call.
+class FrameScanner {
+public:
+    FrameScanner();
+
+    void append(const uint8_t* data, size_t len);
+    // Finds the complete frames in the buffer; the spans stay valid until consume()
+    void scan(std::vector<FrameSpan>* spans, EcgRxStats* stats);
+    // Drops the bytes scan() has dealt with
+    void consume();
+    void clear();
+    const uint8_t* data() const {
+        return buf_.data();
+    }
+
+private:
+    std::vector<uint8_t> buf_;
+    size_t pos_ = 0; // Bytes dealt with by the last scan()
+};
+
+class Receiver {
+public:
+    Receiver(uint32_t ring_capacity, uint32_t event_capacity);
+
+    SerialPort& port() {
+        return port_;
+    }
+    SampleRing& ring() {
+        return ring_;
+    }
+    const SampleRing& ring() const {
+        return ring_;
+    }
+    const EcgRxStats& stats() const {
+        return stats_;
+    }
+
+    int pump(int timeout_ms);
+    int feed(const uint8_t* data, size_t len, double arrival);
+    void reset();
+    bool poll_event(EcgRxEvent* out) {
+        return events_.pop(out);
+    }
+
+private:
+    bool decode_samples(const uint8_t* frame, EcgRxEvent* ev);
+
+    SerialPort port_;
+    SampleRing ring_;
+    EventQueue events_;
+    FrameScanner scanner_;
+    std::vector<FrameSpan> spans_;
+    std::vector<uint8_t> read_buf_;
+    std::vector<uint16_t> scratch_; // Decoded samples, ECG_RX_MAX_CHANNELS x ECG_RX_MAX_SAMPLES
+    EcgRxStats stats_ = {};
+};
+
+} // namespace ecg_rx
+
+#endif /* ECG_RX_H_ */
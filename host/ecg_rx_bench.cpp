@@ -0,0 +1,185 @@
+// Throughput of the native receiver (ecg_rx.h) on a pty loopback. Build: see ecg_rx.h.
+//
+//   ./ecg_rx_bench [-n frames] [-c channel_mask] [-e error_percent]
+//
+// Builds a stream like the firmware's (ecg_test_stream.h) and decodes it three ways:
+//   byte-wise   the firmware's ecg_decoder_push(), one call per byte, as the reference
+//   in memory   Receiver::feed() in 4 KB chunks
+//   pty         a writer thread writes the stream to a pty master as fast as it is taken,
+//               and Receiver::pump() reads the slave side, as from a serial port
+// Each run must find the same frames and samples; the exit status is 1 if not.
+
+#include "ecg_rx.h"
+#include "ecg_test_stream.h"
+#include <chrono>
+#include <fcntl.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const size_t CHUNK = 4096;
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// samples == ~0 skips the sample count
+bool check(const char* name,
+           const ecg_rx::TestStream& exp,
+           uint64_t frames,
+           uint64_t ctrl,
+           uint64_t samples) {
+    bool ok = frames == exp.frames && ctrl == exp.ctrl
+              && (samples == exp.samples || samples == ~0ull);
+    if (!ok) {
+        printf("%s: MISMATCH, %llu frames (expected %llu), %llu control (%llu), "
+               "%llu samples (%llu)\n",
+               name,
+               (unsigned long long)frames,
+               (unsigned long long)exp.frames,
+               (unsigned long long)ctrl,
+               (unsigned long long)exp.ctrl,
+               (unsigned long long)samples,
+               (unsigned long long)exp.samples);
+    }
+    return ok;
+}
+
+void report(const char* name, uint64_t frames, size_t bytes, double seconds) {
+    printf("%-12s %10.0f frames/s %8.1f MB/s\n", name, frames / seconds, bytes / seconds / 1e6);
+}
+
+// Drains the events, counting frames, control frames and samples
+void drain(ecg_rx::Receiver* rx, uint64_t* frames, uint64_t* ctrl, uint64_t* samples) {
+    static EcgRxEvent ev;
+    while (rx->poll_event(&ev)) {
+        if (ev.kind == ECG_RX_EVENT_CTRL) {
+            (*ctrl)++;
+        } else {
+            (*frames)++;
+            *samples += ev.num_samples;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t frames = 200000;
+    uint8_t mask = 0x01;
+    uint32_t error_percent = 1;
+    int opt;
+    bool ok = true;
+
+    while ((opt = getopt(argc, argv, "n:c:e:")) != -1) {
+        switch (opt) {
+            case 'n':
+                frames = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'c':
+                mask = (uint8_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'e':
+                error_percent = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            default:
+                fprintf(stderr,
+                        "usage: %s [-n frames] [-c channel_mask] [-e error_percent]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    ecg_rx::TestStream exp;
+    ecg_rx::build_test_stream(frames, mask, error_percent, &exp);
+    const std::vector<uint8_t>& stream = exp.bytes;
+    printf("%u frames, %zu bytes, channel mask 0x%02X, %u%% corrupted\n",
+           frames,
+           stream.size(),
+           mask,
+           error_percent);
+
+    // Byte-wise reference (the firmware's decoder does not decode samples or control frames)
+    {
+        static EcgDecoder dec;
+        EcgFrameHeader header;
+        const uint8_t* payload;
+        uint64_t found = 0;
+        auto start = std::chrono::steady_clock::now();
+        ecg_decoder_init(&dec);
+        for (uint8_t b : stream) {
+            found += (uint64_t)ecg_decoder_push(&dec, b, &header, &payload);
+        }
+        double t = seconds_since(start);
+        report("byte-wise", found, stream.size(), t);
+        ok &= check("byte-wise", exp, found, exp.ctrl, ~0ull);
+    }
+
+    // In memory, chunked
+    {
+        ecg_rx::Receiver rx(1u << 16, 1024);
+        uint64_t found = 0, ctrl = 0, samples = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t pos = 0; pos < stream.size(); pos += CHUNK) {
+            size_t n = stream.size() - pos < CHUNK ? stream.size() - pos : CHUNK;
+            rx.feed(&stream[pos], n, 0.0);
+            drain(&rx, &found, &ctrl, &samples);
+        }
+        double t = seconds_since(start);
+        report("in memory", found + ctrl, stream.size(), t);
+        ok &= check("in memory", exp, found, ctrl, samples);
+    }
+
+    // pty loopback
+    {
+        int master, slave;
+        struct termios tio;
+        if (openpty(&master, &slave, nullptr, nullptr, nullptr) != 0) {
+            perror("openpty");
+            return 1;
+        }
+        tcgetattr(slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+        fcntl(slave, F_SETFL, fcntl(slave, F_GETFL) | O_NONBLOCK);
+
+        ecg_rx::Receiver rx(1u << 16, 1024);
+        rx.port().attach(slave);
+        uint64_t found = 0, ctrl = 0, samples = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::thread writer([&] {
+            for (size_t pos = 0; pos < stream.size();) {
+                ssize_t n = write(master, &stream[pos], std::min(CHUNK, stream.size() - pos));
+                if (n > 0) {
+                    pos += (size_t)n;
+                }
+            }
+        });
+        while (found + ctrl < exp.frames + exp.ctrl && seconds_since(start) < 60) {
+            if (rx.pump(100) < 0) {
+                perror("read");
+                break;
+            }
+            drain(&rx, &found, &ctrl, &samples);
+        }
+        double t = seconds_since(start);
+        writer.join();
+        report("pty", found + ctrl, stream.size(), t);
+        ok &= check("pty", exp, found, ctrl, samples);
+        const EcgRxStats& s = rx.stats();
+        printf("pty stats: %llu header errors, %llu CRC errors, %llu bytes skipped\n",
+               (unsigned long long)s.header_errors,
+               (unsigned long long)s.crc_errors,
+               (unsigned long long)s.bytes_skipped);
+        close(master);
+        close(slave);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+#ifndef ECG_RX_C_H_
+#define ECG_RX_C_H_
+
+#include "ecg_proto.h"
+#include <stdint.h>
+
+// C interface of the native receiver (ecg_rx.h), for ctypes (util/ecg_rx.py) and C callers.
+// One thread pumps a receiver; events, statistics and sample reads are meant for that thread
+// too, except ecg_rx_ring_read(), which any number of other threads may call.
+
+#define ECG_RX_MAX_CHANNELS 8 // Channel mask is 8 bits
+#define ECG_RX_MAX_SAMPLES 4096 // Per channel in one frame; a Rice block claiming more is malformed
+
+// EcgRxEvent.kind
+#define ECG_RX_EVENT_FRAME 0 // An ECG frame that passed both CRCs
+#define ECG_RX_EVENT_CTRL 1 // A link control frame (uart_link.h) with a good checksum
+
+// Link control frames, as in the firmware's uart_link.h
+#define ECG_RX_CTRL_HEADER2 0x5A
+#define ECG_RX_CTRL_FRAME_LEN 8
+#define ECG_RX_CMD_BAUD_OFFER 0x01
+#define ECG_RX_CMD_BAUD_ACK 0x02
+#define ECG_RX_CMD_PROBE 0x03
+#define ECG_RX_CMD_PROBE_ECHO 0x04
+#define ECG_RX_CMD_CONFIRM 0x05
+#define ECG_RX_CMD_RATE_REPORT 0x08
+
+typedef struct {
+    uint8_t kind; // ECG_RX_EVENT_*
+    uint8_t type; // Frame type (EcgFrameType) or control command
+    uint8_t channel_mask;
+    uint8_t num_channels;
+    uint16_t seq;
+    uint16_t payload_len; // Bytes in payload[]; 0 for sample frames, whose samples are in the ring
+    uint32_t sample_index;
+    uint32_t num_samples; // Per channel; 0 for other frames and undecodable sample frames
+    uint32_t arg; // Control argument
+    uint64_t ring_pos; // Ring position of the frame's first sample
+    double arrival; // Wall-clock seconds (as Python's time.time()) when its last byte was read
+    uint8_t payload[ECG_MAX_PAYLOAD];
+} EcgRxEvent;
+
+typedef struct {
+    uint64_t bytes; // Bytes read
+    uint64_t frames_ok;
+    uint64_t ctrl_frames;
+    uint64_t header_errors; // False syncs rejected by the header CRC or length check
+    uint64_t crc_errors; // Frames with a good header but a bad CRC-16, dropped whole
+    uint64_t ctrl_errors; // Control frames with a bad checksum
+    uint64_t bytes_skipped; // Bytes discarded while hunting for sync
+    uint64_t decode_errors; // Sample frames with a malformed payload
+    uint64_t events_dropped; // Events lost because nobody polled them
+} EcgRxStats;
+
+typedef struct EcgRx EcgRx;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opens a serial device in raw 8N1 mode.
+ * @param ring_capacity Samples per channel kept in the ring, a power of two.
+ * @return The receiver, or NULL with errno set.
+ */
+EcgRx* ecg_rx_open(const char* path, uint32_t baud, uint32_t ring_capacity);
+
+/**
+ * @brief Reads from a descriptor someone else opened and configured (e.g. pyserial's fileno()).
+ * The descriptor is not closed with the receiver.
+ */
+EcgRx* ecg_rx_attach(int fd, uint32_t ring_capacity);
+
+void ecg_rx_close(EcgRx* rx);
+
+/**
+ * @brief Changes the baud rate of the descriptor.
+ * @return 0 on success, -1 with errno set.
+ */
+int ecg_rx_set_baud(EcgRx* rx, uint32_t baud);
+
+/**
+ * @brief Writes bytes to the device, e.g. a control frame.
+ * @return Bytes written, or -1 with errno set.
+ */
+int ecg_rx_write(EcgRx* rx, const uint8_t* data, uint32_t len);
+
+/**
+ * @brief Waits up to timeout_ms for data, then reads everything available and decodes it.
+ * @return Events produced, or -1 with errno set if the read failed.
+ */
+int ecg_rx_pump(EcgRx* rx, int timeout_ms);
+
+/**
+ * @brief Decodes bytes from memory as if they had been read.
+ * @return Events produced.
+ */
+int ecg_rx_feed(EcgRx* rx, const uint8_t* data, uint32_t len, double arrival);
+
+/**
+ * @brief Drops buffered bytes not yet decoded, e.g. after a baud rate change.
+ */
+void ecg_rx_reset(EcgRx* rx);
+
+/**
+ * @brief Takes the oldest event.
+ * @return 1 if *out was filled, 0 if there is none.
+ */
+int ecg_rx_poll_event(EcgRx* rx, EcgRxEvent* out);
+
+void ecg_rx_get_stats(const EcgRx* rx, EcgRxStats* out);
+
+uint32_t ecg_rx_ring_capacity(const EcgRx* rx);
+
+/**
+ * @brief Returns the samples written to the ring so far, per channel.
+ */
+uint64_t ecg_rx_ring_head(const EcgRx* rx);
+
+/**
+ * @brief Returns the ring plane of one channel: ring_capacity samples, position p at p % capacity.
+ * Samples older than head - capacity have been overwritten.
+ */
+const uint16_t* ecg_rx_ring_channel(const EcgRx* rx, uint8_t channel);
+
+/**
+ * @brief Copies samples of one channel from *cursor on and advances it. A cursor that fell more
+ * than the capacity behind is first moved up to the oldest sample still held.
+ * @return Samples copied.
+ */
+uint32_t ecg_rx_ring_read(const EcgRx* rx,
+                          uint8_t channel,
+                          uint64_t* cursor,
+                          uint16_t* out,
+                          uint32_t max_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ECG_RX_C_H_ */
@@ -0,0 +1,118 @@
+#include "ecg_test_stream.h"
+#include "ecg_proto.h"
+#include "ecg_rice.h"
+#include "ecg_rx_c.h"
+#include <string.h>
+
+namespace ecg_rx {
+
+// --- Private Definitions ---
+namespace {
+
+uint32_t lcg(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+} // namespace
+
+// --- Function Implementations ---
+
+void build_test_stream(uint32_t frames, uint8_t mask, uint32_t error_percent, TestStream* out) {
+    uint8_t num_channels = 0;
+    uint32_t rng = 1;
+    uint32_t sample_index = 0;
+    uint16_t seq = 0;
+
+    for (uint8_t m = mask; m; m &= (uint8_t)(m - 1)) {
+        num_channels++;
+    }
+    for (uint32_t f = 0; f < frames; f++) {
+        uint8_t frame[ECG_HEADER_LEN + ECG_MAX_PAYLOAD + ECG_TRAILER_LEN];
+        uint8_t payload[ECG_MAX_PAYLOAD];
+        uint16_t samples[TEST_STREAM_SEGMENT_LEN * 8];
+        EcgFrameHeader header;
+        uint16_t len = 0;
+
+        if (f % 100 == 99) {
+            uint8_t ctrl[ECG_RX_CTRL_FRAME_LEN] = {
+                ECG_SYNC0, ECG_RX_CTRL_HEADER2, 0x09, 1, 2, 3, 4, 0
+            };
+            for (int i = 2; i < 7; i++) {
+                ctrl[7] = (uint8_t)(ctrl[7] + ctrl[i]);
+            }
+            out->bytes.insert(out->bytes.end(), ctrl, ctrl + sizeof(ctrl));
+            out->frame_end.push_back(out->bytes.size());
+            out->sample_end.push_back(sample_index);
+            out->ctrl++;
+            continue;
+        }
+        header.seq = seq++;
+        header.channel_mask = mask;
+        header.sample_index = sample_index;
+        if (f % 25 == 24) {
+            header.type = ECG_TYPE_BEAT;
+            len = 5;
+            memset(payload, 0, len);
+        } else {
+            // A sawtooth with some noise, 12-bit codes, interleaved
+            for (uint16_t i = 0; i < TEST_STREAM_SEGMENT_LEN; i++) {
+                for (uint8_t ch = 0; ch < num_channels; ch++) {
+                    uint32_t t = sample_index + i;
+                    int wave = (int)((t * (ch + 3)) % 400) - 200;
+                    samples[i * num_channels + ch] =
+                        (uint16_t)(2048 + wave * 3 + (int)(lcg(&rng) % 9));
+                }
+            }
+            header.type = ECG_TYPE_SAMPLES;
+            for (uint16_t i = 0; i < TEST_STREAM_SEGMENT_LEN * num_channels; i++) {
+                payload[2 * i] = samples[i] & 0xFF;
+                payload[2 * i + 1] = samples[i] >> 8;
+            }
+            len = TEST_STREAM_SEGMENT_LEN * num_channels * 2;
+            if (f % 2) {
+                // Rice, one block per channel with a length prefix when there are several
+                uint8_t packed[ECG_MAX_PAYLOAD];
+                uint16_t packed_len = 0;
+                for (uint8_t ch = 0; ch < num_channels; ch++) {
+                    uint16_t prefix = num_channels > 1 ? 2 : 0;
+                    uint16_t n = ecg_rice_encode(&samples[ch],
+                                                 TEST_STREAM_SEGMENT_LEN,
+                                                 num_channels,
+                                                 packed + packed_len + prefix,
+                                                 (uint16_t)(sizeof(packed) - packed_len - prefix));
+                    if (prefix) {
+                        packed[packed_len] = n & 0xFF;
+                        packed[packed_len + 1] = n >> 8;
+                    }
+                    packed_len += prefix + n;
+                }
+                header.type = ECG_TYPE_SAMPLES_RICE;
+                memcpy(payload, packed, packed_len);
+                len = packed_len;
+            }
+            sample_index += TEST_STREAM_SEGMENT_LEN;
+        }
+        header.payload_len = len;
+        uint16_t frame_len = ecg_encode_frame(frame, &header, payload);
+
+        bool corrupt = error_percent && lcg(&rng) % 100 < error_percent;
+        if (corrupt) {
+            frame[ECG_HEADER_LEN + lcg(&rng) % len] ^= 0x10; // Payload byte: the CRC-16 catches it
+        } else {
+            out->frames++;
+            if (header.type != ECG_TYPE_BEAT) {
+                out->samples += TEST_STREAM_SEGMENT_LEN;
+            }
+        }
+        out->bytes.insert(out->bytes.end(), frame, frame + frame_len);
+        if (error_percent && lcg(&rng) % 100 < error_percent) {
+            static const uint8_t NOISE[] = { 0x00, 0xAA, 0x13, 0xAA, 0x55, 0x20, 0xFF };
+            out->bytes.insert(out->bytes.end(), NOISE, NOISE + sizeof(NOISE));
+        }
+        out->frame_end.push_back(out->bytes.size());
+        out->sample_end.push_back(sample_index);
+    }
+}
+
+} // namespace ecg_rx
@@ -0,0 +1,30 @@
+#ifndef ECG_TEST_STREAM_H_
+#define ECG_TEST_STREAM_H_
+
+// Synthetic board output for the benchmarks: sample frames of TEST_STREAM_SEGMENT_LEN samples
+// per channel, alternating raw and Rice coded, with a beat frame every 25 frames and a control
+// frame (a power report) every 100. With error_percent set, that share of the frames gets one
+// payload byte flipped and some noise is put between frames, so the resync paths run too.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define TEST_STREAM_SEGMENT_LEN 20
+
+namespace ecg_rx {
+
+struct TestStream {
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> frame_end; // Offset just past each frame (and the noise after it)
+    std::vector<uint32_t> sample_end; // Samples per channel sent up to that point
+    uint64_t frames = 0; // ECG frames with a good CRC
+    uint64_t ctrl = 0;
+    uint64_t samples = 0; // Per channel, in good frames
+};
+
+void build_test_stream(uint32_t frames, uint8_t mask, uint32_t error_percent, TestStream* out);
+
+} // namespace ecg_rx
+
+#endif /* ECG_TEST_STREAM_H_ */
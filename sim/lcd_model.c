@@ -0,0 +1,346 @@
+// LCD controller model for the simulator (see lcd_model.h).
+//
+// Each CS-low transaction carries 16-bit words, high byte first. A word sent with
+// RS low selects the index register; with RS high it is written to the indexed
+// register, or to GRAM at the address counter when the index is 0x202. The
+// address counter moves inside the window set by 0x210-0x213 in the direction
+// given by the entry mode register 0x003 (AM, I/D1, I/D0), wrapping to the next
+// line at the window edge like the panel does.
+
+#include "lcd_model.h"
+#include "sim_internal.h"
+#include <stdio.h>
+#include <string.h>
+
+// --- Private Definitions ---
+#define LCD_REG_ENTRY_MODE 0x0003
+#define LCD_REG_RAM_H 0x0200
+#define LCD_REG_RAM_V 0x0201
+#define LCD_REG_RAM_ACCESS 0x0202
+#define LCD_REG_WIN_HSTART 0x0210
+#define LCD_REG_WIN_HEND 0x0211
+#define LCD_REG_WIN_VSTART 0x0212
+#define LCD_REG_WIN_VEND 0x0213
+#define LCD_REG_COUNT 0x0420
+
+#define LCD_ENTRY_AM 0x0008 // Address counter moves vertically first
+#define LCD_ENTRY_ID0 0x0010 // Horizontal increment
+#define LCD_ENTRY_ID1 0x0020 // Vertical increment
+
+// --- Public Variables ---
+LcdStats lcd_stats;
+uint16_t lcd_fb[LCD_HEIGHT][LCD_WIDTH];
+
+// --- Private Variables ---
+static uint16_t lcd_regs[LCD_REG_COUNT];
+static uint8_t lcd_reg_written[LCD_REG_COUNT];
+static uint8_t lcd_px_written[LCD_HEIGHT][LCD_WIDTH];
+static uint16_t lcd_index;
+static uint16_t lcd_ac_h, lcd_ac_v; // GRAM address counter
+static uint8_t lcd_byte_hi;
+static uint8_t lcd_have_hi;
+static uint32_t lcd_cs_bytes; // Bytes seen in the current transaction
+
+static uint64_t lcd_snap_interval;
+static uint64_t lcd_snap_next;
+static uint32_t lcd_snap_count;
+static const char* lcd_snap_dir;
+static uint16_t lcd_snap_prev[LCD_HEIGHT][LCD_WIDTH];
+static uint64_t lcd_snap_pixel_writes; // lcd_stats.pixel_writes at the previous snapshot
+
+static const char* lcd_golden_path;
+
+// --- Address Counter ---
+
+static void lcd_reset_window(void) {
+    lcd_regs[LCD_REG_WIN_HSTART] = 0;
+    lcd_regs[LCD_REG_WIN_HEND] = LCD_GRAM_H - 1;
+    lcd_regs[LCD_REG_WIN_VSTART] = 0;
+    lcd_regs[LCD_REG_WIN_VEND] = LCD_GRAM_V - 1;
+    lcd_regs[LCD_REG_ENTRY_MODE] = LCD_ENTRY_ID0 | LCD_ENTRY_ID1;
+}
+
+// Steps one address inside [lo, hi]; returns 1 when it wrapped around
+static int lcd_step(uint16_t* addr, uint16_t lo, uint16_t hi, int increment) {
+    if (increment) {
+        if (*addr >= hi) {
+            *addr = lo;
+            return 1;
+        }
+        (*addr)++;
+    } else {
+        if (*addr <= lo) {
+            *addr = hi;
+            return 1;
+        }
+        (*addr)--;
+    }
+    return 0;
+}
+
+static void lcd_advance(void) {
+    uint16_t mode = lcd_regs[LCD_REG_ENTRY_MODE];
+    uint16_t hs = lcd_regs[LCD_REG_WIN_HSTART], he = lcd_regs[LCD_REG_WIN_HEND];
+    uint16_t vs = lcd_regs[LCD_REG_WIN_VSTART], ve = lcd_regs[LCD_REG_WIN_VEND];
+    int h_inc = (mode & LCD_ENTRY_ID0) != 0;
+    int v_inc = (mode & LCD_ENTRY_ID1) != 0;
+
+    if (mode & LCD_ENTRY_AM) {
+        if (lcd_step(&lcd_ac_v, vs, ve, v_inc)) {
+            lcd_step(&lcd_ac_h, hs, he, h_inc);
+        }
+    } else {
+        if (lcd_step(&lcd_ac_h, hs, he, h_inc)) {
+            lcd_step(&lcd_ac_v, vs, ve, v_inc);
+        }
+    }
+}
+
+// --- Word Decoder ---
+
+static void lcd_write_pixel(uint16_t color) {
+    lcd_stats.pixel_writes++;
+    if (lcd_ac_h < LCD_GRAM_H && lcd_ac_v < LCD_GRAM_V) {
+        uint16_t* px = &lcd_fb[lcd_ac_h][lcd_ac_v];
+        if (lcd_px_written[lcd_ac_h][lcd_ac_v] && *px == color) {
+            lcd_stats.redundant_pixel_writes++;
+        }
+        *px = color;
+        lcd_px_written[lcd_ac_h][lcd_ac_v] = 1;
+    }
+    lcd_advance();
+}
+
+static void lcd_write_reg(uint16_t value) {
+    lcd_stats.reg_writes++;
+    if (lcd_index >= LCD_REG_COUNT) {
+        return;
+    }
+    if (lcd_reg_written[lcd_index] && lcd_regs[lcd_index] == value) {
+        lcd_stats.redundant_reg_writes++;
+    }
+    lcd_regs[lcd_index] = value;
+    lcd_reg_written[lcd_index] = 1;
+
+    switch (lcd_index) {
+        case LCD_REG_RAM_H:
+            lcd_ac_h = value;
+            break;
+        case LCD_REG_RAM_V:
+            lcd_ac_v = value;
+            break;
+        default:
+            break;
+    }
+}
+
+static void lcd_word(uint16_t word, int rs) {
+    if (!rs) {
+        lcd_stats.index_writes++;
+        lcd_index = word;
+    } else if (lcd_index == LCD_REG_RAM_ACCESS) {
+        lcd_write_pixel(word);
+    } else {
+        lcd_write_reg(word);
+    }
+}
+
+// --- Snapshots ---
+
+static void lcd_snapshot(void) {
+    char path[512];
+    LcdDiff diff;
+
+    snprintf(path, sizeof(path), "%s/lcd_%04lu.ppm", lcd_snap_dir, (unsigned long)lcd_snap_count);
+    lcd_write_ppm(path, &lcd_fb[0][0]);
+    lcd_diff(&lcd_snap_prev[0][0], &lcd_fb[0][0], &diff);
+    printf("[%9.3f ms] %s: %lu pixels changed", sim_now * 1000.0 / SIM_MCLK_HZ, path,
+           (unsigned long)diff.changed);
+    if (diff.changed) {
+        printf(" in (%u,%u)-(%u,%u)", diff.min_x, diff.min_y, diff.max_x, diff.max_y);
+    }
+    printf(", %llu pixel writes\n",
+           (unsigned long long)(lcd_stats.pixel_writes - lcd_snap_pixel_writes));
+
+    memcpy(lcd_snap_prev, lcd_fb, sizeof(lcd_fb));
+    lcd_snap_pixel_writes = lcd_stats.pixel_writes;
+    lcd_snap_count++;
+}
+
+// --- Simulator Hooks ---
+
+static void lcd_spi_byte(uint8_t byte, int rs, int cs_active) {
+    lcd_stats.spi_bytes++;
+    if (!cs_active) {
+        return; // Panel ignores the bus while deselected
+    }
+    lcd_cs_bytes++;
+    if (!lcd_have_hi) {
+        lcd_byte_hi = byte;
+        lcd_have_hi = 1;
+        return;
+    }
+    lcd_have_hi = 0;
+    lcd_word(((uint16_t)lcd_byte_hi << 8) | byte, rs);
+}
+
+static void lcd_spi_cs(int cs_active) {
+    if (cs_active) {
+        return;
+    }
+    // CS high ends the transaction; a dangling high byte is dropped by the panel
+    if (lcd_cs_bytes) {
+        lcd_stats.transactions++;
+    }
+    if (lcd_have_hi) {
+        lcd_stats.odd_bytes++;
+        lcd_have_hi = 0;
+    }
+    lcd_cs_bytes = 0;
+
+    if (lcd_snap_interval && sim_now >= lcd_snap_next) {
+        lcd_snapshot();
+        lcd_snap_next += lcd_snap_interval;
+    }
+}
+
+// --- Public Functions ---
+
+void lcd_model_init(void) {
+    memset(&lcd_stats, 0, sizeof(lcd_stats));
+    memset(lcd_fb, 0, sizeof(lcd_fb));
+    memset(lcd_px_written, 0, sizeof(lcd_px_written));
+    memset(lcd_regs, 0, sizeof(lcd_regs));
+    memset(lcd_reg_written, 0, sizeof(lcd_reg_written));
+    lcd_reset_window();
+    lcd_index = 0;
+    lcd_ac_h = lcd_ac_v = 0;
+    lcd_have_hi = 0;
+    lcd_cs_bytes = 0;
+    sim_spi_sink = lcd_spi_byte;
+    sim_spi_cs = lcd_spi_cs;
+}
+
+void lcd_model_set_snapshots(uint64_t interval_cycles, const char* out_dir) {
+    lcd_snap_interval = interval_cycles;
+    lcd_snap_next = interval_cycles;
+    lcd_snap_dir = out_dir;
+}
+
+void lcd_model_set_golden(const char* path) {
+    lcd_golden_path = path;
+}
+
+int lcd_model_finish(const char* out_dir) {
+    static uint16_t golden[LCD_HEIGHT][LCD_WIDTH];
+    char path[512];
+    int mismatch = 0;
+
+    snprintf(path, sizeof(path), "%s/lcd_final.ppm", out_dir);
+    lcd_write_ppm(path, &lcd_fb[0][0]);
+
+    printf("\nlcd   %10llu transactions, %llu index writes, %llu register writes (%llu redundant)\n",
+           (unsigned long long)lcd_stats.transactions, (unsigned long long)lcd_stats.index_writes,
+           (unsigned long long)lcd_stats.reg_writes,
+           (unsigned long long)lcd_stats.redundant_reg_writes);
+    printf("lcd   %10llu pixel writes, %llu redundant (%.1f%%), %llu odd-byte transactions\n",
+           (unsigned long long)lcd_stats.pixel_writes,
+           (unsigned long long)lcd_stats.redundant_pixel_writes,
+           lcd_stats.pixel_writes
+               ? 100.0 * lcd_stats.redundant_pixel_writes / lcd_stats.pixel_writes
+               : 0.0,
+           (unsigned long long)lcd_stats.odd_bytes);
+
+    if (lcd_golden_path) {
+        LcdDiff diff;
+        if (lcd_read_ppm(lcd_golden_path, &golden[0][0]) != 0) {
+            printf("lcd   cannot read golden image %s\n", lcd_golden_path);
+            return 1;
+        }
+        lcd_diff(&golden[0][0], &lcd_fb[0][0], &diff);
+        if (diff.changed) {
+            printf("lcd   %lu pixels differ from %s in (%u,%u)-(%u,%u)\n",
+                   (unsigned long)diff.changed, lcd_golden_path, diff.min_x, diff.min_y,
+                   diff.max_x, diff.max_y);
+            mismatch = 1;
+        } else {
+            printf("lcd   matches %s\n", lcd_golden_path);
+        }
+    }
+    return mismatch;
+}
+
+void lcd_diff(const uint16_t* a, const uint16_t* b, LcdDiff* out) {
+    uint16_t x, y;
+
+    out->changed = 0;
+    out->min_x = LCD_WIDTH;
+    out->min_y = LCD_HEIGHT;
+    out->max_x = 0;
+    out->max_y = 0;
+    for (y = 0; y < LCD_HEIGHT; y++) {
+        for (x = 0; x < LCD_WIDTH; x++) {
+            if (a[y * LCD_WIDTH + x] == b[y * LCD_WIDTH + x]) {
+                continue;
+            }
+            out->changed++;
+            if (x < out->min_x)
+                out->min_x = x;
+            if (x > out->max_x)
+                out->max_x = x;
+            if (y < out->min_y)
+                out->min_y = y;
+            if (y > out->max_y)
+                out->max_y = y;
+        }
+    }
+}
+
+int lcd_write_ppm(const char* path, const uint16_t* fb) {
+    FILE* f = fopen(path, "wb");
+    uint32_t i;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", LCD_WIDTH, LCD_HEIGHT);
+    for (i = 0; i < (uint32_t)LCD_WIDTH * LCD_HEIGHT; i++) {
+        uint16_t c = fb[i];
+        uint8_t r = (c >> 11) & 0x1F, g = (c >> 5) & 0x3F, b = c & 0x1F;
+        uint8_t rgb[3] = {
+            (uint8_t)((r << 3) | (r >> 2)),
+            (uint8_t)((g << 2) | (g >> 4)),
+            (uint8_t)((b << 3) | (b >> 2)),
+        };
+        fwrite(rgb, 1, sizeof(rgb), f);
+    }
+    fclose(f);
+    return 0;
+}
+
+int lcd_read_ppm(const char* path, uint16_t* fb) {
+    FILE* f = fopen(path, "rb");
+    int w, h, maxval;
+    uint32_t i;
+
+    if (!f) {
+        return -1;
+    }
+    if (fscanf(f, "P6 %d %d %d", &w, &h, &maxval) != 3 || w != LCD_WIDTH || h != LCD_HEIGHT
+        || maxval != 255 || fgetc(f) == EOF)
+    {
+        fclose(f);
+        return -1;
+    }
+    for (i = 0; i < (uint32_t)LCD_WIDTH * LCD_HEIGHT; i++) {
+        uint8_t rgb[3];
+        if (fread(rgb, 1, sizeof(rgb), f) != sizeof(rgb)) {
+            fclose(f);
+            return -1;
+        }
+        fb[i] = ((uint16_t)(rgb[0] >> 3) << 11) | ((uint16_t)(rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+    }
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef LCD_MODEL_H_
+#define LCD_MODEL_H_
+
+// Model of the LCD controller behind tft_SendIndex()/tft_SendData(), fed from the
+// simulated USCI_B1. Keeps the panel's GRAM as a 320x240 RGB565 framebuffer in the
+// landscape orientation the etft_ functions draw in, and counts the SPI traffic
+// that went into it.
+
+#include <stdint.h>
+
+#define LCD_GRAM_H 240 // Controller horizontal address range (0x200, 0x210-0x211)
+#define LCD_GRAM_V 320 // Controller vertical address range (0x201, 0x212-0x213)
+
+// Framebuffer in screen coordinates: x = GRAM vertical address, y = GRAM horizontal address
+#define LCD_WIDTH LCD_GRAM_V
+#define LCD_HEIGHT LCD_GRAM_H
+
+typedef struct {
+    uint64_t spi_bytes;
+    uint64_t transactions; // CS low-high cycles that carried data
+    uint64_t index_writes;
+    uint64_t reg_writes; // Data words to registers other than GRAM
+    uint64_t redundant_reg_writes; // Register already held the written value
+    uint64_t pixel_writes;
+    uint64_t redundant_pixel_writes; // Same colour written over the same colour
+    uint64_t odd_bytes; // Transactions ending on half a word
+} LcdStats;
+
+typedef struct {
+    uint32_t changed; // Pixels that differ
+    uint16_t min_x, min_y, max_x, max_y; // Bounding box of the differences, valid if changed > 0
+} LcdDiff;
+
+extern LcdStats lcd_stats;
+extern uint16_t lcd_fb[LCD_HEIGHT][LCD_WIDTH];
+
+// Hooks the model into the simulator's SPI output and resets it
+void lcd_model_init(void);
+
+// Writes snapshots every interval_cycles of virtual time into out_dir (0 disables)
+void lcd_model_set_snapshots(uint64_t interval_cycles, const char* out_dir);
+
+// Compares the final frame against a golden PPM in lcd_model_finish()
+void lcd_model_set_golden(const char* path);
+
+// Writes the final frame and prints the report; returns nonzero if the golden image differs
+int lcd_model_finish(const char* out_dir);
+
+// Counts the pixels that differ between two framebuffers
+void lcd_diff(const uint16_t* a, const uint16_t* b, LcdDiff* out);
+
+// Writes a framebuffer as a binary PPM (P6); returns 0 on success
+int lcd_write_ppm(const char* path, const uint16_t* fb);
+
+// Reads a 320x240 binary PPM back into RGB565; returns 0 on success
+int lcd_read_ppm(const char* path, uint16_t* fb);
+
+#endif /* LCD_MODEL_H_ */
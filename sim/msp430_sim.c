@@ -0,0 +1,1127 @@
+// Host simulator for the MSP430F6638 peripherals used by the ECG firmware.
+//
+// Build from the repository root (the firmware sources are compiled unmodified):
+//   gcc -O2 -DHOST_SIM -Isim -Idma-adc-display -Wno-unknown-pragmas -o msp430_sim
+//       sim/*.c dma-adc-display/*.c -lm
+// Run:
+//   ./msp430_sim [-t seconds] [-b host_max_baud] [-o output_dir] [-s snapshot_ms] [-g golden.ppm]
+//                [-r recording.ecgr] [-f sample_rate]
+//
+// Models: Timer_A0 in up mode driving the ADC12 sample trigger (TA0.1), Timer_A1
+// counting ACLK and Timer_B0 counting SMCLK in continuous mode (read only, no
+// interrupts), ADC12_A
+// conversions into MEM0 (repeat-single-channel) or MEM0..n (repeat-sequence, one conversion
+// per trigger starting at MEM0, DMA trigger at the end of sequence), DMA channels 0-5 (single/block, repeated, ADC12IFG and
+// USCI TXIFG triggers), USCI_A1 UART and USCI_B1 SPI with byte timing from their
+// dividers, the MPY32 multiplier, and a PC on the other end of the UART that answers the baud rate
+// negotiation. The SPI side drives the LCD controller model in lcd_model.c.
+// Interrupts are dispatched at register accesses, which is where
+// the firmware's visible behavior changes.
+//
+// Virtual time is counted in MCLK cycles. Only register accesses, DMA transfers,
+// interrupt entry/exit, __delay_cycles() and idle time advance it; plain CPU
+// work between accesses is free. The per-peripheral cycle report therefore
+// compares peripheral costs between builds, not absolute CPU load.
+//
+// Outputs in the output directory:
+//   uart_tx.bin  every byte the UART sent, ready for the host-side decoders
+//   spi_tx.bin   every SPI byte as two bytes: flags (bit 0 RS, bit 1 CS active) and data
+//   lcd_final.ppm  the panel contents at the end of the run
+//   lcd_NNNN.ppm   panel snapshots every snapshot_ms of virtual time (-s)
+//
+// With -r the ADC input is a recording made by util/ecg_convert.py instead of the
+// built-in synthetic beat (replay_source.c), played from the first conversion on.
+// It drives every input alike; the synthetic beat differs per input (An scaled as a
+// different lead, A7 a flat half-scale reference).
+// util/ecg_qrs_bench.py uses this to score the firmware's beat detection.
+//
+// With -f the emulated PC asks the firmware for another sample rate (LINK_CMD_SET_RATE)
+// when it reports its start-up rate. Capture restarts at the new rate, and so do the
+// ADC source and the firmware's sample index.
+//
+// With -g the final panel is compared against a golden PPM and the exit status
+// is 2 if any pixel differs.
+
+#define SIM_IMPL
+#include "msp430_sim.h"
+#include "lcd_model.h"
+#include "replay_source.h"
+#include "sim_internal.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// --- Private Definitions ---
+#define SIM_CYCLES_REG_ACCESS 3 // mov &reg, Rn / mov Rn, &reg
+#define SIM_CYCLES_DMA_TRANSFER 2 // CPU is held for 2 MCLK per DMA transfer
+#define SIM_CYCLES_ISR_ENTRY 6
+#define SIM_CYCLES_ISR_EXIT 5 // RETI
+#define SIM_ADC_CONVERSION_CYCLES (13 * SIM_SMCLK_DIV) // 12-bit conversion after the S/H time
+#define SIM_HOST_REPLY_CYCLES (SIM_MCLK_HZ / 1000) // PC answers a control frame after ~1 ms
+
+#define SIM_NO_EVENT UINT64_MAX
+
+// ADC12 trigger source 24, USCI_B1 TXIFG 23, USCI_A1 TXIFG 21 (device datasheet, DMA trigger table)
+#define SIM_DMA_TRIG_UCA1TX 21
+#define SIM_DMA_TRIG_UCB1TX 23
+#define SIM_DMA_TRIG_ADC12 24
+
+extern void DMA_ISR(void);
+extern void USCI_A1_ISR(void);
+extern void firmware_main(void);
+
+typedef enum {
+    SIM_GRP_SYS,
+    SIM_GRP_PORT,
+    SIM_GRP_TIMER,
+    SIM_GRP_ADC,
+    SIM_GRP_DMA,
+    SIM_GRP_UART,
+    SIM_GRP_SPI,
+    SIM_GRP_MPY,
+    SIM_GRP_COUNT
+} SimGroup;
+
+static const char* const sim_group_names[SIM_GRP_COUNT] = {
+    "system", "ports", "timer", "adc", "dma", "uart", "spi", "mpy32",
+};
+
+typedef struct {
+    volatile uint16_t* ctl;
+    volatile uint16_t* sz;
+    volatile unsigned long* sa;
+    volatile unsigned long* da;
+    unsigned long work_sa; // Working registers, latched when DMAEN is set
+    unsigned long work_da;
+    uint16_t work_sz;
+    uint16_t init_sz; // DMAxSZ as written; the visible register counts down through a block
+    uint8_t enabled;
+    uint64_t transfers;
+} SimDma;
+
+// One USCI in transmit-only terms: TXBUF, a shift register and the bit clock
+typedef struct {
+    volatile uint8_t* ctl1;
+    volatile uint16_t* brw;
+    volatile uint8_t* txbuf;
+    volatile uint8_t* ifg;
+    volatile uint8_t* ie;
+    volatile uint8_t* stat;
+    uint8_t dma_trigger;
+    uint8_t bits_per_byte; // 8 for SPI, 10 for 8N1 UART
+    uint8_t txbuf_full;
+    uint8_t shifting;
+    uint8_t shift_byte;
+    uint8_t prev_ifg; // Last IFG value seen, for firmware-made TXIFG edges
+    uint64_t load_at; // TXBUF -> shift register
+    uint64_t done_at; // Last bit out
+    uint64_t bytes;
+    uint64_t poll_accesses; // IFG/STAT reads while the shifter was busy
+} SimUsci;
+
+typedef struct {
+    uint64_t at;
+    uint8_t byte;
+} SimRxByte;
+
+// --- Public Variables ---
+volatile SimRegs sim_regs;
+uint64_t sim_now = 0;
+SimStats sim_stats;
+uint16_t (*sim_adc_source)(uint64_t sample_index) = 0;
+void (*sim_spi_sink)(uint8_t byte, int rs, int cs_active) = 0;
+void (*sim_spi_cs)(int cs_active) = 0;
+
+// --- Private Variables ---
+static uint64_t sim_end = (uint64_t)SIM_MCLK_HZ * 10; // Default run: 10 s of virtual time
+static const char* sim_out_dir = ".";
+static FILE* sim_uart_file;
+static FILE* sim_spi_file;
+static uint8_t sim_lcd_cs_prev = BIT0; // P5.0 as last seen, CS idles high
+
+static volatile void* sim_pending; // Register of the previous access, its write is applied lazily
+static int sim_taking_address = 0; // Register names only yield their address, see sim_address_only()
+static int sim_gie = 0;
+static int sim_in_isr = 0;
+static uint16_t sim_sleep_bits = 0; // LPM bits while the CPU is off
+static uint16_t sim_wake_bits = 0; // Cleared from the saved SR by an ISR
+
+static SimDma sim_dma[6];
+static SimUsci sim_uart;
+static SimUsci sim_spi;
+
+static uint8_t sim_timer_running = 0;
+static uint64_t sim_timer_next_shi = SIM_NO_EVENT; // Next TA0.1 rising edge (ADC12 SHI)
+static uint64_t sim_adc_done_at = SIM_NO_EVENT;
+static uint64_t sim_ta1_origin = 0; // Virtual time at which TA1R was 0, while TA1 counts
+static int sim_ta1_running = 0;
+static uint64_t sim_tb0_origin = 0; // The same for TB0R
+static int sim_tb0_running = 0;
+static uint64_t sim_adc_samples = 0; // Sample sets converted
+static unsigned sim_adc_seq_pos = 0; // MCTL entry of the next conversion
+
+// MPY32 operand 1 as last written
+static uint32_t sim_mpy_op1;
+static uint8_t sim_mpy_signed;
+static uint8_t sim_mpy_accumulate;
+static uint8_t sim_mpy_op1_32; // Operand 1 came from a 32-bit register pair
+
+// Emulated PC on the UART
+static uint32_t sim_host_max_baud = 460800;
+static uint32_t sim_host_rate = 0; // Sample rate to ask for when the firmware reports its own, or 0
+static uint8_t sim_host_frame[8];
+static uint8_t sim_host_fill = 0;
+static SimRxByte sim_rx_queue[64];
+static uint16_t sim_rx_head = 0, sim_rx_tail = 0;
+
+// --- Private Function Prototypes ---
+static void sim_sync(void);
+static void sim_advance_to(uint64_t target);
+static void sim_dispatch(void);
+static void sim_finish(void);
+
+// --- Register Groups ---
+
+static SimGroup sim_group_of(volatile void* reg) {
+    const volatile uint8_t* p = (const volatile uint8_t*)reg;
+    if (p >= (const volatile uint8_t*)&sim_regs.MPY)
+        return SIM_GRP_MPY;
+    if (p >= (const volatile uint8_t*)&sim_regs.UCB1CTL0)
+        return SIM_GRP_SPI;
+    if (p >= (const volatile uint8_t*)&sim_regs.UCA1CTL0)
+        return SIM_GRP_UART;
+    if (p >= (const volatile uint8_t*)&sim_regs.DMACTL0)
+        return SIM_GRP_DMA;
+    if (p >= (const volatile uint8_t*)&sim_regs.ADC12CTL0)
+        return SIM_GRP_ADC;
+    if (p >= (const volatile uint8_t*)&sim_regs.TA0CTL)
+        return SIM_GRP_TIMER;
+    if (p >= (const volatile uint8_t*)&sim_regs.P1OUT)
+        return SIM_GRP_PORT;
+    return SIM_GRP_SYS;
+}
+
+// --- USCI Model ---
+
+static uint64_t sim_usci_bit_cycles(const SimUsci* u) {
+    uint16_t br = *u->brw ? *u->brw : 1;
+    return (uint64_t)br * SIM_SMCLK_DIV;
+}
+
+static void sim_dma_trigger(uint8_t source);
+
+static void sim_usci_set_txifg(SimUsci* u) {
+    if (!(*u->ifg & UCTXIFG)) {
+        *u->ifg |= UCTXIFG;
+        u->prev_ifg = *u->ifg;
+        sim_dma_trigger(u->dma_trigger);
+    }
+}
+
+static void sim_usci_write(SimUsci* u, uint8_t byte) {
+    *u->txbuf = byte;
+    u->txbuf_full = 1;
+    *u->ifg &= ~UCTXIFG;
+    u->prev_ifg = *u->ifg;
+    if (!u->shifting && u->load_at == SIM_NO_EVENT) {
+        u->load_at = sim_now + SIM_SMCLK_DIV; // One BRCLK to move into the shift register
+    }
+}
+
+static void sim_usci_reset(SimUsci* u) {
+    // UCSWRST: shifter stops, UCTXIFG set, interrupt enables cleared
+    u->txbuf_full = 0;
+    u->shifting = 0;
+    u->load_at = SIM_NO_EVENT;
+    u->done_at = SIM_NO_EVENT;
+    *u->ie = 0;
+    *u->ifg = UCTXIFG;
+    u->prev_ifg = *u->ifg;
+}
+
+static uint64_t sim_usci_next_event(const SimUsci* u) {
+    return (u->load_at < u->done_at) ? u->load_at : u->done_at;
+}
+
+static void sim_uart_host_rx(uint8_t byte);
+
+static void sim_usci_event(SimUsci* u) {
+    if (u->done_at <= sim_now) {
+        u->done_at = SIM_NO_EVENT;
+        u->shifting = 0;
+        u->bytes++;
+        if (u == &sim_spi) {
+            int rs = (sim_regs.P5OUT & BIT2) != 0;
+            int cs_active = (sim_regs.P5OUT & BIT0) == 0;
+            uint8_t rec[2] = { (uint8_t)(rs | (cs_active << 1)), u->shift_byte };
+            fwrite(rec, 1, sizeof(rec), sim_spi_file);
+            if (sim_spi_sink) {
+                sim_spi_sink(u->shift_byte, rs, cs_active);
+            }
+        } else {
+            fputc(u->shift_byte, sim_uart_file);
+            sim_uart_host_rx(u->shift_byte);
+        }
+        if (u->txbuf_full) {
+            u->load_at = sim_now; // Back-to-back bytes
+        }
+    }
+    if (u->load_at <= sim_now) {
+        u->load_at = SIM_NO_EVENT;
+        u->shift_byte = *u->txbuf;
+        u->txbuf_full = 0;
+        u->shifting = 1;
+        u->done_at = sim_now + sim_usci_bit_cycles(u) * u->bits_per_byte;
+        sim_usci_set_txifg(u);
+    }
+}
+
+static void sim_usci_update_stat(SimUsci* u) {
+    if (u->shifting || u->txbuf_full) {
+        *u->stat |= UCBUSY;
+    } else {
+        *u->stat &= ~UCBUSY;
+    }
+}
+
+// --- UART Receive Side and Emulated PC ---
+
+static void sim_rx_push(uint8_t byte, uint64_t at) {
+    uint16_t next = (sim_rx_head + 1) % (sizeof(sim_rx_queue) / sizeof(sim_rx_queue[0]));
+    if (next == sim_rx_tail) {
+        return;
+    }
+    sim_rx_queue[sim_rx_head].at = at;
+    sim_rx_queue[sim_rx_head].byte = byte;
+    sim_rx_head = next;
+}
+
+static void sim_host_send_ctrl(uint8_t cmd, uint32_t arg) {
+    uint8_t frame[8] = { 0xAA, 0x5A, cmd };
+    uint64_t byte_cycles = sim_usci_bit_cycles(&sim_uart) * 10;
+    uint64_t at = sim_now + SIM_HOST_REPLY_CYCLES;
+    uint8_t i;
+
+    frame[7] = cmd;
+    for (i = 0; i < 4; i++) {
+        frame[3 + i] = (arg >> (8 * i)) & 0xFF;
+        frame[7] += frame[3 + i];
+    }
+    for (i = 0; i < sizeof(frame); i++) {
+        sim_rx_push(frame[i], at + byte_cycles * (i + 1));
+    }
+}
+
+// Answers the firmware's link negotiation like util/ecg_receiver.py does
+static void sim_uart_host_rx(uint8_t byte) {
+    uint32_t arg;
+    uint8_t sum;
+
+    if ((sim_host_fill == 0 && byte != 0xAA) || (sim_host_fill == 1 && byte != 0x5A)) {
+        sim_host_fill = (byte == 0xAA) ? 1 : 0;
+        if (sim_host_fill) {
+            sim_host_frame[0] = byte;
+        }
+        return;
+    }
+    sim_host_frame[sim_host_fill++] = byte;
+    if (sim_host_fill < sizeof(sim_host_frame)) {
+        return;
+    }
+    sim_host_fill = 0;
+
+    sum = sim_host_frame[2] + sim_host_frame[3] + sim_host_frame[4] + sim_host_frame[5]
+        + sim_host_frame[6];
+    if (sum != sim_host_frame[7]) {
+        return;
+    }
+    arg = (uint32_t)sim_host_frame[3] | ((uint32_t)sim_host_frame[4] << 8)
+        | ((uint32_t)sim_host_frame[5] << 16) | ((uint32_t)sim_host_frame[6] << 24);
+    switch (sim_host_frame[2]) {
+        case 0x01: // BAUD_OFFER
+            if (arg <= sim_host_max_baud) {
+                sim_host_send_ctrl(0x02, arg);
+            }
+            break;
+        case 0x03: // PROBE
+            sim_host_send_ctrl(0x04, arg);
+            break;
+        case 0x05: // CONFIRM
+            printf("[%9.3f ms] link confirmed at %lu baud\n", sim_now * 1000.0 / SIM_MCLK_HZ,
+                   (unsigned long)arg);
+            break;
+        case 0x06: // LINK_REPORT
+            printf("[%9.3f ms] link report: need %lu B/s, capacity %lu B/s\n",
+                   sim_now * 1000.0 / SIM_MCLK_HZ, (unsigned long)(arg & 0xFFFF),
+                   (unsigned long)(arg >> 16));
+            break;
+        case 0x08: // RATE_REPORT
+            printf("[%9.3f ms] sample rate %lu Hz, %lu-bit samples%s\n",
+                   sim_now * 1000.0 / SIM_MCLK_HZ, (unsigned long)(arg & 0xFFFF),
+                   12 + (unsigned long)(arg >> 24), (arg >> 16 & 0xFF) ? " kept, request refused" : "");
+            if (sim_host_rate && (arg & 0xFFFF) != sim_host_rate) {
+                sim_host_send_ctrl(0x07, sim_host_rate); // SET_RATE
+            }
+            sim_host_rate = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static void sim_rx_event(void) {
+    while (sim_rx_tail != sim_rx_head && sim_rx_queue[sim_rx_tail].at <= sim_now) {
+        if (sim_regs.UCA1IFG & UCRXIFG) {
+            sim_stats.uart_rx_overruns++;
+        }
+        sim_regs.UCA1RXBUF = sim_rx_queue[sim_rx_tail].byte;
+        sim_regs.UCA1IFG |= UCRXIFG;
+        sim_uart.prev_ifg = sim_regs.UCA1IFG;
+        sim_rx_tail = (sim_rx_tail + 1) % (sizeof(sim_rx_queue) / sizeof(sim_rx_queue[0]));
+    }
+}
+
+static uint64_t sim_rx_next_event(void) {
+    return (sim_rx_tail != sim_rx_head) ? sim_rx_queue[sim_rx_tail].at : SIM_NO_EVENT;
+}
+
+// --- DMA Model ---
+
+static uint8_t sim_dma_tsel(uint8_t ch) {
+    volatile uint16_t* ctl = (ch < 2) ? &sim_regs.DMACTL0 : (ch < 4) ? &sim_regs.DMACTL1 : &sim_regs.DMACTL2;
+    return (ch & 1) ? (*ctl >> 8) & 0x1F : *ctl & 0x1F;
+}
+
+static void sim_dma_latch(SimDma* d) {
+    d->work_sa = *d->sa;
+    d->work_da = *d->da;
+    d->init_sz = *d->sz;
+    d->work_sz = d->init_sz;
+}
+
+static void sim_dma_step_addr(unsigned long* addr, uint16_t incr_bits, unsigned step) {
+    if (incr_bits == 3) {
+        *addr += step;
+    } else if (incr_bits == 2) {
+        *addr -= step;
+    }
+}
+
+static void sim_dma_transfer(SimDma* d) {
+    uint16_t ctl = *d->ctl;
+    unsigned src_step = (ctl & DMASRCBYTE) ? 1 : 2;
+    unsigned dst_step = (ctl & DMADSTBYTE) ? 1 : 2;
+    uint16_t value;
+
+    if (src_step == 1) {
+        value = *(volatile uint8_t*)d->work_sa;
+    } else {
+        value = *(volatile uint16_t*)d->work_sa;
+    }
+    if (d->work_sa >= (unsigned long)&sim_regs.ADC12MEM[0]
+        && d->work_sa < (unsigned long)&sim_regs.ADC12MEM[16])
+    {
+        // Reading MEMx clears its flag
+        sim_regs.ADC12IFG &= ~(1u << ((uint16_t*)d->work_sa - sim_regs.ADC12MEM));
+    }
+
+    if (d->work_da == (unsigned long)&sim_regs.UCB1TXBUF) {
+        sim_usci_write(&sim_spi, (uint8_t)value);
+    } else if (d->work_da == (unsigned long)&sim_regs.UCA1TXBUF) {
+        sim_usci_write(&sim_uart, (uint8_t)value);
+    } else if (dst_step == 1) {
+        *(volatile uint8_t*)d->work_da = (uint8_t)value;
+    } else {
+        *(volatile uint16_t*)d->work_da = value;
+    }
+
+    sim_dma_step_addr(&d->work_sa, (ctl >> 8) & 3, src_step);
+    sim_dma_step_addr(&d->work_da, (ctl >> 10) & 3, dst_step);
+    d->transfers++;
+    sim_now += SIM_CYCLES_DMA_TRANSFER;
+    sim_stats.dma_cycles += SIM_CYCLES_DMA_TRANSFER;
+
+    *d->sz = --d->work_sz;
+    if (d->work_sz == 0) {
+        *d->sz = d->init_sz; // Reloaded with its initial value
+        *d->ctl |= DMAIFG;
+        if ((ctl & 0x4000) != 0) {
+            sim_dma_latch(d); // Repeated modes reload from the visible registers
+        } else {
+            *d->ctl &= ~DMAEN;
+            d->enabled = 0;
+        }
+    }
+}
+
+static void sim_dma_trigger(uint8_t source) {
+    uint8_t ch;
+    for (ch = 0; ch < 6; ch++) {
+        SimDma* d = &sim_dma[ch];
+        if (!d->enabled || sim_dma_tsel(ch) != source) {
+            continue;
+        }
+        if (((*d->ctl >> 12) & 3) == 0) {
+            sim_dma_transfer(d); // Single transfer per trigger
+        } else {
+            do {
+                sim_dma_transfer(d); // Block/burst: the whole block per trigger
+            } while (d->enabled && d->work_sz != d->init_sz);
+        }
+    }
+}
+
+static void sim_dma_check_enable(void) {
+    uint8_t ch;
+    for (ch = 0; ch < 6; ch++) {
+        SimDma* d = &sim_dma[ch];
+        uint8_t en = (*d->ctl & DMAEN) != 0;
+        if (en && !d->enabled) {
+            sim_dma_latch(d);
+        }
+        d->enabled = en;
+    }
+}
+
+static uint16_t sim_dma_read_iv(void) {
+    uint8_t ch;
+    for (ch = 0; ch < 6; ch++) {
+        uint16_t ctl = *sim_dma[ch].ctl;
+        if ((ctl & DMAIFG) && (ctl & DMAIE)) {
+            *sim_dma[ch].ctl &= ~DMAIFG;
+            return 2 * (ch + 1);
+        }
+    }
+    return 0;
+}
+
+// --- Timer_A0 and ADC12 ---
+
+static uint64_t sim_timer_period(void) {
+    return ((uint64_t)sim_regs.TA0CCR0 + 1) * SIM_SMCLK_DIV;
+}
+
+static void sim_timer_update(void) {
+    int running = (sim_regs.TA0CTL & MC_3) == MC__UP && (sim_regs.TA0CTL & 0x0300) == TASSEL__SMCLK;
+
+    if (sim_regs.TA0CTL & TACLR) {
+        sim_regs.TA0CTL &= ~TACLR; // Self-clearing
+        sim_timer_running = 0;
+    }
+    if (running && !sim_timer_running) {
+        sim_timer_next_shi = sim_now + (uint64_t)sim_regs.TA0CCR1 * SIM_SMCLK_DIV;
+        sim_adc_samples = 0; // The ADC source restarts with the firmware's sample index
+        sim_adc_seq_pos = 0;
+    } else if (!running) {
+        sim_timer_next_shi = SIM_NO_EVENT;
+    }
+    sim_timer_running = running;
+}
+
+// Conversions per sample set: the MCTL entries up to and including the first EOS in
+// repeat-sequence mode (the firmware always starts at MEM0), else 1
+static unsigned sim_adc_sequence_len(void) {
+    unsigned n = 1;
+
+    if ((sim_regs.ADC12CTL1 & ADC12CONSEQ_3) == ADC12CONSEQ_3) {
+        while (n < 16 && !(sim_regs.ADC12MCTL[n - 1] & ADC12EOS)) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static uint16_t sim_ta1_count(void) {
+    return (uint16_t)((sim_now - sim_ta1_origin) * SIM_ACLK_HZ / SIM_MCLK_HZ);
+}
+
+static void sim_ta1_update(void) {
+    int running = (sim_regs.TA1CTL & MC_3) == MC__CONTINUOUS
+        && (sim_regs.TA1CTL & 0x0300) == TASSEL__ACLK;
+
+    if (sim_ta1_running) {
+        sim_regs.TA1R = sim_ta1_count();
+    }
+    if (sim_regs.TA1CTL & TACLR) {
+        sim_regs.TA1CTL &= ~TACLR; // Self-clearing
+        sim_regs.TA1R = 0;
+    }
+    // Resume from the held count
+    sim_ta1_origin = sim_now - ((uint64_t)sim_regs.TA1R * SIM_MCLK_HZ + SIM_ACLK_HZ - 1) / SIM_ACLK_HZ;
+    sim_ta1_running = running;
+}
+
+static uint16_t sim_tb0_count(void) {
+    return (uint16_t)((sim_now - sim_tb0_origin) / SIM_SMCLK_DIV);
+}
+
+static void sim_tb0_update(void) {
+    int running = (sim_regs.TB0CTL & MC_3) == MC__CONTINUOUS
+        && (sim_regs.TB0CTL & 0x0300) == TBSSEL__SMCLK;
+
+    if (sim_tb0_running) {
+        sim_regs.TB0R = sim_tb0_count();
+    }
+    if (sim_regs.TB0CTL & TBCLR) {
+        sim_regs.TB0CTL &= ~TBCLR; // Self-clearing
+        sim_regs.TB0R = 0;
+    }
+    sim_tb0_origin = sim_now - (uint64_t)sim_regs.TB0R * SIM_SMCLK_DIV;
+    sim_tb0_running = running;
+}
+
+// TA0R from the time left to the next TA0.1 edge, where the count equals TA0CCR1
+static uint16_t sim_ta0_count(void) {
+    uint64_t period = (uint64_t)sim_regs.TA0CCR0 + 1;
+    uint64_t until_edge = (sim_timer_next_shi - sim_now) / SIM_SMCLK_DIV % period;
+
+    return (uint16_t)((sim_regs.TA0CCR1 + period - until_edge) % period);
+}
+
+static uint16_t sim_adc_default_source(uint8_t input, uint64_t n) {
+    // Synthetic lead-II-like beat at 72 bpm on a 1.65 V baseline, sampled at the ADC rate.
+    // Each input sees it with its own gain, like a different lead; A7 is a flat reference.
+    static const double gain[8] = { 1.0, 0.6, -0.4, 0.8, 0.3, -0.7, 0.5, 0.0 };
+    double t = (double)n * sim_timer_period() * sim_adc_sequence_len() / SIM_MCLK_HZ;
+    double p = fmod(t, 60.0 / 72.0);
+    double v = 0.10 * exp(-pow((p - 0.20) / 0.030, 2)) + 1.00 * exp(-pow((p - 0.35) / 0.008, 2))
+        - 0.15 * exp(-pow((p - 0.37) / 0.010, 2)) + 0.25 * exp(-pow((p - 0.55) / 0.050, 2));
+    return (uint16_t)(2048 + 800 * gain[input & 7] * v);
+}
+
+// ADC12SHT0x field (ADC12CTL0 bits 8-11) in ADC12CLK cycles
+static uint64_t sim_adc_sample_cycles(void) {
+    static const uint16_t sht_cycles[16] = { 4,   8,   16,  32,  64,   96,   128,  192,
+                                             256, 384, 512, 768, 1024, 1024, 1024, 1024 };
+    return (uint64_t)sht_cycles[(sim_regs.ADC12CTL0 >> 8) & 0x0F] * SIM_SMCLK_DIV;
+}
+
+static void sim_timer_event(void) {
+    sim_timer_next_shi += sim_timer_period();
+    if ((sim_regs.ADC12CTL0 & (ADC12ON | ADC12ENC)) == (ADC12ON | ADC12ENC)
+        && (sim_regs.ADC12CTL1 & 0x0C00) == ADC12SHS_1)
+    {
+        if (sim_adc_done_at != SIM_NO_EVENT) {
+            sim_stats.adc_timing_overflows++; // The trigger is lost, the running conversion ends
+        } else {
+            sim_adc_done_at = sim_now + sim_adc_sample_cycles() + SIM_ADC_CONVERSION_CYCLES;
+        }
+    }
+}
+
+static void sim_adc_event(void) {
+    unsigned pos = sim_adc_seq_pos;
+    uint8_t input = sim_regs.ADC12MCTL[pos] & 0x0F;
+    int end_of_sequence = pos + 1 >= sim_adc_sequence_len();
+
+    sim_adc_done_at = SIM_NO_EVENT;
+    if (sim_regs.ADC12IFG & (1u << pos)) {
+        sim_stats.adc_overflows++; // Previous result never read
+    }
+    sim_regs.ADC12MEM[pos] = (sim_adc_source ? sim_adc_source(sim_adc_samples)
+                                             : sim_adc_default_source(input, sim_adc_samples))
+        & 0x0FFF;
+    sim_regs.ADC12IFG |= 1u << pos;
+    sim_stats.adc_conversions++;
+    if (end_of_sequence) {
+        // Only the last conversion of a sequence triggers the DMA
+        sim_adc_seq_pos = 0;
+        sim_adc_samples++;
+        sim_dma_trigger(SIM_DMA_TRIG_ADC12);
+    } else {
+        sim_adc_seq_pos++;
+    }
+}
+
+// --- MPY32 ---
+
+static void sim_mpy_op1_write(volatile uint16_t* reg) {
+    // MPY, MPYS, MAC, MACS, then the 32-bit pairs in the same order
+    unsigned idx = (unsigned)(reg - &sim_regs.MPY);
+    unsigned mode;
+
+    if (idx < 4) {
+        mode = idx;
+        sim_mpy_op1 = *reg;
+        sim_mpy_op1_32 = 0;
+    } else {
+        mode = (idx - 4) / 2;
+        if ((idx - 4) % 2 == 0) {
+            sim_mpy_op1 = (sim_mpy_op1 & 0xFFFF0000UL) | *reg;
+        } else {
+            sim_mpy_op1 = (sim_mpy_op1 & 0x0000FFFFUL) | ((uint32_t)*reg << 16);
+        }
+        sim_mpy_op1_32 = 1;
+    }
+    sim_mpy_signed = mode & 1;
+    sim_mpy_accumulate = mode >= 2;
+}
+
+static void sim_mpy_run(int op2_32) {
+    int64_t a, b;
+    uint64_t result;
+
+    if (sim_mpy_signed) {
+        a = sim_mpy_op1_32 ? (int64_t)(int32_t)sim_mpy_op1 : (int64_t)(int16_t)sim_mpy_op1;
+        b = op2_32 ? (int64_t)(int32_t)(((uint32_t)sim_regs.OP2H << 16) | sim_regs.OP2)
+                   : (int64_t)(int16_t)sim_regs.OP2;
+    } else {
+        a = sim_mpy_op1_32 ? (int64_t)sim_mpy_op1 : (int64_t)(uint16_t)sim_mpy_op1;
+        b = op2_32 ? (int64_t)(((uint32_t)sim_regs.OP2H << 16) | sim_regs.OP2)
+                   : (int64_t)sim_regs.OP2;
+    }
+    result = (uint64_t)(a * b);
+
+    if (!sim_mpy_op1_32 && !op2_32) {
+        // 16x16: a 32-bit result in RES1:RES0, SUMEXT holds the sign or the carry
+        uint32_t acc = (uint32_t)result;
+        if (sim_mpy_accumulate) {
+            uint32_t prev = ((uint32_t)sim_regs.RES1 << 16) | sim_regs.RES0;
+            acc = prev + (uint32_t)result;
+            if (sim_mpy_signed) {
+                sim_regs.SUMEXT = (acc & 0x80000000UL) ? 0xFFFF : 0;
+            } else {
+                sim_regs.SUMEXT = acc < prev;
+            }
+        } else {
+            sim_regs.SUMEXT = (sim_mpy_signed && (acc & 0x80000000UL)) ? 0xFFFF : 0;
+        }
+        result = acc;
+        if (sim_mpy_signed && (acc & 0x80000000UL)) {
+            result |= 0xFFFFFFFF00000000ULL;
+        }
+    } else if (sim_mpy_accumulate) {
+        result += ((uint64_t)sim_regs.RES3 << 48) | ((uint64_t)sim_regs.RES2 << 32)
+            | ((uint64_t)sim_regs.RES1 << 16) | sim_regs.RES0;
+    }
+    sim_regs.RES0 = (uint16_t)result;
+    sim_regs.RES1 = (uint16_t)(result >> 16);
+    sim_regs.RES2 = (uint16_t)(result >> 32);
+    sim_regs.RES3 = (uint16_t)(result >> 48);
+}
+
+// --- Time and Interrupts ---
+
+static uint64_t sim_next_event(void) {
+    uint64_t t = sim_timer_next_shi;
+    uint64_t e;
+    if (sim_adc_done_at < t)
+        t = sim_adc_done_at;
+    if ((e = sim_usci_next_event(&sim_spi)) < t)
+        t = e;
+    if ((e = sim_usci_next_event(&sim_uart)) < t)
+        t = e;
+    if ((e = sim_rx_next_event()) < t)
+        t = e;
+    return t;
+}
+
+static void sim_run_events(void) {
+    if (sim_adc_done_at <= sim_now)
+        sim_adc_event();
+    if (sim_timer_next_shi <= sim_now)
+        sim_timer_event();
+    if (sim_usci_next_event(&sim_spi) <= sim_now)
+        sim_usci_event(&sim_spi);
+    if (sim_usci_next_event(&sim_uart) <= sim_now)
+        sim_usci_event(&sim_uart);
+    if (sim_rx_next_event() <= sim_now)
+        sim_rx_event();
+}
+
+static void sim_advance_to(uint64_t target) {
+    for (;;) {
+        uint64_t next = sim_next_event();
+        if (next > target) {
+            break;
+        }
+        if (next > sim_now) {
+            sim_now = next;
+        }
+        if (sim_now >= sim_end) {
+            sim_finish();
+        }
+        sim_run_events();
+        sim_dispatch();
+    }
+    if (target > sim_now) {
+        sim_now = target;
+    }
+    if (sim_now >= sim_end) {
+        sim_finish();
+    }
+}
+
+static int sim_irq_pending(void) {
+    uint8_t ch;
+    for (ch = 0; ch < 6; ch++) {
+        if ((*sim_dma[ch].ctl & (DMAIFG | DMAIE)) == (DMAIFG | DMAIE)) {
+            return 1;
+        }
+    }
+    return (sim_regs.UCA1IFG & sim_regs.UCA1IE & (UCRXIFG | UCTXIFG)) != 0;
+}
+
+static void sim_dispatch(void) {
+    if (!sim_gie || sim_in_isr) {
+        return;
+    }
+    while (sim_gie && sim_irq_pending()) {
+        uint16_t saved_sleep = sim_sleep_bits;
+        void (*isr)(void) = USCI_A1_ISR;
+        uint8_t vector = SIM_VEC_USCI_A1;
+
+        // USCI_A1 has the higher vector address on the F6638, so it wins over DMA
+        if (!(sim_regs.UCA1IFG & sim_regs.UCA1IE & (UCRXIFG | UCTXIFG))) {
+            isr = DMA_ISR;
+            vector = SIM_VEC_DMA;
+        }
+        sim_in_isr = 1;
+        sim_gie = 0;
+        sim_sleep_bits = 0;
+        sim_wake_bits = 0;
+        sim_now += SIM_CYCLES_ISR_ENTRY;
+        sim_stats.isr_count[vector]++;
+        {
+            uint64_t start = sim_now;
+            isr();
+            sim_sync(); // Apply the ISR's last register write before RETI
+            sim_stats.isr_cycles[vector] += sim_now - start;
+        }
+        sim_now += SIM_CYCLES_ISR_EXIT;
+        sim_stats.isr_overhead_cycles += SIM_CYCLES_ISR_ENTRY + SIM_CYCLES_ISR_EXIT;
+        sim_in_isr = 0;
+        sim_gie = 1;
+        sim_sleep_bits = saved_sleep & ~sim_wake_bits;
+    }
+}
+
+// Applies the side effects of the previous register access, whose value the
+// firmware has written by now, then lets hardware state catch up.
+static void sim_sync(void) {
+    volatile void* reg = sim_pending;
+    sim_pending = 0;
+
+    if (reg == &sim_regs.UCB1TXBUF) {
+        sim_usci_write(&sim_spi, sim_regs.UCB1TXBUF);
+    } else if (reg == &sim_regs.UCA1TXBUF) {
+        sim_usci_write(&sim_uart, sim_regs.UCA1TXBUF);
+    } else if (reg == &sim_regs.UCB1CTL1 && (sim_regs.UCB1CTL1 & UCSWRST)) {
+        sim_usci_reset(&sim_spi);
+    } else if (reg == &sim_regs.UCA1CTL1 && (sim_regs.UCA1CTL1 & UCSWRST)) {
+        sim_usci_reset(&sim_uart);
+    } else if (reg == &sim_regs.TA0CTL || reg == &sim_regs.TA0CCR0 || reg == &sim_regs.TA0CCR1) {
+        sim_timer_update();
+    } else if (reg == &sim_regs.TA1CTL) {
+        sim_ta1_update();
+    } else if (reg == &sim_regs.TB0CTL) {
+        sim_tb0_update();
+    } else if (reg >= (volatile void*)&sim_regs.MPY && reg <= (volatile void*)&sim_regs.MACS32H) {
+        sim_mpy_op1_write((volatile uint16_t*)reg);
+    } else if (reg == &sim_regs.OP2) {
+        sim_mpy_run(0);
+    } else if (reg == &sim_regs.OP2H) {
+        sim_mpy_run(1);
+    } else if (reg == &sim_regs.P5OUT && (sim_regs.P5OUT & BIT0) != sim_lcd_cs_prev) {
+        sim_lcd_cs_prev = sim_regs.P5OUT & BIT0;
+        if (sim_spi_cs) {
+            sim_spi_cs(!sim_lcd_cs_prev);
+        }
+    }
+
+    sim_dma_check_enable();
+
+    // A TXIFG edge made by software (the manual toggle before arming a DMA) also triggers the DMA
+    if ((sim_regs.UCB1IFG & UCTXIFG) && !(sim_spi.prev_ifg & UCTXIFG)) {
+        sim_dma_trigger(SIM_DMA_TRIG_UCB1TX);
+    }
+    sim_spi.prev_ifg = sim_regs.UCB1IFG;
+    if ((sim_regs.UCA1IFG & UCTXIFG) && !(sim_uart.prev_ifg & UCTXIFG)) {
+        sim_dma_trigger(SIM_DMA_TRIG_UCA1TX);
+    }
+    sim_uart.prev_ifg = sim_regs.UCA1IFG;
+}
+
+// --- Public Hooks ---
+
+volatile void* sim_access(volatile void* reg) {
+    SimGroup group = sim_group_of(reg);
+
+    if (sim_taking_address) {
+        return reg;
+    }
+    sim_sync();
+    sim_stats.reg_accesses[group]++;
+    sim_advance_to(sim_now + SIM_CYCLES_REG_ACCESS);
+    sim_dispatch();
+
+    // Registers whose read has side effects or whose value is computed on access
+    if (reg == &sim_regs.DMAIV) {
+        sim_regs.DMAIV = sim_dma_read_iv();
+    } else if (reg == &sim_regs.TA1R && sim_ta1_running) {
+        sim_regs.TA1R = sim_ta1_count();
+    } else if (reg == &sim_regs.TB0R && sim_tb0_running) {
+        sim_regs.TB0R = sim_tb0_count();
+    } else if (reg == &sim_regs.TA0R && sim_timer_running) {
+        sim_regs.TA0R = sim_ta0_count();
+    } else if (reg == &sim_regs.UCA1IV) {
+        uint8_t pending = sim_regs.UCA1IFG & sim_regs.UCA1IE;
+        if (pending & UCRXIFG) {
+            sim_regs.UCA1IFG &= ~UCRXIFG;
+            sim_regs.UCA1IV = 2;
+        } else if (pending & UCTXIFG) {
+            sim_regs.UCA1IFG &= ~UCTXIFG;
+            sim_regs.UCA1IV = 4;
+        } else {
+            sim_regs.UCA1IV = 0;
+        }
+        sim_uart.prev_ifg = sim_regs.UCA1IFG;
+    } else if (reg == &sim_regs.UCA1RXBUF) {
+        sim_regs.UCA1IFG &= ~UCRXIFG;
+        sim_uart.prev_ifg = sim_regs.UCA1IFG;
+    } else if (reg >= (volatile void*)&sim_regs.ADC12MEM[0]
+               && reg < (volatile void*)&sim_regs.ADC12MEM[16])
+    {
+        sim_regs.ADC12IFG &= ~(1u << ((volatile uint16_t*)reg - sim_regs.ADC12MEM));
+    } else if (reg == &sim_regs.UCB1STAT || reg == &sim_regs.UCB1IFG) {
+        sim_usci_update_stat(&sim_spi);
+        if (sim_spi.shifting || sim_spi.txbuf_full) {
+            sim_spi.poll_accesses++;
+        }
+    } else if (reg == &sim_regs.UCA1STAT || reg == &sim_regs.UCA1IFG) {
+        sim_usci_update_stat(&sim_uart);
+        if (sim_uart.shifting || sim_uart.txbuf_full) {
+            sim_uart.poll_accesses++;
+        }
+    }
+
+    sim_pending = reg;
+    return reg;
+}
+
+void sim_address_only(void) {
+    sim_sync();
+    sim_taking_address = 1;
+}
+
+void sim_data20_write_long(unsigned long addr, unsigned long value) {
+    sim_taking_address = 0;
+    *(volatile unsigned long*)addr = value;
+    sim_access((volatile void*)addr); // Charged and synced like the MOVX.A it stands for
+}
+
+void sim_delay(unsigned long cycles) {
+    sim_sync();
+    sim_stats.delay_cycles += cycles;
+    sim_advance_to(sim_now + cycles);
+}
+
+void sim_idle(void) {
+    // Jump to the next hardware event: nothing the main loop polls can change before it
+    uint64_t start, next;
+
+    sim_sync();
+    start = sim_now;
+    next = sim_next_event();
+    if (next == SIM_NO_EVENT) {
+        sim_finish();
+    }
+    sim_advance_to(next);
+    sim_dispatch();
+    sim_stats.idle_cycles += sim_now - start;
+}
+
+void sim_set_gie(int enable) {
+    sim_sync();
+    sim_gie = enable;
+    if (enable) {
+        sim_dispatch();
+    }
+}
+
+uint16_t sim_get_interrupt_state(void) {
+    return sim_gie ? GIE : 0;
+}
+
+void sim_bis_sr(uint16_t bits) {
+    sim_sync();
+    if (bits & GIE) {
+        sim_gie = 1;
+    }
+    sim_sleep_bits |= bits & (CPUOFF | SCG0 | SCG1 | OSCOFF);
+    sim_dispatch();
+    // CPU off: only interrupts run until one of them clears the LPM bits on exit
+    while (sim_sleep_bits & CPUOFF) {
+        uint64_t start = sim_now;
+        uint64_t next = sim_next_event();
+        if (next == SIM_NO_EVENT) {
+            sim_finish();
+        }
+        sim_advance_to(next);
+        sim_dispatch();
+        sim_stats.sleep_cycles += sim_now - start;
+    }
+}
+
+void sim_bic_sr_on_exit(uint16_t bits) {
+    sim_wake_bits |= bits;
+}
+
+// --- Report ---
+
+static void sim_finish(void) {
+    uint64_t access_total = 0;
+    int g, status;
+
+    fflush(sim_uart_file);
+    fflush(sim_spi_file);
+    printf("\nvirtual time %.3f s (%llu MCLK cycles)\n", (double)sim_now / SIM_MCLK_HZ,
+           (unsigned long long)sim_now);
+    printf("\n%-10s %12s %14s\n", "registers", "accesses", "est. cycles");
+    for (g = 0; g < SIM_GRP_COUNT; g++) {
+        printf("%-10s %12llu %14llu\n", sim_group_names[g],
+               (unsigned long long)sim_stats.reg_accesses[g],
+               (unsigned long long)sim_stats.reg_accesses[g] * SIM_CYCLES_REG_ACCESS);
+        access_total += sim_stats.reg_accesses[g];
+    }
+    printf("%-10s %12llu %14llu\n", "total", (unsigned long long)access_total,
+           (unsigned long long)access_total * SIM_CYCLES_REG_ACCESS);
+
+    printf("\nspi   %10llu bytes, %10llu polls while busy (%llu cycles)\n",
+           (unsigned long long)sim_spi.bytes, (unsigned long long)sim_spi.poll_accesses,
+           (unsigned long long)sim_spi.poll_accesses * SIM_CYCLES_REG_ACCESS);
+    printf("uart  %10llu bytes, %10llu polls while busy (%llu cycles), %llu rx overruns\n",
+           (unsigned long long)sim_uart.bytes, (unsigned long long)sim_uart.poll_accesses,
+           (unsigned long long)sim_uart.poll_accesses * SIM_CYCLES_REG_ACCESS,
+           (unsigned long long)sim_stats.uart_rx_overruns);
+    printf("adc   %10llu conversions, %llu results lost, %llu triggers during a conversion\n",
+           (unsigned long long)sim_stats.adc_conversions,
+           (unsigned long long)sim_stats.adc_overflows,
+           (unsigned long long)sim_stats.adc_timing_overflows);
+    for (g = 0; g < 6; g++) {
+        if (sim_dma[g].transfers) {
+            printf("dma%d  %10llu transfers (%llu stall cycles)\n", g,
+                   (unsigned long long)sim_dma[g].transfers,
+                   (unsigned long long)sim_dma[g].transfers * SIM_CYCLES_DMA_TRANSFER);
+        }
+    }
+    printf("isr   DMA %llu x (%llu cycles), USCI_A1 %llu x (%llu cycles), entry/exit %llu cycles\n",
+           (unsigned long long)sim_stats.isr_count[SIM_VEC_DMA],
+           (unsigned long long)sim_stats.isr_cycles[SIM_VEC_DMA],
+           (unsigned long long)sim_stats.isr_count[SIM_VEC_USCI_A1],
+           (unsigned long long)sim_stats.isr_cycles[SIM_VEC_USCI_A1],
+           (unsigned long long)sim_stats.isr_overhead_cycles);
+    printf("cpu   %llu delay cycles, %llu idle cycles, %llu sleep cycles\n",
+           (unsigned long long)sim_stats.delay_cycles, (unsigned long long)sim_stats.idle_cycles,
+           (unsigned long long)sim_stats.sleep_cycles);
+
+    status = lcd_model_finish(sim_out_dir) ? 2 : 0;
+
+    fclose(sim_uart_file);
+    fclose(sim_spi_file);
+    exit(status);
+}
+
+// --- Entry Point ---
+
+static FILE* sim_open_output(const char* name) {
+    char path[512];
+    FILE* f;
+    snprintf(path, sizeof(path), "%s/%s", sim_out_dir, name);
+    f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    return f;
+}
+
+static void sim_init_usci(SimUsci* u,
+                          volatile uint8_t* ctl1,
+                          volatile uint16_t* brw,
+                          volatile uint8_t* txbuf,
+                          volatile uint8_t* ifg,
+                          volatile uint8_t* ie,
+                          volatile uint8_t* stat,
+                          uint8_t dma_trigger,
+                          uint8_t bits_per_byte) {
+    memset(u, 0, sizeof(*u));
+    u->ctl1 = ctl1;
+    u->brw = brw;
+    u->txbuf = txbuf;
+    u->ifg = ifg;
+    u->ie = ie;
+    u->stat = stat;
+    u->dma_trigger = dma_trigger;
+    u->bits_per_byte = bits_per_byte;
+    *ctl1 = UCSWRST; // Power-up state
+    sim_usci_reset(u);
+}
+
+int main(int argc, char** argv) {
+    uint64_t snapshot_cycles = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:b:o:s:g:r:f:")) != -1) {
+        switch (opt) {
+            case 't':
+                sim_end = (uint64_t)(atof(optarg) * SIM_MCLK_HZ);
+                break;
+            case 'b':
+                sim_host_max_baud = strtoul(optarg, 0, 10);
+                break;
+            case 'o':
+                sim_out_dir = optarg;
+                break;
+            case 's':
+                snapshot_cycles = (uint64_t)(atof(optarg) * (SIM_MCLK_HZ / 1000));
+                break;
+            case 'g':
+                lcd_model_set_golden(optarg);
+                break;
+            case 'r':
+                if (replay_load(optarg) != 0) {
+                    return 1;
+                }
+                break;
+            case 'f':
+                sim_host_rate = strtoul(optarg, 0, 10);
+                break;
+            default:
+                fprintf(stderr,
+                        "usage: %s [-t seconds] [-b host_max_baud] [-o output_dir] "
+                        "[-s snapshot_ms] [-g golden.ppm] [-r recording.ecgr] [-f sample_rate]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    sim_uart_file = sim_open_output("uart_tx.bin");
+    sim_spi_file = sim_open_output("spi_tx.bin");
+    lcd_model_init();
+    lcd_model_set_snapshots(snapshot_cycles, sim_out_dir);
+
+#define SIM_DMA_CHANNEL(n)                                                                        \
+    sim_dma[n].ctl = &sim_regs.DMA##n##CTL;                                                       \
+    sim_dma[n].sz = &sim_regs.DMA##n##SZ;                                                         \
+    sim_dma[n].sa = &sim_regs.DMA##n##SA;                                                         \
+    sim_dma[n].da = &sim_regs.DMA##n##DA;
+    SIM_DMA_CHANNEL(0)
+    SIM_DMA_CHANNEL(1)
+    SIM_DMA_CHANNEL(2)
+    SIM_DMA_CHANNEL(3)
+    SIM_DMA_CHANNEL(4)
+    SIM_DMA_CHANNEL(5)
+#undef SIM_DMA_CHANNEL
+
+    sim_init_usci(&sim_uart, &sim_regs.UCA1CTL1, &sim_regs.UCA1BRW, &sim_regs.UCA1TXBUF,
+                  &sim_regs.UCA1IFG, &sim_regs.UCA1IE, &sim_regs.UCA1STAT, SIM_DMA_TRIG_UCA1TX, 10);
+    sim_init_usci(&sim_spi, &sim_regs.UCB1CTL1, &sim_regs.UCB1BRW, &sim_regs.UCB1TXBUF,
+                  &sim_regs.UCB1IFG, &sim_regs.UCB1IE, &sim_regs.UCB1STAT, SIM_DMA_TRIG_UCB1TX, 8);
+
+    firmware_main();
+    sim_finish();
+    return 0;
+}
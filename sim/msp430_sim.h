@@ -0,0 +1,442 @@
+#ifndef MSP430_SIM_H_
+#define MSP430_SIM_H_
+
+// Host stand-in for <msp430f6638.h>, used when the firmware is built with HOST_SIM.
+// Every register the firmware touches is a field of sim_regs, and every access goes
+// through sim_access(), which advances virtual time, runs the peripheral models and
+// dispatches interrupts. Bit definitions carry the same values as the TI header.
+
+#include <stdint.h>
+
+// --- Register File ---
+// Grouped by peripheral; the simulator charges accesses to the group a field belongs to.
+typedef struct {
+    // System, clock, watchdog
+    uint16_t WDTCTL;
+    uint16_t SFRIFG1;
+    uint16_t BAKCTL;
+    uint16_t UCSCTL0, UCSCTL1, UCSCTL2, UCSCTL3, UCSCTL4, UCSCTL5, UCSCTL6, UCSCTL7;
+
+    // Ports
+    uint8_t P1OUT, P1DIR, P1SEL, P1REN, P1IN;
+    uint8_t P2OUT, P2DIR, P2SEL, P2REN, P2IN;
+    uint8_t P3OUT, P3DIR, P3SEL, P3REN, P3IN;
+    uint8_t P4OUT, P4DIR, P4SEL, P4REN, P4IN;
+    uint8_t P5OUT, P5DIR, P5SEL, P5REN, P5IN;
+    uint8_t P6OUT, P6DIR, P6SEL, P6REN, P6IN;
+    uint8_t P7OUT, P7DIR, P7SEL, P7REN, P7IN;
+    uint8_t P8OUT, P8DIR, P8SEL, P8REN, P8IN;
+
+    // Timer_A0
+    uint16_t TA0CTL, TA0R, TA0EX0;
+    uint16_t TA0CCTL0, TA0CCTL1, TA0CCTL2;
+    uint16_t TA0CCR0, TA0CCR1, TA0CCR2;
+
+    // Timer_A1 and Timer_B0, counters only
+    uint16_t TA1CTL, TA1R;
+    uint16_t TB0CTL, TB0R;
+
+    // ADC12_A
+    uint16_t ADC12CTL0, ADC12CTL1, ADC12CTL2;
+    uint16_t ADC12IFG, ADC12IE, ADC12IV;
+    uint8_t ADC12MCTL[16]; // ADC12MCTL0..15, consecutive bytes as on the device
+    uint16_t ADC12MEM[16];
+
+    // DMA. Address registers are host pointers, written with __data20_write_long()
+    uint16_t DMACTL0, DMACTL1, DMACTL2, DMACTL4, DMAIV;
+    uint16_t DMA0CTL, DMA0SZ;
+    unsigned long DMA0SA, DMA0DA;
+    uint16_t DMA1CTL, DMA1SZ;
+    unsigned long DMA1SA, DMA1DA;
+    uint16_t DMA2CTL, DMA2SZ;
+    unsigned long DMA2SA, DMA2DA;
+    uint16_t DMA3CTL, DMA3SZ;
+    unsigned long DMA3SA, DMA3DA;
+    uint16_t DMA4CTL, DMA4SZ;
+    unsigned long DMA4SA, DMA4DA;
+    uint16_t DMA5CTL, DMA5SZ;
+    unsigned long DMA5SA, DMA5DA;
+
+    // USCI_A1 (UART)
+    uint8_t UCA1CTL0, UCA1CTL1;
+    union {
+        uint16_t UCA1BRW;
+        struct {
+            uint8_t UCA1BR0, UCA1BR1; // Byte halves, little-endian like the device
+        };
+    };
+    uint8_t UCA1MCTL, UCA1STAT, UCA1RXBUF, UCA1TXBUF, UCA1IE, UCA1IFG;
+    uint16_t UCA1IV;
+
+    // USCI_B1 (SPI to the LCD)
+    uint8_t UCB1CTL0, UCB1CTL1;
+    union {
+        uint16_t UCB1BRW;
+        struct {
+            uint8_t UCB1BR0, UCB1BR1; // Byte halves, little-endian like the device
+        };
+    };
+    uint8_t UCB1STAT, UCB1RXBUF, UCB1TXBUF, UCB1IE, UCB1IFG;
+    uint16_t UCB1IV;
+
+    // MPY32. RESLO/RESHI are RES0/RES1 and OP2L is OP2, as on the device
+    uint16_t MPY, MPYS, MAC, MACS;
+    uint16_t MPY32L, MPY32H, MPYS32L, MPYS32H, MAC32L, MAC32H, MACS32L, MACS32H;
+    union {
+        uint16_t OP2;
+        uint16_t OP2L;
+    };
+    uint16_t OP2H;
+    union {
+        uint16_t RES0;
+        uint16_t RESLO;
+    };
+    union {
+        uint16_t RES1;
+        uint16_t RESHI;
+    };
+    uint16_t RES2, RES3, SUMEXT, MPY32CTL0;
+} SimRegs;
+
+extern volatile SimRegs sim_regs;
+
+// --- Simulator Hooks ---
+volatile void* sim_access(volatile void* reg);
+void sim_delay(unsigned long cycles);
+void sim_idle(void);
+void sim_set_gie(int enable);
+uint16_t sim_get_interrupt_state(void);
+void sim_bis_sr(uint16_t bits);
+void sim_bic_sr_on_exit(uint16_t bits);
+void sim_address_only(void);
+void sim_data20_write_long(unsigned long addr, unsigned long value);
+
+#define SIM_REG(name) (*(__typeof__(sim_regs.name)*)sim_access(&sim_regs.name))
+
+
+// --- Register Names ---
+// The simulator itself works on sim_regs directly and defines SIM_IMPL to keep these out.
+#ifndef SIM_IMPL
+#define WDTCTL SIM_REG(WDTCTL)
+#define SFRIFG1 SIM_REG(SFRIFG1)
+#define BAKCTL SIM_REG(BAKCTL)
+#define UCSCTL0 SIM_REG(UCSCTL0)
+#define UCSCTL1 SIM_REG(UCSCTL1)
+#define UCSCTL2 SIM_REG(UCSCTL2)
+#define UCSCTL3 SIM_REG(UCSCTL3)
+#define UCSCTL4 SIM_REG(UCSCTL4)
+#define UCSCTL5 SIM_REG(UCSCTL5)
+#define UCSCTL6 SIM_REG(UCSCTL6)
+#define UCSCTL7 SIM_REG(UCSCTL7)
+
+#define P1OUT SIM_REG(P1OUT)
+#define P1DIR SIM_REG(P1DIR)
+#define P1SEL SIM_REG(P1SEL)
+#define P1REN SIM_REG(P1REN)
+#define P1IN SIM_REG(P1IN)
+#define P2OUT SIM_REG(P2OUT)
+#define P2DIR SIM_REG(P2DIR)
+#define P2SEL SIM_REG(P2SEL)
+#define P2REN SIM_REG(P2REN)
+#define P2IN SIM_REG(P2IN)
+#define P3OUT SIM_REG(P3OUT)
+#define P3DIR SIM_REG(P3DIR)
+#define P3SEL SIM_REG(P3SEL)
+#define P3REN SIM_REG(P3REN)
+#define P3IN SIM_REG(P3IN)
+#define P4OUT SIM_REG(P4OUT)
+#define P4DIR SIM_REG(P4DIR)
+#define P4SEL SIM_REG(P4SEL)
+#define P4REN SIM_REG(P4REN)
+#define P4IN SIM_REG(P4IN)
+#define P5OUT SIM_REG(P5OUT)
+#define P5DIR SIM_REG(P5DIR)
+#define P5SEL SIM_REG(P5SEL)
+#define P5REN SIM_REG(P5REN)
+#define P5IN SIM_REG(P5IN)
+#define P6OUT SIM_REG(P6OUT)
+#define P6DIR SIM_REG(P6DIR)
+#define P6SEL SIM_REG(P6SEL)
+#define P6REN SIM_REG(P6REN)
+#define P6IN SIM_REG(P6IN)
+#define P7OUT SIM_REG(P7OUT)
+#define P7DIR SIM_REG(P7DIR)
+#define P7SEL SIM_REG(P7SEL)
+#define P7REN SIM_REG(P7REN)
+#define P7IN SIM_REG(P7IN)
+#define P8OUT SIM_REG(P8OUT)
+#define P8DIR SIM_REG(P8DIR)
+#define P8SEL SIM_REG(P8SEL)
+#define P8REN SIM_REG(P8REN)
+#define P8IN SIM_REG(P8IN)
+
+#define TA0CTL SIM_REG(TA0CTL)
+#define TA0R SIM_REG(TA0R)
+#define TA0EX0 SIM_REG(TA0EX0)
+#define TA0CCTL0 SIM_REG(TA0CCTL0)
+#define TA0CCTL1 SIM_REG(TA0CCTL1)
+#define TA0CCTL2 SIM_REG(TA0CCTL2)
+#define TA0CCR0 SIM_REG(TA0CCR0)
+#define TA0CCR1 SIM_REG(TA0CCR1)
+#define TA0CCR2 SIM_REG(TA0CCR2)
+#define TA1CTL SIM_REG(TA1CTL)
+#define TA1R SIM_REG(TA1R)
+#define TB0CTL SIM_REG(TB0CTL)
+#define TB0R SIM_REG(TB0R)
+
+#define ADC12CTL0 SIM_REG(ADC12CTL0)
+#define ADC12CTL1 SIM_REG(ADC12CTL1)
+#define ADC12CTL2 SIM_REG(ADC12CTL2)
+#define ADC12IFG SIM_REG(ADC12IFG)
+#define ADC12IE SIM_REG(ADC12IE)
+#define ADC12IV SIM_REG(ADC12IV)
+#define ADC12MCTL0 SIM_REG(ADC12MCTL[0])
+#define ADC12MEM0 SIM_REG(ADC12MEM[0])
+
+#define DMACTL0 SIM_REG(DMACTL0)
+#define DMACTL1 SIM_REG(DMACTL1)
+#define DMACTL2 SIM_REG(DMACTL2)
+#define DMACTL4 SIM_REG(DMACTL4)
+#define DMAIV SIM_REG(DMAIV)
+#define DMA0CTL SIM_REG(DMA0CTL)
+#define DMA0SZ SIM_REG(DMA0SZ)
+#define DMA0SA SIM_REG(DMA0SA)
+#define DMA0DA SIM_REG(DMA0DA)
+#define DMA1CTL SIM_REG(DMA1CTL)
+#define DMA1SZ SIM_REG(DMA1SZ)
+#define DMA1SA SIM_REG(DMA1SA)
+#define DMA1DA SIM_REG(DMA1DA)
+#define DMA2CTL SIM_REG(DMA2CTL)
+#define DMA2SZ SIM_REG(DMA2SZ)
+#define DMA2SA SIM_REG(DMA2SA)
+#define DMA2DA SIM_REG(DMA2DA)
+#define DMA3CTL SIM_REG(DMA3CTL)
+#define DMA3SZ SIM_REG(DMA3SZ)
+#define DMA3SA SIM_REG(DMA3SA)
+#define DMA3DA SIM_REG(DMA3DA)
+#define DMA4CTL SIM_REG(DMA4CTL)
+#define DMA4SZ SIM_REG(DMA4SZ)
+#define DMA4SA SIM_REG(DMA4SA)
+#define DMA4DA SIM_REG(DMA4DA)
+#define DMA5CTL SIM_REG(DMA5CTL)
+#define DMA5SZ SIM_REG(DMA5SZ)
+#define DMA5SA SIM_REG(DMA5SA)
+#define DMA5DA SIM_REG(DMA5DA)
+
+#define UCA1CTL0 SIM_REG(UCA1CTL0)
+#define UCA1CTL1 SIM_REG(UCA1CTL1)
+#define UCA1BRW SIM_REG(UCA1BRW)
+#define UCA1BR0 SIM_REG(UCA1BR0)
+#define UCA1BR1 SIM_REG(UCA1BR1)
+#define UCA1MCTL SIM_REG(UCA1MCTL)
+#define UCA1STAT SIM_REG(UCA1STAT)
+#define UCA1RXBUF SIM_REG(UCA1RXBUF)
+#define UCA1TXBUF SIM_REG(UCA1TXBUF)
+#define UCA1IE SIM_REG(UCA1IE)
+#define UCA1IFG SIM_REG(UCA1IFG)
+#define UCA1IV SIM_REG(UCA1IV)
+
+#define UCB1CTL0 SIM_REG(UCB1CTL0)
+#define UCB1CTL1 SIM_REG(UCB1CTL1)
+#define UCB1BRW SIM_REG(UCB1BRW)
+#define UCB1BR0 SIM_REG(UCB1BR0)
+#define UCB1BR1 SIM_REG(UCB1BR1)
+#define UCB1STAT SIM_REG(UCB1STAT)
+#define UCB1RXBUF SIM_REG(UCB1RXBUF)
+#define UCB1TXBUF SIM_REG(UCB1TXBUF)
+#define UCB1IE SIM_REG(UCB1IE)
+#define UCB1IFG SIM_REG(UCB1IFG)
+#define UCB1IV SIM_REG(UCB1IV)
+#define MPY SIM_REG(MPY)
+#define MPYS SIM_REG(MPYS)
+#define MAC SIM_REG(MAC)
+#define MACS SIM_REG(MACS)
+#define MPY32L SIM_REG(MPY32L)
+#define MPY32H SIM_REG(MPY32H)
+#define MPYS32L SIM_REG(MPYS32L)
+#define MPYS32H SIM_REG(MPYS32H)
+#define MAC32L SIM_REG(MAC32L)
+#define MAC32H SIM_REG(MAC32H)
+#define MACS32L SIM_REG(MACS32L)
+#define MACS32H SIM_REG(MACS32H)
+#define OP2 SIM_REG(OP2)
+#define OP2L SIM_REG(OP2L)
+#define OP2H SIM_REG(OP2H)
+#define RES0 SIM_REG(RES0)
+#define RES1 SIM_REG(RES1)
+#define RES2 SIM_REG(RES2)
+#define RES3 SIM_REG(RES3)
+#define RESLO SIM_REG(RESLO)
+#define RESHI SIM_REG(RESHI)
+#define SUMEXT SIM_REG(SUMEXT)
+#define MPY32CTL0 SIM_REG(MPY32CTL0)
+#endif /* SIM_IMPL */
+
+// --- Intrinsics ---
+#define __interrupt
+// Both arguments only take register addresses (&DMA1SA, &UCB1TXBUF); those must not
+// count as accesses, or the TXBUF would look written and send its stale byte again
+#define __data20_write_long(addr, value)                                                          \
+    (sim_address_only(), sim_data20_write_long((unsigned long)(addr), (unsigned long)(value)))
+#define __delay_cycles(n) sim_delay(n)
+#define __disable_interrupt() sim_set_gie(0)
+#define __enable_interrupt() sim_set_gie(1)
+#define __get_interrupt_state() sim_get_interrupt_state()
+#define __set_interrupt_state(state) sim_set_gie(((state) & GIE) != 0)
+#define _DINT() sim_set_gie(0)
+#define _EINT() sim_set_gie(1)
+#define __bis_SR_register(bits) sim_bis_sr(bits)
+#define __bic_SR_register_on_exit(bits) sim_bic_sr_on_exit(bits)
+#define __even_in_range(value, bound) (value)
+#define __no_operation() ((void)0)
+
+// --- Bit Definitions ---
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+#define BIT8 (0x0100)
+#define BIT9 (0x0200)
+#define BITA (0x0400)
+#define BITB (0x0800)
+#define BITC (0x1000)
+#define BITD (0x2000)
+#define BITE (0x4000)
+#define BITF (0x8000)
+
+// Status register
+#define GIE (0x0008)
+#define CPUOFF (0x0010)
+#define OSCOFF (0x0020)
+#define SCG0 (0x0040)
+#define SCG1 (0x0080)
+#define LPM0_bits (CPUOFF)
+#define LPM1_bits (SCG0 + CPUOFF)
+#define LPM2_bits (SCG1 + CPUOFF)
+#define LPM3_bits (SCG1 + SCG0 + CPUOFF)
+#define LPM4_bits (SCG1 + SCG0 + OSCOFF + CPUOFF)
+
+// Watchdog, SFR, battery backup
+#define WDTPW (0x5A00)
+#define WDTHOLD (0x0080)
+#define OFIFG (0x0002)
+#define LOCKIO (0x0001)
+
+// UCS
+#define DCOFFG (0x0001)
+#define XT1LFOFFG (0x0002)
+#define XT2OFFG (0x0008)
+#define XT1OFF (0x0001)
+#define XT2OFF (0x0100)
+#define DCORSEL_5 (0x0050)
+#define SELREF__XT2CLK (0x0050)
+#define FLLREFDIV__16 (0x0005)
+#define SELA__XT1CLK (0x0000)
+#define SELS__XT2CLK (0x0050)
+#define SELM__XT2CLK (0x0005)
+#define SELM__DCOCLK (0x0003)
+#define DIVA__1 (0x0000)
+#define DIVS__1 (0x0000)
+#define DIVM__1 (0x0000)
+
+// Timer_A
+#define TASSEL__ACLK (0x0100)
+#define TASSEL__SMCLK (0x0200)
+#define TASSEL_3 (0x0300)
+#define MC__STOP (0x0000)
+#define MC__UP (0x0010)
+#define MC__CONTINUOUS (0x0020)
+#define MC__UPDOWN (0x0030)
+#define MC_3 (0x0030)
+#define TACLR (0x0004)
+#define TAIE (0x0002)
+#define TAIFG (0x0001)
+#define TBSSEL__ACLK (0x0100)
+#define TBSSEL__SMCLK (0x0200)
+#define TBCLR (0x0004)
+#define CCIE (0x0010)
+#define CCIFG (0x0001)
+#define OUTMOD_3 (0x0060)
+#define OUTMOD_7 (0x00E0)
+
+// ADC12_A
+#define ADC12SC (0x0001)
+#define ADC12ENC (0x0002)
+#define ADC12ON (0x0010)
+#define ADC12MSC (0x0080)
+#define ADC12SHT0_2 (0x0200)
+#define ADC12SHT0_3 (0x0300)
+#define ADC12SHT0_4 (0x0400)
+#define ADC12SHT0_5 (0x0500)
+#define ADC12SHT0_6 (0x0600)
+#define ADC12SHT0_7 (0x0700)
+#define ADC12SHT0_8 (0x0800)
+#define ADC12SHP (0x0200)
+#define ADC12SHS_0 (0x0000)
+#define ADC12SHS_1 (0x0400)
+#define ADC12SHS_3 (0x0C00)
+#define ADC12CONSEQ_0 (0x0000)
+#define ADC12CONSEQ_2 (0x0004)
+#define ADC12CONSEQ_3 (0x0006)
+#define ADC12SSEL_3 (0x0018)
+#define ADC12RES_1 (0x0010)
+#define ADC12RES_2 (0x0020)
+#define ADC12INCH_0 (0x0000)
+#define ADC12EOS (0x0080)
+#define ADC12IFG0 (0x0001)
+
+// DMA
+#define DMAREQ (0x0001)
+#define DMAABORT (0x0002)
+#define DMAIE (0x0004)
+#define DMAIFG (0x0008)
+#define DMAEN (0x0010)
+#define DMALEVEL (0x0020)
+#define DMASRCBYTE (0x0040)
+#define DMADSTBYTE (0x0080)
+#define DMASRCINCR_0 (0x0000)
+#define DMASRCINCR_2 (0x0200)
+#define DMASRCINCR_3 (0x0300)
+#define DMADSTINCR_0 (0x0000)
+#define DMADSTINCR_2 (0x0800)
+#define DMADSTINCR_3 (0x0C00)
+#define DMADT_0 (0x0000)
+#define DMADT_1 (0x1000)
+#define DMADT_4 (0x4000)
+#define DMADT_5 (0x5000)
+#define DMA0TSEL_31 (0x001F)
+#define DMA0TSEL_24 (0x0018)
+#define DMA1TSEL_31 (0x1F00)
+#define DMA1TSEL_23 (0x1700)
+#define DMA2TSEL_31 (0x001F)
+#define DMA2TSEL_21 (0x0015)
+#define DMA3TSEL_31 (0x1F00)
+#define DMA4TSEL_31 (0x001F)
+#define DMA5TSEL_31 (0x1F00)
+
+// USCI
+#define UCSWRST (0x01)
+#define UCSYNC (0x01)
+#define UCMST (0x08)
+#define UCMSB (0x20)
+#define UCCKPL (0x40)
+#define UCCKPH (0x80)
+#define UCSSEL_2 (0x80)
+#define UCSSEL__SMCLK (0x80)
+#define UCOS16 (0x01)
+#define UCBRS_1 (0x02)
+#define UCBRS_3 (0x06)
+#define UCBRS_4 (0x08)
+#define UCBRS_6 (0x0C)
+#define UCBRF_0 (0x00)
+#define UCBUSY (0x01)
+#define UCRXIE (0x01)
+#define UCTXIE (0x02)
+#define UCRXIFG (0x01)
+#define UCTXIFG (0x02)
+
+#endif /* MSP430_SIM_H_ */
@@ -0,0 +1,99 @@
+// Recorded-ECG source for the simulated ADC12 (see replay_source.h).
+//
+// .ecgr layout, little-endian:
+//   0   "ECGR"
+//   4   version (1)
+//   5   bits per sample (12)
+//   6   reserved
+//   8   sample rate in mHz (uint32)
+//   12  sample count (uint32)
+//   16  samples, two per 3 bytes as in MIT-BIH format 212
+
+#include "replay_source.h"
+#include "sim_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Private Definitions ---
+#define REPLAY_HEADER_LEN 16
+#define REPLAY_VERSION 1
+
+// --- Private Variables ---
+static uint16_t* replay_samples;
+static uint32_t replay_count;
+static double replay_rate_hz;
+static uint64_t replay_start; // Virtual time of the first conversion
+
+// --- Private Functions ---
+
+static uint32_t replay_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t replay_sample(uint64_t sample_index) {
+    double pos, frac;
+    uint64_t whole;
+    uint16_t a, b;
+
+    if (sample_index == 0) {
+        replay_start = sim_now;
+    }
+    pos = (double)(sim_now - replay_start) / SIM_MCLK_HZ * replay_rate_hz;
+    whole = (uint64_t)pos;
+    frac = pos - (double)whole;
+    a = replay_samples[whole % replay_count];
+    b = replay_samples[(whole + 1) % replay_count];
+    return (uint16_t)(a + (b - a) * frac + 0.5);
+}
+
+// --- Public Functions ---
+
+int replay_load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    uint8_t header[REPLAY_HEADER_LEN];
+    uint8_t* packed;
+    size_t packed_len;
+    uint32_t i;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) || memcmp(header, "ECGR", 4) != 0
+        || header[4] != REPLAY_VERSION || header[5] != 12)
+    {
+        fprintf(stderr, "%s: not an .ecgr v%d file\n", path, REPLAY_VERSION);
+        fclose(f);
+        return -1;
+    }
+    replay_rate_hz = replay_u32(&header[8]) / 1000.0;
+    replay_count = replay_u32(&header[12]);
+    if (replay_count == 0 || replay_rate_hz <= 0) {
+        fprintf(stderr, "%s: empty recording\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    packed_len = (replay_count + 1) / 2 * 3;
+    packed = malloc(packed_len);
+    replay_samples = malloc((replay_count + 1) * sizeof(uint16_t));
+    if (!packed || !replay_samples || fread(packed, 1, packed_len, f) != packed_len) {
+        fprintf(stderr, "%s: truncated\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    for (i = 0; i < (replay_count + 1) / 2; i++) {
+        const uint8_t* p = &packed[i * 3];
+        replay_samples[2 * i] = p[0] | ((p[1] & 0x0F) << 8);
+        replay_samples[2 * i + 1] = p[2] | ((p[1] & 0xF0) << 4);
+    }
+    free(packed);
+
+    printf("replaying %s: %lu samples at %.3f Hz (%.1f s)\n", path, (unsigned long)replay_count,
+           replay_rate_hz, replay_count / replay_rate_hz);
+    sim_adc_source = replay_sample;
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef REPLAY_SOURCE_H_
+#define REPLAY_SOURCE_H_
+
+// ADC12 input from a recorded ECG (.ecgr, written by util/ecg_convert.py).
+// The recording is indexed by virtual time since the first conversion and linearly
+// interpolated, so it plays at its own speed whatever sample rate the firmware
+// configures, and loops at its end. Sample n of the capture is taken at n / rate
+// seconds into the recording.
+
+// Loads the file and installs it as sim_adc_source; returns 0 on success
+int replay_load(const char* path);
+
+#endif /* REPLAY_SOURCE_H_ */
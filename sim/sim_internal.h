@@ -0,0 +1,49 @@
+#ifndef SIM_INTERNAL_H_
+#define SIM_INTERNAL_H_
+
+// Simulator state shared between the peripheral models; not visible to the firmware.
+
+#include "clock.h"
+#include <stdint.h>
+
+// Clock tree as configured by init_clock(): MCLK = DCO 20 MHz, SMCLK = XT2 4 MHz
+#define SIM_MCLK_HZ MCLK_FREQ
+#define SIM_SMCLK_HZ SMCLK_FREQ
+#define SIM_SMCLK_DIV (SIM_MCLK_HZ / SIM_SMCLK_HZ)
+#define SIM_ACLK_HZ 32768UL // XT1
+
+typedef enum {
+    SIM_VEC_DMA,
+    SIM_VEC_USCI_A1,
+    SIM_VEC_COUNT
+} SimVector;
+
+typedef struct {
+    uint64_t reg_accesses[8]; // Per register group, see sim_group_names
+    uint64_t dma_cycles; // CPU cycles stolen by DMA transfers
+    uint64_t isr_count[SIM_VEC_COUNT];
+    uint64_t isr_cycles[SIM_VEC_COUNT]; // Time spent in ISR bodies
+    uint64_t isr_overhead_cycles; // Entry and RETI
+    uint64_t delay_cycles; // __delay_cycles()
+    uint64_t idle_cycles; // Main loop waiting in HAL_IDLE()
+    uint64_t sleep_cycles; // CPU off in a low-power mode
+    uint64_t adc_conversions;
+    uint64_t adc_overflows; // A MEMx result overwritten before it was read
+    uint64_t adc_timing_overflows; // Triggered again before the S/H and conversion finished (ADC12TOV)
+    uint64_t uart_rx_overruns;
+} SimStats;
+
+extern uint64_t sim_now; // Virtual time in MCLK cycles
+extern SimStats sim_stats;
+
+// Sample source for every ADC input, indexed by sample set (one pass over the conversion
+// sequence); 0 selects the built-in synthetic ECG
+extern uint16_t (*sim_adc_source)(uint64_t sample_index);
+
+// Receives every byte clocked out of USCI_B1 with the RS (P5.2) and CS (P5.0, active low) lines
+extern void (*sim_spi_sink)(uint8_t byte, int rs, int cs_active);
+
+// Called when the firmware moves the LCD chip select (P5.0, active low)
+extern void (*sim_spi_cs)(int cs_active);
+
+#endif /* SIM_INTERNAL_H_ */
@@ -0,0 +1,210 @@
+// Fuzz harness for the streaming frame decoder (ecg_decoder_init/ecg_decoder_push in
+// ecg_proto.c), run under AddressSanitizer so an access outside the decoder buffer fails at once.
+//
+// Build from the repository root and run the built-in driver (random and mutated streams from a
+// fixed seed; a failed check aborts):
+//   gcc -O1 -g -fsanitize=address,undefined -fno-sanitize-recover -Idma-adc-display
+//       -o ecg_decoder_fuzz tests/ecg_decoder_fuzz.c dma-adc-display/ecg_proto.c
+//   ./ecg_decoder_fuzz [iterations] [seed]
+// Or with libFuzzer, which supplies main() and mutates the input itself:
+//   clang -O1 -g -fsanitize=fuzzer,address,undefined -DECG_FUZZ_LIBFUZZER -Idma-adc-display
+//       -o ecg_decoder_fuzz tests/ecg_decoder_fuzz.c dma-adc-display/ecg_proto.c
+//   ./ecg_decoder_fuzz -max_len=4096
+//
+// Each input is pushed one byte at a time. Checks that
+//   - the decoder never holds more than its buffer, and never more than one header while it
+//     has not accepted one,
+//   - a frame is reported only with a payload of at most ECG_MAX_PAYLOAD bytes, and re-encoding
+//     the reported header and payload gives exactly the last bytes pushed,
+//   - resync: after the input, one maximum-length frame's worth of bytes that can't start a
+//     sync leaves the decoder empty, and a valid frame with the 1024-byte payload the protocol
+//     allows decodes on its last byte,
+//   - a header claiming ECG_MAX_PAYLOAD + 1 bytes, CRC-8 good, is rejected as a header error and
+//     the frame right behind it still decodes.
+
+#include "ecg_proto.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_MAX (ECG_MAX_PAYLOAD + ECG_FRAME_OVERHEAD)
+#define INPUT_MAX (4 * FRAME_MAX)
+
+static EcgDecoder dec;
+static uint8_t frame[FRAME_MAX + 1];
+
+static void fail(const char* what, size_t offset) {
+    fprintf(stderr, "FAIL at byte %lu: %s\n", (unsigned long)offset, what);
+    abort(); // libFuzzer saves the input as a crash
+}
+
+// Pushes one byte and checks the invariants; returns 1 if a frame completed
+static int push(const uint8_t* stream, size_t pos) {
+    EcgFrameHeader header;
+    const uint8_t* payload = 0;
+    uint16_t len;
+    int done = ecg_decoder_push(&dec, stream[pos], &header, &payload);
+
+    if (dec.fill > sizeof(dec.buf) || (dec.frame_len == 0 && dec.fill >= ECG_HEADER_LEN))
+        fail("decoder holds more than it should", pos);
+    if (!done)
+        return 0;
+    if (header.payload_len > ECG_MAX_PAYLOAD || payload != &dec.buf[ECG_HEADER_LEN])
+        fail("frame reported with a bad payload length or pointer", pos);
+    len = ecg_encode_frame(frame, &header, payload);
+    if (len > pos + 1 || memcmp(frame, &stream[pos + 1 - len], len) != 0)
+        fail("reported frame differs from the bytes received", pos);
+    return 1;
+}
+
+// Writes a valid frame whose payload is taken from seed bytes; returns its length
+static uint16_t make_frame(uint8_t* out, uint16_t payload_len, const uint8_t* seed, size_t seed_len) {
+    static uint8_t payload[ECG_MAX_PAYLOAD];
+    EcgFrameHeader header;
+    uint16_t i;
+
+    for (i = 0; i < payload_len; i++) {
+        payload[i] = seed_len ? seed[i % seed_len] : (uint8_t)i;
+    }
+    header.type = seed_len ? seed[0] & 0x0F : 0;
+    header.version = ECG_PROTO_VERSION;
+    header.payload_len = payload_len;
+    header.seq = 0x0102; // No sync byte in the header fields
+    header.sample_index = 0x12345678;
+    header.channel_mask = 0x01;
+    return ecg_encode_frame(out, &header, payload);
+}
+
+// Feeds a whole stream; returns the number of frames reported
+static unsigned feed(const uint8_t* stream, size_t len) {
+    unsigned frames = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        frames += push(stream, i);
+    }
+    return frames;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static uint8_t tail[3 * FRAME_MAX + 1];
+    uint16_t pos = 0, len;
+    size_t i;
+
+    ecg_decoder_init(&dec);
+    feed(data, size);
+
+    // Flush: a maximum-length frame of bytes that are never ECG_SYNC0 completes or drops
+    // whatever the input left half-collected
+    memset(tail, 0, FRAME_MAX);
+    feed(tail, FRAME_MAX);
+    if (dec.fill != 0 || dec.frame_len != 0)
+        fail("no resync after a maximum-length frame of non-sync bytes", size);
+
+    // A header one byte over the limit, then a frame of exactly the limit, then a short one
+    make_frame(tail, 8, data, size);
+    tail[3] = (ECG_MAX_PAYLOAD + 1) & 0xFF;
+    tail[4] = (ECG_MAX_PAYLOAD + 1) >> 8;
+    tail[12] = ecg_crc8(&tail[2], 10);
+    pos = ECG_HEADER_LEN; // Only the header; its claimed payload never arrives
+    pos += make_frame(&tail[pos], ECG_MAX_PAYLOAD, data, size);
+    len = make_frame(&tail[pos], 0, data, size);
+    {
+        uint32_t header_errors = dec.header_errors;
+        uint32_t frames_ok = dec.frames_ok;
+        for (i = 0; i < (size_t)pos + len; i++) {
+            int done = push(tail, i);
+            if (done != (i == ECG_HEADER_LEN + FRAME_MAX - 1 || i == (size_t)pos + len - 1))
+                fail("frame after the input not decoded on its last byte", size + FRAME_MAX + i);
+        }
+        if (dec.header_errors == header_errors || dec.frames_ok != frames_ok + 2)
+            fail("oversized header accepted", size + FRAME_MAX);
+    }
+    return 0;
+}
+
+#ifndef ECG_FUZZ_LIBFUZZER
+// --- Built-in driver ---
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// An input made of valid frames, sync bytes and noise, then cut, bit-flipped and spliced, so
+// the decoder sees false syncs, corrupted headers and frames cut short in every state
+static size_t make_input(uint8_t* in) {
+    size_t len = 0;
+    int parts = 1 + rng() % 6;
+    int i;
+
+    while (parts-- > 0) {
+        size_t room = INPUT_MAX - len;
+        uint8_t* p = &in[len];
+        size_t n;
+
+        switch (rng() % 4) {
+            case 0: // Valid frame, often a long one
+                if (room < FRAME_MAX)
+                    continue;
+                n = make_frame(p, rng() % 2 ? rng() % 64 : rng() % (ECG_MAX_PAYLOAD + 1), in, len);
+                break;
+            case 1: // Noise
+                n = rng() % 64;
+                for (i = 0; i < (int)n; i++) {
+                    p[i] = (uint8_t)rng();
+                }
+                break;
+            case 2: // Sync pairs with nothing behind them
+                n = 2 * (1 + rng() % 8);
+                for (i = 0; i < (int)n; i += 2) {
+                    p[i] = ECG_SYNC0;
+                    p[i + 1] = ECG_SYNC1;
+                }
+                break;
+            default: // Header only, CRC-8 good, payload never sent
+                if (room < FRAME_MAX)
+                    continue;
+                make_frame(p, rng() % (ECG_MAX_PAYLOAD + 1), in, len);
+                n = ECG_HEADER_LEN + rng() % 16;
+                break;
+        }
+        if (n > room)
+            n = room;
+        len += n;
+    }
+    for (i = rng() % 4; i > 0 && len; i--) {
+        in[rng() % len] ^= (uint8_t)(1 << (rng() % 8));
+    }
+    if (len && rng() % 4 == 0)
+        len -= rng() % len; // Cut short
+    return len;
+}
+
+int main(int argc, char** argv) {
+    static uint8_t in[INPUT_MAX];
+    unsigned long iterations = argc > 1 ? strtoul(argv[1], 0, 10) : 20000;
+    unsigned long frames = 0, header_errors = 0, crc_errors = 0, n;
+
+    rng_state = argc > 2 ? (uint32_t)strtoul(argv[2], 0, 10) : 1;
+    if (rng_state == 0)
+        rng_state = 1;
+    for (n = 0; n < iterations; n++) {
+        size_t len = make_input(in);
+        LLVMFuzzerTestOneInput(in, len);
+        frames += dec.frames_ok;
+        header_errors += dec.header_errors;
+        crc_errors += dec.crc_errors;
+    }
+    printf("%lu inputs: %lu frames, %lu header errors, %lu CRC errors, all checks passed\n",
+           iterations,
+           frames,
+           header_errors,
+           crc_errors);
+    return 0;
+}
+#endif
@@ -0,0 +1,280 @@
+// Fixed-point filter chain (ecg_filter.c) against a double-precision reference, and the MPY32
+// build against the plain C one. ecg_filter.c is linked as the firmware builds it, with
+// ECG_FILTER_MPY32 running on the simulator's multiplier model (sim/msp430_sim.c), and included
+// a second time below without it; this file stands in for main.c.
+//
+// Build from the repository root:
+//   gcc -O2 -DHOST_SIM -Isim -Idma-adc-display -Wno-unknown-pragmas -o ecg_filter_test
+//       sim/*.c dma-adc-display/ecg_filter.c tests/ecg_filter_test.c -lm
+// Run:
+//   ./ecg_filter_test -o /tmp
+//
+// For every sample width (12 bits, and 13 and 14 as with ACQ_OVS_BITS), sample rate and mains
+// setting (off, 50 Hz, 60 Hz), 10 s of synthetic ECG with baseline wander, mains hum and noise.
+// Checks that
+//   - the loaded biquads have a DC gain of exactly 1 (the b and a terms cancel in Q14),
+//   - the MPY32 and plain C builds give bit-identical output, also on a full-scale square wave
+//     that drives the chain into saturation,
+//   - running the input in 20-sample segments, one channel of two interleaved, gives the same
+//     output as one block,
+//   - the output is within MAX_ERROR 12-bit codes of the same chain computed in double precision
+//     from the same quantised coefficients, i.e. the rounding inside the chain costs at most that,
+//   - the notch takes the mains hum down by at least NOTCH_MIN_DB,
+//   - unsupported rates, mains frequencies and sample widths are refused and leave samples
+//     unchanged.
+// Prints the largest error against the reference per case. Exit status 1 on any failure.
+
+#include "ecg_filter.h"
+#include "hal.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The same source again without ECG_FILTER_MPY32: the plain C arithmetic, under other names
+#undef ECG_FILTER_MPY32
+#define ecg_filter_init c_filter_init
+#define ecg_filter_reset c_filter_reset
+#define ecg_filter_run c_filter_run
+void c_filter_reset(EcgFilter* f); // Called before its definition; ecg_filter.h is in already
+#include "../dma-adc-display/ecg_filter.c"
+#undef ecg_filter_init
+#undef ecg_filter_reset
+#undef ecg_filter_run
+
+#define SECONDS 10
+#define MAX_SAMPLES (2000 * SECONDS)
+#define SEGMENT_LEN 20
+#define MAX_ERROR 2.0 // 12-bit codes; rounding the output alone costs 0.5
+#define NOTCH_MIN_DB 20.0
+#define HUM_AMPLITUDE 100 // 12-bit codes
+
+static const uint16_t rates[] = { 250, 500, 1000, 2000 };
+static const uint8_t mains[] = { 0, 50, 60 };
+
+static uint16_t input[MAX_SAMPLES];
+static uint16_t out_mpy[MAX_SAMPLES];
+static uint16_t out_c[MAX_SAMPLES];
+static uint16_t interleaved[2 * MAX_SAMPLES];
+static double out_ref[MAX_SAMPLES];
+static int failures;
+static uint8_t bits = ECG_FILTER_MIN_BITS; // Sample width of the case being run
+
+__interrupt void DMA_ISR(void) {
+}
+
+__interrupt void USCI_A1_ISR(void) {
+}
+
+static void fail(const char* name, const char* what) {
+    printf("FAIL: %s: %s\n", name, what);
+    failures++;
+}
+
+// Synthetic ECG: baseline wander, a QRS-like pulse at 72 beats/min, mains hum and hash noise,
+// in codes of the current sample width
+static void make_ecg(uint16_t rate, uint8_t hum_hz, uint32_t count) {
+    double scale = 1 << (bits - ECG_FILTER_MIN_BITS);
+    uint32_t n;
+
+    for (n = 0; n < count; n++) {
+        double t = (double)n / rate;
+        double beat = fmod(t, 60.0 / 72);
+        double v = 2048 + 300 * sin(2 * M_PI * 0.3 * t) + 800 * exp(-pow((beat - 0.4) / 0.012, 2))
+                   + 150 * exp(-pow((beat - 0.65) / 0.05, 2));
+
+        if (hum_hz)
+            v += HUM_AMPLITUDE * sin(2 * M_PI * hum_hz * t);
+        v += (double)(((n * 2654435761u) >> 13) & 7) - 3.5;
+        input[n] = (uint16_t)lround(v * scale);
+    }
+}
+
+static double biquad_ref(const int16_t* c, double x, double* s) {
+    double y = (c[0] * x + c[1] * s[0] + c[2] * s[1] + c[3] * s[2] + c[4] * s[3]) / 16384.0;
+
+    s[1] = s[0];
+    s[0] = x;
+    s[3] = s[2];
+    s[2] = y;
+    return y;
+}
+
+// The chain of ecg_filter_run() in double precision, with the coefficients f was loaded with
+static void filter_ref(const EcgFilter* f, uint32_t count) {
+    uint8_t shift = ECG_FILTER_MAX_BITS - bits;
+    double hp_x1 = (double)(input[0] << shift);
+    double hp_y = 0;
+    double notch[4] = { 0 }, lowpass[4] = { 0 };
+    uint32_t n;
+
+    for (n = 0; n < count; n++) {
+        double x = (double)(input[n] << shift);
+        double y;
+
+        hp_y = x - hp_x1 + f->hp_a / 32768.0 * hp_y;
+        hp_x1 = x;
+        y = hp_y;
+        if (f->mains_hz)
+            y = biquad_ref(f->notch.c, y, notch);
+        y = biquad_ref(f->lowpass.c, y, lowpass);
+        out_ref[n] = (1 << (bits - 1)) + y / (1 << shift);
+    }
+}
+
+static void check_dc_gain(const char* name, const EcgBiquad* q) {
+    if ((int32_t)q->c[0] + q->c[1] + q->c[2] + q->c[3] + q->c[4] != 1L << 14)
+        fail(name, "biquad DC gain is not exactly 1");
+}
+
+// Filters input[] with both builds, in one block and in interleaved segments; returns 0 if
+// the outputs differ
+static int run_both(const char* name, uint16_t rate, uint8_t mains_hz, uint32_t count) {
+    EcgFilter mpy, c, seg;
+    uint32_t n;
+
+    if (!ecg_filter_init(&mpy, rate, mains_hz, bits) || !c_filter_init(&c, rate, mains_hz, bits)
+        || !ecg_filter_init(&seg, rate, mains_hz, bits))
+    {
+        fail(name, "rate refused");
+        return 0;
+    }
+    memcpy(out_mpy, input, count * sizeof(uint16_t));
+    memcpy(out_c, input, count * sizeof(uint16_t));
+    for (n = 0; n < count; n++) {
+        interleaved[2 * n] = input[n];
+        interleaved[2 * n + 1] = (uint16_t)((1 << bits) - 1 - input[n]);
+    }
+    ecg_filter_run(&mpy, out_mpy, (uint16_t)count, 1);
+    c_filter_run(&c, out_c, (uint16_t)count, 1);
+    for (n = 0; n < count; n += SEGMENT_LEN) {
+        uint32_t len = count - n < SEGMENT_LEN ? count - n : SEGMENT_LEN;
+        ecg_filter_run(&seg, &interleaved[2 * n], (uint16_t)len, 2);
+    }
+
+    for (n = 0; n < count; n++) {
+        if (out_mpy[n] != out_c[n]) {
+            printf("FAIL: %s: sample %lu is %u with MPY32, %u in plain C\n",
+                   name,
+                   (unsigned long)n,
+                   out_mpy[n],
+                   out_c[n]);
+            failures++;
+            return 0;
+        }
+        if (interleaved[2 * n] != out_mpy[n]) {
+            printf("FAIL: %s: sample %lu is %u in segments, %u in one block\n",
+                   name,
+                   (unsigned long)n,
+                   interleaved[2 * n],
+                   out_mpy[n]);
+            failures++;
+            return 0;
+        }
+    }
+    if (mains_hz)
+        check_dc_gain(name, &mpy.notch);
+    check_dc_gain(name, &mpy.lowpass);
+    filter_ref(&mpy, count);
+    return 1;
+}
+
+// RMS of the output minus the same chain without the hum, over the last half second
+static double hum_left(const uint16_t* with_hum, const uint16_t* without, uint32_t count,
+                       uint16_t rate) {
+    double sum = 0;
+    uint32_t n;
+
+    for (n = count - rate / 2; n < count; n++) {
+        double d = (double)with_hum[n] - without[n];
+        sum += d * d;
+    }
+    return sqrt(sum / (rate / 2));
+}
+
+static void test_chain(uint16_t rate, uint8_t mains_hz) {
+    static uint16_t clean[MAX_SAMPLES];
+    uint32_t count = (uint32_t)rate * SECONDS;
+    double scale = 1 << (bits - ECG_FILTER_MIN_BITS);
+    double max_error = 0;
+    uint32_t n;
+    char name[48];
+
+    snprintf(name,
+             sizeof(name),
+             "%u-bit, %u Hz, notch %s",
+             bits,
+             rate,
+             mains_hz == 50 ? "50" : mains_hz ? "60" : "off");
+
+    // Hum on the notched mains frequency, none without the notch
+    make_ecg(rate, mains_hz, count);
+    if (!run_both(name, rate, mains_hz, count))
+        return;
+    for (n = 0; n < count; n++) {
+        double e = fabs(out_mpy[n] - out_ref[n]) / scale;
+        if (e > max_error)
+            max_error = e;
+    }
+    printf("%-28s largest error against double precision %.2f 12-bit codes\n", name, max_error);
+    if (max_error > MAX_ERROR)
+        fail(name, "output too far from the double-precision reference");
+
+    if (mains_hz) {
+        double rms;
+
+        memcpy(clean, out_mpy, count * sizeof(uint16_t));
+        make_ecg(rate, 0, count);
+        run_both(name, rate, mains_hz, count);
+        rms = hum_left(clean, out_mpy, count, rate) / scale;
+        if (20 * log10(HUM_AMPLITUDE / sqrt(2) / (rms + 1e-9)) < NOTCH_MIN_DB) {
+            printf("FAIL: %s: %.1f codes RMS of hum left\n", name, rms);
+            failures++;
+        }
+    }
+}
+
+// Full-scale square wave at 5 Hz: the high-pass output and the biquads saturate
+static void test_saturation(uint16_t rate) {
+    uint32_t count = (uint32_t)rate * 2;
+    uint32_t n;
+    char name[48];
+
+    snprintf(name, sizeof(name), "%u-bit, %u Hz, full-scale steps", bits, rate);
+    for (n = 0; n < count; n++) {
+        input[n] = (n * 10 / rate) & 1 ? (uint16_t)((1 << bits) - 1) : 0;
+    }
+    run_both(name, rate, 50, count);
+}
+
+static void test_refused(void) {
+    EcgFilter f;
+    uint16_t s[4] = { 0, 1000, 4095, 2048 };
+
+    if (ecg_filter_init(&f, 300, 50, 12) || c_filter_init(&f, 300, 50, 12))
+        fail("refused", "300 Hz accepted");
+    if (ecg_filter_init(&f, 500, 55, 12))
+        fail("refused", "55 Hz mains accepted");
+    if (ecg_filter_init(&f, 500, 50, ECG_FILTER_MIN_BITS - 1)
+        || ecg_filter_init(&f, 500, 50, ECG_FILTER_MAX_BITS + 1))
+        fail("refused", "sample width out of range accepted");
+    ecg_filter_run(&f, s, 4, 1);
+    if (s[0] != 0 || s[1] != 1000 || s[2] != 4095 || s[3] != 2048)
+        fail("refused", "samples changed by a filter that was refused");
+}
+
+int main(void) {
+    unsigned r, m;
+
+    for (bits = ECG_FILTER_MIN_BITS; bits <= ECG_FILTER_MAX_BITS; bits++) {
+        for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+            for (m = 0; m < sizeof(mains) / sizeof(mains[0]); m++) {
+                test_chain(rates[r], mains[m]);
+            }
+            test_saturation(rates[r]);
+        }
+    }
+    test_refused();
+    printf(failures ? "%d failures\n" : "all checks passed\n", failures);
+    exit(failures ? 1 : 0);
+}
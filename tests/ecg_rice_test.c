@@ -0,0 +1,283 @@
+// Round trip of the Rice codec (ecg_rice.c): every block ecg_rice_encode() produces has to
+// decode to the samples it was given, with the predictor and escape the test expects.
+//
+// Build from the repository root:
+//   gcc -O2 -Idma-adc-display -o ecg_rice_test tests/ecg_rice_test.c dma-adc-display/ecg_rice.c
+//       -lm
+// Run:
+//   ./ecg_rice_test
+//
+// Cases:
+//   - flat, ramp, and synthetic ECG with noise, 1..ACQ_MAX_SEGMENT_LEN (64) samples
+//   - one channel out of interleaved data (stride 2 and 4)
+//   - the escape path with first-order residuals of +-4095
+//   - the escape path with second-order residuals at the 14-bit limit: full-scale spikes
+//     0, 4095, 0 and 4095, 0, 4095 give -8190 and +8190, zigzag 16379 and 16380, inside a
+//     block where the second-order predictor wins; the escape width w stays 0
+//   - the same with 13- and 14-bit samples (ACQ_OVS_BITS), where w has to grow to 1 and 2
+//   - random 12-bit codes with out_cap short of the result: the coder has to give up (return 0)
+//     without writing past out_cap
+//   - decoding cut-short and malformed blocks fails instead of reading past the end
+// Compression ratio over recorded ECG is measured by util/ecg_rice_bench.py. Exit status 1 on
+// any failure.
+
+#include "ecg_rice.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SAMPLES 512
+#define MAX_STRIDE 4
+
+static int failures;
+static unsigned long blocks, escapes_order2;
+
+static void fail(const char* name, const char* what) {
+    printf("FAIL: %s: %s\n", name, what);
+    failures++;
+}
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Largest zigzagged residual the encoder's chosen predictor meets in a block
+static uint16_t max_residual(const uint16_t* s, uint16_t count, uint16_t stride, int order2) {
+    uint16_t i, max = 0;
+
+    for (i = 1; i < count; i++) {
+        const uint16_t* p = s + i * stride;
+        int32_t r = order2 && i >= 2 ? (int32_t)p[0] - 2 * p[-stride] + p[-2 * stride]
+                                     : (int32_t)p[0] - p[-stride];
+        uint16_t v = (uint16_t)(r >= 0 ? 2 * r : -2 * r - 1);
+        if (v > max)
+            max = v;
+    }
+    return max;
+}
+
+// Encodes one channel of s and decodes it again; returns the params byte, or -1 on failure.
+// want_order2 is 0 or 1 to check the predictor the encoder picked, -1 for either.
+static int round_trip(const char* name, const uint16_t* s, uint16_t count, uint16_t stride,
+                      int want_order2) {
+    static uint8_t packed[MAX_SAMPLES * 4];
+    static uint16_t out[MAX_SAMPLES];
+    uint16_t len, i;
+    int n, order2;
+
+    blocks++;
+    len = ecg_rice_encode(s, count, stride, packed, sizeof(packed));
+    if (len == 0) {
+        fail(name, "encoder gave up with room to spare");
+        return -1;
+    }
+    order2 = (packed[2] & ECG_RICE_ORDER2) != 0;
+    if (want_order2 >= 0 && order2 != want_order2) {
+        fail(name, want_order2 ? "first-order predictor picked" : "second-order predictor picked");
+        return -1;
+    }
+    n = ecg_rice_decode(packed, len, out, MAX_SAMPLES);
+    if (n != count) {
+        fail(name, "decoded sample count");
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        if (out[i] != s[i * stride]) {
+            printf("FAIL: %s: sample %u decoded as %u, was %u\n", name, i, out[i], s[i * stride]);
+            failures++;
+            return -1;
+        }
+    }
+    if (count > 1 && ecg_rice_decode(packed, len, out, count - 1) != -1)
+        fail(name, "decoded into a buffer smaller than the block");
+    if (order2 && max_residual(s, count, stride, 1) >> (packed[2] & ECG_RICE_K_MASK)
+                      >= ECG_RICE_ESCAPE_Q)
+        escapes_order2++;
+    return packed[2];
+}
+
+static void test_shapes(void) {
+    static uint16_t s[MAX_SAMPLES];
+    uint16_t count, i;
+    char name[64];
+
+    for (count = 1; count <= 64; count++) {
+        for (i = 0; i < count; i++) {
+            s[i] = 2048;
+        }
+        snprintf(name, sizeof(name), "flat, %u samples", count);
+        round_trip(name, s, count, 1, -1);
+        for (i = 0; i < count; i++) {
+            s[i] = (uint16_t)(100 + 60 * i);
+        }
+        snprintf(name, sizeof(name), "ramp, %u samples", count);
+        round_trip(name, s, count, 1, count > 2 ? 1 : -1);
+        for (i = 0; i < count; i++) {
+            double t = i / 500.0;
+            double v = 2048 + 200 * sin(2 * M_PI * 0.3 * t) + 1500 * exp(-pow((i % 40 - 20) / 2.0, 2));
+            s[i] = (uint16_t)(v + (int)(rng() % 5) - 2);
+        }
+        snprintf(name, sizeof(name), "ECG, %u samples", count);
+        round_trip(name, s, count, 1, -1);
+    }
+}
+
+static void test_stride(void) {
+    static uint16_t s[MAX_SAMPLES * MAX_STRIDE];
+    uint16_t stride, ch, i;
+    char name[64];
+
+    for (stride = 2; stride <= MAX_STRIDE; stride *= 2) {
+        for (i = 0; i < 64 * stride; i++) {
+            s[i] = (uint16_t)(i % stride * 1000 + (i / stride) * (i % stride + 1) + rng() % 3);
+        }
+        for (ch = 0; ch < stride; ch++) {
+            snprintf(name, sizeof(name), "channel %u of %u interleaved", ch, stride);
+            round_trip(name, s + ch, 64, stride, -1);
+        }
+    }
+}
+
+static void test_escapes(void) {
+    static uint16_t s[MAX_SAMPLES];
+    uint16_t i;
+    int params;
+
+    // First order: a square wave between the rails, residuals +-4095
+    for (i = 0; i < 64; i++) {
+        s[i] = (i / 16) & 1 ? 4095 : 0;
+    }
+    params = round_trip("full-scale steps", s, 64, 1, 0);
+    if (params >= 0 && (max_residual(s, 64, 1, 0) >> (params & ECG_RICE_K_MASK)) < ECG_RICE_ESCAPE_Q)
+        fail("full-scale steps", "did not reach the escape");
+
+    // Second order: a fast sine, where second differences are far smaller than first ones, with
+    // both full-scale spikes in it. Their residuals reach the 14-bit limit.
+    for (i = 0; i < MAX_SAMPLES; i++) {
+        s[i] = (uint16_t)(2048 + 1800 * sin(i * 0.4));
+    }
+    s[200] = 0;
+    s[201] = 4095;
+    s[202] = 0;
+    s[300] = 4095;
+    s[301] = 0;
+    s[302] = 4095;
+    if (max_residual(s, MAX_SAMPLES, 1, 1) != (1 << ECG_RICE_RAW_BITS) - 4)
+        fail("second-order spikes", "test data does not reach zigzag 16380");
+    params = round_trip("second-order spikes", s, MAX_SAMPLES, 1, 1);
+    if (params >= 0 && (16380 >> (params & ECG_RICE_K_MASK)) < ECG_RICE_ESCAPE_Q)
+        fail("second-order spikes", "did not reach the escape");
+
+    if (params >= 0 && (params & ECG_RICE_W_MASK) != 0)
+        fail("second-order spikes", "escape wider than 12-bit samples need");
+
+    // The same spikes at the very start, where sample 1 still uses the first-order predictor
+    s[0] = 4095;
+    s[1] = 0;
+    s[2] = 4095;
+    s[3] = 0;
+    round_trip("second-order spikes at the start", s, MAX_SAMPLES, 1, 1);
+}
+
+// Second-order spikes over 13- and 14-bit samples: zigzag residuals up to 4 * 2^bits - 4, so the
+// escape needs bits - 12 more raw bits
+static void test_wide_escapes(void) {
+    static uint16_t s[MAX_SAMPLES];
+    uint16_t bits, i;
+    int params;
+    char name[64];
+
+    for (bits = 13; bits <= 14; bits++) {
+        uint16_t full = (uint16_t)((1u << bits) - 1);
+
+        for (i = 0; i < MAX_SAMPLES; i++) {
+            s[i] = (uint16_t)((full + 1) / 2 + (full / 2 - 100) * sin(i * 0.4));
+        }
+        s[200] = 0;
+        s[201] = full;
+        s[202] = 0;
+        s[300] = full;
+        s[301] = 0;
+        s[302] = full;
+        snprintf(name, sizeof(name), "second-order spikes, %u-bit", bits);
+        params = round_trip(name, s, MAX_SAMPLES, 1, 1);
+        if (params >= 0 && (params & ECG_RICE_W_MASK) >> ECG_RICE_W_SHIFT != bits - 12)
+            fail(name, "escape width does not match the sample width");
+
+        // A quiet block of the same width needs no wider escape
+        for (i = 0; i < 64; i++) {
+            s[i] = (uint16_t)(full - 50 + i % 5);
+        }
+        snprintf(name, sizeof(name), "quiet, %u-bit", bits);
+        params = round_trip(name, s, 64, 1, -1);
+        if (params >= 0 && (params & ECG_RICE_W_MASK) != 0)
+            fail(name, "escape widened without a residual that needs it");
+    }
+}
+
+static void test_out_cap(void) {
+    static uint16_t s[64];
+    static uint8_t packed[256];
+    uint16_t len, cap, i;
+
+    for (i = 0; i < 64; i++) {
+        s[i] = rng() & 0xFFF;
+    }
+    len = ecg_rice_encode(s, 64, 1, packed, sizeof(packed));
+    for (cap = 0; cap < len; cap++) {
+        memset(packed, 0xEE, sizeof(packed));
+        if (ecg_rice_encode(s, 64, 1, packed, cap) != 0)
+            fail("random codes", "encoded into less than its size");
+        for (i = cap; i < sizeof(packed); i++) {
+            if (packed[i] != 0xEE) {
+                fail("random codes", "wrote past out_cap");
+                break;
+            }
+        }
+    }
+}
+
+static void test_malformed(void) {
+    static uint16_t s[64], out[64];
+    static uint8_t packed[256];
+    uint16_t len, i;
+
+    for (i = 0; i < 64; i++) {
+        s[i] = (uint16_t)(2048 + (i % 7) * 30);
+    }
+    len = ecg_rice_encode(s, 64, 1, packed, sizeof(packed));
+    if (ecg_rice_decode(packed, ECG_RICE_HEADER_LEN - 1, out, 64) != -1)
+        fail("malformed", "block shorter than its header decoded");
+    for (i = ECG_RICE_HEADER_LEN; i < len; i++) {
+        if (ecg_rice_decode(packed, i, out, 64) != -1)
+            fail("malformed", "cut-short block decoded");
+    }
+    packed[2] = (packed[2] & ~ECG_RICE_K_MASK) | 14;
+    if (ecg_rice_decode(packed, len, out, 64) != -1)
+        fail("malformed", "k above 13 accepted");
+    packed[2] = (packed[2] & ~ECG_RICE_K_MASK) | ECG_RICE_W_MASK;
+    if (ecg_rice_decode(packed, len, out, 64) != -1)
+        fail("malformed", "escape width above ECG_RICE_MAX_W accepted");
+    packed[0] = packed[1] = 0;
+    if (ecg_rice_decode(packed, len, out, 64) != -1)
+        fail("malformed", "empty block accepted");
+}
+
+int main(void) {
+    test_shapes();
+    test_stride();
+    test_escapes();
+    test_wide_escapes();
+    test_out_cap();
+    test_malformed();
+    printf("%lu blocks round-tripped, %lu with a second-order escape\n", blocks, escapes_order2);
+    if (escapes_order2 == 0)
+        fail("escapes", "no block went through the second-order escape");
+    return failures ? 1 : 0;
+}
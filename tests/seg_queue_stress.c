@@ -0,0 +1,243 @@
+// Stress test of the segment queue (seg_queue.c) with the DMA ISR simulated on the host. Two
+// consumer threads pop, one keeping up and one that stalls now and then so the producer laps
+// it. The producer runs twice:
+//   thread  a thread of its own pushing as fast as it can; on a multi-core host it runs
+//           against the consumers in parallel, which is what SEGQ_BARRIER() is for
+//   signal  a timer signal handler that, like the DMA ISR, interrupts a consumer at any
+//           instruction, also halfway through copying an entry, and pushes a burst before the
+//           consumer resumes, now and then more than the whole ring; this needs only one core
+//
+// Build from the repository root (SEGQ_BARRIER as seg_queue.h asks for on a multi-core host):
+//   gcc -O2 -pthread "-DSEGQ_BARRIER()=__sync_synchronize()" -Idma-adc-display
+//       -o seg_queue_stress tests/seg_queue_stress.c dma-adc-display/seg_queue.c
+// Run:
+//   ./seg_queue_stress [pushes] [depth]
+//
+// Every descriptor's fields are derived from its push number, so a consumer can tell a torn
+// copy (fields of two different pushes) from a good one. Checks, for each run and consumer, that
+//   - every entry it gets is intact, and the entries come in push order,
+//   - an entry follows on from the previous one unless entries were dropped, and then, and only
+//     then, it carries SEGQ_FLAG_AFTER_GAP,
+//   - the entries it got plus its cursor's drops add up to every push, once drained,
+//   - its backlog never exceeded the depth,
+// and that the slow consumer was lapped at least once. A consumer still running WATCHDOG_S
+// seconds after the start, or popping more entries than were pushed, fails the test instead of
+// hanging it. Exit status 1 on any failure.
+
+#include "seg_queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define SEGMENT_LEN 20
+#define SLOTS 16
+#define CONSUMER_FAST 0
+#define CONSUMER_SLOW 1
+#define SIGNAL_PERIOD_US 20
+#define WATCHDOG_S 30
+
+typedef struct {
+    uint8_t consumer;
+    uint32_t got, gaps, torn, out_of_order, bad_flags;
+    volatile int finished;
+} ConsumerResult;
+
+static SegQueue queue;
+static uint16_t buffer[SLOTS * SEGMENT_LEN];
+static uint32_t pushes = 1000000;
+static volatile uint32_t pushed;
+static volatile int producer_done;
+static sigset_t alarm_signal;
+
+// Descriptor of push n; every field depends on n
+static void make_desc(uint32_t n, SegDesc* d) {
+    d->slot = n % SLOTS;
+    d->data = &buffer[d->slot * SEGMENT_LEN];
+    d->num_samples = (uint16_t)(n * 7 + 1);
+    d->start_sample = n * SEGMENT_LEN;
+    d->flags = 0;
+}
+
+static void push_next(void) {
+    SegDesc d;
+
+    make_desc(pushed, &d);
+    segq_push(&queue, &d);
+    pushed++;
+}
+
+static void* producer_thread(void* arg) {
+    (void)arg;
+    while (pushed < pushes) {
+        push_next();
+        if ((pushed & 7) == 0)
+            sched_yield(); // Let the consumers in between on a single core too
+    }
+    producer_done = 1;
+    return 0;
+}
+
+// The "ISR": mostly 1..4 entries, every eighth tick SEGQ_LEN or more, which overwrites the
+// entry an interrupted consumer was copying. The signal can land in one consumer thread while the handler is still running, preempted, in the
+// other; such a tick is skipped, as the queue has a single producer.
+static void producer_signal(int sig) {
+    static volatile int busy;
+    uint32_t hash, burst;
+
+    (void)sig;
+    if (__sync_lock_test_and_set(&busy, 1))
+        return;
+    hash = pushed * 2654435761u >> 16;
+    burst = hash % 8 == 0 ? SEGQ_LEN + hash % queue.depth : 1 + hash % 4;
+    while (burst-- > 0 && pushed < pushes) {
+        push_next();
+    }
+    if (pushed == pushes)
+        producer_done = 1;
+    __sync_lock_release(&busy);
+}
+
+static void* consumer(void* arg) {
+    ConsumerResult* r = arg;
+    SegDesc got, want;
+    uint32_t next = 0; // Push number expected next
+    uint32_t popped = 0;
+    uint32_t spin = 0;
+
+    pthread_sigmask(SIG_UNBLOCK, &alarm_signal, 0);
+    while (popped <= pushes) {
+        int done = producer_done; // Read before popping: once set and the queue is empty, stop
+        uint32_t n;
+
+        if (!segq_pop(&queue, r->consumer, &got)) {
+            if (done)
+                break;
+            sched_yield();
+            continue;
+        }
+        popped++;
+        n = got.start_sample / SEGMENT_LEN;
+        make_desc(n, &want);
+        if (got.start_sample % SEGMENT_LEN || got.slot != want.slot || got.data != want.data
+            || got.num_samples != want.num_samples)
+        {
+            r->torn++;
+            continue;
+        }
+        if (n < next) {
+            r->out_of_order++;
+            continue;
+        }
+        if (n > next)
+            r->gaps++;
+        if (!(got.flags & SEGQ_FLAG_AFTER_GAP) != (n == next))
+            r->bad_flags++;
+        next = n + 1;
+        r->got++;
+
+        // The slow consumer stalls every so often, long enough for the producer to lap it
+        if (r->consumer == CONSUMER_SLOW && ++spin % 4096 == 0) {
+            int i;
+            for (i = 0; i < 16; i++) {
+                sched_yield();
+            }
+        }
+    }
+    r->finished = 1;
+    return 0;
+}
+
+// One run with the producer as a thread or as the signal handler; returns the failure count
+static int run(const char* name, int from_signal, uint16_t depth) {
+    ConsumerResult result[SEGQ_MAX_CONSUMERS] = { { .consumer = CONSUMER_FAST },
+                                                  { .consumer = CONSUMER_SLOW } };
+    struct itimerval timer = { { 0, SIGNAL_PERIOD_US }, { 0, SIGNAL_PERIOD_US } };
+    pthread_t threads[SEGQ_MAX_CONSUMERS], producer;
+    struct timespec tick = { 0, 10000000 };
+    int failures = 0;
+    int i, waited;
+
+    segq_init(&queue, depth);
+    pushed = 0;
+    producer_done = 0;
+
+    for (i = 0; i < SEGQ_MAX_CONSUMERS; i++) {
+        pthread_create(&threads[i], 0, consumer, &result[i]);
+    }
+    if (from_signal)
+        setitimer(ITIMER_REAL, &timer, 0);
+    else
+        pthread_create(&producer, 0, producer_thread, 0);
+    for (i = 0; i < SEGQ_MAX_CONSUMERS; i++) {
+        for (waited = 0; !result[i].finished; waited++) {
+            if (waited == WATCHDOG_S * 100) {
+                printf("%s: FAIL: consumer %d still running after %d s, stuck in segq_pop()?\n",
+                       name,
+                       i,
+                       WATCHDOG_S);
+                exit(1);
+            }
+            nanosleep(&tick, 0);
+        }
+        pthread_join(threads[i], 0);
+    }
+    if (from_signal) {
+        memset(&timer, 0, sizeof(timer));
+        setitimer(ITIMER_REAL, &timer, 0);
+    } else {
+        pthread_join(producer, 0);
+    }
+
+    printf("%s: %lu pushes, depth %u\n", name, (unsigned long)pushed, queue.depth);
+    for (i = 0; i < SEGQ_MAX_CONSUMERS; i++) {
+        const ConsumerResult* r = &result[i];
+        const SegCursor* c = &queue.cursor[i];
+        int ok = r->torn == 0 && r->out_of_order == 0 && r->bad_flags == 0
+                 && (uint16_t)(pushes - r->got) == c->drops // drops is 16 bits and wraps
+                 && c->high_water <= queue.depth;
+
+        printf("  consumer %d: %lu entries, %lu gaps, %u dropped, backlog up to %u; %lu torn, "
+               "%lu out of order, %lu with wrong flags%s\n",
+               i,
+               (unsigned long)r->got,
+               (unsigned long)r->gaps,
+               c->drops,
+               c->high_water,
+               (unsigned long)r->torn,
+               (unsigned long)r->out_of_order,
+               (unsigned long)r->bad_flags,
+               ok ? "" : " FAIL");
+        failures += !ok;
+    }
+    if (result[CONSUMER_SLOW].gaps == 0) {
+        printf("  FAIL: the slow consumer was never lapped, the drop path did not run\n");
+        failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    uint16_t depth = SLOTS - 1;
+    int failures;
+
+    if (argc > 1)
+        pushes = strtoul(argv[1], 0, 10);
+    if (argc > 2)
+        depth = (uint16_t)strtoul(argv[2], 0, 10);
+
+    // Only the consumer threads unblock the timer signal, so the "ISR" always interrupts one
+    // of them
+    sigemptyset(&alarm_signal);
+    sigaddset(&alarm_signal, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarm_signal, 0);
+    signal(SIGALRM, producer_signal);
+
+    failures = run("thread", 0, depth);
+    failures += run("signal", 1, depth);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+// Completion ordering of the TFT DMA path (tft_DmaFill/tft_DmaPattern/tft_DmaBlit) on the
+// simulator's DMA channel 1 model (sim/msp430_sim.c). The driver runs unmodified; this file
+// stands in for main.c.
+//
+// Build from the repository root:
+//   gcc -O2 -DHOST_SIM -Isim -Idma-adc-display -Wno-unknown-pragmas -o tft_dma_test
+//       sim/*.c dma-adc-display/dr_tft.c dma-adc-display/dr_tft2.c tests/tft_dma_test.c -lm
+// Run:
+//   ./tft_dma_test -o /tmp
+//
+// Queues a sequence of transfers back to back without waiting: a full-screen fill (2400
+// passes over the 64-byte pattern buffer), a blit larger than one DMA pass, a multi-pixel
+// pattern, the synchronous fallback for a pattern too large for the buffer, and a
+// synchronous etft_AreaSet() behind them. Checks that
+//   - every async call returns while its transfer is still running,
+//   - the completion callback runs once per transfer, in submission order, only after the
+//     LCD has received the transfer's last pixel and CS is back high,
+//   - tft_DmaBusy() is clear inside the callback,
+//   - the panel ends up holding exactly what the sequence drew.
+// Also reports the longest DMA_ISR of a pass restart and of a completion, and checks that the
+// completion's UCBUSY drain stays within the bound documented in tft_DmaIsr(). Exit status 1
+// on any failure.
+
+#include "dr_tft.h"
+#include "hal.h"
+#include "lcd_model.h"
+#include "sim_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_DONE 8
+#define BLIT_W 320
+#define BLIT_H 120 // 76800 bytes, two DMA passes
+// Worst-case UCBUSY drain documented in tft_DmaIsr(): two bytes at the 4 MHz SPI clock
+#define DRAIN_LIMIT 80
+
+typedef struct {
+    uint64_t pixels; // lcd_stats.pixel_writes when the callback ran
+    uint64_t time;
+    int cs_active;
+    int busy;
+} DoneEvent;
+
+static DoneEvent done[MAX_DONE];
+static int done_count;
+static uint64_t pass_isr_max, done_isr_max;
+static uint8_t blit_pixels[BLIT_W * BLIT_H * 2];
+static uint16_t expected[LCD_HEIGHT][LCD_WIDTH];
+static int failures;
+
+__interrupt void DMA_ISR(void) {
+    uint64_t start;
+
+    switch (__even_in_range(DMAIV, 16)) {
+        case 4: // DMA1IFG
+            start = sim_now;
+            tft_DmaIsr();
+            if (tft_DmaBusy()) {
+                if (sim_now - start > pass_isr_max)
+                    pass_isr_max = sim_now - start;
+            } else if (sim_now - start > done_isr_max) {
+                done_isr_max = sim_now - start;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+__interrupt void USCI_A1_ISR(void) {
+}
+
+static void on_done(void) {
+    if (done_count < MAX_DONE) {
+        done[done_count].pixels = lcd_stats.pixel_writes;
+        done[done_count].time = sim_now;
+        done[done_count].cs_active = !(P5OUT & BIT0); // P5.0, active low
+        done[done_count].busy = tft_DmaBusy();
+    }
+    done_count++;
+}
+
+static void fail(const char* what) {
+    printf("FAIL: %s\n", what);
+    failures++;
+}
+
+// Marks an etft-coordinate rectangle in the expected image
+static void expect_area(int sx, int sy, int ex, int ey, uint16_t color) {
+    int x, y;
+
+    for (y = sy; y <= ey; y++) {
+        for (x = sx; x <= ex; x++) {
+            expected[y][x] = color;
+        }
+    }
+}
+
+// Submits an async transfer and checks it did not finish inside the call
+static void expect_running(const char* what) {
+    if (!tft_DmaBusy())
+        fail(what);
+}
+
+int main(void) {
+    static const uint16_t stripes[3] = { 0xF800, 0x07E0, 0x001F };
+    uint16_t big_pattern[40];
+    uint64_t pixels[MAX_DONE];
+    int n = 0;
+    int i, x, y;
+    LcdDiff diff;
+
+    initTFT();
+    tft_DmaSetCallback(on_done);
+    __enable_interrupt();
+
+    for (i = 0; i < BLIT_W * BLIT_H; i++) {
+        uint16_t c = (uint16_t)(i * 7 + (i >> 5));
+        blit_pixels[i * 2] = c >> 8;
+        blit_pixels[i * 2 + 1] = c & 0xFF;
+    }
+    for (i = 0; i < 40; i++) {
+        big_pattern[i] = (uint16_t)(0x1000 + i * 0x0101);
+    }
+
+    // 1. Full-screen fill
+    etft_AreaSetAsync(0, 0, TFT_YSIZE - 1, TFT_XSIZE - 1, 0x1234);
+    expect_running("full-screen fill finished before returning");
+    expect_area(0, 0, TFT_YSIZE - 1, TFT_XSIZE - 1, 0x1234);
+    pixels[n++] = (uint64_t)TFT_XSIZE * TFT_YSIZE;
+
+    // 2. Blit of two passes, queued behind the fill
+    etft_BlitAsync(blit_pixels, 0, 60, BLIT_W, BLIT_H);
+    expect_running("blit finished before returning");
+    if (done_count < 1)
+        fail("blit started before the fill completed");
+    for (y = 0; y < BLIT_H; y++) {
+        for (x = 0; x < BLIT_W; x++) {
+            i = y * BLIT_W + x;
+            expected[60 + y][x] = (uint16_t)(blit_pixels[i * 2] << 8 | blit_pixels[i * 2 + 1]);
+        }
+    }
+    pixels[n++] = BLIT_W * BLIT_H;
+
+    // 3. Three-colour pattern, 30 repeats across a 10x9 window
+    etft_BeginWindow(100, 20, 109, 28);
+    tft_DmaPattern(stripes, 3, 30);
+    expect_running("pattern finished before returning");
+    for (i = 0; i < 90; i++) {
+        expected[20 + i / 10][100 + i % 10] = stripes[i % 3];
+    }
+    pixels[n++] = 90;
+
+    // 4. Pattern too large for the buffer: sent synchronously, still completes in order
+    etft_BeginWindow(200, 200, 239, 201);
+    tft_DmaPattern(big_pattern, 40, 2);
+    if (tft_DmaBusy())
+        fail("synchronous fallback left the busy flag set");
+    for (i = 0; i < 80; i++) {
+        expected[200 + i / 40][200 + i % 40] = big_pattern[i % 40];
+    }
+    pixels[n++] = 80;
+
+    // 5. Async fill, then a synchronous fill that must wait for it
+    etft_AreaSetAsync(300, 0, 319, 239, 0xFFFF);
+    expect_running("column fill finished before returning");
+    expect_area(300, 0, 319, 239, 0xFFFF);
+    pixels[n++] = 20 * TFT_XSIZE;
+    etft_AreaSet(310, 100, 319, 109, 0x0000);
+    expect_area(310, 100, 319, 109, 0x0000);
+
+    tft_DmaWait();
+
+    if (done_count != n) {
+        printf("FAIL: %d completions for %d transfers\n", done_count, n);
+        failures++;
+    }
+    for (i = 0; i < n && i < done_count; i++) {
+        uint64_t want = (i ? done[i - 1].pixels : 0) + pixels[i];
+        if (done[i].pixels != want || done[i].cs_active || done[i].busy) {
+            printf("FAIL: completion %d at %llu pixels (want %llu), CS %s, busy %d\n",
+                   i + 1,
+                   (unsigned long long)done[i].pixels,
+                   (unsigned long long)want,
+                   done[i].cs_active ? "low" : "high",
+                   done[i].busy);
+            failures++;
+        }
+        if (i && done[i].time < done[i - 1].time)
+            fail("completions out of order");
+    }
+
+    lcd_diff(&expected[0][0], &lcd_fb[0][0], &diff);
+    if (diff.changed) {
+        printf("FAIL: %u pixels differ from the expected image, (%u,%u)-(%u,%u)\n",
+               diff.changed,
+               diff.min_x,
+               diff.min_y,
+               diff.max_x,
+               diff.max_y);
+        failures++;
+    }
+
+    if (done_isr_max > pass_isr_max + DRAIN_LIMIT)
+        fail("completion ISR drained UCBUSY for longer than two SPI bytes");
+
+    printf("%d transfers, %d completions\n", n, done_count);
+    printf("longest DMA_ISR: pass restart %llu cycles, completion %llu cycles (%.1f us)\n",
+           (unsigned long long)pass_isr_max,
+           (unsigned long long)done_isr_max,
+           done_isr_max * 1e6 / SIM_MCLK_HZ);
+    exit(failures ? 1 : 0);
+}
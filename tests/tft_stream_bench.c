@@ -0,0 +1,109 @@
+// Cost of filling the TFT, per-word versus streamed versus DMA, measured in the
+// simulator's virtual MCLK cycles (sim/msp430_sim.c). The driver runs unmodified;
+// this file stands in for main.c.
+//
+// Build from the repository root:
+//   gcc -O2 -DHOST_SIM -Isim -Idma-adc-display -Wno-unknown-pragmas -o tft_stream_bench
+//       sim/*.c dma-adc-display/dr_tft.c dma-adc-display/dr_tft2.c tests/tft_stream_bench.c -lm
+// Run (simulator options apply, -o takes the simulator's output files):
+//   ./tft_stream_bench -o /tmp
+//
+// Each case fills the whole panel with its own colour:
+//   word    every pixel through tft_SendData(), CS and RS set and UCBUSY drained per word
+//           (how etft_AreaSet() drew before the streaming interface)
+//   stream  etft_AreaSet(): one window, pixels back to back with CS held low
+//   dma     etft_AreaSetAsync(): the same stream fed by DMA channel 1, the CPU idles until done
+// "cpu" is the time the CPU spent in the driver, the rest it spent idle. The exit status is 1
+// if the panel does not hold the colour afterwards.
+
+#include "dr_tft.h"
+#include "hal.h"
+#include "lcd_model.h"
+#include "sim_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef enum {
+    BENCH_WORD,
+    BENCH_STREAM,
+    BENCH_DMA
+} BenchMode;
+
+static const char* const bench_names[] = { "word", "stream", "dma" };
+
+__interrupt void DMA_ISR(void) {
+    switch (__even_in_range(DMAIV, 16)) {
+        case 4: // DMA1IFG
+            tft_DmaIsr();
+            break;
+        default:
+            break;
+    }
+}
+
+__interrupt void USCI_A1_ISR(void) {
+}
+
+static void fill_by_words(uint16_t color) {
+    uint32_t n;
+
+    tft_SendCmd(TFTREG_WIN_MINX, 0);
+    tft_SendCmd(TFTREG_WIN_MINY, 0);
+    tft_SendCmd(TFTREG_WIN_MAXX, TFT_YSIZE - 1); // etft coordinates: X along the long side
+    tft_SendCmd(TFTREG_WIN_MAXY, TFT_XSIZE - 1);
+    tft_SendCmd(TFTREG_RAM_XADDR, 0);
+    tft_SendCmd(TFTREG_RAM_YADDR, 0);
+    tft_SendIndex(TFTREG_RAM_ACCESS);
+    for (n = 0; n < (uint32_t)TFT_XSIZE * TFT_YSIZE; n++) {
+        tft_SendData(color);
+    }
+}
+
+static int bench(BenchMode mode, uint16_t color) {
+    uint64_t start = sim_now;
+    uint64_t idle = sim_stats.idle_cycles;
+    uint64_t bytes = lcd_stats.spi_bytes;
+    uint64_t cycles, cpu;
+    uint32_t wrong = 0;
+    int x, y;
+
+    switch (mode) {
+        case BENCH_WORD:
+            fill_by_words(color);
+            break;
+        case BENCH_STREAM:
+            etft_AreaSet(0, 0, TFT_YSIZE - 1, TFT_XSIZE - 1, color);
+            break;
+        case BENCH_DMA:
+            etft_AreaSetAsync(0, 0, TFT_YSIZE - 1, TFT_XSIZE - 1, color);
+            tft_DmaWait();
+            break;
+    }
+    cycles = sim_now - start;
+    cpu = cycles - (sim_stats.idle_cycles - idle);
+    for (y = 0; y < LCD_HEIGHT; y++) {
+        for (x = 0; x < LCD_WIDTH; x++) {
+            wrong += lcd_fb[y][x] != color;
+        }
+    }
+    printf("%-7s %10llu cycles (%7.2f ms), cpu %10llu cycles, %7llu SPI bytes%s\n",
+           bench_names[mode],
+           (unsigned long long)cycles,
+           cycles * 1000.0 / SIM_MCLK_HZ,
+           (unsigned long long)cpu,
+           (unsigned long long)(lcd_stats.spi_bytes - bytes),
+           wrong ? "  WRONG PIXELS" : "");
+    return wrong == 0;
+}
+
+int main(void) {
+    int ok = 1;
+
+    initTFT();
+    __enable_interrupt();
+    printf("full-screen fill, %u pixels\n", TFT_XSIZE * TFT_YSIZE);
+    ok &= bench(BENCH_WORD, 0xF800);
+    ok &= bench(BENCH_STREAM, 0x07E0);
+    ok &= bench(BENCH_DMA, 0x001F);
+    exit(ok ? 0 : 1);
+}
@@ -0,0 +1,277 @@
+// Sweep trace rendering (etft_TraceSamples in dr_tft2.c) against a golden image, plus the SPI
+// cost per segment of the column renderer against the line renderer it replaced. Runs on the
+// simulator's LCD model (sim/lcd_model.c); this file stands in for main.c.
+//
+// Build from the repository root:
+//   gcc -O2 -DHOST_SIM -Isim -Idma-adc-display -Wno-unknown-pragmas -o trace_golden_test
+//       sim/*.c dma-adc-display/dr_tft.c dma-adc-display/dr_tft2.c tests/trace_golden_test.c -lm
+// Run, comparing the final panel with the golden image (exit status 2 if a pixel differs):
+//   ./trace_golden_test -o /tmp -g tests/golden/trace_sweep.ppm
+// After an intended change to the rendering, check /tmp/lcd_final.ppm by eye and copy it over
+// tests/golden/trace_sweep.ppm.
+//
+// Equivalence: 1.5 sweeps drawn one column per sample with each renderer from a clear screen
+// must give the same panel. The column renderer joins neighbouring columns with Bresenham's
+// pixel split, so steep edges match too; the only columns allowed to differ are the erase bar
+// ETFT_SWEEP_GAP columns ahead of the cursor, which the column renderer has blanked and the
+// line renderer has not reached yet. Exit status 1 if any other pixel differs.
+//
+// Cost, 20 samples per segment drawn one column per sample, 16 segments per screen (the
+// geometry of the original display loop), counted over the second and third sweep:
+//   lines    the original renderer: clear the segment's 21 columns, then Bresenham lines
+//            through 1x1 windows (etft_DisplayADCSegment before the column renderer)
+//   columns  etft_TraceSamples(): each column written once, only the pixels that change
+// Golden image: two lanes at 500 Hz and 123 columns/s (25 mm/s), synthetic ECG with the same
+// integer arithmetic on every host. 1.5 sweeps, so the cursor wraps and the erase bar runs
+// over the previous sweep, with a dropped segment in the lower lane and a final stretch at
+// 50 Hz where columns outnumber samples and the trace is interpolated.
+
+#include "dr_tft.h"
+#include "hal.h"
+#include "lcd_model.h"
+#include "sim_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGMENT_LEN 20
+#define SEGMENTS_PER_SCREEN 16
+#define BENCH_SEGMENTS (3 * SEGMENTS_PER_SCREEN)
+#define EQUIV_SEGMENTS (SEGMENTS_PER_SCREEN * 3 / 2)
+#define GOLDEN_SEGMENTS 100 // 2000 samples at 500 Hz, 492 columns
+#define GOLDEN_DROPPED 70 // Segment the lower lane never sees
+#define ZOOM_SEGMENTS 2 // Then 40 samples at 50 Hz, 98 columns
+#define FG 0x07E0
+#define BG 0x0000
+
+__interrupt void DMA_ISR(void) {
+    switch (__even_in_range(DMAIV, 16)) {
+        case 4: // DMA1IFG
+            tft_DmaIsr();
+            break;
+        default:
+            break;
+    }
+}
+
+__interrupt void USCI_A1_ISR(void) {
+}
+
+// Synthetic ECG at 500 Hz: baseline wander, QRS, T wave and hash noise, 72 beats/min.
+// lead scales the R wave so the lanes differ.
+static uint16_t ecg_code(uint32_t n, int lead) {
+    uint32_t p = n % 417;
+    int32_t wander = (int32_t)(n % 2000);
+    int32_t v;
+
+    v = 2048 + (wander < 1000 ? wander : 2000 - wander) / 5 - 100;
+    if (p >= 150 && p < 156)
+        v += (int32_t)(p - 149) * (200 - 40 * lead); // R up
+    else if (p >= 156 && p < 163)
+        v += (int32_t)(162 - p) * (200 - 40 * lead) - 250; // R down into S
+    else if (p >= 163 && p < 168)
+        v -= (int32_t)(168 - p) * 50; // S back to baseline
+    else if (p >= 250 && p < 330)
+        v += 250 - (int32_t)(p > 290 ? p - 290 : 290 - p) * 6; // T
+    v += (int32_t)(((n * 2654435761u) >> 13) & 15) - 8;
+    if (v < 0)
+        v = 0;
+    if (v > 4095)
+        v = 4095;
+    return (uint16_t)v;
+}
+
+// --- The line renderer before the column renderer, one sample per column ---
+
+static uint16_t line_prev_x, line_prev_y;
+
+static void line_pixel(uint16_t x, uint16_t y) {
+    if (x < TFT_YSIZE && y < TFT_XSIZE)
+        etft_AreaSet(x, y, x, y, FG);
+}
+
+static void line_draw(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2) {
+    int16_t dx_abs = x2 > x1 ? x2 - x1 : x1 - x2;
+    int16_t dy_abs = y2 > y1 ? y2 - y1 : y1 - y2;
+    int16_t sx = x2 > x1 ? 1 : -1;
+    int16_t sy = y2 > y1 ? 1 : -1;
+    int16_t err = dx_abs - dy_abs, e2;
+
+    for (;;) {
+        line_pixel(x1, y1);
+        if (x1 == x2 && y1 == y2)
+            break;
+        e2 = 2 * err;
+        if (e2 > -dy_abs) {
+            err -= dy_abs;
+            x1 += sx;
+        }
+        if (e2 < dx_abs) {
+            err += dx_abs;
+            y1 += sy;
+        }
+    }
+}
+
+static void line_segment(const uint16_t* samples, uint16_t segment_idx) {
+    uint16_t width = TFT_YSIZE / SEGMENTS_PER_SCREEN;
+    uint16_t x0 = segment_idx * width;
+    uint16_t i;
+
+    etft_AreaSet(x0, 0, x0 + width, TFT_XSIZE - 1, BG);
+    for (i = 0; i < width; i++) {
+        uint16_t x = x0 + i;
+        uint16_t y = (TFT_XSIZE - 1) - (uint32_t)samples[i] * (TFT_XSIZE - 1) / 4095;
+        if (i > 0 || segment_idx > 0)
+            line_draw(line_prev_x, line_prev_y, x, y);
+        else
+            line_pixel(x, y);
+        line_prev_x = x;
+        line_prev_y = y;
+    }
+}
+
+// --- Same panel from both renderers ---
+
+static uint16_t lines_fb[LCD_HEIGHT][LCD_WIDTH];
+
+static void draw_sweep(int columns, int segments) {
+    uint16_t samples[SEGMENT_LEN];
+    uint32_t n = 0;
+    int s, i;
+
+    etft_AreaSet(0, 0, TFT_YSIZE - 1, TFT_XSIZE - 1, BG);
+    etft_TraceSetLanes(1);
+    etft_TraceSetScale(500, 500);
+    for (s = 0; s < segments; s++) {
+        for (i = 0; i < SEGMENT_LEN; i++) {
+            samples[i] = ecg_code(n + i, 0);
+        }
+        if (columns)
+            etft_TraceSamples(0, samples, SEGMENT_LEN, 1, n, FG, BG);
+        else
+            line_segment(samples, s % SEGMENTS_PER_SCREEN);
+        n += SEGMENT_LEN;
+    }
+}
+
+static void equivalence(void) {
+    uint16_t cursor = (EQUIV_SEGMENTS * SEGMENT_LEN) % TFT_YSIZE;
+    uint16_t x, y, gap;
+    LcdDiff diff;
+    int failures = 0;
+
+    draw_sweep(0, EQUIV_SEGMENTS);
+    memcpy(lines_fb, lcd_fb, sizeof(lines_fb));
+    draw_sweep(1, EQUIV_SEGMENTS);
+
+    // The erase bar: blank on the column panel, the previous sweep on the line panel. Take
+    // those columns out of the comparison once the column panel is checked to be blank there.
+    for (gap = 1; gap < ETFT_SWEEP_GAP; gap++) {
+        x = (cursor + gap) % TFT_YSIZE;
+        for (y = 0; y < TFT_XSIZE; y++) {
+            if (lcd_fb[y][x] != BG) {
+                printf("FAIL: erase bar column %u not blank at row %u\n", x, y);
+                failures++;
+                break;
+            }
+            lines_fb[y][x] = BG;
+        }
+    }
+
+    lcd_diff(&lines_fb[0][0], &lcd_fb[0][0], &diff);
+    if (diff.changed) {
+        printf("FAIL: %u pixels differ between the line and column renderers, (%u,%u)-(%u,%u)\n",
+               diff.changed,
+               diff.min_x,
+               diff.min_y,
+               diff.max_x,
+               diff.max_y);
+        failures++;
+    }
+    if (failures)
+        exit(1);
+    printf("renderers match over %d segments outside the erase bar (columns %u-%u)\n",
+           EQUIV_SEGMENTS,
+           (cursor + 1) % TFT_YSIZE,
+           (cursor + ETFT_SWEEP_GAP - 1) % TFT_YSIZE);
+}
+
+// --- Cost per segment ---
+
+typedef struct {
+    uint64_t cycles, bytes, transactions;
+} Cost;
+
+static Cost cost_now(void) {
+    Cost c = { sim_now, lcd_stats.spi_bytes, lcd_stats.transactions };
+    return c;
+}
+
+static void bench(const char* name, int columns) {
+    uint16_t samples[SEGMENT_LEN];
+    Cost start = { 0, 0, 0 }, end;
+    uint32_t n = 0;
+    int s, i;
+
+    etft_AreaSet(0, 0, TFT_YSIZE - 1, TFT_XSIZE - 1, BG);
+    etft_TraceSetLanes(1);
+    etft_TraceSetScale(500, 500);
+    for (s = 0; s < BENCH_SEGMENTS; s++) {
+        if (s == SEGMENTS_PER_SCREEN)
+            start = cost_now();
+        for (i = 0; i < SEGMENT_LEN; i++) {
+            samples[i] = ecg_code(n + i, 0);
+        }
+        if (columns)
+            etft_TraceSamples(0, samples, SEGMENT_LEN, 1, n, FG, BG);
+        else
+            line_segment(samples, s % SEGMENTS_PER_SCREEN);
+        n += SEGMENT_LEN;
+    }
+    end = cost_now();
+    s = BENCH_SEGMENTS - SEGMENTS_PER_SCREEN;
+    printf("%-8s %7.1f SPI bytes, %5.1f transactions, %7.0f cycles per segment\n",
+           name,
+           (double)(end.bytes - start.bytes) / s,
+           (double)(end.transactions - start.transactions) / s,
+           (double)(end.cycles - start.cycles) / s);
+}
+
+int main(void) {
+    uint16_t samples[SEGMENT_LEN * 2];
+    uint32_t n = 0;
+    int s, i;
+
+    initTFT();
+    __enable_interrupt();
+
+    equivalence();
+    bench("lines", 0);
+    bench("columns", 1);
+
+    etft_AreaSet(0, 0, TFT_YSIZE - 1, TFT_XSIZE - 1, BG);
+    etft_TraceSetLanes(2);
+    etft_TraceSetScale(500, 123);
+    for (s = 0; s < GOLDEN_SEGMENTS; s++) {
+        for (i = 0; i < SEGMENT_LEN; i++) {
+            samples[i * 2] = ecg_code(n + i, 0);
+            samples[i * 2 + 1] = ecg_code(n + i, 1);
+        }
+        etft_TraceSamples(0, &samples[0], SEGMENT_LEN, 2, n, FG, BG);
+        if (s != GOLDEN_DROPPED)
+            etft_TraceSamples(1, &samples[1], SEGMENT_LEN, 2, n, FG, BG);
+        n += SEGMENT_LEN;
+    }
+    etft_TraceSetScale(50, 123);
+    n /= 10;
+    for (s = 0; s < ZOOM_SEGMENTS; s++) {
+        for (i = 0; i < SEGMENT_LEN; i++) {
+            samples[i] = ecg_code((n + i) * 10, 0);
+        }
+        etft_TraceSamples(0, samples, SEGMENT_LEN, 1, n, FG, BG);
+        etft_TraceSamples(1, samples, SEGMENT_LEN, 1, n, FG, BG);
+        n += SEGMENT_LEN;
+    }
+    return 0; // The simulator compares the panel with -g and sets the exit status
+}
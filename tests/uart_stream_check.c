@@ -0,0 +1,303 @@
+// Checks a UART byte stream from the firmware, e.g. the simulator's uart_tx.bin, against the
+// frame formats in ecg_proto.h and uart_link.h.
+//
+// Build from the repository root:
+//   gcc -O2 -Idma-adc-display -o uart_stream_check tests/uart_stream_check.c
+//       dma-adc-display/ecg_proto.c dma-adc-display/ecg_rice.c
+// Run:
+//   ./uart_stream_check [-r min_recaptured] [-w sample_bits] uart_tx.bin
+//
+// Every byte has to belong to a control frame (0xAA 0x5A, checksum good) or to an ECG frame
+// (0xAA 0x55, header CRC-8 and CRC-16 good); only the end of the file may hold a partial frame.
+// On top of that:
+//   - version 2, a known type, and a payload length that fits the type
+//   - raw sample frames hold whole samples of every channel in the mask; Rice frames decode,
+//     to the same count in every channel
+//   - sequence numbers go up by one; a gap is a frame the firmware dropped (reported)
+//   - consecutive sample frames continue each other's sample index unless a sequence gap
+//     or a LINK_CMD_RATE_REPORT lies between them
+//   - every sample fits the width the last LINK_CMD_RATE_REPORT gave (12 bits before one)
+// With -w that width has to be sample_bits, and above 12 bits some sample has to use the extra
+// range (ACQ_OVS_BITS builds).
+// With -r the stats frames (PROF builds) have to report at least min_recaptured segments that
+// capture re-entered while the UART still sent them: a way to prove that the run went through
+// that path. The exit status is 1 if any check fails.
+
+#include "ecg_proto.h"
+#include "ecg_rice.h"
+#include "uart_link.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_SAMPLES 1024
+
+static const char* const type_names[] = { "raw", "rice", "beat", "planar", "stats", "latency" };
+
+static unsigned long frames_by_type[6];
+static unsigned long ctrl_frames, seq_gaps, frames_dropped, recaptured;
+static unsigned long errors;
+static int have_samples; // The next sample frame has to start at next_sample
+static uint32_t next_sample;
+static unsigned sample_bits = 12, reported_bits; // reported_bits 0 until a rate report
+static uint16_t max_sample;
+
+static void error(long offset, const char* what) {
+    if (errors < 20)
+        printf("offset %ld: %s\n", offset, what);
+    errors++;
+}
+
+static int popcount8(uint8_t v) {
+    int n = 0;
+    for (; v; v &= v - 1) {
+        n++;
+    }
+    return n;
+}
+
+// Records the largest sample; returns 0 if any is wider than sample_bits
+static int samples_fit(const uint16_t* samples, int count) {
+    int ok = 1;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (samples[i] > max_sample)
+            max_sample = samples[i];
+        if (samples[i] >> sample_bits)
+            ok = 0;
+    }
+    return ok;
+}
+
+// Samples per channel in a sample frame's payload, -1 if it does not fit the type, -2 if a
+// sample is wider than sample_bits
+static int frame_samples(const EcgFrameHeader* h, const uint8_t* payload) {
+    static uint16_t samples[MAX_SAMPLES];
+    int channels = popcount8(h->channel_mask);
+    int count = -1, fit = 1;
+    uint16_t pos = 0;
+    int ch;
+
+    if (channels == 0)
+        return -1;
+    if (h->type != ECG_TYPE_SAMPLES_RICE) {
+        int i;
+        if (h->payload_len % (channels * 2) || h->payload_len / 2 > MAX_SAMPLES)
+            return -1;
+        for (i = 0; i < h->payload_len / 2; i++) {
+            samples[i] = payload[2 * i] | payload[2 * i + 1] << 8;
+        }
+        if (!samples_fit(samples, h->payload_len / 2))
+            return -2;
+        return h->payload_len / (channels * 2);
+    }
+    for (ch = 0; ch < channels; ch++) {
+        uint16_t len = h->payload_len - pos;
+        int n;
+        if (channels > 1) {
+            if (pos + 2 > h->payload_len)
+                return -1;
+            len = payload[pos] | payload[pos + 1] << 8;
+            pos += 2;
+            if (len > h->payload_len - pos)
+                return -1;
+        }
+        n = ecg_rice_decode(payload + pos, len, samples, MAX_SAMPLES);
+        if (n <= 0 || (count >= 0 && n != count))
+            return -1;
+        fit &= samples_fit(samples, n);
+        count = n;
+        pos += len;
+    }
+    if (pos != h->payload_len)
+        return -1;
+    return fit ? count : -2;
+}
+
+static void check_frame(long offset, const EcgFrameHeader* h, const uint8_t* payload) {
+    static int have_prev;
+    static uint16_t prev_seq;
+    int n;
+
+    if (h->version != ECG_PROTO_VERSION || h->type > ECG_TYPE_LATENCY) {
+        error(offset, "unknown version or type");
+        return;
+    }
+    frames_by_type[h->type]++;
+    if (have_prev && h->seq != (uint16_t)(prev_seq + 1)) {
+        seq_gaps++;
+        frames_dropped += (uint16_t)(h->seq - prev_seq - 1);
+        have_samples = 0;
+    }
+    have_prev = 1;
+    prev_seq = h->seq;
+
+    switch (h->type) {
+        case ECG_TYPE_SAMPLES:
+        case ECG_TYPE_SAMPLES_RICE:
+        case ECG_TYPE_SAMPLES_PLANAR:
+            n = frame_samples(h, payload);
+            if (n == -2) {
+                error(offset, "sample wider than the reported sample width");
+                have_samples = 0;
+                break;
+            }
+            if (n <= 0) {
+                error(offset, "sample payload does not fit the channel mask");
+                have_samples = 0;
+                break;
+            }
+            if (have_samples && h->sample_index != next_sample)
+                error(offset, "sample index does not follow on from the previous frame");
+            have_samples = 1;
+            next_sample = h->sample_index + n;
+            break;
+        case ECG_TYPE_BEAT:
+            if (h->payload_len != ECG_BEAT_PAYLOAD_LEN)
+                error(offset, "beat payload length");
+            break;
+        case ECG_TYPE_STATS:
+            if (h->payload_len < ECG_STATS_HEADER_LEN + 3
+                || h->payload_len != ECG_STATS_HEADER_LEN + 3 + payload[6] * ECG_STATS_RECORD_LEN)
+            {
+                error(offset, "stats payload length");
+                break;
+            }
+            recaptured = payload[2] | payload[3] << 8;
+            break;
+        case ECG_TYPE_LATENCY:
+            if (h->payload_len != ECG_LATENCY_PAYLOAD_LEN)
+                error(offset, "latency payload length");
+            break;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long min_recaptured = 0;
+    unsigned want_bits = 0;
+    EcgDecoder* dec = malloc(sizeof(EcgDecoder));
+    EcgFrameHeader header;
+    const uint8_t* payload;
+    uint8_t* data;
+    long size, pos = 0, partial = 0;
+    FILE* f;
+    int opt, t;
+
+    while ((opt = getopt(argc, argv, "r:w:")) != -1) {
+        if (opt == 'r') {
+            min_recaptured = strtoul(optarg, 0, 10);
+        } else if (opt == 'w') {
+            want_bits = (unsigned)strtoul(optarg, 0, 10);
+        } else {
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1 || !(f = fopen(argv[optind], "rb"))) {
+        fprintf(stderr, "usage: %s [-r min_recaptured] [-w sample_bits] uart_tx.bin\n", argv[0]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(size + 1);
+    if (fread(data, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "cannot read %s\n", argv[optind]);
+        return 1;
+    }
+    fclose(f);
+    ecg_decoder_init(dec);
+
+    while (pos < size) {
+        long len;
+        int done = 0;
+
+        if (data[pos] != ECG_SYNC0) {
+            error(pos, "byte outside any frame");
+            pos++;
+            continue;
+        }
+        if (pos + 1 < size && data[pos + 1] == LINK_CTRL_HEADER2) {
+            uint8_t sum = 0;
+            int i;
+            if (pos + LINK_CTRL_FRAME_LEN > size) {
+                partial = size - pos;
+                break;
+            }
+            for (i = 2; i < LINK_CTRL_FRAME_LEN - 1; i++) {
+                sum += data[pos + i];
+            }
+            if (sum != data[pos + LINK_CTRL_FRAME_LEN - 1])
+                error(pos, "control frame checksum");
+            if (data[pos + 2] == LINK_CMD_RATE_REPORT) {
+                have_samples = 0; // Capture may have restarted at another rate
+                if (data[pos + 5] == LINK_RATE_OK) {
+                    reported_bits = sample_bits = 12 + data[pos + 6];
+                    if (sample_bits > 16)
+                        error(pos, "sample width beyond 16 bits");
+                }
+            }
+            ctrl_frames++;
+            pos += LINK_CTRL_FRAME_LEN;
+            continue;
+        }
+        if (pos + ECG_HEADER_LEN > size) {
+            partial = size - pos;
+            break;
+        }
+        if (data[pos + 1] != ECG_SYNC1) {
+            error(pos, "byte outside any frame");
+            pos++;
+            continue;
+        }
+
+        // An ECG frame: the decoder has to accept it exactly at its last byte
+        len = (data[pos + 3] | data[pos + 4] << 8) + ECG_FRAME_OVERHEAD;
+        if (pos + len > size && len <= ECG_MAX_PAYLOAD + ECG_FRAME_OVERHEAD) {
+            partial = size - pos;
+            break;
+        }
+        for (t = 0; t < len && pos + t < size && !done; t++) {
+            done = ecg_decoder_push(dec, data[pos + t], &header, &payload);
+            if (done && t != len - 1)
+                done = 0;
+        }
+        if (!done || dec->header_errors || dec->crc_errors) {
+            error(pos, "bad ECG frame (header CRC, length or CRC-16)");
+            ecg_decoder_init(dec);
+            pos++;
+            continue;
+        }
+        check_frame(pos, &header, payload);
+        pos += len;
+    }
+
+    printf("%ld bytes: %lu control frames", size, ctrl_frames);
+    for (t = 0; t < 6; t++) {
+        if (frames_by_type[t])
+            printf(", %lu %s", frames_by_type[t], type_names[t]);
+    }
+    printf("\n%lu sequence gaps (%lu frames dropped by the firmware), %ld bytes cut off at the end\n",
+           seq_gaps,
+           frames_dropped,
+           partial);
+    printf("%lu segments recaptured while in flight (last stats frame)\n", recaptured);
+    printf("%u-bit samples reported, largest sample %u\n", reported_bits, max_sample);
+    if (want_bits && reported_bits != want_bits) {
+        printf("FAIL: expected %u-bit samples\n", want_bits);
+        errors++;
+    }
+    if (want_bits > 12 && max_sample >> 12 == 0) {
+        printf("FAIL: no sample uses the range beyond 12 bits\n");
+        errors++;
+    }
+    if (recaptured < min_recaptured) {
+        printf("FAIL: fewer than %lu recaptured segments, the run did not test that path\n",
+               min_recaptured);
+        errors++;
+    }
+    if (errors)
+        printf("FAIL: %lu errors\n", errors);
+    return errors ? 1 : 0;
+}
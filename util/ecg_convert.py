@@ -0,0 +1,227 @@
+"""把心电记录转换为回放用的样本流 (.ecgr)，或转换为固件的闪存测试向量头文件
+
+输入:
+  MIT-BIH 风格记录: 给出 .hea 或 .dat 路径 (格式 212 或 16)，按头文件中的增益、基线换算为 mV
+  CSV: 每行一个采样点；有 time/t/sec 列时可由它推出采样率，否则用 --rate 指定
+
+输出的电压按 AD8232 前端换算为 12 位 ADC 码值: 1.65V 中点，--gain 倍增益，3.3V 参考
+
+.ecgr 格式 (小端):
+  0   'ECGR'
+  4   版本 (1)
+  5   每样本位数 (12)
+  6   保留 (0)
+  8   采样率，单位 mHz (uint32)
+  12  样本数 (uint32)
+  16  样本: 每两个样本打包为 3 字节 (与 MIT-BIH 格式 212 相同的排列)，奇数个时末尾补 0
+
+用法示例:
+  python ecg_convert.py mitdb/100.hea -o 100.ecgr --seconds 60
+  python ecg_convert.py 100.hea --c-header ../dma-adc-display/ecg_replay_data.h --resample 500 --seconds 20
+  python ecg_convert.py record.csv --rate 250 -o record.ecgr
+仿真器用 -r 100.ecgr 回放；固件定义 ACQ_REPLAY 后回放 ecg_replay_data.h 中的向量
+"""
+import argparse
+import csv
+import os
+import struct
+import sys
+
+import numpy as np
+
+ECGR_MAGIC = b'ECGR'
+ECGR_VERSION = 1
+ECGR_BITS = 12
+ADC_RESOLUTION = 4095
+V_REF = 3.3
+V_MID = 1.65
+DEFAULT_GAIN = 1100  # AD8232 模块常见的总增益 (V/V)
+FIRMWARE_RATE = 500  # 与固件启动时的采样率 ECG_SAMPLE_RATE_HZ 一致
+MAX_FLASH_SAMPLES = 16384  # 32KB，小数据模型下常量数组须放在低64KB内
+
+
+def read_mitbih(path, channel):
+    """读取 MIT-BIH 记录的一个通道，返回 (mV 数组, 采样率)"""
+    base = os.path.splitext(path)[0]
+    with open(base + '.hea') as f:
+        lines = [l.split() for l in f if l.strip() and not l.startswith('#')]
+    record = lines[0]
+    num_signals = int(record[1])
+    rate = float(record[2].split('/')[0]) if len(record) > 2 else 250.0
+    signals = lines[1:1 + num_signals]
+    if channel >= num_signals:
+        sys.exit(f"记录只有 {num_signals} 个通道")
+
+    sig = signals[channel]
+    fmt = sig[1].split('x')[0].split(':')[0].split('+')[0]
+    gain_field = sig[2] if len(sig) > 2 else '200'
+    gain_str = gain_field.split('/')[0]
+    if '(' in gain_str:
+        gain = float(gain_str.split('(')[0])
+        baseline = int(gain_str.split('(')[1].rstrip(')'))
+    else:
+        gain = float(gain_str)
+        baseline = int(sig[4]) if len(sig) > 4 else 0
+    if gain == 0:
+        gain = 200.0
+    if any(s[1].split('x')[0] != fmt for s in signals) or any(s[0] != sig[0] for s in signals):
+        sys.exit("只支持所有通道同一格式、同一数据文件的记录")
+
+    raw = np.fromfile(os.path.join(os.path.dirname(path), sig[0]), dtype=np.uint8)
+    if fmt == '212':
+        raw = raw[:len(raw) // 3 * 3].reshape(-1, 3).astype(np.int32)
+        s0 = raw[:, 0] | ((raw[:, 1] & 0x0F) << 8)
+        s1 = raw[:, 2] | ((raw[:, 1] & 0xF0) << 4)
+        adu = np.empty(len(raw) * 2, dtype=np.int32)
+        adu[0::2] = s0
+        adu[1::2] = s1
+        adu = np.where(adu >= 2048, adu - 4096, adu)
+    elif fmt == '16':
+        adu = raw[:len(raw) // 2 * 2].view('<i2').astype(np.int32)
+    else:
+        sys.exit(f"不支持的信号格式 {fmt} (只支持 212 和 16)")
+
+    adu = adu[:len(adu) // num_signals * num_signals].reshape(-1, num_signals)[:, channel]
+    return (adu - baseline) / gain, rate
+
+
+def read_csv(path, column, rate, units):
+    """读取 CSV 的一列，返回 (mV 数组, 采样率)；units 为 'adc' 时原样返回码值"""
+    rows = []
+    header = None
+    with open(path, newline='') as f:
+        for row in csv.reader(f):
+            if not row or row[0].lstrip().startswith('#'):
+                continue
+            try:
+                rows.append([float(v) for v in row])
+            except ValueError:
+                if rows:
+                    sys.exit(f"CSV 第 {len(rows) + 1} 个数据行不是数字: {row}")
+                header = [h.strip().strip("'\"").lower() for h in row]
+    if not rows:
+        sys.exit("CSV 中没有数据")
+    data = np.array(rows)
+
+    time_col = None
+    if header:
+        for i, h in enumerate(header):
+            if h in ('time', 't', 'sec', 'seconds', 'elapsed time'):
+                time_col = i
+    if column is None:
+        column = 1 if time_col == 0 and data.shape[1] > 1 else 0
+    elif not column.isdigit():
+        if not header or column.lower() not in header:
+            sys.exit(f"CSV 中没有名为 {column} 的列")
+        column = header.index(column.lower())
+    else:
+        column = int(column)
+
+    if rate is None:
+        if time_col is None or len(data) < 2:
+            sys.exit("CSV 没有时间列，请用 --rate 指定采样率")
+        rate = (len(data) - 1) / (data[-1, time_col] - data[0, time_col])
+    values = data[:, column]
+    return values if units == 'adc' else values * (1000.0 if units == 'v' else 1.0), rate
+
+
+def to_adc(mv, gain):
+    """按 AD8232 前端把 mV 换算为 ADC 码值"""
+    volts = V_MID + mv / 1000.0 * gain
+    return np.clip(np.round(volts / V_REF * ADC_RESOLUTION), 0, ADC_RESOLUTION).astype(np.uint16)
+
+
+def resample(samples, rate, new_rate):
+    """线性插值重采样"""
+    if new_rate == rate:
+        return samples
+    t = np.arange(int(len(samples) * new_rate / rate)) / new_rate
+    return np.round(np.interp(t, np.arange(len(samples)) / rate, samples)).astype(np.uint16)
+
+
+def write_ecgr(path, samples, rate):
+    packed = bytearray()
+    padded = np.append(samples, 0) if len(samples) % 2 else samples
+    for s0, s1 in zip(padded[0::2], padded[1::2]):
+        s0, s1 = int(s0), int(s1)
+        packed += bytes((s0 & 0xFF, (s0 >> 8) | ((s1 >> 8) << 4), s1 & 0xFF))
+    with open(path, 'wb') as f:
+        f.write(ECGR_MAGIC + struct.pack('<BBHII', ECGR_VERSION, ECGR_BITS, 0,
+                                         int(round(rate * 1000)), len(samples)))
+        f.write(packed)
+
+
+def write_c_header(path, samples, rate, source):
+    lines = [
+        f"// 由 util/ecg_convert.py 从 {os.path.basename(source)} 生成，勿手工修改",
+        "#ifndef ECG_REPLAY_DATA_H_",
+        "#define ECG_REPLAY_DATA_H_",
+        "",
+        "#include <stdint.h>",
+        "",
+        f"#define ACQ_REPLAY_RATE_HZ {int(round(rate))}",
+        f"#define ACQ_REPLAY_LEN {len(samples)}",
+        "",
+        "static const uint16_t acq_replay_samples[ACQ_REPLAY_LEN] = {",
+    ]
+    for i in range(0, len(samples), 16):
+        lines.append("    " + ", ".join(str(int(s)) for s in samples[i:i + 16]) + ",")
+    lines += ["};", "", "#endif", ""]
+    with open(path, 'w', newline='\n') as f:
+        f.write("\n".join(lines))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="把心电记录转换为回放样本流或固件测试向量")
+    parser.add_argument('input', help="MIT-BIH 记录 (.hea/.dat) 或 CSV 文件")
+    parser.add_argument('-o', '--output', help="输出的 .ecgr 文件")
+    parser.add_argument('--c-header', help="输出固件测试向量头文件 (如 dma-adc-display/ecg_replay_data.h)")
+    parser.add_argument('--channel', type=int, default=0, help="MIT-BIH 记录的通道号")
+    parser.add_argument('--column', help="CSV 的列号或列名")
+    parser.add_argument('--rate', type=float, help="CSV 的采样率 (Hz)")
+    parser.add_argument('--units', choices=('mv', 'v', 'adc'), default='mv', help="CSV 数值的单位")
+    parser.add_argument('--gain', type=float, default=DEFAULT_GAIN, help="前端增益 (V/V)")
+    parser.add_argument('--start', type=float, default=0.0, help="从第几秒开始")
+    parser.add_argument('--seconds', type=float, help="截取的时长 (秒)")
+    parser.add_argument('--resample', type=float,
+                        help=f"重采样到该采样率；头文件默认 {FIRMWARE_RATE}Hz，.ecgr 默认保持原采样率")
+    args = parser.parse_args()
+
+    if not args.output and not args.c_header:
+        parser.error("至少需要 -o 或 --c-header 之一")
+
+    ext = os.path.splitext(args.input)[1].lower()
+    if ext in ('.hea', '.dat'):
+        values, rate = read_mitbih(args.input, args.channel)
+        samples = to_adc(values, args.gain)
+    else:
+        values, rate = read_csv(args.input, args.column, args.rate, args.units)
+        if args.units == 'adc':
+            samples = np.clip(np.round(values), 0, ADC_RESOLUTION).astype(np.uint16)
+        else:
+            samples = to_adc(values, args.gain)
+
+    first = int(args.start * rate)
+    last = len(samples) if args.seconds is None else first + int(args.seconds * rate)
+    samples = samples[first:last]
+    if len(samples) == 0:
+        sys.exit("截取范围内没有样本")
+
+    if args.output:
+        out_rate = args.resample or rate
+        out = resample(samples, rate, out_rate)
+        write_ecgr(args.output, out, out_rate)
+        print(f"{args.output}: {len(out)} 个样本, {out_rate:g}Hz, {len(out) / out_rate:.1f}s")
+
+    if args.c_header:
+        out_rate = args.resample or FIRMWARE_RATE
+        out = resample(samples, rate, out_rate)
+        if len(out) > MAX_FLASH_SAMPLES:
+            print(f"测试向量截短到 {MAX_FLASH_SAMPLES} 个样本 ({MAX_FLASH_SAMPLES / out_rate:.1f}s)")
+            out = out[:MAX_FLASH_SAMPLES]
+        write_c_header(args.c_header, out, out_rate, args.input)
+        print(f"{args.c_header}: {len(out)} 个样本, {out_rate:g}Hz, 须与固件 ECG_SAMPLE_RATE_HZ 一致")
+
+
+if __name__ == '__main__':
+    main()
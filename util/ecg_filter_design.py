@@ -0,0 +1,74 @@
+"""生成固件滤波链 (dma-adc-display/ecg_filter.c) 的定点系数表
+
+每个采样率一组系数:
+  高通: 一阶隔直 y = x - x1 + a*y1，截止约 HP_CUTOFF_HZ，a 为 Q15
+  低通: 二阶 Butterworth (双线性变换)，截止 LP_CUTOFF_HZ，Q14
+  陷波: 50Hz 与 60Hz 二阶陷波，-3dB 带宽 NOTCH_BW_HZ，Q14
+
+定点化后调整 b 系数，使低通与陷波的直流增益严格为 1 (否则基线会被整体缩放)
+用法: python ecg_filter_design.py > table.txt，把输出粘贴到 ecg_filter.c 的 ecg_filter_sets[]
+改动系数后运行 tests/ecg_filter_test.c: 它把定点滤波链与同样系数的双精度计算逐点比较
+"""
+import math
+
+RATES = [250, 500, 1000, 2000]
+HP_CUTOFF_HZ = 0.5
+LP_CUTOFF_HZ = 40.0
+NOTCH_BW_HZ = 2.0
+MAINS = [50, 60]
+Q14 = 1 << 14
+Q15 = 1 << 15
+
+
+def hp_pole(fs):
+    return round(math.exp(-2 * math.pi * HP_CUTOFF_HZ / fs) * Q15)
+
+
+def fix_dc(b, a):
+    """把 b 量化为 Q14，并把舍入误差并入 b1，使 sum(b) == 1 + a1 + a2 (Q14)"""
+    aq = [round(v * Q14) for v in a]
+    bq = [round(v * Q14) for v in b]
+    target = Q14 + aq[0] + aq[1]
+    dc_b = b[0] + b[1] + b[2]
+    if abs(dc_b) > 1e-12:
+        bq[1] += target - sum(bq)
+    return bq + aq
+
+
+def lowpass(fs):
+    k = math.tan(math.pi * LP_CUTOFF_HZ / fs)
+    norm = 1 / (1 + math.sqrt(2) * k + k * k)
+    b0 = k * k * norm
+    a1 = 2 * (k * k - 1) * norm
+    a2 = (1 - math.sqrt(2) * k + k * k) * norm
+    return fix_dc([b0, 2 * b0, b0], [a1, a2])
+
+
+def notch(fs, f0):
+    w0 = 2 * math.pi * f0 / fs
+    r = 1 - math.pi * NOTCH_BW_HZ / fs
+    a1 = -2 * r * math.cos(w0)
+    a2 = r * r
+    g = (1 + a1 + a2) / (2 - 2 * math.cos(w0))
+    aq = [round(a1 * Q14), round(a2 * Q14)]
+    b1q = round(-2 * math.cos(w0) * g * Q14)
+    b0q = round(g * Q14)
+    # 零点须严格在单位圆上 (b0 == b2)，直流增益误差并入 b1
+    b1q = Q14 + aq[0] + aq[1] - 2 * b0q
+    return [b0q, b1q, b0q] + aq
+
+
+def fmt(c):
+    return "{ " + ", ".join(f"{v}" for v in c) + " }"
+
+
+def main():
+    for fs in RATES:
+        print("    {")
+        print(f"        {fs}, {hp_pole(fs)}, {fmt(lowpass(fs))},")
+        print(f"        {{ {fmt(notch(fs, MAINS[0]))}, {fmt(notch(fs, MAINS[1]))} }},")
+        print("    },")
+
+
+if __name__ == '__main__':
+    main()
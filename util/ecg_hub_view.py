@@ -0,0 +1,203 @@
+"""多板卡心电查看器：连接聚合服务 (host/ecg_hub.h) 的Unix套接字，在同一时间轴上显示所有板卡
+
+聚合服务独占全部串口，本程序只读它转发的记录，可以同时开任意多个。每块板卡一个子图，横轴为主机时间
+(服务按各板卡的样本计数器对齐，见 ecg_hub.h)，同一时刻采到的样本在各子图中上下对齐。
+--stats 时不画图，每秒打印各板卡的状态和收到的样本数，适合无界面的机器。
+
+用法示例:
+  ./ecg_hub /dev/ttyACM0 /dev/ttyACM1 &
+  python util/ecg_hub_view.py
+  python util/ecg_hub_view.py --stats
+"""
+import argparse
+import collections
+import socket
+import struct
+import threading
+import time
+
+import numpy as np
+
+# 与 host/ecg_hub.h 对应，均为小端
+DEFAULT_SOCKET = '/tmp/ecg_hub.sock'
+RECORD_HEADER = struct.Struct('<BBHI')  # 类型 | 板卡号 | 保留 | 记录体长度
+RECORD_DEVICE = 0
+RECORD_SAMPLES = 1
+RECORD_FRAME = 2
+RECORD_CTRL = 3
+DEVICE_INFO = struct.Struct('<BBBBIIIdQQQQ')  # 状态 | 通道掩码 | 样本位宽 | 保留 | 采样率 | 波特率 | 保留 | 起点 | 计数x4
+SAMPLES_INFO = struct.Struct('<HBBIIId')  # 序号 | 通道掩码 | 通道数 | 样本索引 | 每通道样本数 | 采样率 | 首样本时间
+FRAME_INFO = struct.Struct('<BBHId')  # 帧类型 | 通道掩码 | 序号 | 样本索引 | 到达时间
+DEVICE_STATES = ['未打开', '搜索波特率', '协商波特率', '接收中']
+FRAME_TYPE_BEAT = 2
+BEAT_PAYLOAD_LEN = 5
+
+V_REF = 3.3
+ADC_BITS = 12  # 板卡回报样本位宽之前按12位换算
+DISPLAY_SECONDS = 5.0
+PLOT_DELAY_S = 0.3  # 横轴右端比当前时间早这么多，各板卡最新的一段都已到达
+
+
+class Device:
+    def __init__(self, index):
+        self.index = index
+        self.path = f"板卡{index}"
+        self.state = 0
+        self.sample_rate = 0
+        self.sample_bits = ADC_BITS
+        self.baud = 0
+        self.counters = (0, 0, 0, 0)  # 帧数 | 丢帧 | 帧头错误 | CRC错误
+        self.times = collections.deque()  # 各段首样本的主机时间
+        self.chunks = collections.deque()  # 各段第一个通道的样本
+        self.samples = 0
+        self.bpm = 0  # 最近一次心跳帧的平均心率
+
+    def trim(self, now):
+        while self.times and self.times[0] < now - DISPLAY_SECONDS - 1.0:
+            self.times.popleft()
+            self.chunks.popleft()
+
+
+class HubView:
+    """在后台线程中读取聚合服务的记录流，按板卡保存最近的波形"""
+
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.devices = {}
+        self.lock = threading.Lock()
+        self.closed = False
+
+    def device(self, index):
+        if index not in self.devices:
+            self.devices[index] = Device(index)
+        return self.devices[index]
+
+    def on_record(self, kind, index, body):
+        dev = self.device(index)
+        if kind == RECORD_DEVICE:
+            state, _, bits, _, rate, baud, _, _, *counters = DEVICE_INFO.unpack_from(body)
+            dev.path = body[DEVICE_INFO.size:].decode(errors='replace')
+            dev.state, dev.sample_rate, dev.baud, dev.counters = state, rate, baud, tuple(counters)
+            dev.sample_bits = bits or ADC_BITS
+        elif kind == RECORD_SAMPLES:
+            _, _, _, _, count, rate, t0 = SAMPLES_INFO.unpack_from(body)
+            samples = np.frombuffer(body, dtype='<u2', count=count, offset=SAMPLES_INFO.size)
+            dev.sample_rate = rate
+            dev.times.append(t0)
+            dev.chunks.append(samples.copy())
+            dev.samples += count
+            dev.trim(time.time())
+        elif kind == RECORD_FRAME:
+            frame_type = FRAME_INFO.unpack_from(body)[0]
+            payload = body[FRAME_INFO.size:]
+            if frame_type == FRAME_TYPE_BEAT and len(payload) == BEAT_PAYLOAD_LEN:
+                _, bpm, bpm_avg, _ = struct.unpack('<HBBB', payload)
+                dev.bpm = bpm_avg or bpm
+
+    def read_loop(self):
+        buffer = bytearray()
+        while True:
+            data = self.sock.recv(1 << 16)
+            if not data:
+                break
+            buffer.extend(data)
+            pos = 0
+            while len(buffer) - pos >= RECORD_HEADER.size:
+                kind, index, _, length = RECORD_HEADER.unpack_from(buffer, pos)
+                if len(buffer) - pos - RECORD_HEADER.size < length:
+                    break
+                body = bytes(buffer[pos + RECORD_HEADER.size:pos + RECORD_HEADER.size + length])
+                pos += RECORD_HEADER.size + length
+                with self.lock:
+                    self.on_record(kind, index, body)
+            del buffer[:pos]
+        self.closed = True
+        print("聚合服务已断开")
+
+    def snapshot(self, index, start, end):
+        """返回一个板卡在主机时间 [start, end) 内第一个通道的 (时间, 电压)"""
+        with self.lock:
+            dev = self.devices[index]
+            if not dev.times or not dev.sample_rate:
+                return np.array([]), np.array([])
+            t = np.concatenate([t0 + np.arange(len(c)) / dev.sample_rate
+                                for t0, c in zip(dev.times, dev.chunks)])
+            v = np.concatenate(list(dev.chunks)) / ((1 << dev.sample_bits) - 1) * V_REF
+        keep = (t >= start) & (t < end)
+        return t[keep], v[keep]
+
+
+def print_stats(view):
+    last = {}
+    while not view.closed:
+        time.sleep(1.0)
+        with view.lock:
+            for index, dev in sorted(view.devices.items()):
+                frames, lost, header_errors, crc_errors = dev.counters
+                rate = dev.samples - last.get(index, 0)
+                last[index] = dev.samples
+                state = DEVICE_STATES[dev.state] if dev.state < len(DEVICE_STATES) else dev.state
+                print(f"[{index}] {dev.path} {state} {dev.baud}bps {dev.sample_rate}Hz: "
+                      f"{rate} 样本/秒, 帧 {frames}, 丢失 {lost}, 帧头错误 {header_errors}, "
+                      f"CRC错误 {crc_errors}" + (f", 心率 {dev.bpm}" if dev.bpm else ""))
+
+
+def plot(view):
+    from matplotlib import pyplot as plt
+    from matplotlib.animation import FuncAnimation
+
+    indices = sorted(view.devices)
+    fig, axes = plt.subplots(len(indices), 1, sharex=True, squeeze=False,
+                             figsize=(12, 2.5 * len(indices)))
+    lines = []
+    for ax, index in zip(axes[:, 0], indices):
+        line, = ax.plot([], [], lw=1.2, color='b')
+        lines.append(line)
+        ax.set_xlim(-DISPLAY_SECONDS, 0)
+        ax.set_ylabel('电压 (V)')
+        ax.grid(True)
+    axes[-1, 0].set_xlabel('时间 (s)，0 为当前')
+
+    def update(_):
+        end = time.time() - PLOT_DELAY_S
+        for ax, line, index in zip(axes[:, 0], lines, indices):
+            t, v = view.snapshot(index, end - DISPLAY_SECONDS, end)
+            line.set_data(t - end, v)
+            if len(v) > 10:
+                ax.set_ylim(v.min() - 0.2, v.max() + 0.2)
+            dev = view.devices[index]
+            state = DEVICE_STATES[dev.state] if dev.state < len(DEVICE_STATES) else dev.state
+            ax.set_title(f"{dev.path} ({state}, {dev.sample_rate} Hz"
+                         + (f", 心率 {dev.bpm} BPM)" if dev.bpm else ")"), fontsize=10)
+        return lines
+
+    ani = FuncAnimation(fig, update, interval=100, cache_frame_data=False)
+    plt.tight_layout()
+    plt.show()
+    return ani
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="从聚合服务查看多块板卡的心电波形")
+    parser.add_argument('-s', '--socket', default=DEFAULT_SOCKET, help="聚合服务的Unix套接字")
+    parser.add_argument('--stats', action='store_true', help="只打印各板卡的统计，不画图")
+    args = parser.parse_args()
+
+    view = HubView(args.socket)
+    reader = threading.Thread(target=view.read_loop, daemon=True)
+    reader.start()
+    # 连接后服务先发来每块板卡的状态记录，据此确定子图数
+    deadline = time.time() + 2.0
+    while not view.devices and time.time() < deadline:
+        time.sleep(0.05)
+    time.sleep(0.2)  # 其余板卡的状态记录紧随其后
+    if not view.devices:
+        print("聚合服务没有板卡")
+    elif args.stats:
+        try:
+            print_stats(view)
+        except KeyboardInterrupt:
+            pass
+    else:
+        plot(view)
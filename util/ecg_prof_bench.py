@@ -0,0 +1,187 @@
+"""固件性能剖析 (PROF构建，dma-adc-display/prof.h) 的汇总，用于给出各过采样倍数下CIC抽取的实测开销，
+以及滤波 (ecg_filter_run) 是否在预算之内: 每样本每通道15 us (见 ecg_filter.h)
+
+从固件的UART输出中取出统计帧 (ECG_TYPE_STATS)，按区段汇总所有统计窗口:
+  每秒次数、每次的平均和最大耗时、CPU占用 (区段总耗时 / 窗口总时长)
+窗口时长按统计帧之间的功耗报告 (LINK_CMD_POWER_REPORT，每 POWER_REPORT_S 秒一个) 计算，
+第一个统计帧含启动过程，不计入。
+
+输入 (可多个，每个可写成 标签=输入):
+  串口: 设备运行PROF构建，以9600波特被动接收 --seconds 秒；不应答波特率协商，固件就留在9600
+  文件: 模拟器输出的 uart_tx.bin，或串口原始数据的转存
+  --sim-ratios: 按各过采样倍数 (ACQ_OVERSAMPLE) 编译PROF构建的模拟器并运行
+模拟器只对寄存器访问、DMA和中断进出计时，不计普通指令: CIC抽取全是内存运算，在模拟器上只测到
+读定时器本身，只能用来检查整条剖析链路。实测数字要在设备上取，每个倍数编译烧写一次 (预定义
+PROF 和 ACQ_OVERSAMPLE)，逐个接收后一起列出。ecg_filter_run 的MPY32寄存器访问在模拟器上计时，
+所以它在模拟器上的数字是下限。
+
+用法示例:
+  python util/ecg_prof_bench.py x1=/dev/ttyACM0 --seconds 30    # 依次烧写 x1/x4/x8/x16 的PROF构建
+  python util/ecg_prof_bench.py x1=x1.bin x4=x4.bin x8=x8.bin x16=x16.bin
+  python util/ecg_prof_bench.py --sim-ratios 1,4,8,16 --seconds 20
+"""
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+from ecg_qrs_bench import HEADER_LEN, TRAILER_LEN, SIM_START_MARGIN_S, crc8, crc16_ccitt
+
+FRAME_TYPE_STATS = 4
+STATS_HEADER_LEN = 4  # 采集积压高水位 | 队列深度 | 溢出次数(2)，之后为 每毫秒计数(2) | 区段数 | 各区段记录
+STATS_RECORD_LEN = 26  # 次数 | 最小 | 最大 | 总和(4) | 8个直方图桶，均为小端
+PROF_REGION_NAMES = ['DMA_ISR', 'UART_ISR', 'send_ecg_frame', 'process_segment', 'show_segment',
+                     'ISR延迟', 'CIC抽取', 'ecg_filter_run']  # 与 prof.h 中 ProfRegion 的顺序一致
+CTRL_HEADER2 = 0x5A
+CTRL_FRAME_LEN = 8
+CMD_POWER_REPORT = 0x09
+POWER_REPORT_S = 5  # 与固件 power.h 一致
+DEVICE_BAUD = 9600  # 固件启动时的波特率
+REPO_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def parse_stream(data):
+    """从UART字节流中依次取出统计帧和功耗报告，返回 [('stats', 负载) 或 ('power', None), ...]"""
+    events = []
+    i = 0
+    while i + CTRL_FRAME_LEN <= len(data):
+        if data[i] != 0xAA:
+            i += 1
+            continue
+        if data[i + 1] == CTRL_HEADER2:
+            if sum(data[i + 2:i + 7]) & 0xFF == data[i + 7]:
+                if data[i + 2] == CMD_POWER_REPORT:
+                    events.append(('power', None))
+                i += CTRL_FRAME_LEN
+            else:
+                i += 1
+            continue
+        if data[i + 1] != 0x55 or i + HEADER_LEN > len(data) or crc8(data[i + 2:i + 12]) != data[i + 12]:
+            i += 1
+            continue
+        payload_len = data[i + 3] | (data[i + 4] << 8)
+        end = i + HEADER_LEN + payload_len + TRAILER_LEN
+        if end > len(data):
+            break
+        if crc16_ccitt(data[i + 2:end - 2]) != (data[end - 2] | (data[end - 1] << 8)):
+            i += 1
+            continue
+        if data[i + 2] & 0x0F == FRAME_TYPE_STATS:
+            events.append(('stats', data[i + HEADER_LEN:end - TRAILER_LEN]))
+        i = end
+    return events
+
+
+def summarize(data):
+    """汇总各区段，返回 (窗口总时长秒, 每毫秒计数, {区段号: [次数, 最小, 最大, 总和]})，没有完整窗口时返回None"""
+    regions = {}
+    seconds = 0.0
+    ticks_per_ms = None
+    windows = 0
+    first = True
+    for kind, payload in parse_stream(data):
+        if kind == 'power':
+            windows += 1
+            continue
+        # 统计帧紧跟在关闭其窗口的功耗报告之后；上一帧没发完时一帧覆盖多个窗口
+        if first or len(payload) < STATS_HEADER_LEN + 3:
+            first = False
+            windows = 0
+            continue
+        ticks_per_ms, count = struct.unpack_from('<HB', payload, STATS_HEADER_LEN)
+        if len(payload) != STATS_HEADER_LEN + 3 + count * STATS_RECORD_LEN or not ticks_per_ms:
+            continue
+        seconds += max(windows, 1) * POWER_REPORT_S
+        windows = 0
+        for r in range(count):
+            n, lo, hi, total = struct.unpack_from('<HHHI', payload, STATS_HEADER_LEN + 3 + r * STATS_RECORD_LEN)
+            s = regions.setdefault(r, [0, None, 0, 0])
+            if n:
+                s[0] += n
+                s[1] = lo if s[1] is None else min(s[1], lo)
+                s[2] = max(s[2], hi)
+                s[3] += total
+    if not seconds:
+        return None
+    return seconds, ticks_per_ms, regions
+
+
+def capture_port(port, seconds):
+    """从串口被动接收 seconds 秒"""
+    import serial
+    data = bytearray()
+    with serial.Serial(port, DEVICE_BAUD, timeout=0.5) as ser:
+        end = time.time() + seconds
+        while time.time() < end:
+            data += ser.read(4096)
+    return bytes(data)
+
+
+def run_sim(ratio, seconds, workdir):
+    """编译 ACQ_OVERSAMPLE=ratio 的PROF构建模拟器并运行，返回UART输出"""
+    sim = os.path.join(workdir, f'msp430_sim_x{ratio}')
+    sources = [os.path.join(d, f) for d in ('sim', 'dma-adc-display')
+               for f in sorted(os.listdir(os.path.join(REPO_ROOT, d))) if f.endswith('.c')]
+    subprocess.run(['gcc', '-O2', '-DHOST_SIM', '-DPROF', f'-DACQ_OVERSAMPLE={ratio}', '-Isim',
+                    '-Idma-adc-display', '-Wno-unknown-pragmas', '-o', sim] + sources + ['-lm'],
+                   cwd=REPO_ROOT, check=True)
+    out = os.path.join(workdir, f'x{ratio}')
+    os.makedirs(out)
+    subprocess.run([sim, '-t', f'{seconds + SIM_START_MARGIN_S:.1f}', '-o', out], check=True,
+                   stdout=subprocess.DEVNULL)
+    return open(os.path.join(out, 'uart_tx.bin'), 'rb').read()
+
+
+def report(label, data, names):
+    result = summarize(data)
+    if result is None:
+        print(f"{label:<8} 没有完整的统计窗口 (PROF构建? 接收时长至少两个 {POWER_REPORT_S} s 窗口)")
+        return
+    seconds, ticks_per_ms, regions = result
+    us = 1000.0 / ticks_per_ms
+    for r, (n, lo, hi, total) in sorted(regions.items()):
+        name = PROF_REGION_NAMES[r] if r < len(PROF_REGION_NAMES) else f"区段{r}"
+        if names and name not in names:
+            continue
+        if not n:
+            print(f"{label:<8} {name:<16} {0:>9}")
+            continue
+        cpu = total * us / (seconds * 1e6) * 100
+        print(f"{label:<8} {name:<16} {n / seconds:>9.1f} {total / n * us:>9.1f} {hi * us:>9.1f} {cpu:>7.2f}")
+    print(f"{label:<8} ({seconds:.0f} s)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="汇总PROF构建固件的性能统计帧")
+    parser.add_argument('inputs', nargs='*', help="串口或UART字节流文件，可写成 标签=输入")
+    parser.add_argument('--sim-ratios', help="逗号分隔的过采样倍数，各编译一个PROF模拟器运行 (只计寄存器访问)")
+    parser.add_argument('--seconds', type=float, default=30.0, help="每个输入接收或模拟的时长 (秒)")
+    parser.add_argument('--regions', default='DMA_ISR,CIC抽取,ecg_filter_run',
+                        help="只列出这些区段，逗号分隔；空字符串列出全部")
+    args = parser.parse_args()
+    names = [n for n in args.regions.split(',') if n]
+
+    print(f"{'输入':<8} {'区段':<16} {'次/秒':>9} {'平均us':>9} {'最大us':>9} {'CPU%':>7}")
+    for item in args.inputs:
+        label, _, source = item.rpartition('=')
+        label = label or os.path.basename(source)
+        if os.path.isfile(source):
+            data = open(source, 'rb').read()
+        else:
+            if len(args.inputs) > 1:
+                input(f"烧写 {label} 的PROF构建并运行后按回车开始接收 {source}")
+            data = capture_port(source, args.seconds)
+        report(label, data, names)
+    if args.sim_ratios:
+        with tempfile.TemporaryDirectory() as workdir:
+            for ratio in (int(r) for r in args.sim_ratios.split(',')):
+                report(f'sim x{ratio}', run_sim(ratio, args.seconds, workdir), names)
+    if not args.inputs and not args.sim_ratios:
+        sys.exit("没有输入：给出串口或文件，或 --sim-ratios")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,222 @@
+"""固件QRS检测 (dma-adc-display/ecg_qrs.c) 的准确度基准
+
+把带R波标注 (.atr) 的MIT-BIH记录经 ecg_convert.py 转成 .ecgr，用主机模拟器 (sim/) 回放给未修改的
+固件，从模拟器输出的UART字节流中解出心跳帧 (ECG_TYPE_BEAT)，再与标注逐拍比对:
+  灵敏度 Se = TP / (TP + FN)，阳性预测值 +P = TP / (TP + FP)，匹配窗口 ±150ms (与 ANSI/AAMI EC57 相同)
+  R波定位误差: 匹配上的检测与标注的时间差
+  心率误差: 固件上报的平均心率与由标注算出的最近8个RR间期平均心率之差
+固件从第一次转换起回放记录，所以固件样本索引 n 对应记录中 n / 采样率 秒处
+--rate 让模拟器里的上位机请求切换采样率 (固件 timebase.h)，切换后采集、回放和样本索引都从头开始
+检测器启动后先学习2秒阈值，默认不计前 --skip 秒的标注
+
+用法示例:
+  gcc -O2 -DHOST_SIM -Isim -Idma-adc-display -Wno-unknown-pragmas -o msp430_sim sim/*.c dma-adc-display/*.c -lm
+  python util/ecg_qrs_bench.py --sim ./msp430_sim mitdb/100.hea mitdb/105.hea --seconds 600
+"""
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+import numpy as np
+
+from ecg_convert import FIRMWARE_RATE, DEFAULT_GAIN, read_mitbih, to_adc, write_ecgr
+
+MATCH_WINDOW_S = 0.150
+HR_AVG_BEATS = 8  # 与固件 ECG_QRS_RR_AVG 一致
+SIM_START_MARGIN_S = 2.0  # 固件开始采集前的波特率协商所需的虚拟时间
+
+# 帧格式 (协议v2，见固件 ecg_proto.h)
+HEADER_LEN = 13
+TRAILER_LEN = 2
+FRAME_TYPE_BEAT = 2
+BEAT_PAYLOAD_LEN = 5
+
+# MIT-BIH 标注中代表心搏的类型码 (WFDB isqrs)
+BEAT_CODES = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 25, 30, 34, 35, 37, 38, 41}
+ANN_SKIP, ANN_NUM, ANN_SUB, ANN_CHN, ANN_AUX = 59, 60, 61, 62, 63
+
+
+def read_annotations(path):
+    """读取 MIT 格式的标注文件，返回心搏标注的样本位置数组"""
+    data = open(path, 'rb').read()
+    beats = []
+    sample = 0
+    i = 0
+    while i + 2 <= len(data):
+        word = data[i] | (data[i + 1] << 8)
+        i += 2
+        code, value = word >> 10, word & 0x3FF
+        if word == 0:
+            break
+        if code == ANN_SKIP:
+            high, low = struct.unpack_from('<HH', data, i)
+            i += 4
+            sample += (high << 16) | low
+        elif code == ANN_AUX:
+            i += value + (value & 1)
+        elif code in (ANN_NUM, ANN_SUB, ANN_CHN):
+            pass
+        else:
+            sample += value
+            if code in BEAT_CODES:
+                beats.append(sample)
+    return np.array(beats, dtype=np.int64)
+
+
+def crc8(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def read_beat_frames(path):
+    """从UART字节流中解出所有心跳帧，返回 [(R波样本索引, 平均心率), ...]"""
+    data = open(path, 'rb').read()
+    beats = []
+    i = 0
+    while i + HEADER_LEN <= len(data):
+        if data[i] != 0xAA or data[i + 1] != 0x55 or crc8(data[i + 2:i + 12]) != data[i + 12]:
+            i += 1
+            continue
+        payload_len = data[i + 3] | (data[i + 4] << 8)
+        end = i + HEADER_LEN + payload_len + TRAILER_LEN
+        if end > len(data):
+            break
+        if crc16_ccitt(data[i + 2:end - 2]) != (data[end - 2] | (data[end - 1] << 8)):
+            i += 1
+            continue
+        if data[i + 2] & 0x0F == FRAME_TYPE_BEAT and payload_len == BEAT_PAYLOAD_LEN:
+            sample_index = struct.unpack_from('<I', data, i + 7)[0]
+            bpm_avg = data[i + HEADER_LEN + 3]
+            beats.append((sample_index, bpm_avg))
+        i = end
+    return beats
+
+
+def run_firmware(sim, samples, rate, seconds, firmware_rate, workdir):
+    """用模拟器把样本回放给固件，返回UART输出文件路径"""
+    ecgr = os.path.join(workdir, 'record.ecgr')
+    write_ecgr(ecgr, samples, rate)
+    cmd = [sim, '-t', f'{seconds + SIM_START_MARGIN_S:.1f}', '-r', ecgr, '-o', workdir]
+    if firmware_rate != FIRMWARE_RATE:
+        cmd += ['-f', str(firmware_rate)]
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+    return os.path.join(workdir, 'uart_tx.bin')
+
+
+def reference_hr(ref_times, i):
+    """第i个标注处的参考心率: 最近 HR_AVG_BEATS 个RR间期的平均值"""
+    first = max(0, i - HR_AVG_BEATS)
+    if i - first < 1:
+        return None
+    return 60.0 * (i - first) / (ref_times[i] - ref_times[first])
+
+
+def score(ref_times, det, firmware_rate, skip, duration):
+    """逐拍比对，返回统计字典"""
+    det_times = np.array([d[0] for d in det], dtype=float) / firmware_rate
+    in_range = (det_times >= skip) & (det_times < duration - MATCH_WINDOW_S)
+    ref_scored = (ref_times >= skip) & (ref_times < duration - MATCH_WINDOW_S)
+
+    matched_det = set()
+    tp = 0
+    errors = []
+    hr_errors = []
+    for i in np.nonzero(ref_scored)[0]:
+        j = np.searchsorted(det_times, ref_times[i])
+        best = None
+        for k in (j - 1, j):
+            if 0 <= k < len(det_times) and k not in matched_det \
+                    and abs(det_times[k] - ref_times[i]) <= MATCH_WINDOW_S:
+                if best is None or abs(det_times[k] - ref_times[i]) < abs(det_times[best] - ref_times[i]):
+                    best = k
+        if best is None:
+            continue
+        matched_det.add(best)
+        tp += 1
+        errors.append(det_times[best] - ref_times[i])
+        hr = reference_hr(ref_times, i)
+        if hr is not None and det[best][1] > 0:
+            hr_errors.append(det[best][1] - hr)
+
+    n_ref = int(ref_scored.sum())
+    fp = int(sum(1 for k in np.nonzero(in_range)[0] if k not in matched_det))
+    return {
+        'ref': n_ref,
+        'tp': tp,
+        'fn': n_ref - tp,
+        'fp': fp,
+        'err_ms': np.array(errors) * 1000,
+        'hr_err': np.array(hr_errors),
+    }
+
+
+def report(name, s):
+    se = s['tp'] / s['ref'] * 100 if s['ref'] else 0.0
+    ppv = s['tp'] / (s['tp'] + s['fp']) * 100 if s['tp'] + s['fp'] else 0.0
+    err = s['err_ms']
+    hr = s['hr_err']
+    print(f"{name:<12} {s['ref']:>6} {s['tp']:>6} {s['fn']:>5} {s['fp']:>5} {se:>7.2f} {ppv:>7.2f} "
+          f"{(err.mean() if len(err) else 0):>+7.1f} {(err.std() if len(err) else 0):>6.1f} "
+          f"{(np.abs(hr).mean() if len(hr) else 0):>6.2f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="用主机模拟器评估固件QRS检测的准确度")
+    parser.add_argument('records', nargs='+', help="带 .atr 标注的 MIT-BIH 记录 (.hea)")
+    parser.add_argument('--sim', default='./msp430_sim', help="主机模拟器可执行文件")
+    parser.add_argument('--channel', type=int, default=0, help="使用的通道")
+    parser.add_argument('--gain', type=float, default=DEFAULT_GAIN, help="前端增益 (V/V)")
+    parser.add_argument('--seconds', type=float, help="每条记录最多评估的时长 (秒)")
+    parser.add_argument('--skip', type=float, default=3.0, help="不计分的起始时长 (秒)，覆盖检测器的学习期")
+    parser.add_argument('--rate', type=int, default=FIRMWARE_RATE, choices=(250, 500, 1000, 2000),
+                        help="固件采样率 (Hz)")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.sim):
+        sys.exit(f"找不到模拟器 {args.sim}，编译方法见 sim/msp430_sim.c 开头")
+
+    print(f"{'记录':<10} {'标注':>6} {'TP':>6} {'FN':>5} {'FP':>5} {'Se%':>7} {'+P%':>7} "
+          f"{'定位ms':>7} {'σms':>6} {'|ΔHR|':>6}")
+    total = None
+    for path in args.records:
+        base = os.path.splitext(path)[0]
+        values, rate = read_mitbih(base + '.hea', args.channel)
+        samples = to_adc(values, args.gain)
+        ref = read_annotations(base + '.atr')
+        if args.seconds is not None:
+            samples = samples[:int(args.seconds * rate)]
+        duration = len(samples) / rate
+        ref_times = ref[ref < len(samples)] / rate
+
+        with tempfile.TemporaryDirectory() as workdir:
+            det = read_beat_frames(run_firmware(args.sim, samples, rate, duration, args.rate, workdir))
+        s = score(ref_times, det, args.rate, args.skip, duration)
+        report(os.path.basename(base), s)
+        if total is None:
+            total = s
+        else:
+            for key in ('ref', 'tp', 'fn', 'fp'):
+                total[key] += s[key]
+            total['err_ms'] = np.concatenate((total['err_ms'], s['err_ms']))
+            total['hr_err'] = np.concatenate((total['hr_err'], s['hr_err']))
+    if len(args.records) > 1:
+        report('合计', total)
+
+
+if __name__ == '__main__':
+    main()
@@ -6,7 +6,8 @@ import time
 import numpy as np
 from matplotlib import pyplot as plt
 from matplotlib.animation import FuncAnimation
-from scipy.signal import find_peaks
+import ecg_rx
+import ecg_record
 
 plt.rcParams['font.sans-serif'] = ['SimHei'] # Or any other Chinese font you have
 plt.rcParams['axes.unicode_minus'] = False # Display minus sign correctly
@@ -14,106 +15,552 @@ plt.rcParams['axes.unicode_minus'] = False # Display minus sign correctly
 # --- 1. 配置区更新 ---
 # 串口配置
 SERIAL_PORT = '/dev/ttyACM0'  # !!! 重要：修改为你的MSP430连接的COM端口
-BAUD_RATE = 9600
+BAUD_RATE = 9600  # 初始波特率，固件启动时会协商到更高的速率
 
-# 帧格式定义
+# 帧格式定义 (协议v2，与固件 ecg_proto.h 对应)
+# AA 55 | 版本<<4|类型 | 负载长度(2) | 序号(2) | 首样本索引(4) | 通道掩码 | 帧头CRC-8 | 负载 | CRC-16(2)
+# 通道掩码 bit n = ADC输入An；样本帧含掩码中每个通道相同数量的样本，首样本索引按单个通道计数
 FRAME_HEADER = b'\xAA\x55'
-DATA_SAMPLES_PER_FRAME = 40
-DATA_BYTES_PER_FRAME = DATA_SAMPLES_PER_FRAME * 2
+PROTO_VERSION = 2
+HEADER_LEN = 13
+TRAILER_LEN = 2
+MAX_PAYLOAD = 1024
+FRAME_TYPE_SAMPLES = 0
+FRAME_TYPE_SAMPLES_RICE = 1  # 差分+Rice压缩的样本 (与固件 ecg_rice.h 对应)
+FRAME_TYPE_BEAT = 2  # 固件检测到的一次心跳 (与固件 ecg_qrs.h 对应)
+FRAME_TYPE_SAMPLES_PLANAR = 3  # 原始样本，各通道依次存放 (FRAME_TYPE_SAMPLES 为通道交织)
+FRAME_TYPE_STATS = 4  # 固件性能统计，仅PROF构建发送 (与固件 prof.h 对应)
+FRAME_TYPE_LATENCY = 5  # 一个段经过各级的时间，仅LATENCY构建发送 (与固件 latency.h 对应)
+SAMPLE_FRAME_TYPES = (FRAME_TYPE_SAMPLES, FRAME_TYPE_SAMPLES_RICE, FRAME_TYPE_SAMPLES_PLANAR)
+BEAT_PAYLOAD_LEN = 5
+RICE_HEADER_LEN = 5
+RICE_ESCAPE_Q = 16
+RICE_RAW_BITS = 14
+RICE_MAX_W = 2
+STATS_HEADER_LEN = 4  # 采集积压高水位 | 队列深度 | 溢出次数(2)，之后为 每毫秒计数(2) | 区段数 | 各区段记录
+STATS_RECORD_LEN = 26  # 次数 | 最小 | 最大 | 总和(4) | 8个直方图桶，均为小端
+PROF_REGION_NAMES = ['DMA_ISR', 'UART_ISR', 'send_ecg_frame', 'process_segment', 'show_segment',
+                     'ISR延迟', 'CIC抽取', 'ecg_filter_run']  # 与 prof.h 中 ProfRegion 的顺序一致
+LATENCY_PAYLOAD_LEN = 12  # 每通道样本数(2) | 样本帧序号(2) | 各级时间(4x2)
+LATENCY_TICK_HZ = 32768  # 各级时间的单位，从DMA采完该段起算，0xFFFF表示未经过该级
+LATENCY_STAGE_NAMES = ['处理完成', '入发送队列', '发送完成', '显示完成']
+PROF_BUCKET_NAMES = ['<1us', '1-4us', '4-16us', '16-64us', '64-256us', '.25-1ms', '1-4ms', '4-16ms']
+STATS_INTERVAL_S = 5.0  # 每隔多久打印一次丢帧/延迟统计
 
-# ADC与采样配置 (新增)
-SAMPLE_RATE = 200  # 采样率 (Hz)
+# 链路控制帧 (与固件 uart_link.h 对应): 0xAA 0x5A <cmd> <arg 4字节小端> <cmd与arg的8位累加和>
+CTRL_HEADER2 = 0x5A
+CTRL_FRAME_LEN = 8
+CMD_BAUD_OFFER = 0x01
+CMD_BAUD_ACK = 0x02
+CMD_PROBE = 0x03
+CMD_PROBE_ECHO = 0x04
+CMD_CONFIRM = 0x05
+CMD_LINK_REPORT = 0x06
+CMD_SET_RATE = 0x07     # 主机 -> 固件, 参数为采样率 (Hz)
+CMD_RATE_REPORT = 0x08  # 固件 -> 主机, 参数为生效的采样率 | (状态 << 16) | (样本超出12位的位数 << 24)
+                        # 状态非0表示请求被拒绝
+CMD_POWER_REPORT = 0x09  # 固件 -> 主机, 每5秒一次, 参数为CPU活动时间(0.01%) | (每秒唤醒次数 << 16)
+RATE_STATUS = {1: "固件不支持该采样率", 2: "ADC时序不成立", 3: "采集缓冲区放不下", 4: "链路带宽不够"}
+SUPPORTED_BAUD_RATES = [9600, 19200, 38400, 57600, 115200, 230400, 460800]
+LINK_SWITCH_TIMEOUT_S = 0.5  # 切换波特率后等待探测帧/确认帧的时间
+LINK_HUNT_TIMEOUT_S = 2.0    # 这么久没有收到有效帧就轮询其他波特率
+
+# ADC与采样配置
+# 采样率由固件决定 (timebase.h)，固件启动和切换时发来 CMD_RATE_REPORT，这里只是收到之前的默认值
+DEFAULT_SAMPLE_RATE = 500
+REQUESTED_RATE = None  # 设为 250/500/1000/2000 时，收到固件的采样率后请求切换
 V_REF = 3.3        # ADC参考电压 (V)
-ADC_RESOLUTION = 4095 # 12-bit ADC -> 2^12 - 1
+ADC_BITS = 12  # 12位ADC; 固件过采样保留额外位时 (adc_acq.h 的 ACQ_OVS_BITS) 由 CMD_RATE_REPORT 告知
 
 # 绘图与分析配置 (新增与修改)
 DISPLAY_SECONDS = 5.0 # 在屏幕上显示5秒的数据
-PLOT_SAMPLES = int(DISPLAY_SECONDS * SAMPLE_RATE) # 总共显示1000个点
 
-# 心率计算配置 (新增)
-HR_PEAK_THRESHOLD_V = 1.5  # R波峰值检测的电压阈值 (V), !!! 重要：这个值需要根据你的实际信号幅度进行调整
-HR_MIN_PEAK_DISTANCE_SAMPLES = int(SAMPLE_RATE * 0.3) # 两个R波之间的最小采样点数 (0.3秒对应最高200BPM)
+# 心率由固件检测 (ecg_qrs.h)，每次心跳发来一个心跳帧: R波的样本索引和心率
+HR_TIMEOUT_S = 3.0  # 这么久没有心跳帧时心率显示为 --
+
+# 录制: 设为文件名 (如 'capture.ecgc') 时把收到的全部样本和心跳写入录制文件 (格式见 ecg_record.py)
+RECORD_PATH = None
 
 # --- 全局变量 ---
-# 修改deque长度以缓存5秒的数据
-data_queue = collections.deque(maxlen=PLOT_SAMPLES)
+sample_rate = DEFAULT_SAMPLE_RATE
+sample_bits = ADC_BITS
+# 缓存 DISPLAY_SECONDS 秒的数据，采样率改变时重建
+data_queue = collections.deque(maxlen=int(DISPLAY_SECONDS * sample_rate))
+beat_queue = collections.deque(maxlen=64)  # 最近的心跳: (R波样本索引, 平均心率)
+newest_sample_index = 0  # data_queue 中最后一个样本的索引
+rate_request = REQUESTED_RATE  # 尚未发出的采样率切换请求
+last_beat_time = 0.0
 exit_flag = False
-last_heart_rate = 0 # 用于在数据不足时显示上一次的心率
+last_heart_rate = 0
+recorder = None  # 收到第一个样本帧时按其通道掩码创建
 
 def calculate_checksum(payload):
-    """计算8位累加和校验"""
+    """计算8位累加和校验 (链路控制帧使用)"""
     return sum(payload) & 0xFF
 
-def calculate_heart_rate(voltage_data, sample_rate):
+
+def crc8(data):
+    """帧头校验: CRC-8, 多项式0x07, 初值0"""
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    """帧校验: CRC-16/CCITT-FALSE"""
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def rice_decode(payload):
+    """解码 ECG_TYPE_SAMPLES_RICE 负载，返回样本列表；负载格式错误时返回None
+
+    负载: 样本数(2) | 参数(k为低4位, bit4为二阶预测, bit5-6为w) | 首样本(2) | 残差比特流(高位在前)
+    残差先zigzag映射, 再按 q个1 + 0 + 低k位 编码; q达到RICE_ESCAPE_Q时后跟RICE_RAW_BITS+w位原始值
+    (w为样本超出12位的位数所需, 见固件 ecg_rice.h)
     """
-    使用scipy.signal.find_peaks计算心率
-    返回: (计算出的心率BPM, R波峰值的索引列表)
+    if len(payload) < RICE_HEADER_LEN:
+        return None
+    count, params, first = struct.unpack_from('<HBH', payload)
+    k = params & 0x0F
+    order2 = bool(params & 0x10)
+    raw_bits = RICE_RAW_BITS + ((params >> 5) & 3)
+    if count == 0 or k > 13 or raw_bits > RICE_RAW_BITS + RICE_MAX_W:
+        return None
+    bits = int.from_bytes(payload[RICE_HEADER_LEN:], 'big')
+    remaining = (len(payload) - RICE_HEADER_LEN) * 8
+
+    def take(n):
+        nonlocal remaining
+        if n > remaining:
+            raise ValueError
+        remaining -= n
+        return (bits >> remaining) & ((1 << n) - 1)
+
+    samples = [first]
+    try:
+        for i in range(1, count):
+            q = 0
+            while q < RICE_ESCAPE_Q and take(1):
+                q += 1
+            v = take(raw_bits) if q == RICE_ESCAPE_Q else (q << k) | take(k)
+            r = -((v + 1) >> 1) if v & 1 else v >> 1
+            if order2 and i >= 2:
+                prediction = 2 * samples[-1] - samples[-2]
+            else:
+                prediction = samples[-1]
+            samples.append((prediction + r) & 0xFFFF)
+    except ValueError:
+        return None
+    return samples
+
+
+def decode_channels(frame_type, channel_mask, payload):
+    """把样本帧负载拆成各通道的样本列表 (按输入编号从小到大)；格式错误时返回None
+
+    压缩帧每个通道单独编码一块，多于一个通道时每块前有2字节小端的块长度
     """
-    if len(voltage_data) < HR_MIN_PEAK_DISTANCE_SAMPLES:
-        return 0, []
+    num_channels = max(bin(channel_mask).count('1'), 1)
+    if frame_type in (FRAME_TYPE_SAMPLES, FRAME_TYPE_SAMPLES_PLANAR):
+        samples = struct.unpack(f'<{len(payload) // 2}H', payload)
+        if len(samples) % num_channels:
+            return None
+        if frame_type == FRAME_TYPE_SAMPLES:
+            return [list(samples[ch::num_channels]) for ch in range(num_channels)]
+        count = len(samples) // num_channels
+        return [list(samples[ch * count:(ch + 1) * count]) for ch in range(num_channels)]
+    if num_channels == 1:
+        samples = rice_decode(payload)
+        return None if samples is None else [samples]
+    channels = []
+    pos = 0
+    for _ in range(num_channels):
+        if pos + 2 > len(payload):
+            return None
+        block_len = payload[pos] | payload[pos + 1] << 8
+        samples = rice_decode(payload[pos + 2:pos + 2 + block_len])
+        if samples is None or (channels and len(samples) != len(channels[0])):
+            return None
+        channels.append(samples)
+        pos += 2 + block_len
+    return channels
+
+
+class LinkStats:
+    """根据序号和样本索引统计丢帧数与相对延迟"""
+
+    def __init__(self):
+        self.frames = 0
+        self.lost_frames = 0
+        self.header_errors = 0
+        self.crc_errors = 0
+        self.expected_seq = None
+        self.min_offset = None
+        self.latencies = []
+
+    def on_frame(self, seq, sample_index, arrival):
+        """sample_index 为 None 时 (心跳帧，索引指向过去的R波) 只统计丢帧"""
+        self.frames += 1
+        if self.expected_seq is not None:
+            self.lost_frames += (seq - self.expected_seq) & 0xFFFF
+        self.expected_seq = (seq + 1) & 0xFFFF
+        if sample_index is None:
+            return
+        # 到达时间减去样本时间得到一个固定偏移加上传输延迟；以见过的最小偏移为零点
+        offset = arrival - sample_index / sample_rate
+        if self.min_offset is None or offset < self.min_offset:
+            self.min_offset = offset
+        self.latencies.append(offset - self.min_offset)
+
+    def report(self):
+        if self.latencies:
+            lat = np.array(self.latencies) * 1000
+            print(f"帧 {self.frames}, 丢失 {self.lost_frames}, 帧头错误 {self.header_errors}, "
+                  f"CRC错误 {self.crc_errors}, 相对延迟 p50={np.percentile(lat, 50):.1f}ms "
+                  f"p99={np.percentile(lat, 99):.1f}ms max={lat.max():.1f}ms")
+        self.latencies.clear()
+
+
+class LatencyStats:
+    """按级统计固件发来的段延迟记录，与样本帧的到达时间合起来估计到达主机的延迟"""
+
+    def __init__(self):
+        self.arrivals = collections.OrderedDict()  # 样本帧序号 -> 到达时间
+        self.stages = [[] for _ in LATENCY_STAGE_NAMES]
+        self.missed = [0] * len(LATENCY_STAGE_NAMES)
+        self.host = []  # (到达时间 - 段采完时间, 发送完成时间)，秒
+        self.min_offset = None
+        self.fill_s = 0.0
+
+    def on_samples(self, seq, arrival):
+        self.arrivals[seq] = arrival
+        if len(self.arrivals) > 256:
+            self.arrivals.popitem(last=False)
+
+    def on_record(self, sample_index, payload):
+        if len(payload) != LATENCY_PAYLOAD_LEN:
+            return
+        num_samples, frame_seq, *ticks = struct.unpack('<HH4H', payload)
+        self.fill_s = (num_samples - 1) / sample_rate
+        for stage, t in enumerate(ticks):
+            if t == 0xFFFF:
+                self.missed[stage] += 1
+            else:
+                self.stages[stage].append(t / LATENCY_TICK_HZ)
+        sent = ticks[LATENCY_STAGE_NAMES.index('发送完成')]
+        arrival = self.arrivals.get(frame_seq)
+        if sent == 0xFFFF or arrival is None:
+            return
+        # 主机与固件没有共同的时钟，用样本索引换算段采完的时刻；把最快一帧的USB传输时间当作0，
+        # 得到的是到达延迟的下限，其余帧比它慢多少是准确的
+        captured = arrival - (sample_index + num_samples) / sample_rate
+        sent_s = sent / LATENCY_TICK_HZ
+        if self.min_offset is None or captured - sent_s < self.min_offset:
+            self.min_offset = captured - sent_s
+        self.host.append(captured)
+
+    def report(self):
+        if not any(self.stages) and not self.host:
+            return
+        print(f"段延迟 (从DMA采完一段起，段内最早的样本再早 {self.fill_s * 1000:.1f}ms):")
+        rows = list(zip(LATENCY_STAGE_NAMES, self.stages, self.missed))
+        rows.append(('到达主机(下限)', [c - self.min_offset for c in self.host], 0))
+        for name, values, missed in rows:
+            if not values:
+                continue
+            lat = np.array(values) * 1000
+            print(f"  {name:<12} n={len(lat):<5} p50={np.percentile(lat, 50):7.2f}ms "
+                  f"p90={np.percentile(lat, 90):7.2f}ms p99={np.percentile(lat, 99):7.2f}ms "
+                  f"max={lat.max():7.2f}ms" + (f" 未经过 {missed}" if missed else ""))
+        self.stages = [[] for _ in LATENCY_STAGE_NAMES]
+        self.missed = [0] * len(LATENCY_STAGE_NAMES)
+        self.host.clear()
+
+
+link_stats = LinkStats()
+latency_stats = LatencyStats()
+
+def build_ctrl_frame(cmd, arg):
+    """构造一个链路控制帧"""
+    body = bytes([cmd]) + struct.pack('<I', arg)
+    return bytes([FRAME_HEADER[0], CTRL_HEADER2]) + body + bytes([calculate_checksum(body)])
+
+
+def read_ctrl_body(ser):
+    """在已读到 0xAA 0x5A 之后读取控制帧的其余部分，返回 (cmd, arg)，校验失败返回 None"""
+    body = ser.read(CTRL_FRAME_LEN - 2)
+    if len(body) != CTRL_FRAME_LEN - 2 or calculate_checksum(body[:5]) != body[5]:
+        return None
+    return body[0], struct.unpack('<I', body[1:5])[0]
+
+
+def wait_ctrl(ser, cmd, timeout):
+    """在timeout秒内等待指定命令的控制帧，返回其参数，超时返回None"""
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if ser.read(1) != FRAME_HEADER[0:1]:
+            continue
+        if ser.read(1) != bytes([CTRL_HEADER2]):
+            continue
+        ctrl = read_ctrl_body(ser)
+        if ctrl and ctrl[0] == cmd:
+            return ctrl[1]
+    return None
+
 
-    # 使用find_peaks寻找R波
-    # height: 峰值的最小高度 (阈值)
-    # distance: 相邻峰之间的最小水平距离 (采样点数)
-    peaks, _ = find_peaks(voltage_data, height=HR_PEAK_THRESHOLD_V, distance=HR_MIN_PEAK_DISTANCE_SAMPLES)
+def handle_ctrl_frame(ser, cmd, arg):
+    """处理固件发来的控制帧，负责波特率协商的主机一侧"""
+    if cmd == CMD_BAUD_OFFER:
+        if arg not in SUPPORTED_BAUD_RATES:
+            print(f"固件提议的波特率 {arg} 不受支持，忽略")
+            return
+        old_baud = ser.baudrate
+        ser.write(build_ctrl_frame(CMD_BAUD_ACK, arg))
+        ser.flush()
+        ser.baudrate = arg
+        ser.reset_input_buffer()
+        probe = wait_ctrl(ser, CMD_PROBE, LINK_SWITCH_TIMEOUT_S)
+        if probe is not None:
+            ser.write(build_ctrl_frame(CMD_PROBE_ECHO, probe))
+            ser.flush()
+            if wait_ctrl(ser, CMD_CONFIRM, LINK_SWITCH_TIMEOUT_S) == arg:
+                print(f"波特率协商成功: {old_baud} -> {arg}")
+                return
+        print(f"波特率 {arg} 验证失败，回退到 {old_baud}")
+        ser.baudrate = old_baud
+    elif cmd == CMD_LINK_REPORT:
+        required = arg & 0xFFFF
+        capacity = arg >> 16
+        status = "正常" if required * 100 <= capacity * 90 else "超出带宽，数据会被丢弃!"
+        print(f"链路预算: 需要 {required} B/s, 链路容量 {capacity} B/s ({status})")
+    elif cmd == CMD_RATE_REPORT:
+        on_rate_report(ser, arg & 0xFFFF, (arg >> 16) & 0xFF, ADC_BITS + (arg >> 24))
+    elif cmd == CMD_POWER_REPORT:
+        print(f"CPU占空比 {(arg & 0xFFFF) / 100:.2f}%, 每秒唤醒 {arg >> 16} 次")
 
-    if len(peaks) < 2:
-        # 峰值数量不足，无法计算心率
-        return 0, peaks
 
-    # 计算R-R间隔 (单位：秒)
-    rr_intervals = np.diff(peaks) / sample_rate
+def on_rate_report(ser, rate, status, bits):
+    """固件报告生效的采样率和样本位宽: 样本索引从0重新开始，清空缓存的波形和心跳"""
+    global sample_rate, sample_bits, data_queue, newest_sample_index, rate_request
+    if status:
+        print(f"采样率切换被拒绝 ({RATE_STATUS.get(status, status)})，仍为 {rate} Hz")
+    else:
+        print(f"采样率 {rate} Hz, 样本 {bits} 位")
+        sample_rate = rate
+        sample_bits = bits
+        data_queue = collections.deque(maxlen=int(DISPLAY_SECONDS * rate))
+        if recorder:
+            recorder.set_rate(rate)
+        beat_queue.clear()
+        newest_sample_index = 0
+        link_stats.min_offset = None
+        latency_stats.min_offset = None
+    if rate_request and rate_request != rate and not status:
+        ser.write(build_ctrl_frame(CMD_SET_RATE, rate_request))
+        ser.flush()
+    rate_request = None  # 只请求一次
+
+
+def print_stats_frame(payload):
+    """打印固件一个统计窗口内的性能剖析 (FRAME_TYPE_STATS)"""
+    if len(payload) < STATS_HEADER_LEN + 3:
+        print("统计帧长度错误")
+        return
+    high_water, depth, overruns, ticks_per_ms, regions = struct.unpack_from('<BBHHB', payload)
+    if len(payload) != STATS_HEADER_LEN + 3 + regions * STATS_RECORD_LEN or not ticks_per_ms:
+        print("统计帧长度错误")
+        return
+    print(f"固件剖析: 采集积压高水位(启动以来) {high_water} 段, 队列深度 {depth}, 溢出 {overruns} 次")
+    print(f"  {'区段':<16}{'次数':>7}{'最小us':>9}{'平均us':>9}{'最大us':>9}  直方图")
+    us = 1000.0 / ticks_per_ms
+    for r in range(regions):
+        count, lo, hi, total, *hist = struct.unpack_from('<HHHI8H', payload,
+                                                         STATS_HEADER_LEN + 3 + r * STATS_RECORD_LEN)
+        name = PROF_REGION_NAMES[r] if r < len(PROF_REGION_NAMES) else f"区段{r}"
+        if not count:
+            print(f"  {name:<16}{0:>7}")
+            continue
+        buckets = ' '.join(f"{PROF_BUCKET_NAMES[b]}:{n}" for b, n in enumerate(hist) if n)
+        print(f"  {name:<16}{count:>7}{lo * us:>9.1f}{total / count * us:>9.1f}{hi * us:>9.1f}  {buckets}")
+
+
+def handle_ecg_frame(frame_type, seq, sample_index, channel_mask, payload):
+    """处理一个校验通过的数据帧"""
+    global last_heart_rate, last_beat_time
+    if frame_type == FRAME_TYPE_BEAT:
+        link_stats.on_frame(seq, None, time.time())
+        if len(payload) == BEAT_PAYLOAD_LEN:
+            _, bpm, bpm_avg, _ = struct.unpack('<HBBB', payload)
+            beat_queue.append((sample_index, bpm_avg or bpm))
+            if recorder:
+                recorder.add_beat(sample_index, bpm, bpm_avg)
+            if bpm_avg or bpm:
+                last_heart_rate = bpm_avg or bpm
+            last_beat_time = time.time()
+        return
+    if frame_type == FRAME_TYPE_STATS:
+        link_stats.on_frame(seq, None, time.time())
+        print_stats_frame(payload)
+        return
+    if frame_type == FRAME_TYPE_LATENCY:
+        link_stats.on_frame(seq, None, time.time())
+        latency_stats.on_record(sample_index, payload)
+        return
+    arrival = time.time()
+    if frame_type not in SAMPLE_FRAME_TYPES:
+        link_stats.on_frame(seq, sample_index, arrival)
+        return
+    accept_samples(seq, sample_index, channel_mask,
+                   decode_channels(frame_type, channel_mask, payload), arrival)
 
-    if rr_intervals.size == 0:
-        return 0, peaks
 
-    # 计算平均心率 (BPM)
-    avg_rr_interval = np.mean(rr_intervals)
-    heart_rate_bpm = 60.0 / avg_rr_interval
+def accept_samples(seq, sample_index, channel_mask, channels, arrival):
+    """处理一个样本帧解码出的各通道样本，解码失败时 channels 为 None (两种解析方式共用)"""
+    global newest_sample_index, recorder
+    link_stats.on_frame(seq, sample_index, arrival)
+    latency_stats.on_samples(seq, arrival)
+    if channels is None:
+        print(f"样本帧解码失败 (序号 {seq})")
+        return
+    data_queue.extend(channels[0])  # 绘制第一个通道 (主导联)
+    newest_sample_index = sample_index + len(channels[0]) - 1
+    if RECORD_PATH:
+        if recorder is None:
+            recorder = ecg_record.RecordWriter(RECORD_PATH, channel_mask, sample_rate,
+                                               sample_bits=sample_bits)
+            print(f"录制到 {RECORD_PATH}")
+        recorder.append(sample_index, channels, arrival)
 
-    return heart_rate_bpm, peaks
+
+def try_next_baud(ser):
+    """切换到下一个支持的波特率"""
+    idx = SUPPORTED_BAUD_RATES.index(ser.baudrate) if ser.baudrate in SUPPORTED_BAUD_RATES else -1
+    ser.baudrate = SUPPORTED_BAUD_RATES[(idx + 1) % len(SUPPORTED_BAUD_RATES)]
+    ser.reset_input_buffer()
+    print(f"未收到有效数据，尝试波特率 {ser.baudrate}")
 
 
 def parse_serial_data(ser):
-    """运行在独立线程中，负责接收和解析串口数据 (功能不变)"""
-    STATE_WAIT_HEADER = 0
-    STATE_READ_LENGTH = 1
-    STATE_READ_PAYLOAD = 2
-    STATE_READ_CHECKSUM = 3
-
-    state = STATE_WAIT_HEADER
-    payload_buffer = bytearray()
-    
+    """运行在独立线程中，负责接收和解析串口数据"""
+    buffer = bytearray()
+    last_valid_frame = time.time()
+    last_report = time.time()
+
     print("数据接收线程已启动...")
     while not exit_flag:
         try:
-            # ... (这部分的状态机逻辑与之前的版本完全相同，此处省略以保持简洁) ...
-            if state == STATE_WAIT_HEADER:
-                if ser.read(1) == FRAME_HEADER[0:1] and ser.read(1) == FRAME_HEADER[1:2]:
-                    state = STATE_READ_LENGTH
-            elif state == STATE_READ_LENGTH:
-                length_byte = ser.read(1)
-                if length_byte and int.from_bytes(length_byte, 'little') == DATA_BYTES_PER_FRAME:
-                    state = STATE_READ_PAYLOAD
-                    payload_buffer.clear()
-                else:
-                    state = STATE_WAIT_HEADER
-            elif state == STATE_READ_PAYLOAD:
-                payload_buffer.extend(ser.read(DATA_BYTES_PER_FRAME - len(payload_buffer)))
-                if len(payload_buffer) == DATA_BYTES_PER_FRAME:
-                    state = STATE_READ_CHECKSUM
-            elif state == STATE_READ_CHECKSUM:
-                received_checksum = ser.read(1)
-                if received_checksum and int.from_bytes(received_checksum, 'little') == calculate_checksum(payload_buffer):
-                    unpacked_data = struct.unpack(f'<{DATA_SAMPLES_PER_FRAME}H', payload_buffer)
-                    data_queue.extend(unpacked_data)
-                    print(f"成功接收一帧数据，校验通过。样本[0]: {unpacked_data[0]}")
+            # 长时间收不到有效帧时(例如固件已协商到更高波特率而本程序刚启动)，轮询其他波特率
+            if time.time() - last_valid_frame > LINK_HUNT_TIMEOUT_S:
+                try_next_baud(ser)
+                last_valid_frame = time.time()
+                buffer.clear()
+
+            if time.time() - last_report > STATS_INTERVAL_S:
+                link_stats.report()
+                latency_stats.report()
+                last_report = time.time()
+
+            buffer.extend(ser.read(max(ser.in_waiting, 1)))
+
+            while True:
+                start = buffer.find(FRAME_HEADER[0:1])
+                if start < 0:
+                    buffer.clear()
+                    break
+                del buffer[:start]
+                if len(buffer) < 2:
+                    break
+
+                if buffer[1] == CTRL_HEADER2:
+                    if len(buffer) < CTRL_FRAME_LEN:
+                        break
+                    body = bytes(buffer[2:CTRL_FRAME_LEN])
+                    if calculate_checksum(body[:5]) != body[5]:
+                        del buffer[:1]
+                        continue
+                    del buffer[:CTRL_FRAME_LEN]
+                    last_valid_frame = time.time()
+                    cmd, arg = body[0], struct.unpack('<I', body[1:5])[0]
+                    handle_ctrl_frame(ser, cmd, arg)
+                    if cmd == CMD_BAUD_OFFER:
+                        buffer.clear()  # 波特率可能已改变，旧数据作废
+                    continue
+
+                if buffer[1] != FRAME_HEADER[1]:
+                    del buffer[:1]
+                    continue
+                if len(buffer) < HEADER_LEN:
+                    break
+                # 先校验帧头，假同步立即丢弃，无需等待整个负载
+                payload_len = buffer[3] | (buffer[4] << 8)
+                if (buffer[2] >> 4) != PROTO_VERSION or payload_len > MAX_PAYLOAD \
+                        or crc8(buffer[2:12]) != buffer[12]:
+                    link_stats.header_errors += 1
+                    del buffer[:1]
+                    continue
+                frame_len = HEADER_LEN + payload_len + TRAILER_LEN
+                if len(buffer) < frame_len:
+                    break
+                frame = bytes(buffer[:frame_len])
+                del buffer[:frame_len]
+                received_crc = frame[-2] | (frame[-1] << 8)
+                if crc16_ccitt(frame[2:-2]) != received_crc:
+                    link_stats.crc_errors += 1  # 帧头可信，整帧丢弃
+                    continue
+                seq, sample_index = struct.unpack('<HI', frame[5:11])
+                handle_ecg_frame(frame[2] & 0x0F, seq, sample_index, frame[11],
+                                 frame[HEADER_LEN:HEADER_LEN + payload_len])
+                last_valid_frame = time.time()
+        except Exception as e:
+            print(f"串口读取或解析时发生错误: {e}")
+            buffer.clear()
+            time.sleep(1)
+
+
+def parse_serial_native(ser, rx):
+    """parse_serial_data 的本地接收库版本 (ecg_rx.py)：批量读取、分帧、校验和样本解码都在库里完成，
+    这里只处理事件，适合高波特率或多通道时Python逐字节解析跟不上的情况"""
+    last_valid_frame = time.time()
+    last_report = time.time()
+
+    print("数据接收线程已启动 (本地接收库)...")
+    while not exit_flag:
+        try:
+            if time.time() - last_valid_frame > LINK_HUNT_TIMEOUT_S:
+                try_next_baud(ser)
+                last_valid_frame = time.time()
+                rx.reset()
+
+            if time.time() - last_report > STATS_INTERVAL_S:
+                stats = rx.stats()
+                link_stats.header_errors = stats.header_errors
+                link_stats.crc_errors = stats.crc_errors
+                link_stats.report()
+                latency_stats.report()
+                last_report = time.time()
+
+            rx.pump(100)
+            for ev in rx.events():
+                last_valid_frame = time.time()
+                if ev.kind == ecg_rx.EVENT_CTRL:
+                    handle_ctrl_frame(ser, ev.type, ev.arg)
+                    if ev.type == CMD_BAUD_OFFER:
+                        rx.reset()  # 波特率可能已改变，旧数据作废
+                elif ev.type in SAMPLE_FRAME_TYPES:
+                    channels = [rx.read(ch, ev.ring_pos, ev.num_samples)
+                                for ch in range(ev.num_channels)] if ev.num_samples else None
+                    accept_samples(ev.seq, ev.sample_index, ev.channel_mask, channels, ev.arrival)
                 else:
-                    print(f"错误：校验和不匹配！")
-                state = STATE_WAIT_HEADER
+                    handle_ecg_frame(ev.type, ev.seq, ev.sample_index, ev.channel_mask, ev.payload)
         except Exception as e:
             print(f"串口读取或解析时发生错误: {e}")
-            state = STATE_WAIT_HEADER # 出错后重置状态机
+            rx.reset()
             time.sleep(1)
 
 
@@ -153,30 +600,32 @@ def update_plot(frame):
         return line, peak_dots,
 
     # 1. Y轴: ADC值转换为电压
-    voltage_array = (raw_data_array / ADC_RESOLUTION) * V_REF
+    voltage_array = (raw_data_array / ((1 << sample_bits) - 1)) * V_REF
     
     # 2. X轴: 采样点索引转换为时间
-    time_array = np.arange(len(voltage_array)) * (1.0 / SAMPLE_RATE)
-    
-    # 3. 心率计算
-    heart_rate, peak_indices = calculate_heart_rate(voltage_array, SAMPLE_RATE)
-    
-    if heart_rate > 0:
-        last_heart_rate = heart_rate
+    time_array = np.arange(len(voltage_array)) * (1.0 / sample_rate)
     
+    # 3. 心率: 由固件上报的心跳帧给出，R波位置换算到当前窗口内
+    peak_indices = np.array([len(voltage_array) - 1 - (newest_sample_index - idx)
+                             for idx, _ in list(beat_queue)], dtype=int)
+    peak_indices = peak_indices[(peak_indices >= 0) & (peak_indices < len(voltage_array))]
+
     # 更新波形图
     line.set_data(time_array, voltage_array)
-    
+
     # 更新R波峰值标记
     if len(peak_indices) > 0:
-        peak_times = peak_indices * (1.0 / SAMPLE_RATE)
+        peak_times = peak_indices * (1.0 / sample_rate)
         peak_voltages = voltage_array[peak_indices]
         peak_dots.set_data(peak_times, peak_voltages)
     else:
         peak_dots.set_data([],[])
-        
+
     # MODIFICATION 4: 更新文本框的内容，而不是标题
-    hr_text.set_text(f'心率: {last_heart_rate:.0f} BPM')
+    if last_heart_rate and time.time() - last_beat_time < HR_TIMEOUT_S:
+        hr_text.set_text(f'心率: {last_heart_rate:.0f} BPM')
+    else:
+        hr_text.set_text('心率: -- BPM')
     
     # 动态调整Y轴范围以便更好地观察信号
     if len(voltage_array) > 10:
@@ -195,7 +644,12 @@ if __name__ == '__main__':
         print(f"无法打开串口 {SERIAL_PORT}: {e}")
         exit()
 
-    serial_thread = threading.Thread(target=parse_serial_data, args=(ser,))
+    # 编译了本地接收库 (见 host/ecg_rx.h) 时用它解析，否则用纯Python的解析循环
+    native = ecg_rx.load()
+    if native:
+        serial_thread = threading.Thread(target=parse_serial_native, args=(ser, native.attach(ser.fileno())))
+    else:
+        serial_thread = threading.Thread(target=parse_serial_data, args=(ser,))
     serial_thread.daemon = True # 设置为守护线程，主程序退出时它也退出
     serial_thread.start()
 
@@ -205,6 +659,10 @@ if __name__ == '__main__':
 
     exit_flag = True
     print("正在关闭程序...")
-    # 线程是守护线程，会自动退出
+    # 线程是守护线程，会自动退出；录制时等它退出后再写入录制文件的索引
+    if recorder:
+        serial_thread.join(timeout=2.0)
+        recorder.close()
+        print(f"录制已保存到 {RECORD_PATH}")
     ser.close()
     print("程序已退出。")
\ No newline at end of file
@@ -0,0 +1,414 @@
+"""心电录制文件 (.ecgc) 的写入与读取
+
+ecg_receiver.py 把收到的全部样本和心跳写入录制文件 (见其 RECORD_PATH)。文件只追加写入，录制中断时
+已写入的块仍可读。读取时整个文件用 mmap 映射，只解码用到的块，24小时的录制也能立即打开、跳转和缩放。
+
+样本按连续的"段"存放: 缺帧或采样率切换时开始新的一段，段内样本在文件中连续编号 (位置)，缺失的样本
+不占位置。每块最多 CHUNK_SAMPLES 个样本，各通道分列存放，每列为首样本加上逐个差值: 差值做 zigzag
+变换后每 DELTA_GROUP 个一组，按该组所需的最小位宽紧密打包，只有含QRS波的组需要较宽的位宽。
+编解码都是 numpy 的整块运算 (固件的逐个样本的 Rice 编码 ecg_rice.h 在Python中太慢)。
+
+.ecgc 格式 (小端):
+  文件头 (32字节):
+    0   'ECGC'
+    4   版本 (1)
+    5   通道数 n
+    6   通道掩码 (与固件帧头相同)
+    7   样本位宽 (12~14，见固件 adc_acq.h 的 ACQ_OVS_BITS)，0 同 12
+    8   每块样本数上限 (uint32)
+    12  保留
+    16  开始录制的主机时间 (double, 与 time.time() 同一时钟)
+    24  保留
+  之后是若干块，每块为 16 字节块头加块体:
+    0   'BK'
+    2   块类型: BLOCK_SAMPLES / BLOCK_BEATS / BLOCK_INDEX / BLOCK_ALL_BEATS
+    3   保留
+    4   块体长度 (uint32)
+    8   块体的 CRC-32 (zlib.crc32)
+    12  保留
+  样本块体:
+    0   首样本的位置 (uint64)
+    8   首样本的固件样本索引 (uint32)
+    12  采样率，单位 mHz (uint32)
+    16  首样本的主机时间 (double)
+    24  每通道样本数 m (uint32)
+    28  保留
+    32  n 列，每列: 首样本 (uint16) | 各组的最大位宽 (uint8) | 保留 | 最小值 (uint16) | 最大值 (uint16) |
+        g = ceil((m - 1) / DELTA_GROUP) 个组的位宽 (uint8 x g) | 各组的 zigzag 差值，每个按所在组的位宽、
+        高位在前 (np.packbits 的顺序) 连续存放，末尾补齐到整字节；最大位宽为0时没有后两部分
+  心跳块体 (k 个心跳，按列): k (uint32) | 保留 | 位置 (uint64 x k) | 主机时间 (double x k) |
+    心率 (uint8 x k) | 平均心率 (uint8 x k)
+    样本块之后写入该块期间收到的心跳；关闭文件时再写一个包含全部心跳的 BLOCK_ALL_BEATS
+  索引块体 (关闭文件时写入): 每个样本块一项 index_dtype()，其中各通道的最小/最大值用于快速缩放
+  文件尾 (关闭文件时写入，24字节): 'ECGCEND\\0' | 索引块偏移 (uint64) | 全部心跳块偏移 (uint64)
+  没有文件尾 (录制中断) 时，读取方逐块扫描重建索引，扫描到第一个不完整或校验失败的块为止
+
+用法示例:
+  rec = ecg_record.Recording('capture.ecgc')
+  t, v = rec.read_time(0, rec.start_time + 3600, rec.start_time + 3610)  # 第一个小时后的10秒
+  lo, hi = rec.envelope(0, 0, rec.num_samples, 2000)  # 整个录制缩成2000列的包络
+"""
+import mmap
+import struct
+import time
+import zlib
+from functools import lru_cache
+
+import numpy as np
+
+MAGIC = b'ECGC'
+VERSION = 1
+TRAILER_MAGIC = b'ECGCEND\0'
+CHUNK_SAMPLES = 4096
+DELTA_GROUP = 64
+SAMPLE_BITS = 12  # 默认样本位宽
+FILE_HEADER = struct.Struct('<4sBBBBII d 8x')
+BLOCK_HEADER = struct.Struct('<2sBBII4x')
+BLOCK_MAGIC = b'BK'
+BLOCK_SAMPLES = 0
+BLOCK_BEATS = 1
+BLOCK_INDEX = 2
+BLOCK_ALL_BEATS = 3
+CHUNK_HEADER = struct.Struct('<QIId I4x')
+COLUMN_HEADER = struct.Struct('<HBBHH')
+TRAILER = struct.Struct('<8sQQ')
+DECODE_CACHE_CHUNKS = 64  # 最近解码的块，来回拖动时不必重复解码
+
+
+def index_dtype(num_channels):
+    """索引项: 样本块在文件中的偏移、位置、固件样本索引、样本数、采样率、主机时间和各通道的最小/最大值"""
+    return np.dtype([('offset', '<u8'), ('position', '<u8'), ('sample_index', '<u4'),
+                     ('count', '<u4'), ('rate_mhz', '<u4'), ('reserved', '<u4'), ('time', '<f8'),
+                     ('min', '<u2', (num_channels,)), ('max', '<u2', (num_channels,))])
+
+
+def group_widths(widths, count):
+    """各组的位宽展开为每个差值的位宽，及其在 (差值, 最大位宽) 位矩阵中有效的位"""
+    per_value = np.repeat(widths, DELTA_GROUP)[:count]
+    top = int(widths.max())
+    return per_value, np.arange(top - 1, -1, -1) < per_value[:, None]
+
+
+def pack_column(samples):
+    """把一列样本编码为列头加分组打包的差值"""
+    samples = samples.astype(np.int32)
+    deltas = np.diff(samples)
+    zigzag = ((deltas << 1) ^ (deltas >> 31)).astype(np.uint32)
+    top = int(zigzag.max()).bit_length() if len(zigzag) else 0
+    header = COLUMN_HEADER.pack(int(samples[0]), top, 0, int(samples.min()), int(samples.max()))
+    if not top:
+        return header
+    padded = np.zeros(-(-len(zigzag) // DELTA_GROUP) * DELTA_GROUP, dtype=np.uint32)
+    padded[:len(zigzag)] = zigzag
+    # 组内最大值的位数 (frexp 的指数即 bit_length，0 的为 0)
+    widths = np.frexp(padded.reshape(-1, DELTA_GROUP).max(axis=1))[1].astype(np.uint8)
+    _, valid = group_widths(widths, len(zigzag))
+    bits = (zigzag[:, None] >> np.arange(top - 1, -1, -1, dtype=np.uint32)) & 1
+    return header + widths.tobytes() + np.packbits(bits[valid].astype(np.uint8)).tobytes()
+
+
+def column_size(buf, offset, count):
+    """列 (含列头) 的字节数"""
+    top = COLUMN_HEADER.unpack_from(buf, offset)[1]
+    if count <= 1 or not top:
+        return COLUMN_HEADER.size
+    groups = -(-(count - 1) // DELTA_GROUP)
+    widths = np.frombuffer(buf, np.uint8, groups, offset + COLUMN_HEADER.size).astype(np.int64)
+    nbits = int(widths[:-1].sum()) * DELTA_GROUP + int(widths[-1]) * (count - 1 - (groups - 1) * DELTA_GROUP)
+    return COLUMN_HEADER.size + groups + (nbits + 7) // 8
+
+
+def unpack_column(buf, offset, count):
+    """解码一列，返回 (样本数组, 下一列的偏移)"""
+    first, top, _, _, _ = COLUMN_HEADER.unpack_from(buf, offset)
+    if count <= 1 or not top:
+        return np.full(count, first, dtype=np.uint16), offset + COLUMN_HEADER.size
+    groups = -(-(count - 1) // DELTA_GROUP)
+    widths = np.frombuffer(buf, np.uint8, groups, offset + COLUMN_HEADER.size)
+    per_value, valid = group_widths(widths, count - 1)
+    nbits = int(per_value.sum(dtype=np.int64))
+    data = offset + COLUMN_HEADER.size + groups
+    bits = np.zeros((count - 1, top), dtype=np.int32)
+    bits[valid] = np.unpackbits(np.frombuffer(buf, np.uint8, (nbits + 7) // 8, data), count=nbits)
+    zigzag = bits @ (1 << np.arange(top - 1, -1, -1))
+    deltas = (zigzag >> 1) ^ -(zigzag & 1)
+    samples = np.empty(count, dtype=np.int32)
+    samples[0] = first
+    np.cumsum(deltas, out=samples[1:])
+    samples[1:] += first
+    return samples.astype(np.uint16), data + (nbits + 7) // 8
+
+
+def pack_beats(positions, times, bpm, bpm_avg):
+    return (struct.pack('<I4x', len(positions)) + np.asarray(positions, '<u8').tobytes()
+            + np.asarray(times, '<f8').tobytes() + np.asarray(bpm, np.uint8).tobytes()
+            + np.asarray(bpm_avg, np.uint8).tobytes())
+
+
+def unpack_beats(buf, offset):
+    """返回心跳的 (位置, 主机时间, 心率, 平均心率) 四列"""
+    k = struct.unpack_from('<I', buf, offset)[0]
+    offset += 8
+    positions = np.frombuffer(buf, '<u8', k, offset)
+    times = np.frombuffer(buf, '<f8', k, offset + 8 * k)
+    bpm = np.frombuffer(buf, np.uint8, k, offset + 16 * k)
+    bpm_avg = np.frombuffer(buf, np.uint8, k, offset + 17 * k)
+    return positions, times, bpm, bpm_avg
+
+
+class RecordWriter:
+    """流式写入录制文件；只在接收线程中调用"""
+
+    def __init__(self, path, channel_mask, sample_rate, chunk_samples=CHUNK_SAMPLES, start_time=None,
+                 sample_bits=SAMPLE_BITS):
+        self.file = open(path, 'wb')
+        self.num_channels = max(bin(channel_mask).count('1'), 1)
+        self.chunk_samples = chunk_samples
+        self.sample_rate = sample_rate
+        self.file.write(FILE_HEADER.pack(MAGIC, VERSION, self.num_channels, channel_mask, sample_bits,
+                                         chunk_samples, 0, start_time or time.time()))
+        self.offset = FILE_HEADER.size
+        self.position = 0  # 已写入块的样本数
+        self.index = []
+        self.all_beats = ([], [], [], [])
+        self.beats = ([], [], [], [])  # 尚未写入的心跳
+        self.pending = []  # 当前段中尚未写入的样本，每项为各通道的数组
+        self.pending_count = 0
+        self.run_index = None  # 当前段 pending 第一个样本的固件样本索引
+        self.run_time = None  # 及其主机时间
+        self.next_index = None
+
+    def append(self, sample_index, channels, arrival):
+        """追加一帧样本: channels 为各通道的样本数组，arrival 为该帧到达的主机时间"""
+        if len(channels) != self.num_channels or not len(channels[0]):
+            return
+        count = len(channels[0])
+        if sample_index != self.next_index:  # 缺帧或重新开始计数: 新的一段
+            self.flush()
+            # 以到达时间估计首样本的主机时间；之后段内各块的时间由样本数推出，不受到达抖动影响
+            self.run_index = sample_index
+            self.run_time = arrival - count / self.sample_rate
+        self.pending.append([np.asarray(c, dtype=np.uint16) for c in channels])
+        self.pending_count += count
+        self.next_index = (sample_index + count) & 0xFFFFFFFF
+        while self.pending_count >= self.chunk_samples:
+            self.write_chunk(self.chunk_samples)
+
+    def add_beat(self, sample_index, bpm, bpm_avg):
+        """记录一次心跳 (固件心跳帧的R波样本索引)；不在当前段内的心跳无法定位，忽略"""
+        if self.run_index is None:
+            return
+        offset = (sample_index - self.run_index) & 0xFFFFFFFF
+        if offset >= 0x80000000:  # 在 pending 之前: 位于已写入的块中
+            offset -= 0x100000000
+        position = self.position + offset
+        if position < 0:
+            return
+        beat = (position, self.run_time + offset / self.sample_rate, bpm, bpm_avg)
+        for column, all_column, value in zip(self.beats, self.all_beats, beat):
+            column.append(value)
+            all_column.append(value)
+
+    def set_rate(self, sample_rate):
+        """采样率改变 (固件的样本索引从0重新开始)"""
+        self.flush()
+        self.sample_rate = sample_rate
+        self.next_index = None
+
+    def flush(self):
+        """把当前段剩余的样本写成一个较短的块"""
+        if self.pending_count:
+            self.write_chunk(self.pending_count)
+        self.file.flush()
+
+    def write_chunk(self, count):
+        columns = [np.concatenate([frame[ch] for frame in self.pending])
+                   for ch in range(self.num_channels)]
+        rest = [c[count:] for c in columns]
+        self.pending = [rest] if len(rest[0]) else []
+        self.pending_count = len(rest[0])
+        columns = [c[:count] for c in columns]
+
+        rate_mhz = int(round(self.sample_rate * 1000))
+        body = CHUNK_HEADER.pack(self.position, self.run_index, rate_mhz, self.run_time, count)
+        body += b''.join(pack_column(c) for c in columns)
+        self.index.append((self.offset, self.position, self.run_index, count, rate_mhz, 0,
+                           self.run_time, [int(c.min()) for c in columns],
+                           [int(c.max()) for c in columns]))
+        self.write_block(BLOCK_SAMPLES, body)
+        self.position += count
+        self.run_index = (self.run_index + count) & 0xFFFFFFFF
+        self.run_time += count / self.sample_rate
+        if self.beats[0]:
+            self.write_block(BLOCK_BEATS, pack_beats(*self.beats))
+            self.beats = ([], [], [], [])
+
+    def write_block(self, kind, body):
+        self.file.write(BLOCK_HEADER.pack(BLOCK_MAGIC, kind, 0, len(body), zlib.crc32(body)))
+        self.file.write(body)
+        offset = self.offset
+        self.offset += BLOCK_HEADER.size + len(body)
+        return offset
+
+    def close(self):
+        self.flush()
+        index = np.array(self.index, dtype=index_dtype(self.num_channels))
+        index_offset = self.write_block(BLOCK_INDEX, index.tobytes())
+        beats_offset = self.write_block(BLOCK_ALL_BEATS, pack_beats(*self.all_beats))
+        self.file.write(TRAILER.pack(TRAILER_MAGIC, index_offset, beats_offset))
+        self.file.close()
+
+
+class Recording:
+    """以 mmap 方式读取录制文件；位置指文件内样本的连续编号 (0 .. num_samples-1)"""
+
+    def __init__(self, path, use_trailer=True):
+        self.file = open(path, 'rb')
+        self.buf = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, self.num_channels, self.channel_mask, self.sample_bits, self.chunk_samples, _, \
+            self.start_time = FILE_HEADER.unpack_from(self.buf)
+        self.sample_bits = self.sample_bits or SAMPLE_BITS  # 写入位宽之前的文件
+        if magic != MAGIC or version != VERSION:
+            raise ValueError(f"{path} 不是版本 {VERSION} 的 .ecgc 文件")
+        self.complete = False
+        if use_trailer and len(self.buf) >= FILE_HEADER.size + TRAILER.size:
+            magic, index_offset, beats_offset = TRAILER.unpack_from(self.buf, len(self.buf) - TRAILER.size)
+            self.complete = magic == TRAILER_MAGIC
+        if self.complete:
+            dtype = index_dtype(self.num_channels)
+            length = BLOCK_HEADER.unpack_from(self.buf, index_offset)[3]
+            self.index = np.frombuffer(self.buf, dtype, length // dtype.itemsize,
+                                       index_offset + BLOCK_HEADER.size)
+            self.beats = unpack_beats(self.buf, beats_offset + BLOCK_HEADER.size)
+        else:
+            self.scan()
+        last = self.index[-1] if len(self.index) else None
+        self.num_samples = int(last['position'] + last['count']) if last is not None else 0
+        self.chunk_of = lru_cache(maxsize=DECODE_CACHE_CHUNKS)(self.decode_chunk)
+
+    def close(self):
+        self.index = None
+        self.beats = None
+        self.chunk_of = None
+        self.buf.close()
+        self.file.close()
+
+    def scan(self):
+        """没有文件尾时逐块扫描，重建索引和心跳"""
+        entries = []
+        beats = [[], [], [], []]
+        offset = FILE_HEADER.size
+        while offset + BLOCK_HEADER.size <= len(self.buf):
+            magic, kind, _, length, crc = BLOCK_HEADER.unpack_from(self.buf, offset)
+            body = offset + BLOCK_HEADER.size
+            if magic != BLOCK_MAGIC or body + length > len(self.buf) \
+                    or zlib.crc32(self.buf[body:body + length]) != crc:
+                break
+            if kind == BLOCK_SAMPLES:
+                position, sample_index, rate_mhz, t0, count = CHUNK_HEADER.unpack_from(self.buf, body)
+                pos = body + CHUNK_HEADER.size
+                columns = []
+                for _ in range(self.num_channels):
+                    columns.append(COLUMN_HEADER.unpack_from(self.buf, pos)[3:])
+                    pos += column_size(self.buf, pos, count)
+                entries.append((offset, position, sample_index, count, rate_mhz, 0, t0,
+                                [c[0] for c in columns], [c[1] for c in columns]))
+            elif kind == BLOCK_BEATS:
+                for column, values in zip(beats, unpack_beats(self.buf, body)):
+                    column.extend(values)
+            offset = body + length
+        self.index = np.array(entries, dtype=index_dtype(self.num_channels))
+        self.beats = (np.array(beats[0], '<u8'), np.array(beats[1], '<f8'),
+                      np.array(beats[2], np.uint8), np.array(beats[3], np.uint8))
+
+    @property
+    def end_time(self):
+        if not len(self.index):
+            return self.start_time
+        last = self.index[-1]
+        return last['time'] + last['count'] / (last['rate_mhz'] / 1000)
+
+    def decode_chunk(self, i):
+        """解码第 i 个样本块，返回各通道的样本数组"""
+        count = int(self.index[i]['count'])
+        pos = int(self.index[i]['offset']) + BLOCK_HEADER.size + CHUNK_HEADER.size
+        columns = []
+        for _ in range(self.num_channels):
+            samples, pos = unpack_column(self.buf, pos, count)
+            columns.append(samples)
+        return columns
+
+    def chunk_at(self, position):
+        return max(int(np.searchsorted(self.index['position'], position, side='right')) - 1, 0)
+
+    def position_at(self, t):
+        """主机时间 t 处 (或其后第一个) 样本的位置"""
+        if not len(self.index):
+            return 0
+        i = max(int(np.searchsorted(self.index['time'], t, side='right')) - 1, 0)
+        entry = self.index[i]
+        offset = int(np.ceil((t - entry['time']) * entry['rate_mhz'] / 1000))
+        return int(entry['position']) + min(max(offset, 0), int(entry['count']))
+
+    def times(self, start, count):
+        """位置 [start, start+count) 的样本的主机时间"""
+        out = np.empty(count)
+        pos = start
+        while pos < start + count:
+            entry = self.index[self.chunk_at(pos)]
+            n = min(int(entry['position'] + entry['count']) - pos, start + count - pos)
+            first = pos - int(entry['position'])
+            rate = entry['rate_mhz'] / 1000
+            out[pos - start:pos - start + n] = entry['time'] + (first + np.arange(n)) / rate
+            pos += n
+        return out
+
+    def read(self, channel, start, count):
+        """读取一个通道位置 [start, start+count) 的样本"""
+        start = max(start, 0)
+        count = max(min(count, self.num_samples - start), 0)
+        out = np.empty(count, dtype=np.uint16)
+        pos = start
+        while pos < start + count:
+            i = self.chunk_at(pos)
+            entry = self.index[i]
+            first = pos - int(entry['position'])
+            n = min(int(entry['count']) - first, start + count - pos)
+            out[pos - start:pos - start + n] = self.chunk_of(i)[channel][first:first + n]
+            pos += n
+        return out
+
+    def read_time(self, channel, t0, t1):
+        """读取主机时间 [t0, t1) 内的样本，返回 (时间, 样本)"""
+        start = self.position_at(t0)
+        count = self.position_at(t1) - start
+        return self.times(start, count), self.read(channel, start, count)
+
+    def envelope(self, channel, start, count, bins):
+        """把位置 [start, start+count) 缩成 bins 列，返回每列的 (最小值, 最大值)
+
+        每列跨越多个块时直接用索引中各块的最小/最大值 (只读索引，不解码)，列边界按块取整；
+        否则解码范围内的块
+        """
+        count = max(min(count, self.num_samples - start), 0)
+        if not count or bins <= 0:
+            return np.array([], np.uint16), np.array([], np.uint16)
+        edges = start + (np.arange(bins + 1) * count) // bins
+        if count // bins >= 2 * self.chunk_samples:
+            first = np.maximum(np.searchsorted(self.index['position'], edges[:-1], 'right') - 1, 0)
+            lo = np.minimum.reduceat(self.index['min'][:, channel], first)
+            hi = np.maximum.reduceat(self.index['max'][:, channel], first)
+            last = self.chunk_at(edges[-1] - 1) + 1
+            lo[-1] = self.index['min'][first[-1]:last, channel].min()
+            hi[-1] = self.index['max'][first[-1]:last, channel].max()
+            return lo, hi
+        samples = self.read(channel, start, count)
+        edges -= start
+        edges = np.minimum(edges[:-1], count - 1)
+        return np.minimum.reduceat(samples, edges), np.maximum.reduceat(samples, edges)
+
+    def beats_between(self, t0, t1):
+        """主机时间 [t0, t1) 内的心跳: (位置, 主机时间, 心率, 平均心率)"""
+        positions, times, bpm, bpm_avg = self.beats
+        keep = (times >= t0) & (times < t1)
+        return positions[keep], times[keep], bpm[keep], bpm_avg[keep]
@@ -0,0 +1,166 @@
+"""录制文件 (ecg_record.py) 的写入吞吐和跳转延迟基准
+
+按接收程序的方式逐帧写入一段合成心电 (默认24小时、500Hz、单通道，每72次/分一个心跳)，再打开文件测:
+  写入: 每秒写入的样本数 (只计 RecordWriter 的时间，不计信号生成)、相对实时的倍数、每样本的位数
+  打开: 读文件尾的索引，和没有文件尾 (录制中断) 时逐块扫描重建索引
+  跳转: 随机跳到某个主机时间读取 --window 秒，各次延迟的中位数和99分位，并与合成信号逐个样本比对
+  缩放: 把整个录制、1小时和1分钟缩成 --bins 列的包络
+--loss 按比例随机丢帧，检验缺帧后分段和样本定位是否正确
+文件刚写完，测到的是页缓存中的延迟
+
+用法示例:
+  python util/ecg_record_bench.py
+  python util/ecg_record_bench.py --hours 1 --channels 3 --loss 0.01 -o /tmp/bench.ecgc
+"""
+import argparse
+import os
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+import ecg_record
+
+GEN_BLOCK_S = 60.0  # 每次生成这么长的合成信号，再逐帧写入
+HEART_RATE = 72
+START_TIME = 1.7e9
+
+
+def synthetic(index, rate, channel):
+    """固件样本索引 index 处的合成心电: 基线漂移 + R波 + T波 + 伪随机噪声，各通道幅度不同"""
+    t = index / rate
+    phase = (t * HEART_RATE / 60.0) % 1.0
+    v = (2048 + 150 * np.sin(2 * np.pi * 0.25 * t)
+         + (1200 - 300 * channel) * np.exp(-((phase - 0.3) / 0.012) ** 2)
+         + 250 * np.exp(-((phase - 0.6) / 0.05) ** 2)
+         + (((index.astype(np.uint64) * np.uint64(2654435761) + np.uint64(channel)) >> np.uint64(13))
+            & np.uint64(15)).astype(np.float64) - 8)
+    return np.clip(np.round(v), 0, 4095).astype(np.uint16)
+
+
+def write_recording(path, args):
+    """返回 (写入耗时, 写入的样本数, 写入的心跳数)"""
+    rng = np.random.default_rng(1)
+    mask = (1 << args.channels) - 1
+    writer = ecg_record.RecordWriter(path, mask, args.rate, args.chunk, START_TIME)
+    total = int(args.hours * 3600 * args.rate)
+    block = int(GEN_BLOCK_S * args.rate) // args.frame * args.frame
+    beat_period = args.rate * 60.0 / HEART_RATE
+    next_beat = int(round(0.3 * beat_period))
+    spent = 0.0
+    written = beats = 0
+    for start in range(0, total, block):
+        index = np.arange(start, min(start + block, total))
+        columns = [synthetic(index, args.rate, ch) for ch in range(args.channels)]
+        keep = rng.random((len(index) + args.frame - 1) // args.frame) >= args.loss
+        t0 = time.perf_counter()
+        for f, pos in enumerate(range(0, len(index), args.frame)):
+            if not keep[f]:
+                continue
+            frame_index = start + pos
+            frame = [c[pos:pos + args.frame] for c in columns]
+            writer.append(frame_index, frame, START_TIME + (frame_index + len(frame[0])) / args.rate)
+            written += len(frame[0])
+            while next_beat < frame_index + len(frame[0]):
+                writer.add_beat(next_beat, HEART_RATE, HEART_RATE)
+                beats += 1
+                next_beat = int(round(0.3 * beat_period + beats * beat_period))
+        spent += time.perf_counter() - t0
+    t0 = time.perf_counter()
+    writer.close()
+    return spent + time.perf_counter() - t0, written, beats
+
+
+def percentiles(values):
+    values = np.array(values) * 1000
+    return f"中位数 {np.median(values):.2f} ms, 99分位 {np.percentile(values, 99):.2f} ms"
+
+
+def check_window(rec, start, count, rate):
+    """把位置 [start, start+count) 读出的样本与合成信号比对"""
+    pos = start
+    while pos < start + count:
+        entry = rec.index[rec.chunk_at(pos)]
+        n = min(int(entry['position'] + entry['count']) - pos, start + count - pos)
+        index = np.arange(n) + int(entry['sample_index']) + (pos - int(entry['position']))
+        for ch in range(rec.num_channels):
+            if not np.array_equal(rec.read(ch, pos, n), synthetic(index, rate, ch)):
+                return False
+        pos += n
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="录制文件的写入吞吐和跳转延迟基准")
+    parser.add_argument('-o', '--output', help="录制文件 (默认写到临时目录，结束后删除)")
+    parser.add_argument('--hours', type=float, default=24.0, help="录制时长 (小时)")
+    parser.add_argument('--rate', type=int, default=500, help="采样率 (Hz)")
+    parser.add_argument('--channels', type=int, default=1, choices=range(1, 9), help="通道数")
+    parser.add_argument('--frame', type=int, default=20, help="每帧每通道样本数")
+    parser.add_argument('--chunk', type=int, default=ecg_record.CHUNK_SAMPLES, help="每块样本数")
+    parser.add_argument('--loss', type=float, default=0.0, help="丢帧比例")
+    parser.add_argument('--seeks', type=int, default=200, help="随机跳转次数")
+    parser.add_argument('--window', type=float, default=10.0, help="每次跳转读取的时长 (秒)")
+    parser.add_argument('--bins', type=int, default=2000, help="缩放的列数")
+    args = parser.parse_args()
+
+    tmp = None
+    path = args.output
+    if not path:
+        tmp = tempfile.TemporaryDirectory()
+        path = os.path.join(tmp.name, 'bench.ecgc')
+    ok = True
+
+    spent, written, beats = write_recording(path, args)
+    size = os.path.getsize(path)
+    print(f"写入: {written} 样本 x {args.channels} 通道, {spent:.2f} s, "
+          f"{written / spent:.0f} 样本/秒 (实时的 {written / args.rate / spent:.0f} 倍), "
+          f"{size / 1e6:.1f} MB, {size * 8 / (written * args.channels):.2f} 位/样本")
+
+    t0 = time.perf_counter()
+    rec = ecg_record.Recording(path)
+    print(f"打开 (文件尾索引): {(time.perf_counter() - t0) * 1000:.2f} ms, {len(rec.index)} 块")
+    t0 = time.perf_counter()
+    scanned = ecg_record.Recording(path, use_trailer=False)
+    print(f"打开 (逐块扫描): {(time.perf_counter() - t0) * 1000:.2f} ms")
+    same = (np.array_equal(scanned.index, rec.index) and scanned.num_samples == rec.num_samples
+            and np.array_equal(scanned.beats[0], rec.beats[0]))
+    scanned.close()
+    if rec.num_samples != written or len(rec.beats[0]) != beats or not same:
+        print(f"  索引不一致: {rec.num_samples} 样本, {len(rec.beats[0])} 心跳, 扫描结果"
+              f"{'相同' if same else '不同'}")
+        ok = False
+
+    rng = np.random.default_rng(2)
+    latencies = []
+    mismatches = 0
+    span = rec.end_time - rec.start_time - args.window
+    for t in rec.start_time + rng.random(args.seeks) * max(span, 0):
+        t0 = time.perf_counter()
+        times, samples = rec.read_time(0, t, t + args.window)
+        latencies.append(time.perf_counter() - t0)
+        start = rec.position_at(t)
+        if not check_window(rec, start, len(samples), args.rate):
+            mismatches += 1
+    print(f"跳转并读取 {args.window:g} 秒: {percentiles(latencies)}"
+          + (f"  {mismatches} 次样本不符" if mismatches else ""))
+    ok &= mismatches == 0
+
+    for name, seconds in (("整个录制", None), ("1小时", 3600.0), ("1分钟", 60.0)):
+        count = rec.num_samples if seconds is None else min(int(seconds * args.rate), rec.num_samples)
+        latencies = []
+        for start in rng.integers(0, rec.num_samples - count + 1, 20):
+            t0 = time.perf_counter()
+            lo, hi = rec.envelope(0, int(start), count, args.bins)
+            latencies.append(time.perf_counter() - t0)
+        print(f"缩放 {name} 到 {len(lo)} 列: {percentiles(latencies)}")
+
+    rec.close()
+    if tmp:
+        tmp.cleanup()
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
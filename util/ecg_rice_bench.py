@@ -0,0 +1,196 @@
+"""固件样本压缩 (dma-adc-display/ecg_rice.c, ECG_COMPRESS) 的压缩比基准
+
+把心电记录用主机模拟器 (sim/) 回放给未修改的固件，从模拟器输出的UART字节流中取出所有样本帧，
+与同样样本按原始帧 (每样本2字节) 发送时的字节数相比:
+  负载压缩比: 原始负载字节数 / 实际负载字节数
+  线路压缩比: 同上，但两边都计入每帧的帧头和CRC (ECG_FRAME_OVERHEAD)，即串口上实际少发的比例
+  另外统计压缩后不更短、仍按原始帧发送的段的比例，选用二阶预测的比例、平均k和平均w
+  (w为逃逸码在14位原始位之外多带的位数，12位样本恒为0，14位样本 (ACQ_OVS_BITS=2) 最多为2)
+固件先滤波 (ECG_FILTER) 再压缩，测到的是线路上实际发送的数据；压缩构建默认每段80 ms (500 Hz时
+40个样本，见 timebase.h 的 TIMEBASE_SEGMENT_MS)
+不给出记录时回放模拟器内置的合成心跳
+
+输入:
+  MIT-BIH 记录 (.hea)，按 --gain 换算为 ADC 码值 (同 ecg_convert.py)
+  .ecgr 样本流 (ecg_convert.py 的输出)
+
+用法示例:
+  gcc -O2 -DHOST_SIM -Isim -Idma-adc-display -Wno-unknown-pragmas -o msp430_sim sim/*.c dma-adc-display/*.c -lm
+  python util/ecg_rice_bench.py --sim ./msp430_sim mitdb/100.hea mitdb/119.hea --seconds 300
+  python util/ecg_rice_bench.py --sim ./msp430_sim record.ecgr --rate 1000
+  14位样本: 用 -DACQ_OVERSAMPLE=16 -DACQ_OVS_BITS=2 编译模拟器，再同样运行
+"""
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+from ecg_convert import DEFAULT_GAIN, FIRMWARE_RATE, ECGR_MAGIC, read_mitbih, to_adc, write_ecgr
+from ecg_qrs_bench import HEADER_LEN, TRAILER_LEN, SIM_START_MARGIN_S, crc8, crc16_ccitt
+
+# 帧格式 (协议v2，见固件 ecg_proto.h)
+FRAME_OVERHEAD = HEADER_LEN + TRAILER_LEN
+FRAME_TYPE_SAMPLES = 0
+FRAME_TYPE_SAMPLES_RICE = 1
+FRAME_TYPE_SAMPLES_PLANAR = 3
+RICE_HEADER_LEN = 5  # 与 ecg_rice.h 一致: 样本数(2) | 参数(k为bit0-3, bit4为二阶预测, w为bit5-6) | 首样本(2)
+RICE_ORDER2 = 0x10
+RICE_K_MASK = 0x0F
+RICE_W_SHIFT = 5
+RICE_W_MASK = 0x60
+DEFAULT_SECONDS = 60.0  # 内置合成心跳回放的时长
+
+
+def ecgr_duration(path):
+    """读 .ecgr 的文件头，返回时长 (秒)"""
+    with open(path, 'rb') as f:
+        header = f.read(16)
+    if len(header) < 16 or header[:4] != ECGR_MAGIC:
+        sys.exit(f"{path} 不是 .ecgr 文件")
+    rate_mhz, count = struct.unpack_from('<II', header, 8)
+    return count / (rate_mhz / 1000.0)
+
+
+def run_firmware(sim, ecgr, seconds, firmware_rate, workdir):
+    """用模拟器运行固件 (ecgr 为 None 时用内置合成心跳)，返回UART输出文件路径"""
+    cmd = [sim, '-t', f'{seconds + SIM_START_MARGIN_S:.1f}', '-o', workdir]
+    if ecgr:
+        cmd += ['-r', ecgr]
+    if firmware_rate != FIRMWARE_RATE:
+        cmd += ['-f', str(firmware_rate)]
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+    return os.path.join(workdir, 'uart_tx.bin')
+
+
+def rice_blocks(payload, num_channels):
+    """把压缩帧负载拆成各通道的块；多于一个通道时每块前有2字节块长度。格式错误时返回None"""
+    if num_channels == 1:
+        return [payload]
+    blocks = []
+    pos = 0
+    for _ in range(num_channels):
+        if pos + 2 > len(payload):
+            return None
+        block_len = payload[pos] | payload[pos + 1] << 8
+        blocks.append(payload[pos + 2:pos + 2 + block_len])
+        pos += 2 + block_len
+    return blocks
+
+
+def measure(path):
+    """统计UART字节流中的样本帧，返回统计字典"""
+    data = open(path, 'rb').read()
+    s = {'frames': 0, 'rice': 0, 'order2': 0, 'k_sum': 0, 'w_sum': 0, 'blocks': 0, 'samples': 0,
+         'raw_bytes': 0, 'payload_bytes': 0, 'bad': 0}
+    i = 0
+    while i + HEADER_LEN <= len(data):
+        if data[i] != 0xAA or data[i + 1] != 0x55 or crc8(data[i + 2:i + 12]) != data[i + 12]:
+            i += 1
+            continue
+        payload_len = data[i + 3] | (data[i + 4] << 8)
+        end = i + HEADER_LEN + payload_len + TRAILER_LEN
+        if end > len(data):
+            break
+        if crc16_ccitt(data[i + 2:end - 2]) != (data[end - 2] | (data[end - 1] << 8)):
+            i += 1
+            continue
+        frame_type = data[i + 2] & 0x0F
+        num_channels = max(bin(data[i + 11]).count('1'), 1)
+        payload = data[i + HEADER_LEN:end - TRAILER_LEN]
+        i = end
+        if frame_type in (FRAME_TYPE_SAMPLES, FRAME_TYPE_SAMPLES_PLANAR):
+            count = payload_len // 2
+        elif frame_type == FRAME_TYPE_SAMPLES_RICE:
+            blocks = rice_blocks(payload, num_channels)
+            if not blocks or any(len(b) < RICE_HEADER_LEN for b in blocks):
+                s['bad'] += 1
+                continue
+            count = 0
+            for block in blocks:
+                count += block[0] | block[1] << 8
+                s['order2'] += bool(block[2] & RICE_ORDER2)
+                s['k_sum'] += block[2] & RICE_K_MASK
+                s['w_sum'] += (block[2] & RICE_W_MASK) >> RICE_W_SHIFT
+                s['blocks'] += 1
+            s['rice'] += 1
+        else:
+            continue
+        s['frames'] += 1
+        s['samples'] += count
+        s['raw_bytes'] += count * 2
+        s['payload_bytes'] += payload_len
+    return s
+
+
+def report(name, s):
+    if not s['frames']:
+        print(f"{name:<12} 没有样本帧")
+        return
+    payload_ratio = s['raw_bytes'] / s['payload_bytes']
+    wire_ratio = (s['raw_bytes'] + s['frames'] * FRAME_OVERHEAD) / \
+        (s['payload_bytes'] + s['frames'] * FRAME_OVERHEAD)
+    raw_share = (s['frames'] - s['rice']) / s['frames'] * 100
+    order2 = s['order2'] / s['blocks'] * 100 if s['blocks'] else 0.0
+    k_mean = s['k_sum'] / s['blocks'] if s['blocks'] else 0.0
+    w_mean = s['w_sum'] / s['blocks'] if s['blocks'] else 0.0
+    bits = s['payload_bytes'] * 8 / s['samples']
+    print(f"{name:<12} {s['samples']:>9} {s['frames']:>7} {bits:>7.2f} {payload_ratio:>7.2f} "
+          f"{wire_ratio:>7.2f} {raw_share:>6.1f} {order2:>6.1f} {k_mean:>5.2f} {w_mean:>5.2f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="用主机模拟器测量固件样本压缩的压缩比")
+    parser.add_argument('records', nargs='*', help="MIT-BIH 记录 (.hea) 或 .ecgr 样本流；不给出时用内置合成心跳")
+    parser.add_argument('--sim', default='./msp430_sim', help="主机模拟器可执行文件 (默认构建，定义了ECG_COMPRESS)")
+    parser.add_argument('--channel', type=int, default=0, help="MIT-BIH 记录使用的通道")
+    parser.add_argument('--gain', type=float, default=DEFAULT_GAIN, help="前端增益 (V/V)")
+    parser.add_argument('--seconds', type=float, help="每条记录最多回放的时长 (秒)")
+    parser.add_argument('--rate', type=int, default=FIRMWARE_RATE, choices=(250, 500, 1000, 2000),
+                        help="固件采样率 (Hz)")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.sim):
+        sys.exit(f"找不到模拟器 {args.sim}，编译方法见 sim/msp430_sim.c 开头")
+
+    print(f"{'记录':<10} {'样本':>9} {'帧':>7} {'位/样本':>7} {'负载比':>7} {'线路比':>7} "
+          f"{'原始%':>6} {'二阶%':>6} {'平均k':>5} {'平均w':>5}")
+    total = None
+    for path in args.records or [None]:
+        with tempfile.TemporaryDirectory() as workdir:
+            if path is None:
+                name = '合成心跳'
+                ecgr = None
+                duration = args.seconds or DEFAULT_SECONDS
+            elif path.lower().endswith('.ecgr'):
+                name = os.path.splitext(os.path.basename(path))[0]
+                ecgr = path
+                duration = ecgr_duration(path)
+            else:
+                base = os.path.splitext(path)[0]
+                name = os.path.basename(base)
+                values, rate = read_mitbih(base + '.hea', args.channel)
+                samples = to_adc(values, args.gain)
+                if args.seconds is not None:
+                    samples = samples[:int(args.seconds * rate)]
+                ecgr = os.path.join(workdir, 'record.ecgr')
+                write_ecgr(ecgr, samples, rate)
+                duration = len(samples) / rate
+            if args.seconds is not None:
+                duration = min(duration, args.seconds)
+            s = measure(run_firmware(args.sim, ecgr, duration, args.rate, workdir))
+        report(name, s)
+        if s['bad']:
+            print(f"{'':<12} {s['bad']} 个压缩帧格式错误")
+        if total is None:
+            total = s
+        else:
+            for key in total:
+                total[key] += s[key]
+    if len(args.records) > 1:
+        report('合计', total)
+
+
+if __name__ == '__main__':
+    main()
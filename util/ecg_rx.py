@@ -0,0 +1,175 @@
+"""本地接收库 host/ecg_rx.cpp 的 ctypes 封装
+
+库的编译命令见 host/ecg_rx.h 开头，编译出的 libecg_rx.so 放在本目录下。
+找不到库时 load() 返回 None，ecg_receiver.py 退回到纯Python的解析循环。
+
+用法:
+    rx = ecg_rx.load().attach(ser.fileno())
+    rx.pump(100)
+    for ev in rx.events():
+        samples = rx.read(0, ev.ring_pos, ev.num_samples)
+"""
+import ctypes
+import os
+import numpy as np
+
+MAX_PAYLOAD = 1024  # 与固件 ecg_proto.h 的 ECG_MAX_PAYLOAD 一致
+MAX_CHANNELS = 8
+EVENT_FRAME = 0  # 通过两个CRC的数据帧
+EVENT_CTRL = 1  # 校验通过的链路控制帧，type 为命令，arg 为参数
+
+LIB_NAME = 'libecg_rx.so'
+
+
+class Event(ctypes.Structure):
+    """与 ecg_rx_c.h 的 EcgRxEvent 对应；样本帧的样本在环形缓冲区中，payload 为空"""
+    _fields_ = [
+        ('kind', ctypes.c_uint8),
+        ('type', ctypes.c_uint8),
+        ('channel_mask', ctypes.c_uint8),
+        ('num_channels', ctypes.c_uint8),
+        ('seq', ctypes.c_uint16),
+        ('payload_len', ctypes.c_uint16),
+        ('sample_index', ctypes.c_uint32),
+        ('num_samples', ctypes.c_uint32),  # 每通道；解码失败的样本帧为0
+        ('arg', ctypes.c_uint32),
+        ('ring_pos', ctypes.c_uint64),  # 该帧第一个样本在环形缓冲区中的位置
+        ('arrival', ctypes.c_double),  # 最后一个字节读到的时刻，与 time.time() 同一时钟
+        ('payload_buf', ctypes.c_uint8 * MAX_PAYLOAD),
+    ]
+
+    @property
+    def payload(self):
+        return bytes(self.payload_buf[:self.payload_len])
+
+
+class Stats(ctypes.Structure):
+    """与 ecg_rx_c.h 的 EcgRxStats 对应，均为累计值"""
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        'bytes', 'frames_ok', 'ctrl_frames', 'header_errors', 'crc_errors', 'ctrl_errors',
+        'bytes_skipped', 'decode_errors', 'events_dropped')]
+
+
+class Receiver:
+    """一个本地接收器：从串口批量读取、分帧、校验并把样本解码到按通道分开的环形缓冲区"""
+
+    def __init__(self, lib, handle):
+        self._lib = lib
+        self._handle = handle
+        self._event = Event()
+        self.capacity = lib.ecg_rx_ring_capacity(handle)
+
+    def close(self):
+        if self._handle:
+            self._lib.ecg_rx_close(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+    def set_baud(self, baud):
+        if self._lib.ecg_rx_set_baud(self._handle, baud) != 0:
+            raise OSError(ctypes.get_errno(), os.strerror(ctypes.get_errno()))
+
+    def write(self, data):
+        n = self._lib.ecg_rx_write(self._handle, bytes(data), len(data))
+        if n < 0:
+            raise OSError(ctypes.get_errno(), os.strerror(ctypes.get_errno()))
+        return n
+
+    def pump(self, timeout_ms):
+        """等待至多 timeout_ms 毫秒，读取并解码已到达的全部数据，返回产生的事件数"""
+        n = self._lib.ecg_rx_pump(self._handle, timeout_ms)
+        if n < 0:
+            raise OSError(ctypes.get_errno(), os.strerror(ctypes.get_errno()))
+        return n
+
+    def feed(self, data, arrival=0.0):
+        """解码内存中的字节流 (例如模拟器输出的 uart_tx.bin)"""
+        return self._lib.ecg_rx_feed(self._handle, bytes(data), len(data), arrival)
+
+    def reset(self):
+        """丢弃尚未成帧的字节，例如切换波特率之后"""
+        self._lib.ecg_rx_reset(self._handle)
+
+    def events(self):
+        """依次取出全部待处理的事件；每次产生的是同一个对象，需要保留时请复制字段"""
+        while self._lib.ecg_rx_poll_event(self._handle, ctypes.byref(self._event)):
+            yield self._event
+
+    def stats(self):
+        out = Stats()
+        self._lib.ecg_rx_get_stats(self._handle, ctypes.byref(out))
+        return out
+
+    def head(self):
+        """环形缓冲区已写入的样本数 (每通道)"""
+        return self._lib.ecg_rx_ring_head(self._handle)
+
+    def read(self, channel, pos, count):
+        """读取一个通道从 pos 开始的 count 个样本，返回 uint16 数组；已被覆盖的部分不返回"""
+        out = np.empty(count, dtype=np.uint16)
+        cursor = ctypes.c_uint64(pos)
+        n = self._lib.ecg_rx_ring_read(self._handle, channel, ctypes.byref(cursor),
+                                       out.ctypes.data_as(ctypes.POINTER(ctypes.c_uint16)), count)
+        return out[:n]
+
+    def channel_view(self, channel):
+        """一个通道的环形缓冲区本身 (不复制)，位置 p 在下标 p % capacity 处"""
+        ptr = self._lib.ecg_rx_ring_channel(self._handle, channel)
+        return np.ctypeslib.as_array(ptr, shape=(self.capacity,))
+
+
+class Library:
+    def __init__(self, path):
+        lib = ctypes.CDLL(path, use_errno=True)
+        handle = ctypes.c_void_p
+        u16p = ctypes.POINTER(ctypes.c_uint16)
+        for name, restype, argtypes in (
+                ('ecg_rx_open', handle, [ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint32]),
+                ('ecg_rx_attach', handle, [ctypes.c_int, ctypes.c_uint32]),
+                ('ecg_rx_close', None, [handle]),
+                ('ecg_rx_set_baud', ctypes.c_int, [handle, ctypes.c_uint32]),
+                ('ecg_rx_write', ctypes.c_int, [handle, ctypes.c_char_p, ctypes.c_uint32]),
+                ('ecg_rx_pump', ctypes.c_int, [handle, ctypes.c_int]),
+                ('ecg_rx_feed', ctypes.c_int, [handle, ctypes.c_char_p, ctypes.c_uint32,
+                                               ctypes.c_double]),
+                ('ecg_rx_reset', None, [handle]),
+                ('ecg_rx_poll_event', ctypes.c_int, [handle, ctypes.POINTER(Event)]),
+                ('ecg_rx_get_stats', None, [handle, ctypes.POINTER(Stats)]),
+                ('ecg_rx_ring_capacity', ctypes.c_uint32, [handle]),
+                ('ecg_rx_ring_head', ctypes.c_uint64, [handle]),
+                ('ecg_rx_ring_channel', u16p, [handle, ctypes.c_uint8]),
+                ('ecg_rx_ring_read', ctypes.c_uint32, [handle, ctypes.c_uint8,
+                                                       ctypes.POINTER(ctypes.c_uint64), u16p,
+                                                       ctypes.c_uint32])):
+            func = getattr(lib, name)
+            func.restype = restype
+            func.argtypes = argtypes
+        self._lib = lib
+
+    def open(self, path, baud, ring_capacity=1 << 16):
+        """打开串口设备 (原始8N1模式)；ring_capacity 为每通道保留的样本数，须为2的幂"""
+        handle = self._lib.ecg_rx_open(path.encode(), baud, ring_capacity)
+        if not handle:
+            raise OSError(ctypes.get_errno(), f"{path}: {os.strerror(ctypes.get_errno())}")
+        return Receiver(self._lib, handle)
+
+    def attach(self, fd, ring_capacity=1 << 16):
+        """从别处已打开的描述符读取 (例如 pyserial 的 fileno())，关闭接收器时不关闭它"""
+        handle = self._lib.ecg_rx_attach(fd, ring_capacity)
+        if not handle:
+            raise OSError(ctypes.get_errno(), os.strerror(ctypes.get_errno()))
+        return Receiver(self._lib, handle)
+
+
+def load(path=None):
+    """加载本地接收库，找不到或加载失败时返回 None"""
+    path = path or os.path.join(os.path.dirname(os.path.abspath(__file__)), LIB_NAME)
+    if not os.path.exists(path):
+        return None
+    try:
+        return Library(path)
+    except OSError as e:
+        print(f"无法加载 {path}: {e}")
+        return None